@@ -6,6 +6,37 @@
 #include <future>
 #include <iostream>
 #include <condition_variable>
+#include <coroutine>
+#include <chrono>
+#include <unordered_map>
+#include <string>
+
+#include <job.hpp>
+#include <job_trace.hpp>
+
+/**
+ * @brief Options used to create the workers of a Boss
+ */
+struct BossConfig {
+
+	/** Number of workers to create. Negative uses one per core not reserved, 0 runs every job inline on the calling thread */
+	int worker_count = -1;
+
+	/** Cores left for the main thread and the driver, workers are never pinned to them */
+	unsigned int reserved_cores = 1;
+
+	/** Pins each worker to a single core, cycling through the cores that aren't reserved */
+	bool pin_workers = false;
+
+	/** Explicit list of cores to pin the workers to, overrides the reserved cores when not empty */
+	std::vector<unsigned int> affinity;
+
+	/** Prefix of the worker names shown by debuggers and profilers, followed by the worker index */
+	std::string thread_name = "EVE Worker";
+
+	/** Records the timing of every job from the start, see Boss::set_telemetry */
+	bool telemetry = false;
+};
 
 /**
  * @brief	Manages the multithread management of tasks
@@ -16,34 +47,207 @@ public:
 
 	Boss();
 
+	/**
+	 * @brief Creates the workers following the given configuration
+	 *
+	 * @param config Number of workers, affinity and names of the threads
+	 */
+	explicit Boss(const BossConfig& config);
+
 	~Boss();
 
 	/**
 	* @brief Adds a task to the job list
 	*
 	* @param task Task to execute
-	* 
+	*
 	* @return std::future<T> Future result of the task
 	*/
 	template<typename T>
 	auto add(std::function<T()> task) -> std::future<T>;
 
+	/**
+	 * @brief Adds a task to the job list without creating a future for it.
+	 * The task is stored inside a pooled job, so no allocations are made if it's small enough
+	 *
+	 * @param task Callable object with the signature void() to execute
+	 * @param counter Optional counter that will be decremented when the task finishes
+	 */
+	template<typename F>
+	void run(F&& task, JobCounter* counter = nullptr);
+
+	/**
+	 * @brief Blocks until all the jobs of a counter have finished.
+	 * The calling thread executes queued jobs meanwhile instead of sleeping.
+	 * Once it returns no job uses the counter anymore, it can be destroyed or reused
+	 *
+	 * @param counter Counter to wait for
+	 */
+	void wait(JobCounter* counter);
+
+	/**
+	 * @brief Stores a suspended coroutine to be resumed by run_frame_continuations
+	 *
+	 * @param handle Coroutine to resume on the next frame
+	 */
+	void defer_to_next_frame(std::coroutine_handle<> handle);
+
+	/**
+	 * @brief Resumes every coroutine waiting for the next frame on the calling thread.
+	 * Called once per frame by the engine from the main thread
+	 */
+	void run_frame_continuations();
+
+	/**
+	 * @brief Runs the queued jobs and the coroutines waiting for the next frame until nothing is left,
+	 * so the coroutines still loading something finish and free their frames.
+	 * Called from the main thread before shutting down, while what they use is still alive
+	 */
+	void drain();
+
+	/**
+	 * @brief Returns the number of worker threads
+	 *
+	 * @return unsigned int Number of workers, 0 if the jobs run inline
+	 */
+	unsigned int get_worker_count() const;
+
+	/**
+	 * @brief Enables or disables recording the queue wait, start and end of every job.
+	 * The counters of BossStats that aren't timings are always recorded
+	 *
+	 * @param enabled If the jobs have to be traced
+	 */
+	void set_telemetry(bool enabled);
+
+	/**
+	 * @brief Returns if the jobs are being traced
+	 *
+	 * @return bool True if the telemetry is enabled
+	 */
+	bool is_telemetry_enabled() const;
+
+	/**
+	 * @brief Removes every traced job and resets the counters. Call it while there are no jobs running
+	 */
+	void reset_telemetry();
+
+	/**
+	 * @brief Returns the counters of the job system added over all the threads
+	 *
+	 * @return BossStats Accumulated counters
+	 */
+	BossStats get_stats();
+
+	/**
+	 * @brief Writes the traced jobs in the JSON format of chrome://tracing and Perfetto
+	 *
+	 * @param filepath Route of the file to write
+	 *
+	 * @return bool True if the file has been written
+	 */
+	bool export_chrome_trace(const char* filepath);
+
 	/**
 	 * @brief Returns the number of jobs remaining on the list
-	 * 
+	 *
 	 * @return int Number of jobs remaining
 	 */
 	int get_job_count();
 
 	/**
 	 * @brief Get the mutex used to lock thread management
-	 * 
+	 *
 	 * @return std::mutex* Pointer to the mutex object
 	 */
-	std::mutex* get_mutex();	
+	std::mutex* get_mutex();
 
 private:
 
+	/**
+	 * @brief Everything the boss keeps for each thread that uses it
+	 */
+	struct ThreadState {
+		/** Pool to allocate the jobs added from the thread */
+		JobPool pool_;
+		/** Jobs executed by the thread while the telemetry is enabled */
+		JobTraceBuffer trace_;
+		/** Name of the thread on the exported traces */
+		std::string name_;
+		/** Identifier of the thread on the exported traces, workers go first */
+		unsigned int index_ = 0;
+		/** If the thread is one of the workers of the boss */
+		bool worker_ = false;
+
+		//Counters only written by the owner thread, atomic so they can be read from any other
+		std::atomic<uint64_t> jobs_executed_{ 0 };
+		std::atomic<uint64_t> jobs_helped_{ 0 };
+		std::atomic<uint64_t> lock_acquisitions_{ 0 };
+		std::atomic<uint64_t> lock_contentions_{ 0 };
+		std::atomic<uint64_t> queue_wait_ns_{ 0 };
+		std::atomic<uint64_t> run_ns_{ 0 };
+	};
+
+	/**
+	 * @brief Returns the state of the calling thread, creating it the first time
+	 *
+	 * @return ThreadState* State of the calling thread for this boss
+	 */
+	ThreadState* get_local_state();
+
+	/**
+	 * @brief Loop executed by every worker until the boss is destroyed
+	 *
+	 * @param index Index of the worker
+	 * @param name Name of the worker
+	 */
+	void worker_loop(unsigned int index, const std::string& name);
+
+	/**
+	 * @brief Locks the queue mutex counting if another thread was holding it
+	 *
+	 * @param lock Unlocked lock of queue_mutex_
+	 * @param state State of the calling thread
+	 */
+	void lock_queue(std::unique_lock<std::mutex>& lock, ThreadState* state);
+
+	/**
+	 * @brief Nanoseconds since the boss was created
+	 *
+	 * @return uint64_t Current time of the trace
+	 */
+	uint64_t trace_now() const;
+
+	/**
+	 * @brief Adds an already bound job at the end of the queue and wakes up a worker
+	 *
+	 * @param job Job to queue
+	 * @param state State of the calling thread
+	 */
+	void push_job(Job* job, ThreadState* state);
+
+	/**
+	 * @brief Takes the first job of the queue. The queue mutex must be locked
+	 *
+	 * @return Job* First job of the queue, nullptr if empty
+	 */
+	Job* pop_job();
+
+	/**
+	 * @brief Executes one queued job on the calling thread, if there's any
+	 *
+	 * @return bool True if a job has been executed
+	 */
+	bool run_one();
+
+	/**
+	 * @brief Runs a job, records it and returns it to its pool
+	 *
+	 * @param job Job to execute
+	 * @param state State of the calling thread
+	 */
+	void execute(Job* job, ThreadState* state);
+
 	/**
 	 * @brief Condition used to lock threads until a condition is met
 	 */
@@ -60,9 +264,64 @@ private:
 	std::vector<std::thread> workers_;
 
 	/**
-	 * @brief Queue of jobs remaining
+	 * @brief First job of the intrusive queue of jobs remaining
+	 */
+	Job* queue_head_;
+
+	/**
+	 * @brief Last job of the intrusive queue of jobs remaining
 	 */
-	std::queue<std::function<void()>> jobs_;
+	Job* queue_tail_;
+
+	/**
+	 * @brief Number of jobs on the queue
+	 */
+	int job_count_;
+
+	/**
+	 * @brief Jobs taken from the queue that haven't finished yet
+	 */
+	std::atomic<int> running_jobs_;
+
+	/**
+	 * @brief Mutex to protect the creation of thread states
+	 */
+	std::mutex threads_mutex_;
+
+	/**
+	 * @brief State of every thread that has used this boss
+	 */
+	std::unordered_map<std::thread::id, std::unique_ptr<ThreadState>> threads_;
+
+	/**
+	 * @brief Index given to the next thread that isn't a worker
+	 */
+	unsigned int next_thread_index_;
+
+	/**
+	 * @brief If the jobs are being traced
+	 */
+	std::atomic<bool> telemetry_;
+
+	/**
+	 * @brief Moment the boss was created, origin of the trace timestamps
+	 */
+	std::chrono::steady_clock::time_point trace_start_;
+
+	/**
+	 * @brief Mutex to protect the coroutines waiting for the next frame
+	 */
+	std::mutex frame_mutex_;
+
+	/**
+	 * @brief Coroutines waiting for the next frame
+	 */
+	std::vector<std::coroutine_handle<>> frame_continuations_;
+
+	/**
+	 * @brief Unique identifier of the boss, used to cache the pool of each thread
+	 */
+	unsigned int id_;
 
 	bool stop_;
 
@@ -70,24 +329,47 @@ private:
 
 template<typename T>
 auto Boss::add(std::function<T()> task) -> std::future<T> {
-	// Lock mutex to avoid that more than one thread can access the jobs queue
-	//std::lock_guard<std::mutex> lock{ queue_mutex_ };
 
-	auto t = std::make_shared<std::packaged_task<T()>>(task);
-	std::future<T> f = t->get_future();
+	std::promise<T> promise;
+	std::future<T> f = promise.get_future();
 
-	std::unique_lock<std::mutex> lk(queue_mutex_);
+	run([t = std::move(task), p = std::move(promise)]() mutable {
+		try {
+			if constexpr (std::is_void_v<T>) {
+				t();
+				p.set_value();
+			}
+			else {
+				p.set_value(t());
+			}
+		}
+		catch (...) {
+			p.set_exception(std::current_exception());
+		}
+	});
 
-	// As we receive a shared pointer to a function pointer, we take it out of the shared
-	// pointer in order to call the function in the packaged task
-	jobs_.push([t]() {
-		(*t)();
-		});
+	return f;
+}
 
-	lk.unlock();
-	job_condition_.notify_one();
+template<typename F>
+void Boss::run(F&& task, JobCounter* counter) {
+	ThreadState* state = get_local_state();
+	Job* job = state->pool_.Allocate();
+	job->Bind(std::forward<F>(task));
+	job->enqueue_ns_ = telemetry_.load(std::memory_order_relaxed) ? trace_now() : 0;
 
-	return f;
+	if (counter != nullptr) {
+		job->counter_ = counter;
+		counter->pending_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Without workers the job runs right away, making the order of execution deterministic
+	if (workers_.empty()) {
+		execute(job, state);
+		return;
+	}
+
+	push_job(job, state);
 }
 
 #endif //__BOSS_HPP__
\ No newline at end of file
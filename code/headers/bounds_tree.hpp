@@ -0,0 +1,262 @@
+#ifndef __BOUNDS_TREE_HPP__
+#define __BOUNDS_TREE_HPP__	1
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include <frustum_culling.hpp>
+
+//Index of no node
+const int32_t kBoundsTreeNullNode = -1;
+//Room added around the box of a leaf relative to its size, so objects moving a little don't change the tree
+const float kBoundsTreeMargin = 0.1f;
+//Room added around the box of a leaf at least, for flat or tiny objects
+const float kBoundsTreeMinMargin = 0.05f;
+//How many times the surface of a leaf's enlarged box can be bigger than the one it would get now before it's reinserted
+const float kBoundsTreeShrinkRatio = 4.0f;
+
+/**
+ * @brief Gets the axis aligned box of a box once transformed
+ *
+ * @param bounds_min Minimum corner of the box
+ * @param bounds_max Maximum corner of the box
+ * @param transform Transform to apply
+ * @param world_min Where to store the minimum corner of the transformed box
+ * @param world_max Where to store the maximum corner of the transformed box
+ */
+void TransformBounds(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::mat4& transform, glm::vec3* world_min, glm::vec3* world_max);
+
+/**
+ * @brief Entity hit by a ray
+ */
+struct BoundsTreeHit {
+	/** Entity of the leaf hit */
+	size_t entity_;
+	/** Distance along the ray to where it enters the box, 0 if it starts inside */
+	float distance_;
+};
+
+/**
+ * @brief Node of the tree, a leaf with the box of an entity or the union of its two children
+ */
+struct BoundsTreeNode {
+	/** Minimum corner of the box. Leaves keep it enlarged so small moves don't reinsert them */
+	glm::vec3 min_;
+	/** Maximum corner of the box */
+	glm::vec3 max_;
+	/** Minimum corner of the exact box of the entity, only leaves */
+	glm::vec3 tight_min_;
+	/** Maximum corner of the exact box of the entity, only leaves */
+	glm::vec3 tight_max_;
+	/** Parent of the node, or the next free node if it's free */
+	int32_t parent_;
+	/** Children of the node, kBoundsTreeNullNode in leaves */
+	int32_t children_[2];
+	/** Levels below the node, 0 in leaves and -1 if the node is free */
+	int32_t height_;
+	/** Entity of a leaf */
+	size_t entity_;
+
+	bool IsLeaf() const { return children_[0] == kBoundsTreeNullNode; }
+};
+
+/**
+ * @brief Dynamic bounding volume hierarchy of axis aligned boxes. Each entity is a leaf, inserted next to the
+ * node that makes the surface of the tree grow the least, and the tree is rotated back into balance on the way up.
+ * Leaves are enlarged a bit, objects moving inside their enlarged box only update their exact box, and the rest
+ * are reinserted refitting their old and new ancestors. Queries visit only the nodes overlapping what they test,
+ * and frustum queries take whole subtrees inside the frustum without testing them.
+ * Updates are single threaded, queries can run from several threads at once while there are no updates
+ */
+class BoundsTree {
+public:
+	BoundsTree();
+
+	/**
+	 * @brief Adds a leaf
+	 *
+	 * @param bounds_min Minimum corner of the box of the entity
+	 * @param bounds_max Maximum corner of the box of the entity
+	 * @param entity Entity the leaf belongs to, returned by the queries
+	 *
+	 * @return int32_t Proxy of the leaf, to move and destroy it
+	 */
+	int32_t CreateProxy(const glm::vec3& bounds_min, const glm::vec3& bounds_max, size_t entity);
+
+	/**
+	 * @brief Removes a leaf
+	 *
+	 * @param proxy Proxy returned by CreateProxy
+	 */
+	void DestroyProxy(int32_t proxy);
+
+	/**
+	 * @brief Changes the box of a leaf. The tree only changes if the box leaves the enlarged one or it's too small for it
+	 *
+	 * @param proxy Proxy returned by CreateProxy
+	 * @param bounds_min Minimum corner of the new box
+	 * @param bounds_max Maximum corner of the new box
+	 *
+	 * @return bool True if the leaf was reinserted
+	 */
+	bool MoveProxy(int32_t proxy, const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+
+	/**
+	 * @brief Changes the entity of a leaf, for entities that swapped their ids
+	 *
+	 * @param proxy Proxy returned by CreateProxy
+	 * @param entity New entity
+	 */
+	void SetEntity(int32_t proxy, size_t entity) { nodes_[proxy].entity_ = entity; }
+
+	size_t GetEntity(int32_t proxy) const { return nodes_[proxy].entity_; }
+
+	/**
+	 * @brief Gets the exact box of a leaf
+	 *
+	 * @param proxy Proxy returned by CreateProxy
+	 * @param bounds_min Where to store the minimum corner
+	 * @param bounds_max Where to store the maximum corner
+	 */
+	void GetBounds(int32_t proxy, glm::vec3* bounds_min, glm::vec3* bounds_max) const;
+
+	/**
+	 * @brief Removes every leaf, keeping the memory
+	 */
+	void Clear();
+
+	/**
+	 * @brief Gets the entities whose box overlaps a box
+	 *
+	 * @param bounds_min Minimum corner of the box
+	 * @param bounds_max Maximum corner of the box
+	 * @param entities Where to append the entities found
+	 */
+	void QueryAabb(const glm::vec3& bounds_min, const glm::vec3& bounds_max, std::vector<size_t>* entities) const;
+
+	/**
+	 * @brief Gets the entities whose box overlaps a sphere
+	 *
+	 * @param center Center of the sphere
+	 * @param radius Radius of the sphere
+	 * @param entities Where to append the entities found
+	 */
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<size_t>* entities) const;
+
+	/**
+	 * @brief Gets the entities whose box is inside any of several frustums, each entity only once
+	 *
+	 * @param frustums Frustums to test
+	 * @param frustum_count Number of frustums, kCubeFaceCount for the faces of a cube
+	 * @param entities Where to append the entities found
+	 */
+	void QueryFrustum(const Frustum* frustums, unsigned int frustum_count, std::vector<size_t>* entities) const;
+
+	/**
+	 * @brief Gets the entities below a node whose box is inside any of several frustums, to split a query
+	 * over the subtrees given by GetSubtrees
+	 *
+	 * @param subtree Node to start from
+	 * @param frustums Frustums to test
+	 * @param frustum_count Number of frustums
+	 * @param entities Where to append the entities found
+	 */
+	void QueryFrustum(int32_t subtree, const Frustum* frustums, unsigned int frustum_count, std::vector<size_t>* entities) const;
+
+	/**
+	 * @brief Splits the tree in subtrees that don't share any leaf, replacing the highest one by its children
+	 * until there are enough of them
+	 *
+	 * @param count Subtrees wanted, there are less if the tree doesn't have that many leaves
+	 * @param subtrees Where to store the nodes at the top of each subtree, none if the tree is empty
+	 */
+	void GetSubtrees(size_t count, std::vector<int32_t>* subtrees) const;
+
+	/**
+	 * @brief Gets the entities whose box a ray goes through
+	 *
+	 * @param origin Start of the ray
+	 * @param direction Direction of the ray, it doesn't have to be normalized
+	 * @param max_distance Length of the ray, in units of the direction
+	 * @param hits Where to store the entities hit, the nearest first
+	 */
+	void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float max_distance, std::vector<BoundsTreeHit>* hits) const;
+
+	/**
+	 * @brief Gets the levels of the tree, about the logarithm of the leaves while it's balanced
+	 *
+	 * @return int32_t Height of the root, -1 if it's empty
+	 */
+	int32_t GetHeight() const { return root_ == kBoundsTreeNullNode ? -1 : nodes_[root_].height_; }
+
+	size_t GetLeafCount() const { return leaf_count_; }
+
+private:
+	/**
+	 * @brief Takes a node from the free list, growing the pool if there's none
+	 *
+	 * @return int32_t Index of the node
+	 */
+	int32_t AllocateNode();
+
+	/**
+	 * @brief Returns a node to the free list
+	 *
+	 * @param node Index of the node
+	 */
+	void FreeNode(int32_t node);
+
+	/**
+	 * @brief Links a leaf to the tree, as the sibling of the node that makes the tree grow the least
+	 *
+	 * @param leaf Leaf with its box set
+	 */
+	void InsertLeaf(int32_t leaf);
+
+	/**
+	 * @brief Unlinks a leaf from the tree, its sibling takes the place of their parent
+	 *
+	 * @param leaf Leaf to unlink
+	 */
+	void RemoveLeaf(int32_t leaf);
+
+	/**
+	 * @brief Finds the node the leaf has to be the sibling of, going down the child whose surface
+	 * grows the least until stopping is cheaper than going further
+	 *
+	 * @param leaf Leaf to insert
+	 *
+	 * @return int32_t Best sibling
+	 */
+	int32_t FindBestSibling(int32_t leaf) const;
+
+	/**
+	 * @brief Walks from a node to the root balancing and refitting the boxes and heights
+	 *
+	 * @param node First node to refit
+	 */
+	void Refit(int32_t node);
+
+	/**
+	 * @brief Rotates a node if one of its children is more than one level higher than the other
+	 *
+	 * @param node Node to balance
+	 *
+	 * @return int32_t Node at the place of the one given after the rotation
+	 */
+	int32_t Balance(int32_t node);
+
+	/** Nodes of the tree and free nodes, in the same pool */
+	std::vector<BoundsTreeNode> nodes_;
+	/** Root node */
+	int32_t root_;
+	/** First free node */
+	int32_t free_list_;
+	/** Leaves in the tree */
+	size_t leaf_count_;
+};
+
+#endif //__BOUNDS_TREE_HPP__
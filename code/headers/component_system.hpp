@@ -20,6 +20,7 @@
 #include <framebuffer_to_texture.hpp>
 #include <deferred_framebuffer.hpp>
 #include <depth_map.hpp>
+#include <bounds_tree.hpp>
 
 //Include the components
 #include <transform.hpp>
@@ -668,6 +669,22 @@ struct ComponentManager {
 	/** Run the commands that are necessary each frame */
 	void Update();
 
+	//## Spatial queries ##
+	/** Boxes of the renderers that can be drawn, in world space, for culling and spatial queries */
+	BoundsTree bounds_tree_;
+	/** Proxies in the bounds tree, to find the ones of renderers removed */
+	std::vector<int32_t> bounds_proxies_;
+	/** Whether each node of the bounds tree was claimed by a renderer on the last update */
+	std::vector<unsigned char> bounds_proxy_seen_;
+
+	/**
+	 * @brief Moves the box of every renderer in the bounds tree to where its transform puts it. Renderers added
+	 * get a proxy and the ones removed, or without a mesh anymore, lose theirs. The tree answers for the renderers
+	 * as they were on the last call
+	 */
+	void UpdateBoundsTree();
+	//##
+
 
 	//For debug information
 	/** Number of draw calls of the frame */
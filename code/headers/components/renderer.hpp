@@ -4,6 +4,14 @@
 #include <vector>
 #include <memory>
 #include <tinyobj.hpp>
+#include <bounds_tree.hpp>
+
+//Projected size, relative to the height of the view, under which the first simplified LOD is used. Each next LOD halves it
+const float kLodScreenSize = 0.5f;
+//How far past a threshold the projected size has to go to switch LOD, relative to it, so objects on the edge don't flicker
+const float kLodHysteresis = 0.1f;
+//Shadow maps have less resolution than the screen, the shadow LOD takes the objects as this much smaller than the camera sees them
+const float kShadowLodScale = 0.5f;
 
 /**
  * @brief Renderer component that allows an entity to be drawn
@@ -21,12 +29,26 @@ struct RendererComponent {
 	bool casts_shadows_;
 	/** Whether the object shows shadows of other objects */
 	bool receives_shadows_;
+	/** Whether the object hides the ones behind it from the camera, for the big ones like walls. Its mesh is kept on the CPU */
+	bool occluder_;
 
 	/** Mesh of the renderer component */
 	std::shared_ptr<TinyObj> mesh_;
 	/** Different textures that can render the renderer component */
 	std::vector<std::shared_ptr<Texture>> textures_;
 
+	/** Level of detail of the mesh drawn in the main view */
+	unsigned char lod_;
+	/** Level of detail of the mesh drawn in every shadow view, selected from the size on the camera view, not the one on each light */
+	unsigned char shadow_lod_;
+
+	/** Leaf of the renderer in the bounds tree of the component manager, kBoundsTreeNullNode until it's drawable */
+	int32_t bounds_proxy_;
+	/** Whether the mesh changed since the leaf was last moved */
+	bool bounds_dirty_;
+	/** Bounds generation of the mesh when the leaf was last moved */
+	uint32_t bounds_generation_;
+
 	RendererComponent();
 
 	/**
@@ -57,6 +79,17 @@ struct RendererComponent {
 	 */
 	RendererComponent* ChangeMesh(std::shared_ptr<TinyObj> new_mesh);
 
+	/**
+	 * @brief Selects the level of detail from the size the mesh projects on the camera view.
+	 * The current one is kept until the size is past the threshold by kLodHysteresis
+	 *
+	 * @param screen_size Diameter of the bounding sphere of the mesh relative to the height of the camera view
+	 * @param shadow_view Whether to select the LOD shared by the shadow views, scaling the size by kShadowLodScale, or the main one
+	 *
+	 * @return unsigned char The selected level of detail
+	 */
+	unsigned char SelectLod(float screen_size, bool shadow_view);
+
 };
 
 #endif
\ No newline at end of file
@@ -35,6 +35,8 @@ protected:
 
 	/** Dirty flag to mark when the children of the tree need to be updated */
 	bool updated_;
+	/** Dirty flag to mark when the box of the renderer in the bounds tree needs to be moved */
+	bool bounds_dirty_;
 
 public:
 	TransformComponent();
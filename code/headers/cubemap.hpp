@@ -19,6 +19,7 @@
 #endif
 
 struct TinyObj;
+class GeometryArena;
 
 struct Cubemap {
 
@@ -33,7 +34,12 @@ struct Cubemap {
 
 #ifdef RENDER_OPENGL
   std::unique_ptr<Program> program_;
-  Cubemap();
+  /**
+   * @brief Loads the cube mesh into a geometry arena and compiles the cubemap program
+   *
+   * @param arena Arena to upload the cube to
+   */
+  Cubemap(std::shared_ptr<GeometryArena> arena);
   bool addTexture(std::string filepath);
 #endif
 
@@ -13,6 +13,7 @@
 #include <scene_manager.hpp>
 #include <imgui_functions.hpp>
 #include <boss.hpp>
+#include <gltf_loader.hpp>
 
 #ifdef RENDER_OPENGL
     #include <framebuffer_to_texture.hpp>
@@ -91,6 +92,35 @@ public:
     */
     std::shared_ptr<TinyObj> AddMesh(std::string filepath);
     /**
+    * @brief Streams a mesh in over the next frames, drawing it while it's read. Meant for
+    * very big models, the mesh isn't optimized like the ones loaded with AddMesh
+    * 
+    * @param filepath Route to the OBJ file
+    */
+    std::shared_ptr<TinyObj> StreamMesh(std::string filepath);
+    /**
+    * @brief Loads a texture on the workers and uploads it over the next frames, a few
+    * megabytes per frame, so loading it mid-game doesn't stall the frame
+    * 
+    * @param filepath Route to the image
+    */
+    std::shared_ptr<Texture> StreamTexture(std::string filepath);
+    /**
+    * @brief Sets the memory the mip levels of the textures can take on the GPU. Over it, the
+    * textures are drawn with less detailed levels than their size on screen needs
+    * 
+    * @param bytes Budget in bytes
+    */
+    void SetTextureBudget(size_t bytes);
+    /**
+    * @brief Imports a glTF binary file (.glb), creating an entity per node with its meshes
+    * 
+    * @param filepath Route to the .glb file
+    * 
+    * @return size_t Entity the nodes of the file hang from, 0 if it couldn't be loaded
+    */
+    size_t LoadGltf(std::string filepath);
+    /**
     * @brief Loads a new mesh based on the filepath given
     *
     * @param filepath Route to the resource
@@ -115,7 +145,14 @@ public:
     void Render();
 
     Engine() = delete;
-    Engine(int window_w, int window_h);
+    /**
+     * @brief Creates the engine and its window
+     * 
+     * @param window_w Width of the window
+     * @param window_h Height of the window
+     * @param boss_config Number, affinity and names of the job system workers
+     */
+    Engine(int window_w, int window_h, const BossConfig& boss_config = BossConfig());
 #ifdef RENDER_DIRECTX11
     Engine(ID3D11Device* device, ID3D11DeviceContext* devCont, 
         IDXGISwapChain* swap, ID3D11DepthStencilView* depthStencil, HWND hwnd, int window_w, int window_h);
@@ -131,12 +168,12 @@ private:
     std::unique_ptr<ComponentManager> component_manager_;
     /** Scene manager to save and load a scene from the database */
     std::unique_ptr<SceneManager> scene_manager_;
-    /** Boss system to multithread */
-    std::unique_ptr<Boss> boss_system_;
-
     /** Render system that will take care of the displaying of elements */
     std::unique_ptr<RenderSystem> render_system_;
 
+    /** Boss system to multithread. Declared after the systems its jobs use, so the workers stop before they are destroyed */
+    std::unique_ptr<Boss> boss_system_;
+
     /** OpenAL Device */
     ALCdevice* audio_device_;
     /** OpenAL Context */
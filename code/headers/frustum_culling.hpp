@@ -0,0 +1,66 @@
+#ifndef __FRUSTUM_CULLING_HPP__
+#define __FRUSTUM_CULLING_HPP__	1
+
+#include <glm/glm.hpp>
+
+//Planes of a frustum
+const unsigned int kFrustumPlaneCount = 6;
+//Views of a cube, one per face
+const unsigned int kCubeFaceCount = 6;
+//Planes tested together, the lanes of the vector registers
+const unsigned int kFrustumPlaneBatchSize = 4;
+//Batches the planes of a frustum are split in
+const unsigned int kFrustumPlaneBatches = (kFrustumPlaneCount + kFrustumPlaneBatchSize - 1) / kFrustumPlaneBatchSize;
+
+/**
+ * @brief Gets the planes of the frustum of a view projection matrix, in the space the matrix takes from,
+ * normalized and pointing inwards
+ *
+ * @param matrix View projection matrix, or the full transform of an object to get them in its space
+ * @param planes Where to store the left, right, bottom, top, near and far planes
+ */
+void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[kFrustumPlaneCount]);
+
+/**
+ * @brief Where a box is relative to a frustum
+ */
+enum class FrustumResult {
+	kOutside,
+	kIntersecting,
+	kInside,
+};
+
+/**
+ * @brief Planes of a frustum laid out so a box is tested against several of them at once.
+ * The six planes are padded to two whole batches with planes nothing is ever out of
+ */
+struct Frustum {
+	/** X of the normals */
+	alignas(16) float normal_x_[kFrustumPlaneBatches * kFrustumPlaneBatchSize];
+	/** Y of the normals */
+	alignas(16) float normal_y_[kFrustumPlaneBatches * kFrustumPlaneBatchSize];
+	/** Z of the normals */
+	alignas(16) float normal_z_[kFrustumPlaneBatches * kFrustumPlaneBatchSize];
+	/** Distance of each plane to the origin along its normal */
+	alignas(16) float distance_[kFrustumPlaneBatches * kFrustumPlaneBatchSize];
+
+	/**
+	 * @brief Sets the planes of the frustum of a view projection matrix
+	 *
+	 * @param view_projection View projection matrix of the view
+	 */
+	void Set(const glm::mat4& view_projection);
+};
+
+/**
+ * @brief Tests an axis aligned box against a frustum
+ *
+ * @param frustum Frustum to test with
+ * @param center Center of the box
+ * @param extent Half size of the box along each axis
+ *
+ * @return FrustumResult kOutside if it's out of any plane, kInside if it's inside all of them
+ */
+FrustumResult TestBox(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent);
+
+#endif //__FRUSTUM_CULLING_HPP__
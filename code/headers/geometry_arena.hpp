@@ -0,0 +1,162 @@
+#ifndef __GEOMETRY_ARENA_HPP__
+#define __GEOMETRY_ARENA_HPP__	1
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <vertex_format.hpp>
+
+#ifdef RENDER_OPENGL
+#include "GL/glew.h"
+#endif
+
+//Vertices each vertex format has room for when its buffer is created
+const uint32_t kArenaInitialVertices = 1 << 16;
+//Bytes the index buffer has room for when it's created
+const uint32_t kArenaInitialIndexBytes = 1 << 22;
+
+/**
+ * @brief Range of elements of an arena
+ */
+struct ArenaRange {
+	/** First element of the range */
+	uint32_t offset_;
+	/** Number of elements */
+	uint32_t count_;
+};
+
+/**
+ * @brief Sub-allocator of a range of elements. The free ranges are kept sorted and merged,
+ * and each allocation takes the first one it fits in
+ */
+class RangeAllocator {
+public:
+	RangeAllocator();
+
+	/**
+	 * @brief Forgets every allocation, leaving the used elements packed at the start
+	 *
+	 * @param capacity Number of elements managed
+	 * @param used Elements at the start that are taken
+	 */
+	void Reset(uint32_t capacity, uint32_t used = 0);
+
+	/**
+	 * @brief Takes a range of elements
+	 *
+	 * @param count Number of elements
+	 * @param alignment The first element has to be a multiple of it
+	 * @param offset Where to store the first element of the range
+	 *
+	 * @return bool False if there isn't a free range big enough
+	 */
+	bool Allocate(uint32_t count, uint32_t alignment, uint32_t* offset);
+
+	/**
+	 * @brief Returns a range taken with Allocate
+	 *
+	 * @param offset First element of the range
+	 * @param count Number of elements
+	 */
+	void Free(uint32_t offset, uint32_t count);
+
+	/**
+	 * @brief Adds free elements at the end
+	 *
+	 * @param capacity New number of elements, bigger than the current one
+	 */
+	void Grow(uint32_t capacity);
+
+	uint32_t capacity() const { return capacity_; }
+	uint32_t used() const { return used_; }
+	/** Number of separate free ranges, more than one means the arena is fragmented */
+	size_t free_ranges() const { return free_.size(); }
+
+private:
+	std::vector<ArenaRange> free_;
+	uint32_t capacity_;
+	uint32_t used_;
+};
+
+#ifdef RENDER_OPENGL
+/**
+ * @brief Place of the geometry of a mesh in the arena. The arena updates it when the data moves
+ */
+struct GeometryAllocation {
+	/** Vertex array of the vertex format, shared by every mesh with that format */
+	GLuint vertex_array_;
+	/** Vertex format the mesh was allocated in */
+	unsigned int format_;
+	/** First vertex of the mesh, added to its indexes when drawing */
+	uint32_t base_vertex_;
+	/** Number of vertices of the mesh */
+	uint32_t vertex_count_;
+	/** Byte offset of the indexes of the mesh in the index buffer */
+	uint32_t index_offset_;
+	/** Bytes taken by the indexes of the mesh */
+	uint32_t index_bytes_;
+	/** Size of each index, it's also the alignment of the offset */
+	uint32_t index_size_;
+};
+
+/**
+ * @brief Vertices and indexes of every mesh, sub-allocated in a few big buffers so drawing
+ * a different mesh only needs a base vertex and an index offset. Each vertex format has its
+ * buffer and vertex array, and they all share the same index buffer
+ */
+class GeometryArena {
+public:
+	GeometryArena();
+	~GeometryArena();
+
+	/**
+	 * @brief Uploads the geometry of a mesh. The buffers are created on the first call,
+	 * they grow when they are full and are compacted when they are fragmented
+	 *
+	 * @param layout Layout of the packed vertices and indexes
+	 * @param vertex_data Packed vertices
+	 * @param vertex_count Number of vertices
+	 * @param index_data Packed indexes, relative to the first vertex of the mesh
+	 * @param index_count Number of indexes
+	 *
+	 * @return GeometryAllocation* Place of the mesh, owned by the arena until it's freed
+	 */
+	GeometryAllocation* Allocate(const VertexLayout& layout, const void* vertex_data, uint32_t vertex_count,
+		const void* index_data, uint32_t index_count);
+
+	/**
+	 * @brief Releases the geometry of a mesh
+	 *
+	 * @param allocation Place returned by Allocate, it's deleted
+	 */
+	void Free(GeometryAllocation* allocation);
+
+	/**
+	 * @brief Moves the geometry of every mesh to the start of its buffers, merging the free space
+	 */
+	void Compact();
+
+private:
+	/**
+	 * @brief Buffer and vertex array of the meshes with one vertex format
+	 */
+	struct VertexPool {
+		VertexLayout layout_;
+		GLuint buffer_;
+		GLuint vertex_array_;
+		RangeAllocator ranges_;
+	};
+
+	unsigned int FindPool(const VertexLayout& layout);
+	void ResizeVertexPool(unsigned int format, uint32_t capacity, bool compact);
+	void ResizeIndexBuffer(uint32_t capacity, bool compact);
+
+	std::vector<VertexPool> pools_;
+	GLuint index_buffer_;
+	RangeAllocator index_ranges_;
+	std::vector<std::unique_ptr<GeometryAllocation>> allocations_;
+};
+#endif
+
+#endif //__GEOMETRY_ARENA_HPP__
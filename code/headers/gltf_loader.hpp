@@ -0,0 +1,28 @@
+#ifndef __GLTF_LOADER_HPP__
+#define __GLTF_LOADER_HPP__	1
+
+#include <string>
+
+class Boss;
+struct ComponentManager;
+struct Resources;
+
+#ifdef RENDER_OPENGL
+/**
+ * @brief Imports a glTF 2.0 binary file (.glb). The file is mapped and parsed in place, the index
+ * buffers the geometry arena can take as they are go straight from the mapping to the GPU, and the
+ * vertices are packed from the accessors without any other intermediate step. Every primitive becomes
+ * a mesh of the resources and every node an entity with its transform, parented like in the file.
+ * Nodes with a mesh of several primitives get a child entity per primitive
+ *
+ * @param filepath Path to the .glb file
+ * @param component_manager Where to create the entities
+ * @param resources Where to store the meshes and textures, the ones already loaded are reused
+ * @param boss Optional job system to pack the primitives in parallel
+ *
+ * @return size_t Entity the nodes of the scene hang from, 0 if the file couldn't be read
+ */
+size_t LoadGltf(const std::string& filepath, ComponentManager* component_manager, Resources* resources, Boss* boss = nullptr);
+#endif
+
+#endif //__GLTF_LOADER_HPP__
@@ -25,6 +25,22 @@ struct ImguiFunctions {
    */
   static void DisplayWindowData(Window* win, ComponentManager* comp);
 
+#ifdef RENDER_OPENGL
+  /**
+   * @brief Display the draws and state changes of the last frame, and whether the draws are sorted by their state
+   * 
+   * @param render Render system to take them from
+   */
+  static void DisplayRenderStats(RenderSystemOpenGL* render);
+
+  /**
+   * @brief Display the counters of the job system, and trace its jobs to export them
+   * 
+   * @param boss Job system to take them from
+   */
+  static void DisplayJobStats(Boss* boss);
+#endif
+
   /**
    * @brief Displays a texture buffer of OpengGL into a ImGui Window for debug purposes
    * 
@@ -0,0 +1,218 @@
+#ifndef __JOB_HPP__
+#define __JOB_HPP__	1
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Bytes reserved inside each job to store the task without allocating.
+//Keeps the whole Job at 128 bytes (two cache lines)
+const unsigned int kJobInlineStorage = 80;
+
+//Number of jobs allocated at once each time a pool runs out of them
+const unsigned int kJobsPerPoolBlock = 256;
+
+class JobPool;
+
+/**
+ * @brief Counter used to know when a group of jobs has finished without needing a future.
+ *
+ * The last job takes the lock of the counter to bring it to zero and wake the waiting threads,
+ * and Boss::wait takes it too before returning, so a counter on the stack of the waiting thread
+ * is never touched once the wait is over.
+ */
+struct JobCounter {
+
+	/** Number of jobs associated to the counter that haven't finished yet */
+	std::atomic<int> pending_;
+	/** Held while the last job finishes the counter */
+	std::mutex mutex_;
+	/** Where the waiting threads sleep until the counter reaches zero */
+	std::condition_variable done_;
+
+	JobCounter() : pending_{ 0 } {}
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	/**
+	 * @brief Returns if all the jobs associated to the counter have been completed
+	 *
+	 * @return bool True if there are no jobs pending
+	 */
+	bool is_done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+	/**
+	 * @brief Marks one of the jobs as finished, waking up the waiting threads if it was the last one
+	 */
+	void done_one() {
+		//Only the job that may bring it to zero needs the lock, the rest leave the counter right away
+		int pending = pending_.load(std::memory_order_relaxed);
+		while (pending > 1) {
+			if (pending_.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) { return; }
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex_ };
+		if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			done_.notify_all();
+		}
+	}
+
+	/**
+	 * @brief Sleeps until every job of the counter has finished
+	 */
+	void sleep_until_done() {
+		std::unique_lock<std::mutex> lock{ mutex_ };
+		done_.wait(lock, [this]() { return is_done(); });
+	}
+
+	/**
+	 * @brief Waits for the last job to stop using the counter, after which it can be destroyed
+	 */
+	void release() {
+		std::lock_guard<std::mutex> lock{ mutex_ };
+	}
+};
+
+/**
+ * @brief Fixed size unit of work of the Boss.
+ *
+ * The task is stored inside the job itself when it fits in kJobInlineStorage,
+ * so scheduling it doesn't need any allocation nor reference counting.
+ */
+struct Job {
+
+	/** Calls the stored task and destroys it afterwards */
+	void (*invoke_)(Job*);
+	/** Destroys the stored task without calling it */
+	void (*destroy_)(Job*);
+	/** Counter to decrement when the job finishes, can be nullptr */
+	JobCounter* counter_;
+	/** Intrusive link used by the job queue and the pool free lists */
+	Job* next_;
+	/** Pool the job belongs to, where it returns once finished */
+	JobPool* pool_;
+	/** When the job was queued, only filled while the telemetry of the Boss is enabled */
+	uint64_t enqueue_ns_;
+
+	/** Storage of the task, or of a pointer to it when it doesn't fit */
+	alignas(std::max_align_t) unsigned char storage_[kJobInlineStorage];
+
+	/**
+	 * @brief Stores a task in the job, inline if possible
+	 *
+	 * @param task Callable object with the signature void()
+	 */
+	template<typename F>
+	void Bind(F&& task);
+
+	/**
+	 * @brief Executes the stored task and signals the counter of the job
+	 */
+	void Run();
+
+	/**
+	 * @brief Destroys the stored task without executing it
+	 */
+	void Discard();
+};
+
+template<typename F>
+void Job::Bind(F&& task) {
+	using Fn = std::decay_t<F>;
+
+	if constexpr (sizeof(Fn) <= kJobInlineStorage && alignof(Fn) <= alignof(std::max_align_t)) {
+		new (storage_) Fn(std::forward<F>(task));
+
+		invoke_ = [](Job* j) {
+			Fn* fn = std::launder(reinterpret_cast<Fn*>(j->storage_));
+			(*fn)();
+			fn->~Fn();
+		};
+		destroy_ = [](Job* j) {
+			std::launder(reinterpret_cast<Fn*>(j->storage_))->~Fn();
+		};
+	}
+	else {
+		//Big tasks can't be stored inline, so they are the only ones paying for an allocation
+		Fn* boxed = new Fn(std::forward<F>(task));
+		new (storage_) Fn* (boxed);
+
+		invoke_ = [](Job* j) {
+			std::unique_ptr<Fn> fn{ *std::launder(reinterpret_cast<Fn**>(j->storage_)) };
+			(*fn)();
+		};
+		destroy_ = [](Job* j) {
+			delete *std::launder(reinterpret_cast<Fn**>(j->storage_));
+		};
+	}
+}
+
+static_assert(sizeof(Job) <= 128, "Job must fit in two cache lines");
+
+/**
+ * @brief Pool of jobs owned by a single thread.
+ *
+ * Only the owner thread allocates from it. Jobs finished on other threads are
+ * returned through a lock free list that the owner reclaims when it runs out
+ * of free jobs, so neither path needs a lock.
+ */
+class JobPool {
+
+public:
+
+	JobPool();
+
+	~JobPool();
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	/**
+	 * @brief Gets a free job from the pool. Must be called from the owner thread
+	 *
+	 * @return Job* Uninitialized job ready to be bound to a task
+	 */
+	Job* Allocate();
+
+	/**
+	 * @brief Returns a job to the pool. Can be called from any thread
+	 *
+	 * @param job Job previously allocated from this pool
+	 */
+	void Free(Job* job);
+
+	/**
+	 * @brief Returns the number of jobs allocated by the pool, free or not
+	 *
+	 * @return size_t Number of jobs owned by the pool
+	 */
+	size_t capacity() const;
+
+private:
+
+	/** Allocates a new block of jobs and adds them to the free list */
+	void Grow();
+
+	/** Thread that allocates from the pool */
+	std::thread::id owner_;
+
+	/** Jobs that can be allocated without synchronization */
+	Job* free_list_;
+
+	/** Jobs freed from threads that aren't the owner */
+	std::atomic<Job*> remote_free_list_;
+
+	/** Memory blocks where the jobs live */
+	std::vector<std::unique_ptr<Job[]>> blocks_;
+};
+
+#endif //__JOB_HPP__
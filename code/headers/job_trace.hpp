@@ -0,0 +1,94 @@
+#ifndef __JOB_TRACE_HPP__
+#define __JOB_TRACE_HPP__	1
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//Number of events kept by each thread, older ones are overwritten. Must be a power of two
+const unsigned int kJobTraceCapacity = 8192;
+
+/**
+ * @brief Timing of a single job executed by the Boss
+ */
+struct JobTraceEvent {
+	/** Nanoseconds since the trace started when the job was queued */
+	uint64_t enqueue_ns_;
+	/** Nanoseconds since the trace started when the job began to run */
+	uint64_t begin_ns_;
+	/** Nanoseconds since the trace started when the job finished */
+	uint64_t end_ns_;
+	/** True if the job was taken from the queue by a thread that isn't a worker */
+	bool helped_;
+};
+
+/**
+ * @brief Ring buffer of job events written by a single thread.
+ *
+ * Only the owner thread pushes, without locks. Any thread can take a snapshot,
+ * events overwritten while the snapshot is being copied are discarded.
+ */
+class JobTraceBuffer {
+
+public:
+
+	JobTraceBuffer();
+
+	JobTraceBuffer(const JobTraceBuffer&) = delete;
+	JobTraceBuffer& operator=(const JobTraceBuffer&) = delete;
+
+	/**
+	 * @brief Stores an event, overwriting the oldest one if the buffer is full. Owner thread only
+	 *
+	 * @param event Event to store
+	 */
+	void Push(const JobTraceEvent& event);
+
+	/**
+	 * @brief Copies the events still stored in the buffer, oldest first
+	 *
+	 * @param out Vector where the events are appended
+	 */
+	void Snapshot(std::vector<JobTraceEvent>& out) const;
+
+	/**
+	 * @brief Removes every event. Must not be called while the owner thread is pushing
+	 */
+	void Clear();
+
+	/**
+	 * @brief Returns the number of events pushed since the buffer was created or cleared
+	 *
+	 * @return uint64_t Events pushed, including the overwritten ones
+	 */
+	uint64_t total() const;
+
+private:
+
+	/** Storage of the events */
+	std::unique_ptr<JobTraceEvent[]> events_;
+
+	/** Number of events pushed, the next one goes to head_ % kJobTraceCapacity */
+	std::atomic<uint64_t> head_;
+};
+
+/**
+ * @brief Accumulated counters of the job system
+ */
+struct BossStats {
+	/** Jobs executed by any thread */
+	uint64_t jobs_executed_ = 0;
+	/** Jobs executed by threads waiting on a counter instead of by the workers */
+	uint64_t jobs_helped_ = 0;
+	/** Times the queue mutex has been locked */
+	uint64_t lock_acquisitions_ = 0;
+	/** Times the queue mutex was already locked and the thread had to block */
+	uint64_t lock_contentions_ = 0;
+	/** Sum of the time the traced jobs spent queued, in nanoseconds */
+	uint64_t queue_wait_ns_ = 0;
+	/** Sum of the time the traced jobs spent running, in nanoseconds */
+	uint64_t run_ns_ = 0;
+};
+
+#endif //__JOB_TRACE_HPP__
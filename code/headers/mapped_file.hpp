@@ -0,0 +1,70 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__	1
+
+#include <string>
+
+/**
+ * @brief Read only view of a whole file mapped in memory.
+ * The pages are loaded by the OS when accessed, so nothing is copied on open
+ */
+class MappedFile {
+
+public:
+
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * @brief Maps a file, closing the previous one if any
+	 *
+	 * @param filepath Path to the file to map
+	 *
+	 * @return bool True if the file exists, isn't empty and has been mapped
+	 */
+	bool Open(const std::string& filepath);
+
+	/**
+	 * @brief Unmaps the file, invalidating every pointer to its data
+	 */
+	void Close();
+
+	/**
+	 * @brief Returns the start of the file contents
+	 *
+	 * @return const unsigned char* Contents of the file, nullptr if not mapped
+	 */
+	const unsigned char* data() const { return data_; }
+
+	/**
+	 * @brief Returns the size of the file
+	 *
+	 * @return size_t Size in bytes of the mapped file
+	 */
+	size_t size() const { return size_; }
+
+	/**
+	 * @brief Returns if there's a file mapped
+	 *
+	 * @return bool True if data can be read
+	 */
+	bool is_open() const { return data_ != nullptr; }
+
+private:
+
+	/** Start of the mapped view */
+	const unsigned char* data_;
+	/** Bytes mapped */
+	size_t size_;
+
+#ifdef _WIN32
+	/** Handle of the opened file */
+	void* file_handle_;
+	/** Handle of the mapping object */
+	void* mapping_handle_;
+#endif
+};
+
+#endif //__MAPPED_FILE_HPP__
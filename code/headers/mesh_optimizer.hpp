@@ -0,0 +1,116 @@
+#ifndef __MESH_OPTIMIZER_HPP__
+#define __MESH_OPTIMIZER_HPP__	1
+
+#include <vector>
+#include <cstdint>
+
+#include <vertex.hpp>
+
+//Size of the post transform cache the triangle order is optimized for
+const unsigned int kVertexCacheSize = 16;
+//Maximum vertices referenced by a meshlet
+const unsigned int kMeshletMaxVertices = 64;
+//Maximum triangles of a meshlet
+const unsigned int kMeshletMaxTriangles = 124;
+
+/**
+ * @brief Efficiency of an index buffer with the simulated vertex cache
+ */
+struct VertexCacheStats {
+	/** Average cache miss ratio, vertices transformed per triangle. 0.5 is the best possible, 3 the worst */
+	float acmr_;
+	/** Average transform to vertex ratio, times each vertex is transformed. 1 is the best possible */
+	float atvr_;
+};
+
+/**
+ * @brief Cluster of neighbouring triangles of a mesh, culled as a whole
+ */
+struct Meshlet {
+	/** First index of the meshlet in the index buffer */
+	uint32_t index_offset_;
+	/** Number of indexes of the meshlet */
+	uint32_t index_count_;
+	/** Center of the bounding sphere */
+	float center_[3];
+	/** Radius of the bounding sphere */
+	float radius_;
+	/** Average direction the triangles face */
+	float cone_axis_[3];
+	/** Sine of the widest angle between the axis and the triangles, 1 if they can face any direction */
+	float cone_cutoff_;
+};
+
+/**
+ * @brief Simulates a FIFO post transform cache over the triangles of a mesh
+ *
+ * @param indexes Three indexes per triangle
+ * @param vertex_count Number of vertices referenced by the indexes
+ * @param cache_size Entries of the simulated cache
+ *
+ * @return VertexCacheStats ACMR and ATVR of the mesh
+ */
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indexes, size_t vertex_count, unsigned int cache_size = kVertexCacheSize);
+
+/**
+ * @brief Reorders the triangles to reuse the transformed vertices as much as possible, using Tipsify.
+ * Optionally sorts the clusters it generates so the ones facing outwards are drawn first, reducing overdraw
+ *
+ * @param indexes Three indexes per triangle, reordered in place
+ * @param vertices Vertices of the mesh, only needed to reduce overdraw
+ * @param reduce_overdraw If the clusters have to be sorted
+ * @param cache_size Entries of the cache to optimize for
+ */
+void OptimizeVertexCache(std::vector<unsigned int>& indexes, const std::vector<Vertex>& vertices, bool reduce_overdraw = true, unsigned int cache_size = kVertexCacheSize);
+
+/**
+ * @brief Reorders the vertices in the order the triangles use them first, so they are fetched sequentially.
+ * Vertices not used by any triangle are removed
+ *
+ * @param vertices Vertices of the mesh, reordered in place
+ * @param indexes Three indexes per triangle, remapped to the new order
+ */
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indexes);
+
+/**
+ * @brief Reduces the triangles of a mesh collapsing the edges that change its shape the least,
+ * measured with quadric error metrics. The vertices aren't modified, the result references a subset of them
+ *
+ * @param vertices Vertices of the mesh
+ * @param indexes Three indexes per triangle
+ * @param target_index_count Number of indexes to reduce the mesh to
+ * @param max_error Maximum deviation from the original surface allowed, relative to the size of the mesh
+ * @param result_error Deviation of the result relative to the size of the mesh, can be nullptr
+ *
+ * @return std::vector<unsigned int> Indexes of the simplified mesh, it can have more than the target if the error is reached first
+ */
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indexes,
+	size_t target_index_count, float max_error, float* result_error = nullptr);
+
+/**
+ * @brief Splits the triangles of a mesh in meshlets, in the order they are drawn so the
+ * vertex cache optimization is kept, and computes their bounds
+ *
+ * @param indexes Three indexes per triangle
+ * @param index_count Number of indexes to split, from the start
+ * @param vertices Vertices of the mesh
+ * @param max_vertices Maximum vertices referenced by each meshlet
+ * @param max_triangles Maximum triangles of each meshlet
+ *
+ * @return std::vector<Meshlet> Meshlets covering the indexes in order
+ */
+std::vector<Meshlet> BuildMeshlets(const std::vector<unsigned int>& indexes, size_t index_count, const std::vector<Vertex>& vertices,
+	unsigned int max_vertices = kMeshletMaxVertices, unsigned int max_triangles = kMeshletMaxTriangles);
+
+/**
+ * @brief Tests a meshlet against a frustum and, optionally, whether all of its triangles face away from the viewer
+ *
+ * @param meshlet Meshlet to test
+ * @param planes Normalized frustum planes in the space of the mesh, pointing inwards
+ * @param view_position Position of the viewer in the space of the mesh, nullptr to not test the facing
+ *
+ * @return bool True if any of its triangles can be visible
+ */
+bool IsMeshletVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3* view_position);
+
+#endif //__MESH_OPTIMIZER_HPP__
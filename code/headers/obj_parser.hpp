@@ -0,0 +1,118 @@
+#ifndef __OBJ_PARSER_HPP__
+#define __OBJ_PARSER_HPP__	1
+
+#include <string>
+#include <vector>
+
+#include <mapped_file.hpp>
+
+class Boss;
+
+//Size of the chunks the file is split into, so each job has enough lines to be worth it
+const size_t kObjParserMinChunkSize = 256 * 1024;
+//Bytes of the file an ObjStream parses each time
+const size_t kObjStreamWindowSize = 4 * 1024 * 1024;
+
+/**
+ * @brief Attributes referenced by a corner of a face. Negative means the attribute is missing.
+ * Same meaning as tinyobj::index_t
+ */
+struct ObjCorner {
+	int vertex_index;
+	int normal_index;
+	int texcoord_index;
+};
+
+/**
+ * @brief Contents of an OBJ file, with every face already triangulated in file order
+ */
+struct ObjData {
+	/** Three floats per position */
+	std::vector<float> positions_;
+	/** Three floats per position, white if the file doesn't have colors */
+	std::vector<float> colors_;
+	/** Three floats per normal */
+	std::vector<float> normals_;
+	/** Two floats per texture coordinate */
+	std::vector<float> texcoords_;
+	/** Three corners per triangle */
+	std::vector<ObjCorner> corners_;
+};
+
+/**
+ * @brief Parses an OBJ file mapping it in memory and splitting it into line aligned chunks
+ * parsed in parallel. Triangles and quads are triangulated the same way tinyobjloader does,
+ * files with bigger polygons are rejected so the caller can use tinyobjloader instead
+ *
+ * @param filepath Path to the OBJ file
+ * @param boss Job system to parse the chunks on, if nullptr it's parsed on the calling thread
+ * @param out Where to store the parsed contents
+ * @param error Reason of the failure, if any
+ *
+ * @return bool True if the file has been parsed
+ */
+bool ParseObj(const std::string& filepath, Boss* boss, ObjData& out, std::string& error);
+
+/**
+ * @brief Reads an OBJ file a window of lines at a time, so a big file can be turned into
+ * geometry while it's parsed instead of after. The attributes of the whole file are kept,
+ * since any face can reference them, but only the triangles of the last window
+ */
+class ObjStream {
+
+public:
+
+	ObjStream();
+
+	/**
+	 * @brief Maps the file to read
+	 *
+	 * @param filepath Path to the OBJ file
+	 * @param error Reason of the failure, if any
+	 *
+	 * @return bool True if the file has been opened
+	 */
+	bool Open(const std::string& filepath, std::string& error);
+
+	/**
+	 * @brief Parses the next window of the file, replacing the triangles of the previous one
+	 *
+	 * @param window_size Bytes to parse, extended to the end of the last line
+	 * @param error Reason of the failure, if any. Same limitations as ParseObj
+	 *
+	 * @return bool True if the window has been parsed
+	 */
+	bool ReadNext(std::string& error, size_t window_size = kObjStreamWindowSize);
+
+	/**
+	 * @brief Returns the attributes read so far and the triangles of the last window
+	 *
+	 * @return const ObjData& Parsed contents
+	 */
+	const ObjData& data() const { return data_; }
+
+	/**
+	 * @brief Returns if the whole file has been read
+	 *
+	 * @return bool True once the last window has been parsed
+	 */
+	bool done() const { return cursor_ >= file_.size(); }
+
+	/**
+	 * @brief Returns the part of the file already parsed
+	 *
+	 * @return float From 0 to 1
+	 */
+	float progress() const { return file_.size() == 0 ? 1.0f : (float)cursor_ / (float)file_.size(); }
+
+private:
+
+	/** File being read */
+	MappedFile file_;
+	/** Start of the next window */
+	size_t cursor_;
+	/** Attributes read so far and the triangles of the last window */
+	ObjData data_;
+};
+
+#endif //__OBJ_PARSER_HPP__
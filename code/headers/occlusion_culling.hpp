@@ -0,0 +1,115 @@
+#ifndef __OCCLUSION_CULLING_HPP__
+#define __OCCLUSION_CULLING_HPP__	1
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+//Size of the depth buffer the occluders are drawn into, small so drawing them costs little
+const unsigned int kOcclusionWidth = 256;
+const unsigned int kOcclusionHeight = 128;
+//Texels of a level of the pyramid tested per axis at most, the test goes up the levels until the bounds fit
+const unsigned int kOcclusionTestTexels = 4;
+
+/**
+ * @brief Depth buffer drawn on the CPU with the occluders of a view, to find out which objects they hide.
+ * The occluders are rasterized four pixels at a time with SSE, keeping the nearest depth of each pixel sampled
+ * at its center. Then a pyramid is built where each texel keeps the farthest depth of the four below it, and the
+ * screen rectangle of an object is tested at the level where it covers a few texels: if its nearest point is behind
+ * all of them, it's hidden. Doesn't need a GPU
+ */
+class OcclusionBuffer {
+public:
+	/**
+	 * @param width Width of the depth buffer, rounded up to a multiple of 4
+	 * @param height Height of the depth buffer
+	 */
+	OcclusionBuffer(unsigned int width = kOcclusionWidth, unsigned int height = kOcclusionHeight);
+
+	/**
+	 * @brief Removes the occluders and sets the view they are drawn from
+	 *
+	 * @param view_projection View projection matrix of the view
+	 */
+	void Clear(const glm::mat4& view_projection);
+
+	/**
+	 * @brief Draws the triangles of an occluder into the depth buffer, both sides of them
+	 *
+	 * @param positions Positions of the vertices in the space of the object
+	 * @param vertex_count Number of vertices
+	 * @param indexes Three indexes per triangle
+	 * @param index_count Number of indexes
+	 * @param transform World transform of the object
+	 */
+	void DrawOccluder(const glm::vec3* positions, size_t vertex_count, const uint32_t* indexes, size_t index_count, const glm::mat4& transform);
+
+	/**
+	 * @brief Builds the pyramid from the occluders drawn, needed before testing
+	 */
+	void BuildPyramid();
+
+	/**
+	 * @brief Tests whether an axis aligned box may be seen past the occluders. Boxes crossing the near plane
+	 * are always visible
+	 *
+	 * @param bounds_min Minimum corner of the box in world space
+	 * @param bounds_max Maximum corner of the box in world space
+	 *
+	 * @return bool False if the occluders hide it completely
+	 */
+	bool IsVisible(const glm::vec3& bounds_min, const glm::vec3& bounds_max) const;
+
+	unsigned int GetWidth() const { return width_; }
+	unsigned int GetHeight() const { return height_; }
+
+	/**
+	 * @brief Gets the depth buffer the occluders were drawn into, row after row from the bottom
+	 *
+	 * @return const float* Depth of each pixel from 0 at the near plane to 1 at the far plane, 1 if nothing was drawn
+	 */
+	const float* GetDepth() const { return pyramid_.data(); }
+
+	/**
+	 * @brief Gets the triangles drawn since the last Clear, after clipping
+	 *
+	 * @return size_t Number of triangles
+	 */
+	size_t GetTriangleCount() const { return triangle_count_; }
+
+private:
+	/**
+	 * @brief Rasterizes a triangle in front of the near plane
+	 *
+	 * @param a First vertex in clip space
+	 * @param b Second vertex in clip space
+	 * @param c Third vertex in clip space
+	 */
+	void RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+	/**
+	 * @brief Levels of the pyramid, the first one is the depth buffer
+	 */
+	struct Level {
+		/** Offset of the level in pyramid_ */
+		size_t offset_;
+		unsigned int width_;
+		unsigned int height_;
+	};
+
+	/** View the occluders are drawn from */
+	glm::mat4 view_projection_;
+	unsigned int width_;
+	unsigned int height_;
+	/** Every level of the pyramid, one after another */
+	std::vector<float> pyramid_;
+	std::vector<Level> levels_;
+	/** Vertices of the occluder being drawn in clip space */
+	std::vector<glm::vec4> clip_positions_;
+	/** Triangles drawn since the last Clear */
+	size_t triangle_count_;
+};
+
+#endif //__OCCLUSION_CULLING_HPP__
@@ -0,0 +1,114 @@
+#ifndef __RENDER_QUEUE_HPP__
+#define __RENDER_QUEUE_HPP__	1
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Bits of each field of the sort key, from the most significant one. The fields add up to 64
+const unsigned int kRenderKeyPassBits = 4;
+const unsigned int kRenderKeyProgramBits = 6;
+const unsigned int kRenderKeyCullBits = 2;
+const unsigned int kRenderKeyMaterialBits = 16;
+const unsigned int kRenderKeyMeshBits = 16;
+const unsigned int kRenderKeyDepthBits = 20;
+//Distance that takes half of the depth field, it's finer near the viewer where the order matters most
+const float kRenderKeyDepthScale = 100.0f;
+
+/**
+ * @brief Passes the draws are sorted into, the earlier ones first
+ */
+enum class RenderPass : uint32_t {
+	kCamera,
+	kShadow,
+};
+
+/**
+ * @brief Builds the sort key of a draw. Each field is cut to its bits, draws that only differ in the cut bits
+ * still draw right but aren't grouped as well
+ *
+ * @param pass Pass the draw belongs to
+ * @param program Program the draw is made with
+ * @param cull Faces culled
+ * @param material Index of the textures bound
+ * @param mesh Index of the mesh, meshes sharing a vertex array should have consecutive ones
+ * @param distance Distance to the viewer, near ones go first so the depth test rejects more of the rest
+ *
+ * @return uint64_t Key that orders the draws by pass, program, cull, material, mesh and depth
+ */
+uint64_t MakeRenderKey(RenderPass pass, uint32_t program, uint32_t cull, uint32_t material, uint32_t mesh, float distance);
+
+/**
+ * @brief Draw of a render item, ordered by its key
+ */
+struct RenderPacket {
+	/** Sort key from MakeRenderKey */
+	uint64_t key_;
+	/** Render item drawn */
+	uint32_t item_;
+};
+
+/**
+ * @brief State changes the draws of a frame made, to see what the sorting saves
+ */
+struct RenderStateStats {
+	RenderStateStats() { Clear(); }
+
+	void Clear() {
+		draws_ = 0;
+		vertex_array_changes_ = 0;
+		texture_changes_ = 0;
+		cull_changes_ = 0;
+	}
+
+	/** Render items drawn */
+	uint32_t draws_;
+	/** Vertex arrays bound */
+	uint32_t vertex_array_changes_;
+	/** Textures and texture arrays bound */
+	uint32_t texture_changes_;
+	/** Changes of the faces culled */
+	uint32_t cull_changes_;
+};
+
+/**
+ * @brief Draws of a pass sorted so the ones sharing state go together. The packets are added in any order,
+ * then sorted by key with a radix sort that skips the bytes every key has the same, which are most of them
+ */
+class RenderQueue {
+public:
+	/**
+	 * @brief Removes the packets, keeping the memory
+	 */
+	void Clear() { packets_.clear(); }
+
+	/**
+	 * @brief Adds a draw
+	 *
+	 * @param key Sort key from MakeRenderKey
+	 * @param item Render item drawn
+	 */
+	void Add(uint64_t key, uint32_t item) { packets_.push_back({ key, item }); }
+
+	/**
+	 * @brief Sorts the packets by key, the ones with the same key keep the order they were added in
+	 */
+	void Sort();
+
+	/**
+	 * @brief Gets the render items in the order of their packets
+	 *
+	 * @param items Where to store them
+	 */
+	void GetItems(std::vector<uint32_t>* items) const;
+
+	const std::vector<RenderPacket>& GetPackets() const { return packets_; }
+
+private:
+	/** Packets of the queue */
+	std::vector<RenderPacket> packets_;
+	/** Packets being sorted, swapped with packets_ on each byte */
+	std::vector<RenderPacket> scratch_;
+};
+
+#endif //__RENDER_QUEUE_HPP__
@@ -121,6 +121,15 @@ private:
 		int pad3;
 	};
 
+	/**
+	 * @brief Selects the level of detail of every renderer from the size its bounding sphere projects
+	 * with the camera, see RendererComponent::SelectLod. Only the main one, there are no shadow views here
+	 *
+	 * @param comp ComponentManager to get the renderers from
+	 * @param cam Camera the scene is drawn from
+	 */
+	void select_lods(ComponentManager* comp, CameraComponent* cam);
+
 	bool InitDirectXResources();
 	bool InitShaders();
 
@@ -7,6 +7,10 @@
 #include <depth_map.hpp>
 #include <deferred_framebuffer.hpp>
 #include <light.hpp>
+#include <frustum_culling.hpp>
+#include <visibility.hpp>
+#include <occlusion_culling.hpp>
+#include <render_queue.hpp>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H  
@@ -22,6 +26,30 @@ struct Character {
 	unsigned int Advance;    // Offset to advance to next glyph
 };
 
+//Texture units whose binding the draw loops remember, to skip binding the same texture again
+const unsigned int kTrackedTextureUnits = 8;
+
+/**
+ * @brief Renderer drawn this frame, with the world transform of its entity
+ */
+struct RenderItem {
+	/** Renderer of the entity, initialized and with its mesh initialized */
+	RendererComponent* renderer_;
+	/** World transform of the entity, identity if it has no transform */
+	glm::mat4 transform_;
+	/** Entity of the renderer */
+	size_t entity_;
+	/** Center of the bounding sphere of the mesh in world space */
+	glm::vec3 center_;
+	/** Radius of the bounding sphere of the mesh in world space */
+	float radius_;
+	/** Diameter of the bounding sphere over the height of the camera view, set when the LODs are selected */
+	float screen_size_;
+	/** Index of the textures of the renderer this frame, the same for renderers binding the same ones */
+	uint32_t material_id_;
+	/** Index of the mesh this frame, consecutive for the meshes sharing a vertex array */
+	uint32_t mesh_id_;
+};
 
 class RenderSystemOpenGL : public RenderSystem {
 public:
@@ -33,6 +61,19 @@ public:
 	Window* getWindow();
 
 	void ResetResources();
+
+	/**
+	 * @brief Sets the job system the visibility of each frame is worked out on
+	 *
+	 * @param boss Job system, nullptr to do it on the main thread
+	 */
+	void SetBoss(Boss* boss) { boss_ = boss; }
+	Boss* getBoss() { return boss_; }
+
+	/** State changes made by the draws of the last frame */
+	RenderStateStats render_stats_;
+	/** Whether the draws are sorted by their state, off draws them in the order of the entities */
+	bool sort_draws_;
 	
 private:
 
@@ -54,6 +95,121 @@ private:
 
 	void RenderText(std::string text, float screen_x, float screen_y, float scale, glm::vec3 color);
 
+	//## VISIBILITY
+	/**
+	 * @brief Collects the renderers that can be drawn this frame with their transforms and bounding spheres,
+	 * after moving them in the bounds tree of the component manager
+	 *
+	 * @param comp ComponentManager to get the data from
+	 */
+	void gather_render_items(ComponentManager* comp);
+
+	/**
+	 * @brief Updates the matrices of the visible lights and culls the camera view and every shadow view at once,
+	 * before anything is drawn. The shadow views go after the camera in the order the lights are drawn,
+	 * the directional lights first, then the spot lights and then the point lights
+	 *
+	 * @param cam_position Position of the camera
+	 * @param directionals_follow_camera Whether the directional lights are moved to the camera first
+	 */
+	void prepare_visibility(const glm::vec3& cam_position, bool directionals_follow_camera);
+
+	/** Renderers that can be drawn this frame */
+	std::vector<RenderItem> render_items_;
+	/** Bounds tree of the component manager rendered, the views are culled with it */
+	const BoundsTree* bounds_tree_;
+	/** Render items by entity and which ones cast shadows, for the visibility */
+	VisibilityItems visibility_items_;
+	/** Render items inside each view of the frame */
+	Visibility visibility_;
+	/** View of the camera in visibility_ */
+	uint32_t camera_view_;
+	/** Job system the views are culled on, nullptr culls them on the main thread */
+	Boss* boss_;
+
+	//## OCCLUSION CULLING
+	/**
+	 * @brief Draws the occluders in the camera view into the CPU depth buffer and keeps the render items in
+	 * the camera view that they don't hide. Without occluders every item in the camera view is kept.
+	 * The triangles of an occluder are built on the workers the first time it's seen, it's skipped until then
+	 */
+	void cull_occluded();
+
+	/** Render items in the camera view not hidden by the occluders, in the order of the items */
+	std::vector<uint32_t> camera_visible_;
+	/** Depth buffer the occluders in the camera view are drawn into */
+	OcclusionBuffer occlusion_;
+
+	//## DRAW ORDER
+	/**
+	 * @brief Orders the render items of a view by the state they need, so each vertex array, texture and
+	 * cull mode is set once for all the items sharing it, and by distance after that
+	 *
+	 * @param visible Render items of the view
+	 * @param pass Pass they are drawn in, the shadow passes don't bind textures nor change the culling
+	 * @param view_position Position the view is seen from
+	 * @param sorted Where to store the render items in the order to draw them
+	 */
+	void sort_render_items(const std::vector<uint32_t>& visible, RenderPass pass, const glm::vec3& view_position, std::vector<uint32_t>* sorted);
+
+	/** Sorts the draws of a view */
+	RenderQueue render_queue_;
+	/** Render items of the camera view in the order they are drawn */
+	std::vector<uint32_t> camera_sorted_;
+	/** Render items of the shadow view being drawn, in the order they are drawn */
+	std::vector<uint32_t> shadow_sorted_;
+	/** Material index of each set of textures this frame */
+	std::unordered_map<uint64_t, uint32_t> material_ids_;
+	/** Index of each mesh this frame, in the order they were found */
+	std::unordered_map<const TinyObj*, uint32_t> mesh_ids_;
+	/** Meshes of this frame by the index they were found with */
+	std::vector<const TinyObj*> frame_meshes_;
+	/** Meshes of this frame ordered by vertex array, then final index of each one */
+	std::vector<uint32_t> mesh_order_;
+	std::vector<uint32_t> mesh_rank_;
+
+	//## LEVEL OF DETAIL
+	/**
+	 * @brief Selects the level of detail of every render item, for the main view and the shadow views,
+	 * from the size their bounding sphere projects with the camera. The textures of the ones in the
+	 * camera view are asked for the mip level that size needs too
+	 *
+	 * @param projection Projection matrix of the camera
+	 * @param view_position Position of the camera
+	 */
+	void select_lods(const glm::mat4& projection, const glm::vec3& view_position);
+
+	/**
+	 * @brief Draws a level of detail of a mesh, the vertex array of its format has to be bound
+	 *
+	 * @param mesh Mesh to draw
+	 * @param lod Level of detail to draw
+	 */
+	void draw_mesh_lod(const TinyObj* mesh, unsigned int lod);
+
+	/**
+	 * @brief Draws a level of detail of a mesh, the vertex array of its format has to be bound. The full detail one
+	 * only draws the meshlets inside the view and, if given the viewer, the ones facing it
+	 *
+	 * @param mesh Mesh to draw
+	 * @param lod Level of detail to draw
+	 * @param transform Transform of the object, without the dequantization of its positions
+	 * @param view_projection View projection matrix to cull the meshlets with
+	 * @param view_position Position of the viewer, nullptr to not cull the meshlets facing away
+	 */
+	void draw_mesh(const TinyObj* mesh, unsigned int lod, const glm::mat4& transform, const glm::mat4& view_projection, const glm::vec3* view_position);
+
+	/** View projection of the camera this frame, to cull the meshlets of the main view */
+	glm::mat4 main_view_projection_;
+	/** Position of the camera this frame */
+	glm::vec3 main_view_position_;
+	/** Index counts of the meshlet ranges to draw, reused between draws */
+	std::vector<GLsizei> cluster_counts_;
+	/** Index buffer offsets of the meshlet ranges to draw, reused between draws */
+	std::vector<const void*> cluster_offsets_;
+	/** Base vertex of each range, the one of the mesh in the geometry arena */
+	std::vector<GLint> cluster_base_vertices_;
+
 	//## FORWARD RENDERING
 	/**
 	* @brief Render the scene cubemap
@@ -62,43 +218,44 @@ private:
 	/**
 	 * @brief Render only the elements with their textures associated
 	 * 
-	 * @param comp ComponentManager to get the data from
+	 * @param visible Indexes of the render items to draw
 	 * @param prog Program to use in the rendering of the scene
 	 */
-	void render_elements_with_texture(ComponentManager* comp, Program* prog);
+	void render_elements_with_texture(const std::vector<uint32_t>& visible, Program* prog);
 	/**
 	 * @brief Render only the elements for the shadow depthmap
 	 *
-	 * @param comp ComponentManager to get the data from
+	 * @param visible Indexes of the render items to draw
 	 * @param prog Program to use in the rendering of the scene
+	 * @param light_view_projection View projection of the light to cull the meshlets with, nullptr to draw them all
 	 */
-	void render_elements_depthmap(ComponentManager* comp, Program* prog);
+	void render_elements_depthmap(const std::vector<uint32_t>& visible, Program* prog, const glm::mat4* light_view_projection = nullptr);
 	/**
 	 * @brief Render the elements with a directionallight
 	 *
-	 * @param comp ComponentManager to get the data from
+	 * @param visible Indexes of the render items to draw
 	 * @param prog Program to use in the rendering of the scene
 	 * @param directional The DirectionalLight to draw with
 	 */
-	void render_light_elements(ComponentManager* comp, Program* prog, DirectionalLight* directional);
+	void render_light_elements(const std::vector<uint32_t>& visible, Program* prog, DirectionalLight* directional);
 
 	/**
 	* @brief Render the elements with a spotlight
 	*
-	* @param comp ComponentManager to get the data from
+	* @param visible Indexes of the render items to draw
 	* @param prog Program to use in the rendering of the scene
 	* @param spotlight The SpotLight to draw with
 	*/
-	void render_light_elements(ComponentManager* comp, Program* prog, SpotLight* spotlight);
+	void render_light_elements(const std::vector<uint32_t>& visible, Program* prog, SpotLight* spotlight);
 
 	/**
 	* @brief Render the elements with a pointlight
 	*
-	* @param comp ComponentManager to get the data from
+	* @param visible Indexes of the render items to draw
 	* @param prog Program to use in the rendering of the scene
 	* @param pointlight The PointLight to draw with
 	*/
-	void render_light_elements(ComponentManager* comp, Program* prog, PointLight* pointlight);
+	void render_light_elements(const std::vector<uint32_t>& visible, Program* prog, PointLight* pointlight);
 	/**
 	 * @brief Forward rendering method
 	 * 
@@ -184,8 +341,6 @@ private:
 	/** Program for drawing elements on deffered rendering without light */
 	std::unique_ptr<Program> deferred_rendering_elements_with_texture_program_;
 
-	std::shared_ptr<TinyObj> last_loaded_mesh = nullptr;
-
 	/** Freetype content */
 	bool free_type_init = false;
 	std::map<char, Character> characters_;
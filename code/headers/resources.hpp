@@ -2,10 +2,14 @@
 #define __RESOURCES_H__ 1
 
 #include <memory>
+#include <unordered_map>
+#include <cstdint>
 #include <texture.hpp>
 #include <tinyobj.hpp>
 #include <cubemap.hpp>
 #include <audio.hpp>
+#include <texture_streamer.hpp>
+#include <texture_residency.hpp>
 
 
 struct RenderingText {
@@ -36,6 +40,22 @@ struct RenderingText {
 	}
 };
 
+//Memory the loaded meshes and textures can take before the unused ones are evicted
+const size_t kDefaultResourceBudget = (size_t)512 * 1024 * 1024;
+
+/**
+ * @brief Bookkeeping of an asset loaded from a file, to find it again by its path and evict it when unused
+ */
+template<class T>
+struct AssetEntry {
+	/** The asset, owned by the list of Resources */
+	std::weak_ptr<T> asset_;
+	/** Bytes it takes in memory, counted against the budget */
+	size_t size_;
+	/** Value of the use counter the last time it was requested, the lowest are evicted first */
+	uint64_t last_used_;
+};
+
 /**
  * @brief Different types of resources that can be used on the engine
  */
@@ -51,27 +71,77 @@ struct Resources {
 	/** Audio of the scene*/
 	std::vector<std::unique_ptr<Audio>> audios_;
 
-	//TODO:Remains to search in both functions for previously loaded 
-	//elements and return a reference to them instead of loading another one
+	/** Meshes loaded from a file by their normalized path */
+	std::unordered_map<std::string, AssetEntry<TinyObj>> mesh_paths_;
+	/** Textures loaded from a file by their normalized path */
+	std::unordered_map<std::string, AssetEntry<Texture>> texture_paths_;
+	/** Normalized path of the meshes by their name, the first one loaded keeps the name */
+	std::unordered_map<std::string, std::string> mesh_names_;
+	/** Normalized path of the textures by their name, the first one loaded keeps the name */
+	std::unordered_map<std::string, std::string> texture_names_;
+	/** Bytes the loaded meshes and textures can take before the least recently used ones are evicted */
+	size_t memory_budget_;
+	/** Bytes taken by the meshes and textures loaded from a file */
+	size_t memory_used_;
+	/** Increased each time an asset is requested, to know which one was used the longest ago */
+	uint64_t use_counter_;
+#ifdef RENDER_OPENGL
+	/** Buffers the geometry of every mesh is uploaded to */
+	std::shared_ptr<GeometryArena> geometry_arena_;
+	/** Arrays the textures loaded from a file are packed in, by size and format */
+	std::shared_ptr<TextureArrayPool> texture_arrays_;
+	/** Pixel buffers the streamed textures are uploaded through, created with the Opengl context */
+	std::unique_ptr<TextureStreamer> texture_streamer_;
+	/** Mip levels of the textures on the GPU, kept under its own budget, created with the Opengl context */
+	std::unique_ptr<TextureResidency> texture_residency_;
+#endif
+
+	Resources();
 
 #ifdef RENDER_OPENGL
 	/**
-	 * @brief Loads a Texture and stores it in the resources list
+	 * @brief Loads a Texture and stores it in the resources list.
+	 * If the file was already loaded the same texture is returned
 	 *
 	 * @param filepath Path to the texture file
+	 * @param boss Optional job system to compress the texture in parallel the first time it's cooked
 	 *
 	 * @return std::shared_ptr<Texture> A pointer to the loaded texture
 	 */
-	std::shared_ptr<Texture> addTexture(std::string filepath);
+	std::shared_ptr<Texture> addTexture(std::string filepath, Boss* boss = nullptr);
 
 	/**
-	 * @brief Loads a TinyObj mesh and stores it in the resources list
+	 * @brief Loads a TinyObj mesh and stores it in the resources list.
+	 * If the file was already loaded the same mesh is returned
 	 *
 	 * @param filepath Path to the mesh file
+	 * @param boss Optional job system to parse the mesh in parallel
 	 *
 	 * @return std::shared_ptr<TinyObj> A pointer to the loaded mesh
 	 */
-	std::shared_ptr<TinyObj> addMesh(std::string filepath);
+	std::shared_ptr<TinyObj> addMesh(std::string filepath, Boss* boss = nullptr);
+
+	/**
+	 * @brief Stores a mesh that is streamed in from its OBJ file over the next frames,
+	 * see StreamMesh. If the file was already loaded the same mesh is returned
+	 *
+	 * @param filepath Path to the mesh file
+	 * @param boss Job system to stream the mesh on, if nullptr it's loaded like addMesh
+	 *
+	 * @return std::shared_ptr<TinyObj> A pointer to the mesh, empty until the first piece arrives
+	 */
+	std::shared_ptr<TinyObj> streamMesh(std::string filepath, Boss* boss);
+
+	/**
+	 * @brief Stores a texture that is uploaded over the next frames through the texture streamer,
+	 * see StreamTexture. If the file was already loaded the same texture is returned
+	 *
+	 * @param filepath Path to the texture file
+	 * @param boss Job system to load the texture on, if nullptr it's loaded like addTexture
+	 *
+	 * @return std::shared_ptr<Texture> A pointer to the texture, not drawn until its smallest level arrives, or all of them if it is packed
+	 */
+	std::shared_ptr<Texture> streamTexture(std::string filepath, Boss* boss);
 
 	/**
 	 * @brief Init resources like the cubemap mesh
@@ -81,7 +151,8 @@ struct Resources {
 #endif
 #ifdef RENDER_DIRECTX11
 	/**
-	* @brief Loads a Texture and stores it in the resources list
+	* @brief Loads a Texture and stores it in the resources list.
+	* If the file was already loaded the same texture is returned
 	*
 	* @param Device to create the texture into
 	* @param filepath Path to the texture file
@@ -91,7 +162,8 @@ struct Resources {
 	std::shared_ptr<Texture> addTexture(ID3D11Device* dev, std::string filepath);
 
 	/**
-	 * @brief Loads a TinyObj mesh and stores it in the resources list
+	 * @brief Loads a TinyObj mesh and stores it in the resources list.
+	 * If the file was already loaded the same mesh is returned
 	 *
 	 * @param Device to create the texture into
 	 * @param filepath Path to the mesh file
@@ -119,6 +191,39 @@ struct Resources {
 	 */
 	void ClearResources();
 
+	/**
+	 * @brief Stores a mesh loaded elsewhere, like on a worker, in the resources list
+	 *
+	 * @param mesh Loaded mesh, its full_path_ identifies it
+	 *
+	 * @return std::shared_ptr<TinyObj> The mesh, or the one already loaded from the same file
+	 */
+	std::shared_ptr<TinyObj> storeMesh(std::shared_ptr<TinyObj> mesh);
+
+	/**
+	 * @brief Stores a texture loaded elsewhere, like on a worker, in the resources list
+	 *
+	 * @param texture Loaded texture, its src_ identifies it
+	 *
+	 * @return std::shared_ptr<Texture> The texture, or the one already loaded from the same file
+	 */
+	std::shared_ptr<Texture> storeTexture(std::shared_ptr<Texture> texture);
+
+	/**
+	 * @brief Sets the memory the meshes and textures can take, evicting the unused ones if it's exceeded
+	 *
+	 * @param bytes New budget
+	 */
+	void setMemoryBudget(size_t bytes);
+
+	/**
+	 * @brief Evicts the meshes and textures only referenced by the resources list, least recently
+	 * requested first, until the memory used is under the budget
+	 *
+	 * @return size_t Bytes freed
+	 */
+	size_t TrimResources();
+
 
 
 	RenderingText* addTextToRender(std::string text, float x, float y, glm::vec3 color = glm::vec3(0.0f), float s = 1.0f);
@@ -127,7 +232,31 @@ struct Resources {
 
 	Audio* addAudioFile(std::string filepath);
 
+	/**
+	 * @brief Finds a loaded mesh by its name
+	 *
+	 * @param objfile Name of the mesh, its file name without extension
+	 *
+	 * @return std::shared_ptr<TinyObj> The mesh, nullptr if there's none with that name
+	 */
 	std::shared_ptr<TinyObj> getMeshByName(std::string objfile);
+
+	/**
+	 * @brief Finds a loaded mesh by the path it was loaded from
+	 *
+	 * @param filepath Path of the mesh, any spelling of it
+	 *
+	 * @return std::shared_ptr<TinyObj> The mesh, nullptr if it isn't loaded
+	 */
+	std::shared_ptr<TinyObj> getMeshByPath(std::string filepath);
+
+	/**
+	 * @brief Finds a loaded texture by its name
+	 *
+	 * @param texturefile Name of the texture, its file name without extension
+	 *
+	 * @return std::shared_ptr<Texture> The texture, nullptr if there's none with that name
+	 */
 	std::shared_ptr<Texture> getTextureByName(std::string texturefile);
 
 };
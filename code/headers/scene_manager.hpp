@@ -12,6 +12,7 @@
 struct sqlite3;
 
 #include <component_system.hpp>
+#include <task.hpp>
 #ifdef RENDER_OPENGL
   #include <render_system_opengl.hpp>
 #endif
@@ -60,6 +61,20 @@ public:
   */
   bool LoadScene(ComponentManager* component_manager, RenderSystem* render_system, std::string scene_name);
 
+#ifdef RENDER_OPENGL
+  /**
+  * @brief Load all contents of a previously saved scene without blocking the main thread.
+  * The database is read and the resources are loaded in parallel on the workers, and
+  * the buffers and entities are created on the main thread on the next frame
+  *
+  * @param boss Job system to load the resources on
+  * @param scene_name Which scene to load
+  *
+  * @return eve::task<bool> Task that finishes with whether the database was succesfully loaded or not
+  */
+  eve::task<bool> LoadSceneAsync(ComponentManager* component_manager, RenderSystem* render_system, Boss* boss, std::string scene_name);
+#endif
+
   /**
    * @brief Retrieve all the databases in the database folder
    * 
@@ -105,6 +120,18 @@ private:
    */
   void PreLoadDBCreationQueries();
 
+  /**
+   * @brief Creates the texts, lights and entities of a scene once its textures and meshes are loaded
+   *
+   * @param db Opened database of the scene
+   * @param textures Textures of the scene in the order of their ids
+   * @param meshes Meshes of the scene in the order of their ids
+   *
+   * @return bool If the contents were succesfully loaded or not
+   */
+  bool LoadSceneContents(sqlite3* db, ComponentManager* component_manager, RenderSystem* render_system,
+    const std::vector<std::shared_ptr<Texture>>& textures, const std::vector<std::shared_ptr<TinyObj>>& meshes);
+
   /** If the database has loaded or not */
   bool loaded_db_;
 
@@ -0,0 +1,366 @@
+#ifndef __TASK_HPP__
+#define __TASK_HPP__	1
+
+#include <atomic>
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boss.hpp>
+
+namespace eve {
+
+template<typename T = void>
+class task;
+
+namespace detail {
+
+	/**
+	 * @brief Common part of the promise of every task: the coroutine to continue with and the exception thrown, if any
+	 */
+	struct task_promise_base {
+
+		/** Coroutine awaiting this one, resumed when this one finishes */
+		std::coroutine_handle<> continuation_;
+		/** Exception thrown by the body of the coroutine */
+		std::exception_ptr exception_;
+
+		/**
+		 * @brief Resumes the awaiting coroutine directly from the finished one, without growing the stack
+		 */
+		struct final_awaiter {
+			bool await_ready() const noexcept { return false; }
+
+			template<typename P>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<P> finished) noexcept {
+				std::coroutine_handle<> next = finished.promise().continuation_;
+				if (next) { return next; }
+				return std::noop_coroutine();
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		//Tasks are lazy, they don't start until they are awaited
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		final_awaiter final_suspend() const noexcept { return {}; }
+		void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+	};
+
+	template<typename T>
+	struct task_promise : task_promise_base {
+
+		/** Value returned by the coroutine */
+		std::optional<T> value_;
+
+		task<T> get_return_object() noexcept;
+
+		template<typename U>
+		void return_value(U&& value) { value_.emplace(std::forward<U>(value)); }
+
+		T result() {
+			if (exception_) { std::rethrow_exception(exception_); }
+			return std::move(*value_);
+		}
+	};
+
+	template<>
+	struct task_promise<void> : task_promise_base {
+
+		task<void> get_return_object() noexcept;
+
+		void return_void() const noexcept {}
+
+		void result() {
+			if (exception_) { std::rethrow_exception(exception_); }
+		}
+	};
+
+	/**
+	 * @brief Coroutine that starts right away and destroys itself when it finishes.
+	 * Used internally to launch tasks that nobody awaits
+	 */
+	struct detached {
+		struct promise_type {
+			detached get_return_object() const noexcept { return {}; }
+			std::suspend_never initial_suspend() const noexcept { return {}; }
+			std::suspend_never final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			void unhandled_exception() const noexcept { std::terminate(); }
+		};
+	};
+
+	/**
+	 * @brief Shared state of a when_all, resumes the parent when the last task finishes
+	 */
+	struct when_all_state {
+		/** Tasks that haven't finished yet */
+		std::atomic<size_t> remaining_;
+		/** Coroutine waiting for all the tasks */
+		std::coroutine_handle<> parent_;
+		/** First exception thrown by any of the tasks */
+		std::exception_ptr exception_;
+		/** Guards the exception so only the first one is stored */
+		std::atomic<bool> has_exception_;
+	};
+
+} // namespace detail
+
+/**
+ * @brief Lazy coroutine that produces a T. It starts when it's awaited and resumes
+ * the awaiting coroutine when it finishes, on whichever thread it finished
+ */
+template<typename T>
+class [[nodiscard]] task {
+
+public:
+
+	using promise_type = detail::task_promise<T>;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	task() noexcept : handle_{ nullptr } {}
+	explicit task(handle_type handle) noexcept : handle_{ handle } {}
+
+	task(task&& other) noexcept : handle_{ std::exchange(other.handle_, nullptr) } {}
+
+	task& operator=(task&& other) noexcept {
+		if (this != &other) {
+			if (handle_) { handle_.destroy(); }
+			handle_ = std::exchange(other.handle_, nullptr);
+		}
+		return *this;
+	}
+
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+
+	~task() {
+		if (handle_) { handle_.destroy(); }
+	}
+
+	/**
+	 * @brief Returns if the task has already finished, or if it's empty
+	 *
+	 * @return bool True if there's nothing left to run
+	 */
+	bool done() const noexcept { return !handle_ || handle_.done(); }
+
+	/**
+	 * @brief Awaiter that starts the task and resumes the caller when it finishes
+	 */
+	struct awaiter {
+		handle_type handle_;
+
+		bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+			handle_.promise().continuation_ = awaiting;
+			return handle_;
+		}
+
+		T await_resume() { return handle_.promise().result(); }
+	};
+
+	awaiter operator co_await() & noexcept { return awaiter{ handle_ }; }
+	awaiter operator co_await() && noexcept { return awaiter{ handle_ }; }
+
+private:
+
+	handle_type handle_;
+};
+
+namespace detail {
+
+	template<typename T>
+	task<T> task_promise<T>::get_return_object() noexcept {
+		return task<T>{ std::coroutine_handle<task_promise<T>>::from_promise(*this) };
+	}
+
+	inline task<void> task_promise<void>::get_return_object() noexcept {
+		return task<void>{ std::coroutine_handle<task_promise<void>>::from_promise(*this) };
+	}
+
+} // namespace detail
+
+/**
+ * @brief Awaiter that moves the coroutine to a worker of the boss
+ */
+struct schedule_awaiter {
+	Boss& boss_;
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) { boss_.run([handle]() { handle.resume(); }); }
+	void await_resume() const noexcept {}
+};
+
+/**
+ * @brief Continues the coroutine on a worker of the boss
+ *
+ * @param boss Job system to continue on
+ */
+inline schedule_awaiter schedule_on(Boss& boss) { return schedule_awaiter{ boss }; }
+
+/**
+ * @brief Awaiter that continues the coroutine on the main thread at the start of the next frame
+ */
+struct next_frame_awaiter {
+	Boss& boss_;
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) { boss_.defer_to_next_frame(handle); }
+	void await_resume() const noexcept {}
+};
+
+/**
+ * @brief Continues the coroutine on the thread that calls Boss::run_frame_continuations,
+ * the main thread, on the next frame. Needed for anything that touches the render context.
+ * <B>Don't block the main thread waiting for a task that awaits this, or it will never resume</B>
+ *
+ * @param boss Job system that holds the continuations
+ */
+inline next_frame_awaiter next_frame(Boss& boss) { return next_frame_awaiter{ boss }; }
+
+/**
+ * @brief Awaiter that executes a load function on a worker and resumes with its result
+ */
+template<typename F>
+struct run_on_awaiter {
+	using result_type = std::invoke_result_t<F&>;
+	using storage_type = std::conditional_t<std::is_void_v<result_type>, bool, result_type>;
+
+	Boss& boss_;
+	F function_;
+	std::optional<storage_type> result_;
+	std::exception_ptr exception_;
+
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		boss_.run([this, handle]() {
+			try {
+				if constexpr (std::is_void_v<result_type>) { function_(); }
+				else { result_.emplace(function_()); }
+			}
+			catch (...) {
+				exception_ = std::current_exception();
+			}
+			handle.resume();
+		});
+	}
+
+	result_type await_resume() {
+		if (exception_) { std::rethrow_exception(exception_); }
+		if constexpr (!std::is_void_v<result_type>) { return std::move(*result_); }
+	}
+};
+
+/**
+ * @brief Runs a function, usually a load request, on a worker and continues the coroutine there with its result
+ *
+ * @param boss Job system to run on
+ * @param function Function to execute
+ */
+template<typename F>
+run_on_awaiter<std::decay_t<F>> run_on(Boss& boss, F&& function) {
+	return run_on_awaiter<std::decay_t<F>>{ boss, std::forward<F>(function), std::nullopt, nullptr };
+}
+
+namespace detail {
+
+	inline detached run_when_all_child(Boss& boss, task<void>& child, when_all_state* state) {
+		co_await schedule_on(boss);
+
+		try {
+			co_await child;
+		}
+		catch (...) {
+			if (!state->has_exception_.exchange(true)) { state->exception_ = std::current_exception(); }
+		}
+
+		//The last one to finish continues the parent
+		if (state->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			state->parent_.resume();
+		}
+	}
+
+} // namespace detail
+
+/**
+ * @brief Awaiter that runs a group of tasks in parallel and resumes when all of them have finished
+ */
+struct when_all_awaiter {
+	Boss& boss_;
+	std::vector<task<void>> tasks_;
+	detail::when_all_state state_;
+
+	bool await_ready() const noexcept { return tasks_.empty(); }
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		state_.parent_ = handle;
+		state_.remaining_.store(tasks_.size(), std::memory_order_relaxed);
+		state_.has_exception_.store(false, std::memory_order_relaxed);
+
+		//Once the last child has been launched this awaiter can be resumed and
+		//destroyed at any moment, so the size is read before launching them
+		size_t count = tasks_.size();
+		for (size_t i = 0; i < count; ++i) {
+			detail::run_when_all_child(boss_, tasks_[i], &state_);
+		}
+	}
+
+	void await_resume() {
+		if (state_.exception_) { std::rethrow_exception(state_.exception_); }
+	}
+};
+
+/**
+ * @brief Runs all the tasks in parallel on the workers of the boss and continues when all have finished
+ *
+ * @param boss Job system to run on
+ * @param tasks Tasks to run
+ */
+inline when_all_awaiter when_all(Boss& boss, std::vector<task<void>> tasks) {
+	return when_all_awaiter{ boss, std::move(tasks), {} };
+}
+
+namespace detail {
+
+	template<typename T>
+	detached run_spawned(Boss& boss, task<T> spawned, JobCounter* counter) {
+		co_await schedule_on(boss);
+
+		try {
+			co_await spawned;
+		}
+		catch (const std::exception& e) {
+			printf("Unhandled exception in spawned task: %s\n", e.what());
+		}
+		catch (...) {
+			printf("Unhandled exception in spawned task\n");
+		}
+
+		if (counter != nullptr) { counter->done_one(); }
+	}
+
+} // namespace detail
+
+/**
+ * @brief Launches a task on the boss without awaiting it
+ *
+ * @param boss Job system to run on
+ * @param spawned Task to launch, its result is discarded
+ * @param counter Optional counter that will be decremented when the task finishes
+ */
+template<typename T>
+void spawn(Boss& boss, task<T> spawned, JobCounter* counter = nullptr) {
+	if (counter != nullptr) { counter->pending_.fetch_add(1, std::memory_order_relaxed); }
+	detail::run_spawned(boss, std::move(spawned), counter);
+}
+
+} // namespace eve
+
+#endif //__TASK_HPP__
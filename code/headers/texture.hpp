@@ -4,6 +4,12 @@
 #include <d3d11.h>
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
+
+#include <mapped_file.hpp>
+#include <texture_compressor.hpp>
+#include <texture_array.hpp>
 
 #ifdef RENDER_DIRECTX11
 	#include <wrl.h>
@@ -14,6 +20,52 @@
 #include <GLFW/glfw3.h>
 #endif
 
+//Identifier of the cooked texture files
+const char kTextureCacheMagic[4] = { 'E', 'V', 'E', 'T' };
+//Increase it every time the layout of the cooked files or the encoder changes
+const uint32_t kTextureCacheVersion = 2;
+//Extension added to the path of an image to get the path of its cooked file
+const std::string kTextureCacheExtension = ".evetex";
+//Most mip levels a cooked file can hold, enough for 32768 pixels wide textures
+const unsigned int kTextureMaxLevels = 16;
+//Cook option to flip the rows so the first one is the bottom of the image, as the meshes sample it
+const uint32_t kTextureCookFlip = 1;
+//Cook option to build every mip level down to 1x1, without it only the image itself is kept
+const uint32_t kTextureCookMipmaps = 2;
+//Cook options of the textures drawn on meshes
+const uint32_t kTextureCookDefault = kTextureCookFlip | kTextureCookMipmaps;
+
+/**
+ * @brief Header of a cooked texture file. It's followed by every mip level, already
+ * in the format the GPU stores them with, from the biggest to the smallest
+ */
+struct TextureCacheHeader {
+	/** Must be kTextureCacheMagic */
+	char magic_[4];
+	/** Must be kTextureCacheVersion */
+	uint32_t version_;
+	/** Size of the image the file was cooked from, to know if it's outdated */
+	uint64_t source_size_;
+	/** Last write time of the image the file was cooked from, to know if it's outdated */
+	int64_t source_time_;
+	/** Width of the first level */
+	uint32_t width_;
+	/** Height of the first level */
+	uint32_t height_;
+	/** Channels of the source image */
+	uint32_t channels_;
+	/** Format of every level */
+	TextureFormat format_;
+	/** Number of mip levels stored */
+	uint32_t level_count_;
+	/** kTextureCook options it was cooked with, a texture wanting others cooks it again */
+	uint32_t cook_flags_;
+	/** Offset from the start of the file to each level */
+	uint64_t level_offsets_[kTextureMaxLevels];
+	/** Size in bytes of each level */
+	uint64_t level_sizes_[kTextureMaxLevels];
+};
+
 /**
  * @brief Structure of a texture that can be rendered on a mesh
  */
@@ -43,7 +95,47 @@ struct Texture {
 	std::string name_;
 
 	unsigned int format;
-	unsigned char* data_;
+
+#ifdef RENDER_OPENGL
+	/** Cooked file mapped until InitTexture uploads it */
+	std::unique_ptr<MappedFile> cache_file_;
+	/** Cooked file just compressed, kept until InitTexture uploads it */
+	std::vector<uint8_t> cooked_;
+	/** Bytes the texture takes on the GPU once it's uploaded, 0 before */
+	size_t gpu_size_;
+	/** Whether the texture was loaded from its cooked file */
+	bool loaded_from_cache_;
+	/** kTextureCook options of the texture, set before loading it */
+	uint32_t cook_flags_;
+	/** Time it took to load the texture, without creating its Opengl texture */
+	float load_time_ms_;
+	/** Pool the texture is packed in when it's uploaded, nullptr to keep it in its own Opengl texture */
+	std::shared_ptr<TextureArrayPool> array_pool_;
+	/** Array the texture is packed in, nullptr if it has its own Opengl texture */
+	TextureArray* array_;
+	/** Layer of the array the texture is packed in */
+	uint32_t array_layer_;
+	/** Array the levels being uploaded are packed in, swapped with array_ once they are all in */
+	TextureArray* pending_array_;
+	/** Layer of the pending array */
+	uint32_t pending_layer_;
+	/** Format the levels are stored with on the GPU */
+	TextureFormat storage_format_;
+	/** Number of mip levels of the cooked texture */
+	uint32_t level_count_;
+	/** Most detailed level on the GPU, level_count_ while nothing is uploaded */
+	uint32_t resident_level_;
+	/** Most detailed level the draws asked for since the residency last looked, level_count_ if none */
+	uint32_t requested_level_;
+	/** Level the residency wants on the GPU, the requested one unless the budget doesn't allow it */
+	uint32_t target_level_;
+	/** Residency frame the texture was last asked for a level, the ones not drawn lately lose their levels first */
+	uint64_t last_requested_frame_;
+	/** Whether its cooked file is on disk, so the levels dropped can be streamed in again */
+	bool can_stream_levels_;
+	/** Whether a change of its resident levels is being streamed */
+	bool streaming_levels_;
+#endif
 
 	Texture();
 	~Texture();
@@ -54,14 +146,131 @@ struct Texture {
 	 * @brief Creates an Opengl texture
 	 * 
 	 * @param filepath Path of the texture to load
+	 * @param boss Optional job system to compress the image in parallel if it isn't cooked yet
 	 * 
 	 * @return bool True if the texture is loaded successfully, False if not. 
 	 */
-	bool LoadTexture(std::string filepath);
-	bool LoadTextureNoInit(std::string filepath);
+	bool LoadTexture(std::string filepath, Boss* boss = nullptr);
 
+	/**
+	 * @brief Loads a texture without touching Opengl, so it can run on any thread. The cooked file is
+	 * mapped if it's valid, if not the image is decoded, its mip chain built and the result cooked
+	 *
+	 * @param filepath Path of the texture to load
+	 * @param boss Optional job system to compress the image in parallel
+	 *
+	 * @return bool True if the texture is loaded successfully, False if not.
+	 */
+	bool LoadTextureNoInit(std::string filepath, Boss* boss = nullptr);
+
+	/**
+	 * @brief Creates the Opengl texture of one loaded with LoadTextureNoInit, level by level from the
+	 * cooked data, and frees the CPU copy
+	 *
+	 * @return bool True if the texture has been created, False if it already was
+	 */
 	bool InitTexture();
 
+	/**
+	 * @brief Gets the cooked file loaded, header included, until the texture is uploaded
+	 *
+	 * @return const uint8_t* Start of the cooked data, nullptr if there's none
+	 */
+	const uint8_t* GetCookedData() const;
+
+	/**
+	 * @brief Starts uploading levels. A texture with a pool takes a layer of an array sized for the first
+	 * level, and every level from there to the smallest has to be uploaded to it again, even if it
+	 * was already packed. Loose textures create their Opengl texture the first time and then only
+	 * need the levels they don't have
+	 *
+	 * @param first_level Most detailed level that will be uploaded
+	 *
+	 * @return bool False if a packed texture can't get a layer for that level
+	 */
+	bool BeginUpload(uint32_t first_level = 0);
+
+	/**
+	 * @brief Uploads a mip level. Levels have to be uploaded from the smallest to the biggest.
+	 * A loose texture samples each level as soon as it's uploaded, a packed one keeps sampling
+	 * its previous layer until EndUpload
+	 *
+	 * @param level Mip level to upload
+	 * @param pixels Cooked data of the level, or its offset in the bound pixel unpack buffer
+	 */
+	void UploadLevel(uint32_t level, const void* pixels);
+
+	/**
+	 * @brief Frees the cooked data once every level has been uploaded, and switches a packed
+	 * texture to its new layer
+	 */
+	void EndUpload();
+
+	/**
+	 * @brief Frees the most detailed levels of a loose texture, clamping the base level
+	 * so only the ones left are sampled. Packed textures have to be uploaded again to a smaller layer
+	 *
+	 * @param first_level Most detailed level to keep
+	 *
+	 * @return bool True if any level has been freed
+	 */
+	bool DropLevels(uint32_t first_level);
+
+	/**
+	 * @brief Asks for a level to be resident, from the size the texture is drawn with this frame.
+	 * Assumes the texture covers the object once
+	 *
+	 * @param pixels Pixels the object spans on the screen
+	 */
+	void RequestLevel(float pixels);
+
+	/**
+	 * @brief Gets the bytes some levels take on the GPU
+	 *
+	 * @param first_level Most detailed level, every level after it is counted
+	 *
+	 * @return size_t Size in bytes
+	 */
+	size_t GetLevelsSize(uint32_t first_level) const;
+
+	/**
+	 * @brief Maps the cooked file again to stream levels in after they were dropped. It only reads
+	 * what doesn't change once the texture is loaded, so it can run on any thread
+	 *
+	 * @return std::unique_ptr<MappedFile> The file, nullptr if it's gone or it doesn't match the texture anymore
+	 */
+	std::unique_ptr<MappedFile> MapCookedLevels() const;
+
+	/**
+	 * @brief Maps the cooked file of an image, the data stays mapped until InitTexture is called
+	 *
+	 * @param filepath Path to the image
+	 *
+	 * @return bool True if there's a valid cooked file and it's been mapped
+	 */
+	bool LoadCache(std::string filepath);
+
+	/**
+	 * @brief Decodes an image, builds its mip chain and compresses every level to BC1, or to BC3 if it
+	 * has transparency. Without S3TC support the levels are kept uncompressed. The result is kept until InitTexture.
+	 * The flip and the mip chain follow cook_flags_
+	 *
+	 * @param filepath Path to the image
+	 * @param boss Optional job system to compress in parallel
+	 *
+	 * @return bool True if the image has been decoded
+	 */
+	bool CookTexture(std::string filepath, Boss* boss);
+
+	/**
+	 * @brief Writes the texture cooked by CookTexture as the cooked file of an image
+	 *
+	 * @param filepath Path to the image the texture was loaded from
+	 *
+	 * @return bool True if the file has been written
+	 */
+	bool SaveCache(std::string filepath) const;
+
 
 	/**
 	 * @brief Creates an Opengl texture with params for a cubemap
@@ -96,6 +305,20 @@ struct Texture {
 	bool LoadCubemapTexture(ID3D11Device* dev, std::string filepath);
 #endif
 
+	/**
+	 * @brief Sets the path of the texture and takes its name from the file name
+	 *
+	 * @param filepath Path of the texture
+	 */
+	void SetPath(std::string filepath);
+
+#ifdef RENDER_OPENGL
+	/**
+	 * @brief Returns the layers of the arrays the texture is packed in, if it is
+	 */
+	void FreeArrayLayer();
+#endif
+
 	/**
 	 * @brief Frees a texture and deletes its Opengl id
 	 * 
@@ -103,6 +326,13 @@ struct Texture {
 	 */
 	bool FreeTexture();
 
+	/**
+	 * @brief Gets the memory the texture takes on the GPU, with its mipmaps
+	 * 
+	 * @return size_t Size in bytes
+	 */
+	size_t GetMemorySize() const;
+
 };
 
 #endif //__TEXTURE_HPP__
\ No newline at end of file
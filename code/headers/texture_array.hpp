@@ -0,0 +1,121 @@
+#ifndef __TEXTURE_ARRAY_HPP__
+#define __TEXTURE_ARRAY_HPP__	1
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include <texture_compressor.hpp>
+
+#ifdef RENDER_OPENGL
+#include "GL/glew.h"
+#endif
+
+//Layers the first array of each size and format has, every new one doubles the previous
+const uint32_t kTextureArrayInitialLayers = 2;
+//Most layers an array can have
+const uint32_t kTextureArrayMaxLayers = 64;
+//Bytes an array can take at most, textures with bigger levels than this are never packed
+const size_t kTextureArrayMaxBytes = (size_t)64 * 1024 * 1024;
+//Texture unit the arrays are bound to, apart from the units of the loose textures
+const unsigned int kTextureArrayUnit = 8;
+
+#ifdef RENDER_OPENGL
+/**
+ * @brief Gets the Opengl internal format of a texture format
+ *
+ * @param format Format of the texture
+ *
+ * @return GLenum GL_RGBA8 or the S3TC format of the blocks
+ */
+GLenum GetTextureInternalFormat(TextureFormat format);
+
+/**
+ * @brief Opengl array texture whose layers hold textures of the same size, format and sampling
+ */
+struct TextureArray {
+	/** Opengl id of the array texture */
+	GLuint texture_id_;
+	/** Width of the first level of every layer */
+	int width_;
+	/** Height of the first level of every layer */
+	int height_;
+	/** Format of every level */
+	TextureFormat format_;
+	/** Mip levels of every layer */
+	uint32_t level_count_;
+	/** GL_RGBA if the layers are clamped to the edge, GL_RGB if they repeat, like Texture::format */
+	unsigned int wrap_format_;
+	/** Number of layers */
+	uint32_t layer_count_;
+	/** Bytes a layer takes with all its levels */
+	size_t layer_size_;
+	/** Layers no texture is using */
+	std::vector<uint32_t> free_layers_;
+};
+
+/**
+ * @brief Packs the textures with the same size, format and sampling into array textures, so drawing
+ * objects with different textures doesn't need to bind anything else, only to change the layer sampled.
+ * When the arrays of a kind are full a new one twice as big is created, and an array is deleted once
+ * all its layers are free
+ */
+class TextureArrayPool {
+public:
+	TextureArrayPool();
+	~TextureArrayPool();
+
+	TextureArrayPool(const TextureArrayPool&) = delete;
+	TextureArrayPool& operator=(const TextureArrayPool&) = delete;
+
+	/**
+	 * @brief Takes a layer for a texture, creating a new array if there's no room left. Main thread only
+	 *
+	 * @param width Width of the first level
+	 * @param height Height of the first level
+	 * @param format Format of every level
+	 * @param level_count Mip levels of the texture
+	 * @param wrap_format GL_RGBA to clamp the texture to the edge, GL_RGB to repeat it
+	 * @param layer Where to store the layer taken
+	 *
+	 * @return TextureArray* Array the layer belongs to, nullptr if the texture is too big to be packed
+	 */
+	TextureArray* Allocate(int width, int height, TextureFormat format, uint32_t level_count, unsigned int wrap_format, uint32_t* layer);
+
+	/**
+	 * @brief Returns a layer taken with Allocate, the array is deleted if it's the last one in use. Main thread only
+	 *
+	 * @param array Array the layer belongs to
+	 * @param layer Layer to free
+	 */
+	void Free(TextureArray* array, uint32_t layer);
+
+	/**
+	 * @brief Gets the memory every array takes on the GPU, free layers included
+	 *
+	 * @return size_t Size in bytes
+	 */
+	size_t GetMemorySize() const;
+
+	/**
+	 * @brief Gets the number of arrays created
+	 *
+	 * @return size_t Number of arrays
+	 */
+	size_t GetArrayCount() const { return arrays_.size(); }
+
+private:
+	/**
+	 * @brief Creates the storage of a new array with every level of every layer
+	 *
+	 * @param array Array with its size, format and number of layers set
+	 */
+	void CreateStorage(TextureArray& array);
+
+	/** Arrays of every kind, they don't move so the textures can point to them */
+	std::vector<std::unique_ptr<TextureArray>> arrays_;
+};
+#endif
+
+#endif //__TEXTURE_ARRAY_HPP__
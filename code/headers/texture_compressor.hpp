@@ -0,0 +1,58 @@
+#ifndef __TEXTURE_COMPRESSOR_HPP__
+#define __TEXTURE_COMPRESSOR_HPP__	1
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class Boss;
+
+//Blocks each job compresses at least, so small images aren't split in jobs that cost more than they save
+const unsigned int kCompressMinBlocksPerJob = 4096;
+
+/**
+ * @brief Formats a texture can be stored with on the GPU
+ */
+enum class TextureFormat : uint32_t {
+	/** 8 bits per channel, uncompressed */
+	kRGBA8,
+	/** 4x4 blocks of 8 bytes, opaque colors */
+	kBC1,
+	/** 4x4 blocks of 16 bytes, colors with alpha */
+	kBC3
+};
+
+/**
+ * @brief Gets the bytes an image takes in a format
+ *
+ * @param format Format of the image
+ * @param width Width in pixels
+ * @param height Height in pixels
+ *
+ * @return size_t Size in bytes, block formats round the size up to whole blocks
+ */
+size_t GetTextureLevelSize(TextureFormat format, int width, int height);
+
+/**
+ * @brief Compresses an image to a block format. The rows of blocks are split between the workers
+ *
+ * @param format kBC1 or kBC3
+ * @param rgba Pixels of the image, 4 bytes each
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param out Where to write the blocks, GetTextureLevelSize bytes
+ * @param boss Optional job system to compress in parallel
+ */
+void CompressImage(TextureFormat format, const uint8_t* rgba, int width, int height, uint8_t* out, Boss* boss = nullptr);
+
+/**
+ * @brief Halves the size of an image averaging each 2x2 pixels, to build the next mip level
+ *
+ * @param rgba Pixels of the image, 4 bytes each
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param out Where to store the pixels of the next level, max(1, width / 2) by max(1, height / 2)
+ */
+void DownsampleImage(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& out);
+
+#endif //__TEXTURE_COMPRESSOR_HPP__
@@ -0,0 +1,76 @@
+#ifndef __TEXTURE_RESIDENCY_HPP__
+#define __TEXTURE_RESIDENCY_HPP__	1
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+class Boss;
+struct Texture;
+class TextureStreamer;
+class TextureArrayPool;
+
+//Bytes the textures can take on the GPU before the residency keeps them below the level they are drawn at
+const size_t kDefaultTextureBudget = (size_t)256 * 1024 * 1024;
+//Level changes streamed in each frame at most, so a camera cut doesn't map every cooked file at once
+const unsigned int kTextureResidencyStreamsPerFrame = 4;
+
+#ifdef RENDER_OPENGL
+/**
+ * @brief Decides which mip levels of each texture are on the GPU. The draws ask every frame for the level that
+ * matches the pixels each texture covers, and the residency streams in the levels missing and drops the ones
+ * not needed anymore. When they don't fit in the budget, the textures not drawn lately lose their levels first,
+ * and then the ones drawn lose a level each, the biggest first, until they fit.
+ * Only textures with a cooked file on disk are managed, the levels dropped have to be read again from it
+ */
+class TextureResidency {
+public:
+	/**
+	 * @param arrays Pool the packed textures are in, its free layers are reported but don't count against the budget
+	 * @param budget Bytes the textures can take on the GPU
+	 */
+	TextureResidency(std::shared_ptr<TextureArrayPool> arrays, size_t budget = kDefaultTextureBudget);
+
+	/**
+	 * @brief Sets the bytes the textures can take on the GPU, applied on the next Update
+	 *
+	 * @param bytes New budget
+	 */
+	void SetBudget(size_t bytes);
+
+	size_t GetBudget() const { return budget_; }
+
+	/**
+	 * @brief Gets the bytes the textures took on the GPU on the last Update, free layers of the arrays included
+	 *
+	 * @return size_t Size in bytes
+	 */
+	size_t GetResidentBytes() const { return resident_bytes_; }
+
+	/**
+	 * @brief Picks the level each texture should have from the ones asked for since the last call and starts
+	 * the changes. Loose textures drop levels at once, the rest of the changes are streamed. Main thread only,
+	 * once per frame before the frame continuations run
+	 *
+	 * @param textures Textures loaded
+	 * @param boss Job system to stream the levels with
+	 * @param streamer Streamer to upload the levels through
+	 */
+	void Update(const std::vector<std::shared_ptr<Texture>>& textures, Boss& boss, TextureStreamer& streamer);
+
+private:
+	/** Pool of the packed textures */
+	std::shared_ptr<TextureArrayPool> arrays_;
+	/** Bytes the textures can take on the GPU */
+	size_t budget_;
+	/** Bytes taken on the last Update */
+	size_t resident_bytes_;
+	/** Number of updates, a texture asked for a level gets the current one */
+	uint64_t frame_;
+	/** Textures kept below the level they are drawn at on the last Update, to report when it changes */
+	size_t reduced_count_;
+};
+#endif
+
+#endif //__TEXTURE_RESIDENCY_HPP__
@@ -0,0 +1,153 @@
+#ifndef __TEXTURE_STREAMER_HPP__
+#define __TEXTURE_STREAMER_HPP__	1
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include <task.hpp>
+
+#ifdef RENDER_OPENGL
+#include "GL/glew.h"
+#endif
+
+struct Texture;
+
+//Bytes of the pixel buffer the texture levels are staged in
+const size_t kTextureStreamRingSize = (size_t)64 * 1024 * 1024;
+//Bytes of levels started each frame at most, a level bigger than this is started alone in its frame
+const size_t kTextureStreamFrameBudget = (size_t)8 * 1024 * 1024;
+//Alignment of the levels inside the pixel buffer
+const size_t kTextureStreamAlignment = 256;
+//Biggest side of the levels a texture is first streamed with when the residency brings in the rest
+const int kTextureStreamInitialSize = 128;
+
+#ifdef RENDER_OPENGL
+/**
+ * @brief Ring of persistently mapped pixel buffer memory textures are uploaded through. Workers copy the
+ * levels into the mapping and the main thread only issues the uploads from buffer offsets. Each upload is
+ * fenced, and its part of the ring is reused once the GPU has read it
+ */
+class TextureStreamer {
+public:
+	/**
+	 * @brief Creates and maps the pixel buffer. Without persistent mapping every level is uploaded
+	 * straight from memory, still limited by the budget of each frame
+	 *
+	 * @param ring_size Bytes of the pixel buffer
+	 * @param frame_budget Bytes of levels started each frame at most
+	 */
+	TextureStreamer(size_t ring_size = kTextureStreamRingSize, size_t frame_budget = kTextureStreamFrameBudget);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	/**
+	 * @brief Frees the parts of the ring the GPU has finished reading and restarts the budget of the frame.
+	 * Called from the main thread before the frame continuations run
+	 */
+	void BeginFrame();
+
+	/**
+	 * @brief Takes room for a level in the ring and counts it against the budget of the frame. Main thread only
+	 *
+	 * @param size Bytes of the level
+	 * @param offset Where to store the offset of the room in the pixel buffer
+	 * @param memory Where to store the mapped memory to write the level to. Set to nullptr when the level
+	 * can't go through the ring and has to be uploaded from memory this frame
+	 *
+	 * @return bool False if there's no room or budget left this frame and it has to be retried the next one
+	 */
+	bool Reserve(size_t size, size_t* offset, uint8_t** memory);
+
+	/**
+	 * @brief Uploads a level written to the ring and fences its room. Main thread only
+	 *
+	 * @param texture Texture the level belongs to, its upload already begun
+	 * @param level Mip level
+	 * @param offset Offset returned by Reserve
+	 */
+	void Upload(Texture& texture, uint32_t level, size_t offset);
+
+	/**
+	 * @brief Gets the bytes staged in the ring that the GPU hasn't read yet
+	 *
+	 * @return size_t Size in bytes
+	 */
+	size_t GetPendingBytes() const;
+
+private:
+	/**
+	 * @brief Room of the ring taken by a level
+	 */
+	struct Region {
+		/** Offset in the pixel buffer */
+		size_t offset_;
+		/** Bytes taken, including the alignment */
+		size_t size_;
+		/** Signaled once the GPU has read it, null until the upload is issued */
+		GLsync fence_;
+	};
+
+	/** Pixel buffer, 0 without persistent mapping */
+	GLuint buffer_;
+	/** Mapping of the whole pixel buffer */
+	uint8_t* mapping_;
+	/** Bytes of the pixel buffer */
+	size_t capacity_;
+	/** Where the next region starts */
+	size_t head_;
+	/** Regions in use, from the oldest to the newest */
+	std::deque<Region> regions_;
+	/** Bytes of levels that can be started each frame */
+	size_t frame_budget_;
+	/** Bytes reserved this frame */
+	size_t frame_bytes_;
+};
+
+/**
+ * @brief Uploads a texture loaded with LoadTextureNoInit through the streamer over the next frames, from the
+ * smallest mip level to the biggest, starting on the main thread the next frame
+ *
+ * @param texture Texture to upload
+ * @param boss Job system to copy the levels on, its frame continuations have to run on the main thread
+ * @param streamer Streamer to upload through, it has to outlive the task
+ * @param max_size Biggest side of the levels uploaded, 0 for all of them. Only textures with a
+ * cooked file on disk skip levels, they are streamed in later with StreamTextureLevels
+ *
+ * @return eve::task<bool> Task that finishes once the levels are uploaded, false if there was nothing to upload
+ */
+eve::task<bool> UploadTexture(std::shared_ptr<Texture> texture, Boss& boss, TextureStreamer& streamer, int max_size = 0);
+
+/**
+ * @brief Changes the most detailed level of an uploaded texture to a more detailed one, reading the
+ * levels it lacks from its cooked file. Packed textures are uploaded whole to a layer of the size of
+ * the new level, so it also works to make them smaller. Clears streaming_levels_ when it's done
+ *
+ * @param texture Texture to change
+ * @param first_level Most detailed level it will have
+ * @param boss Job system to map the file and copy the levels on, its frame continuations have to run on the main thread
+ * @param streamer Streamer to upload through, it has to outlive the task
+ *
+ * @return eve::task<bool> Task that finishes once the levels are uploaded, false if the cooked file couldn't be read
+ */
+eve::task<bool> StreamTextureLevels(std::shared_ptr<Texture> texture, uint32_t first_level, Boss& boss, TextureStreamer& streamer);
+
+/**
+ * @brief Loads a texture on the workers and then uploads it like UploadTexture.
+ * It can be drawn as soon as the smallest level is uploaded, or all of them if it is packed in an array
+ *
+ * @param texture Texture to fill, its path and name are set before returning
+ * @param filepath Path of the image
+ * @param boss Job system to load and copy the levels on, its frame continuations have to run on the main thread
+ * @param streamer Streamer to upload through, it has to outlive the task
+ * @param max_size Biggest side of the levels uploaded, 0 for all of them, see UploadTexture
+ *
+ * @return eve::task<bool> Task that finishes once the levels are uploaded, true if the texture could be loaded
+ */
+eve::task<bool> StreamTexture(std::shared_ptr<Texture> texture, std::string filepath, Boss& boss, TextureStreamer& streamer, int max_size = 0);
+#endif
+
+#endif //__TEXTURE_STREAMER_HPP__
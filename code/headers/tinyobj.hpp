@@ -6,10 +6,18 @@
 #include <string>
 
 #include <vertex.hpp>
+#include <vertex_format.hpp>
+#include <mesh_optimizer.hpp>
 #include <texture.hpp>
+#include <mapped_file.hpp>
+#include <geometry_arena.hpp>
+#include <task.hpp>
 
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
 #include <algorithm>
 #ifdef RENDER_DIRECTX11
 	#include <wrl.h>
@@ -20,9 +28,70 @@
 #include <GLFW/glfw3.h>
 #endif
 
-//If the number of vertices is higher than this, it doesn't use indexes
-//This is due to the high load times that uses to avoid repeated info
-const unsigned int kVertexCountLimit = 50000;
+//Identifier of the cooked mesh files
+const char kMeshCacheMagic[4] = { 'E', 'V', 'E', 'M' };
+//Increase it every time the layout of the cooked files or of Vertex changes
+const uint32_t kMeshCacheVersion = 5;
+//Extension added to the path of an OBJ to get the path of its cooked file
+const std::string kMeshCacheExtension = ".evemesh";
+
+//Levels of detail generated at import, counting the full detail one
+const unsigned int kMeshLodCount = 5;
+//Fraction of the triangles of each LOD kept by the next one
+const float kMeshLodReduction = 0.5f;
+//Maximum deviation of a LOD from the full detail mesh, relative to the size of the mesh
+const float kMeshLodMaxError = 0.05f;
+
+/**
+ * @brief Level of detail of a mesh, a range of its index buffer drawn with the same vertices
+ */
+struct MeshLod {
+	/** First index of the LOD in the index buffer */
+	uint32_t index_offset_;
+	/** Number of indexes of the LOD */
+	uint32_t index_count_;
+	/** Deviation from the full detail mesh, relative to the size of the mesh */
+	float error_;
+};
+
+/**
+ * @brief Header of a cooked mesh file. It's followed by the vertices and the indexes,
+ * compressed and laid out exactly as the vertex and index buffers expect them, the LODs and the meshlets
+ */
+struct MeshCacheHeader {
+	/** Must be kMeshCacheMagic */
+	char magic_[4];
+	/** Must be kMeshCacheVersion */
+	uint32_t version_;
+	/** Number of vertices stored */
+	uint32_t vertex_count_;
+	/** Number of indexes stored */
+	uint32_t index_count_;
+	/** Size of the OBJ the file was cooked from, to know if it's outdated */
+	uint64_t source_size_;
+	/** Last write time of the OBJ the file was cooked from, to know if it's outdated */
+	int64_t source_time_;
+	/** Offset from the start of the file to the vertices */
+	uint64_t vertex_offset_;
+	/** Offset from the start of the file to the indexes */
+	uint64_t index_offset_;
+	/** Offset from the start of the file to the LODs */
+	uint64_t lod_offset_;
+	/** Number of LODs stored */
+	uint32_t lod_count_;
+	/** Offset from the start of the file to the meshlets */
+	uint64_t meshlet_offset_;
+	/** Number of meshlets stored */
+	uint32_t meshlet_count_;
+	/** Minimum corner of the bounding box */
+	float bounds_min_[3];
+	/** Maximum corner of the bounding box */
+	float bounds_max_[3];
+	/** Radius of the bounding sphere, centered on the bounding box */
+	float bounds_radius_;
+	/** Layout of the compressed vertices and indexes */
+	VertexLayout layout_;
+};
 
 /**
  * @brief Structure that represents a mesh in the scene
@@ -34,13 +103,52 @@ struct TinyObj {
 	/** Vector of indexes to render the mesh */
 	std::vector<unsigned int> indexes_;
 
+	/** Number of vertices of the mesh, even if they only live on the GPU */
+	unsigned int vertex_count_;
+	/** Number of indexes of all the LODs, even if they only live on the GPU */
+	unsigned int index_count_;
+
+	/** Levels of detail stored in the index buffer, the first one is the full mesh */
+	std::vector<MeshLod> lods_;
+	/** Meshlets splitting the full detail LOD, to cull the parts of the mesh that aren't visible */
+	std::vector<Meshlet> meshlets_;
+	/** Minimum corner of the bounding box */
+	glm::vec3 bounds_min_;
+	/** Maximum corner of the bounding box */
+	glm::vec3 bounds_max_;
+	/** Radius of the bounding sphere, centered on the bounding box */
+	float bounds_radius_;
+	/** Changes each time the bounds grow after the mesh was initialized, as streamed meshes do with each piece */
+	uint32_t bounds_generation_;
+
+	/** Positions of the full detail mesh kept on the CPU to draw it as an occluder, empty until it's built */
+	std::vector<glm::vec3> occluder_positions_;
+	/** Triangles of the occluder, indexes of occluder_positions_ */
+	std::vector<uint32_t> occluder_indexes_;
+	/** Whether BuildOccluder couldn't find the triangles, so it isn't tried every frame */
+	bool occluder_failed_;
+	/** Whether the occluder is being built on the workers, see BuildOccluderAsync */
+	bool occluder_building_;
+
+	/** Layout of the vertices and indexes on the GPU, chosen at import or when the buffers are created */
+	VertexLayout layout_;
+
+	/** Cooked file mapped until its contents are uploaded by InitBuffer */
+	std::unique_ptr<MappedFile> cache_file_;
+	/** Whether the mesh was loaded from its cooked file or parsed from the OBJ */
+	bool loaded_from_cache_;
+	/** Milliseconds it took to load the mesh, without the buffers creation */
+	float load_time_ms_;
+
 #ifdef RENDER_OPENGL
-	/** Opengl Virtual Buffer Object identifier */
-	unsigned int virtual_buffer_object_;
-	/** Opengl Virtual Array Object identifier */
-	unsigned int virtual_array_object_;
-	/** Opengl Index Buffer Object identifier */
-	unsigned int index_buffer_object_;
+	/** Arena the vertices and indexes are uploaded to, shared with the other meshes */
+	std::shared_ptr<GeometryArena> arena_;
+	/** Place of the vertices and indexes in the arena, nullptr until InitBuffer */
+	GeometryAllocation* geometry_;
+	/** Pieces of a streamed mesh uploaded so far, each one with 16 bit indexes. Empty if it wasn't streamed */
+	std::vector<GeometryAllocation*> streamed_chunks_;
+	/** Whether the file of a streamed mesh is still being read */
+	bool streaming_;
 #endif
 
 #ifdef RENDER_DIRECTX11
@@ -55,9 +163,6 @@ struct TinyObj {
 	/** Path of the loaded mesh */
 	std::string full_path_;
 
-	/** Check to optimize the mesh reading and loading */
-	bool bigger_than_optimazable_;
-	
 	/** Whether if the buffers of the mesh have been initialized */
 	bool isInit_;
 	
@@ -71,15 +176,149 @@ struct TinyObj {
 	 */
 	void LoadObj(std::string inputfile);
 
+	/**
+	 * @brief Loads a mesh from a file with the engine OBJ parser, in parallel on the workers
+	 * of a boss. The result is the same as LoadObj, which is used if the parser can't read the file
+	 * 
+	 * @param inputfile Path to file to read mesh from
+	 * @param boss Job system to parse the file on, if nullptr it's parsed on the calling thread
+	 */
+	void LoadObjParallel(std::string inputfile, Boss* boss);
+
+	/**
+	 * @brief Loads a mesh from its cooked file if it's up to date. If not, parses the OBJ
+	 * and cooks it so the next load is faster
+	 * 
+	 * @param inputfile Path to the OBJ file
+	 * @param boss Optional job system to parse the OBJ in parallel
+	 */
+	void LoadMesh(std::string inputfile, Boss* boss = nullptr);
+
+	/**
+	 * @brief Reorders the triangles for the vertex cache and to reduce overdraw, and the
+	 * vertices in the order they are used. Prints the ACMR and ATVR before and after.
+	 * Only the full detail mesh is kept, the LODs and meshlets have to be generated after it
+	 * 
+	 * @param reduce_overdraw If the triangle clusters have to be sorted to reduce overdraw
+	 */
+	void Optimize(bool reduce_overdraw = true);
+
+	/**
+	 * @brief Generates the LOD chain simplifying the full detail mesh, stopping early if a LOD
+	 * would deviate too much or barely reduce the previous one. Replaces any previous LOD
+	 * 
+	 * @param lod_count Maximum number of LODs, counting the full detail one
+	 * @param reduction Fraction of the triangles of each LOD kept by the next one
+	 * @param max_error Maximum deviation from the full detail mesh, relative to the size of the mesh
+	 */
+	void GenerateLods(unsigned int lod_count = kMeshLodCount, float reduction = kMeshLodReduction, float max_error = kMeshLodMaxError);
+
+	/**
+	 * @brief Splits the full detail LOD in meshlets, with their bounds to cull them
+	 */
+	void GenerateMeshlets();
+
+	/**
+	 * @brief Gets a level of detail to draw, the coarsest one if the mesh doesn't have that many
+	 * 
+	 * @param lod Level of detail, 0 is the full detail mesh
+	 * 
+	 * @return MeshLod Range of the index buffer to draw
+	 */
+	MeshLod get_lod(unsigned int lod) const;
+
+	/**
+	 * @brief Gathers the positions and triangles of the full detail mesh, for the occlusion culling.
+	 * They're taken from the vertices loaded or, if they only live on the GPU, from the cooked file.
+	 * The mesh is only read, so a loaded mesh can build it on a worker
+	 * 
+	 * @param positions Where to store the positions of the vertices used
+	 * @param triangles Where to store the triangles, three indexes of positions each
+	 * 
+	 * @return bool True if the mesh has triangles to draw as an occluder
+	 */
+	bool BuildOccluder(std::vector<glm::vec3>* positions, std::vector<uint32_t>* triangles) const;
+
+	/**
+	 * @brief Gets the memory taken by the mesh, its GPU buffers and the data kept on the CPU
+	 * 
+	 * @return size_t Size in bytes
+	 */
+	size_t GetMemorySize() const;
+
+	/**
+	 * @brief Maps the cooked file of an OBJ, the data stays mapped until InitBuffer is called
+	 * 
+	 * @param inputfile Path to the OBJ file
+	 * 
+	 * @return bool True if there's a valid cooked file and it's been mapped
+	 */
+	bool LoadCache(std::string inputfile);
+
+	/**
+	 * @brief Writes the loaded vertices and indexes as the cooked file of an OBJ
+	 * 
+	 * @param inputfile Path to the OBJ file the mesh was loaded from
+	 * 
+	 * @return bool True if the file has been written
+	 */
+	bool SaveCache(std::string inputfile) const;
+
 	TinyObj();
 	~TinyObj();
 
 	#ifdef RENDER_OPENGL
-	void InitBuffer();
+	/**
+	 * @brief Uploads the vertices and indexes to a geometry arena, where they stay until the mesh is destroyed
+	 * 
+	 * @param arena Arena shared by the meshes drawn together
+	 */
+	void InitBuffer(std::shared_ptr<GeometryArena> arena);
+
+	/**
+	 * @brief Uploads vertices and indexes packed elsewhere, like by an importer, with the layout,
+	 * vertex count and index count of the mesh
+	 * 
+	 * @param arena Arena shared by the meshes drawn together
+	 * @param vertex_data Packed vertices
+	 * @param index_data Packed indexes
+	 */
+	void InitBuffer(std::shared_ptr<GeometryArena> arena, const void* vertex_data, const void* index_data);
 	#endif
 	#ifdef RENDER_DIRECTX11
 	void InitBuffer(ID3D11Device* dev, ID3D11DeviceContext* devCon);
 	#endif
 };
 
+#ifdef RENDER_OPENGL
+/**
+ * @brief Streams a mesh from an OBJ file. Each window of the file is parsed on the workers and its
+ * triangles are uploaded on the next frame, so the mesh is drawn while the rest is still being read
+ * and only the attributes and one window are in memory at a time. The result isn't optimized,
+ * simplified nor cooked, use LoadMesh for that. The name and path of the mesh are set right away.
+ * Every piece is packed with the layout of the first one, so the vertex colors are dropped if they
+ * only appear after it, those files have to be loaded with LoadMesh too
+ * 
+ * @param mesh Empty mesh to fill, it can be drawn as soon as the first piece is uploaded
+ * @param inputfile Path to the OBJ file
+ * @param boss Job system to parse the file on, it also has to run the frame continuations
+ * @param arena Arena to upload the pieces to
+ * 
+ * @return eve::task<bool> Task to spawn, it finishes with whether the whole file was read
+ */
+eve::task<bool> StreamMesh(std::shared_ptr<TinyObj> mesh, std::string inputfile, Boss& boss, std::shared_ptr<GeometryArena> arena);
+
+/**
+ * @brief Builds the occluder of a loaded mesh on the workers, reading the cooked file if needed.
+ * The triangles are stored in the mesh on the next frame, from the main thread, so the render system
+ * can keep reading it meanwhile. Sets occluder_building_ until then
+ * 
+ * @param mesh Mesh to build the occluder of, its buffers have to be initialized
+ * @param boss Job system to build it on, it also has to run the frame continuations
+ * 
+ * @return eve::task<bool> Task to spawn, it finishes with whether the mesh has an occluder
+ */
+eve::task<bool> BuildOccluderAsync(std::shared_ptr<TinyObj> mesh, Boss& boss);
+#endif
+
 #endif //__TINYOBJ_HPP__
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef __VERTEX_FORMAT_HPP__
+#define __VERTEX_FORMAT_HPP__	1
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <vertex.hpp>
+
+//Meshes with up to this many vertices use 16 bit indexes
+const uint32_t kMaxShortIndexVertices = 65536;
+
+/**
+ * @brief Layout of the compressed vertices of a mesh, chosen per mesh at import.
+ * Each vertex has, in order:
+ * - Position: 3 floats, or 4 unsigned shorts quantized in the bounds of the mesh (the last one unused)
+ * - Normal: 2 shorts, octahedral encoded
+ * - UV: 2 half floats
+ * - Color: 4 unsigned bytes, only if the mesh has vertex colors. If not they are white
+ */
+struct VertexLayout {
+	/** Whether the positions are quantized to 16 bits, if not they are floats */
+	bool quantized_positions_;
+	/** Whether the vertices store their color */
+	bool has_colors_;
+	/** Size of each vertex */
+	uint32_t stride_;
+	/** Size of each index, 2 or 4 */
+	uint32_t index_size_;
+	/** Offset of the normal in the vertex */
+	uint32_t normal_offset_;
+	/** Offset of the UV in the vertex */
+	uint32_t uv_offset_;
+	/** Offset of the color in the vertex, if it has one */
+	uint32_t color_offset_;
+	/** Position the quantized (0, 0, 0) maps to */
+	float position_offset_[3];
+	/** Size of the quantization range, the same on every axis so the normals don't need correcting */
+	float position_scale_;
+};
+
+/**
+ * @brief Chooses the most compact layout for the vertices of a mesh
+ *
+ * @param vertices Vertices of the mesh
+ * @param quantize_positions Whether the positions can be quantized. If they are, they have to be
+ * transformed with GetDequantizeTransform, which only the mesh programs do
+ *
+ * @return VertexLayout Layout to pack the vertices with
+ */
+VertexLayout ChooseVertexLayout(const std::vector<Vertex>& vertices, bool quantize_positions);
+
+/**
+ * @brief Gets the transform that takes quantized positions back to the space of the mesh,
+ * meant to be applied before the transform of the object
+ *
+ * @param layout Layout of the mesh
+ *
+ * @return glm::mat4 Dequantization transform, identity if the positions aren't quantized
+ */
+glm::mat4 GetDequantizeTransform(const VertexLayout& layout);
+
+/**
+ * @brief Compresses the vertices of a mesh
+ *
+ * @param layout Layout to pack them with
+ * @param vertices Vertices to pack
+ * @param out Where to store the packed vertices, layout.stride_ bytes each
+ */
+void PackVertices(const VertexLayout& layout, const std::vector<Vertex>& vertices, std::vector<uint8_t>& out);
+
+/**
+ * @brief Decompresses the vertices of a mesh
+ *
+ * @param layout Layout they were packed with
+ * @param data Packed vertices
+ * @param count Number of vertices
+ * @param out Where to store the vertices
+ */
+void UnpackVertices(const VertexLayout& layout, const uint8_t* data, size_t count, std::vector<Vertex>& out);
+
+/**
+ * @brief Converts the indexes of a mesh to the size of the layout
+ *
+ * @param layout Layout of the mesh
+ * @param indexes Indexes to convert
+ * @param out Where to store the indexes, layout.index_size_ bytes each
+ */
+void PackIndexes(const VertexLayout& layout, const std::vector<unsigned int>& indexes, std::vector<uint8_t>& out);
+
+/**
+ * @brief Converts indexes of the size of a layout back to 32 bits
+ *
+ * @param layout Layout of the mesh
+ * @param data Packed indexes
+ * @param count Number of indexes
+ * @param out Where to store the indexes
+ */
+void UnpackIndexes(const VertexLayout& layout, const uint8_t* data, size_t count, std::vector<unsigned int>& out);
+
+#endif //__VERTEX_FORMAT_HPP__
@@ -0,0 +1,127 @@
+#ifndef __VISIBILITY_HPP__
+#define __VISIBILITY_HPP__	1
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include <frustum_culling.hpp>
+#include <bounds_tree.hpp>
+
+class Boss;
+
+//Index of no item
+const uint32_t kNoVisibilityItem = 0xFFFFFFFF;
+//Jobs wanted per worker, a view is split over several subtrees until there are this many
+const unsigned int kVisibilityJobsPerWorker = 2;
+//Subtrees a view is split over at most
+const unsigned int kVisibilityMaxSubtrees = 64;
+
+/**
+ * @brief What the visibility needs to know of the items the views are culled into
+ */
+struct VisibilityItems {
+	/** Index of the item of each entity, kNoVisibilityItem for the entities without one */
+	std::vector<uint32_t> item_of_entity_;
+	/** Whether each item is drawn in the shadow views */
+	std::vector<unsigned char> casts_shadows_;
+};
+
+/**
+ * @brief View of the frame, one or several frustums seen together like the faces of a cube
+ */
+struct VisibilityView {
+	/** Frustums of the view */
+	Frustum frustums_[kCubeFaceCount];
+	/** Number of frustums */
+	unsigned int frustum_count_;
+	/** If only the items casting shadows are kept */
+	bool shadow_view_;
+	/** Items inside the view, in the order of the items */
+	std::vector<uint32_t> visible_;
+};
+
+/**
+ * @brief Culls every view of a frame at once. The views are added up front, then each one is split over
+ * subtrees of the bounds tree and the pieces are culled as jobs on the workers, so even a single view uses
+ * every core. The draw lists are ready before any of them is drawn.
+ * Doesn't touch the GPU, it only reads the bounds tree and the items
+ */
+class Visibility {
+public:
+	Visibility();
+
+	/**
+	 * @brief Removes the views of the last frame, keeping their memory
+	 */
+	void BeginFrame();
+
+	/**
+	 * @brief Adds a view to cull
+	 *
+	 * @param view_projections View projection matrix of each frustum of the view
+	 * @param frustum_count Number of frustums, kCubeFaceCount for the faces of a point light
+	 * @param shadow_view If only the items casting shadows are kept
+	 *
+	 * @return uint32_t Index of the view, to get its items once culled
+	 */
+	uint32_t AddView(const glm::mat4* view_projections, unsigned int frustum_count, bool shadow_view);
+
+	/**
+	 * @brief Culls every view added since BeginFrame
+	 *
+	 * @param tree Bounds tree of the entities, not changed until it returns
+	 * @param items Items of the entities of the tree
+	 * @param boss Job system to cull on, nullptr culls on the calling thread
+	 */
+	void Cull(const BoundsTree& tree, const VisibilityItems& items, Boss* boss);
+
+	/**
+	 * @brief Gets the items inside a view after Cull
+	 *
+	 * @param view Index returned by AddView
+	 *
+	 * @return const std::vector<uint32_t>& Indexes of the items, in ascending order
+	 */
+	const std::vector<uint32_t>& GetVisible(uint32_t view) const { return views_[view].visible_; }
+
+	size_t GetViewCount() const { return view_count_; }
+
+private:
+	/**
+	 * @brief Part of a view culled by one job
+	 */
+	struct Job {
+		/** View culled */
+		uint32_t view_;
+		/** Top of the subtree culled */
+		int32_t subtree_;
+		/** Entities the tree found */
+		std::vector<size_t> entities_;
+		/** Items of the entities kept */
+		std::vector<uint32_t> items_;
+	};
+
+	/**
+	 * @brief Culls a subtree against a view, keeping the items of the entities found
+	 */
+	static void CullSubtree(const BoundsTree& tree, const VisibilityItems& items, const VisibilityView& view, Job* job);
+
+	/**
+	 * @brief Joins the items the jobs of a view found and sorts them
+	 */
+	static void MergeView(const std::vector<Job>& jobs, size_t first_job, size_t job_count, VisibilityView* view);
+
+	/** Views of the frame, the ones past view_count_ are kept for their memory */
+	std::vector<VisibilityView> views_;
+	/** Views added since BeginFrame */
+	size_t view_count_;
+	/** Jobs of the last Cull, view after view */
+	std::vector<Job> jobs_;
+	/** Subtrees the views are split over */
+	std::vector<int32_t> subtrees_;
+};
+
+#endif //__VISIBILITY_HPP__
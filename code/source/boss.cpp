@@ -1,37 +1,96 @@
-
+#include <algorithm>
 #include <functional>
 
 #include "boss.hpp"
 
-Boss::Boss(): stop_{false}{
-
-	//Get number of cores
-	unsigned int worker_count = std::thread::hardware_concurrency();
-	for (int i = 0; i != worker_count; i++) {
-
-		std::packaged_task<void()> worker([this]() {
-			std::function<void()> job;
-			while (!stop_) {
-				{
-					// Lock mutex to avoid that more than one thread can access the jobs queue
-					std::unique_lock<std::mutex> lk(queue_mutex_);
-					job_condition_.wait(lk, [this] {return stop_ || !jobs_.empty(); });
-					if (!jobs_.empty()) {
-						//Get the first job available
-						job = jobs_.front();
-						//Remove the job from the list
-						jobs_.pop();
-					}
-				}
-				if (job) {
-					job();
-					job = nullptr;
-				}
-			}
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#elif defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+//Counter to give each boss a different identifier
+static std::atomic<unsigned int> next_boss_id{ 1 };
+
+//State of the current thread, cached for the last boss used
+struct LocalStateCache {
+	unsigned int boss_id = 0;
+	void* state = nullptr;
+};
+static thread_local LocalStateCache local_state_cache;
+
+//Names the calling thread so it can be told apart on debuggers and profilers
+static void SetCurrentThreadName(const std::string& name) {
+#if defined(_WIN32)
+	std::wstring wide_name(name.begin(), name.end());
+	SetThreadDescription(GetCurrentThread(), wide_name.c_str());
+#elif defined(__linux__)
+	//Linux only allows 15 characters plus the terminator
+	pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#else
+	(void)name;
+#endif
+}
+
+//Restricts the calling thread to run only on the given core
+static void PinCurrentThread(unsigned int core) {
+#if defined(_WIN32)
+	if (core < sizeof(DWORD_PTR) * 8) {
+		SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core);
+	}
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core, &cpu_set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0) {
+		printf("Boss: couldn't pin worker to core %u\n", core);
+	}
+#else
+	(void)core;
+#endif
+}
+
+Boss::Boss() : Boss(BossConfig()) {}
+
+Boss::Boss(const BossConfig& config): queue_head_{nullptr}, queue_tail_{nullptr}, job_count_{0},
+	running_jobs_{0}, next_thread_index_{0}, telemetry_{config.telemetry}, trace_start_{std::chrono::steady_clock::now()}, stop_{false}{
+
+	id_ = next_boss_id.fetch_add(1);
+
+	//By default leave the reserved cores to the main thread, but always have one worker
+	unsigned int core_count = std::max(std::thread::hardware_concurrency(), 1u);
+	unsigned int reserved_cores = std::min(config.reserved_cores, core_count - 1);
+	unsigned int worker_count = core_count - reserved_cores;
+	if (config.worker_count >= 0) { worker_count = (unsigned int)config.worker_count; }
+
+	//Cores the workers can be pinned to
+	std::vector<unsigned int> cores = config.affinity;
+	if (cores.empty()) {
+		for (unsigned int i = reserved_cores; i < core_count; ++i) { cores.push_back(i); }
+	}
+	bool pin = (config.pin_workers || !config.affinity.empty()) && !cores.empty();
+
+	//Workers take the first indices of the trace, the thread creating the boss goes right after them
+	next_thread_index_ = worker_count;
+	get_local_state()->name_ = "Main";
+
+	for (unsigned int i = 0; i != worker_count; i++) {
+
+		std::string name = config.thread_name + " " + std::to_string(i);
+		int core = pin ? (int)cores[i % cores.size()] : -1;
+
+		std::thread worker([this, i, name, core]() {
+			SetCurrentThreadName(name);
+			if (core >= 0) { PinCurrentThread((unsigned int)core); }
+			worker_loop(i, name);
 		});
 
 		//Add the worker to the worker list
-		workers_.push_back(std::thread{ std::move(worker) });
+		workers_.push_back(std::move(worker));
 	}
 
 }
@@ -45,32 +104,282 @@ Boss::~Boss()	{
 	for (auto& worker : workers_) {
 		worker.join();
 	}
-}
 
+	//Destroy the jobs that never got to run so their counters and promises are released
+	Job* job = pop_job();
+	while (job != nullptr) {
+		job->Discard();
+		job->pool_->Free(job);
+		job = pop_job();
+	}
+}
 
+unsigned int Boss::get_worker_count() const {
+	return (unsigned int)workers_.size();
+}
 
 int Boss::get_job_count() {
 	// Lock mutex to avoid that more than one thread can access the jobs queue
 	std::lock_guard<std::mutex> lock{ queue_mutex_ };
-	return (int) jobs_.size();
+	return job_count_;
 }
 
 std::mutex* Boss::get_mutex() {
 	return &queue_mutex_;
 }
 
-//template<typename Function, typename ...Args>
-//auto Boss::add(Function&& task, Args && ...args) -> std::future<decltype(task(args...))>
-//{
-//	std::lock_guard<std::mutex> lock{ queue_mutex_ };
-//	using ReturnType = decltype(task(args...));
-//	auto t = std::make_shared<std::packaged_task<ReturnType()>>(task);
-//	std::future<ReturnType> f = t->get_future();
-//
-//	jobs_.push([t]() {(*t)(); });
-//
-//
-//	job_available_.notify_one();
-//
-//	return f;
-//}
\ No newline at end of file
+void Boss::wait(JobCounter* counter) {
+	if (counter == nullptr) { return; }
+
+	while (!counter->is_done()) {
+		//Help emptying the queue, and only sleep when there's nothing left to do
+		if (!run_one()) {
+			counter->sleep_until_done();
+		}
+	}
+
+	//The last job may still be waking the waiting threads, the counter lives on the caller's stack
+	counter->release();
+}
+
+void Boss::defer_to_next_frame(std::coroutine_handle<> handle) {
+	std::lock_guard<std::mutex> lock{ frame_mutex_ };
+	frame_continuations_.push_back(handle);
+}
+
+void Boss::run_frame_continuations() {
+	//Take the list first, coroutines that wait for another frame will add themselves again
+	std::vector<std::coroutine_handle<>> continuations;
+	{
+		std::lock_guard<std::mutex> lock{ frame_mutex_ };
+		continuations.swap(frame_continuations_);
+	}
+
+	for (size_t i = 0; i < continuations.size(); ++i) {
+		continuations[i].resume();
+	}
+}
+
+void Boss::drain() {
+	while (true) {
+		run_frame_continuations();
+		if (run_one()) { continue; }
+
+		//Running jobs queue their continuations before they count as finished
+		bool idle = false;
+		{
+			std::lock_guard<std::mutex> queue_lock{ queue_mutex_ };
+			std::lock_guard<std::mutex> frame_lock{ frame_mutex_ };
+			idle = queue_head_ == nullptr && running_jobs_.load() == 0 && frame_continuations_.empty();
+		}
+		if (idle) { return; }
+
+		std::this_thread::yield();
+	}
+}
+
+void Boss::set_telemetry(bool enabled) {
+	telemetry_.store(enabled, std::memory_order_relaxed);
+}
+
+bool Boss::is_telemetry_enabled() const {
+	return telemetry_.load(std::memory_order_relaxed);
+}
+
+void Boss::reset_telemetry() {
+	std::lock_guard<std::mutex> lock{ threads_mutex_ };
+	for (auto& [id, state] : threads_) {
+		state->trace_.Clear();
+		state->jobs_executed_.store(0, std::memory_order_relaxed);
+		state->jobs_helped_.store(0, std::memory_order_relaxed);
+		state->lock_acquisitions_.store(0, std::memory_order_relaxed);
+		state->lock_contentions_.store(0, std::memory_order_relaxed);
+		state->queue_wait_ns_.store(0, std::memory_order_relaxed);
+		state->run_ns_.store(0, std::memory_order_relaxed);
+	}
+}
+
+BossStats Boss::get_stats() {
+	BossStats stats;
+
+	std::lock_guard<std::mutex> lock{ threads_mutex_ };
+	for (auto& [id, state] : threads_) {
+		stats.jobs_executed_ += state->jobs_executed_.load(std::memory_order_relaxed);
+		stats.jobs_helped_ += state->jobs_helped_.load(std::memory_order_relaxed);
+		stats.lock_acquisitions_ += state->lock_acquisitions_.load(std::memory_order_relaxed);
+		stats.lock_contentions_ += state->lock_contentions_.load(std::memory_order_relaxed);
+		stats.queue_wait_ns_ += state->queue_wait_ns_.load(std::memory_order_relaxed);
+		stats.run_ns_ += state->run_ns_.load(std::memory_order_relaxed);
+	}
+
+	return stats;
+}
+
+bool Boss::export_chrome_trace(const char* filepath) {
+	FILE* f = fopen(filepath, "w");
+	if (f == nullptr) {
+		printf("Boss: couldn't open %s to write the trace\n", filepath);
+		return false;
+	}
+
+	BossStats stats = get_stats();
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Boss %u\"}}", id_);
+
+	std::vector<JobTraceEvent> events;
+	std::lock_guard<std::mutex> lock{ threads_mutex_ };
+	for (auto& [id, state] : threads_) {
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			state->index_, state->name_.c_str());
+		fprintf(f, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+			state->index_, state->index_);
+
+		events.clear();
+		state->trace_.Snapshot(events);
+		for (size_t i = 0; i < events.size(); ++i) {
+			const JobTraceEvent& e = events[i];
+			fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"job\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+				"\"args\":{\"queue_wait_us\":%.3f}}",
+				e.helped_ ? "helped job" : "job", state->index_,
+				e.begin_ns_ / 1000.0, (e.end_ns_ - e.begin_ns_) / 1000.0, (e.begin_ns_ - e.enqueue_ns_) / 1000.0);
+		}
+	}
+
+	fprintf(f, "\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"jobs_executed\":%llu,\"jobs_helped\":%llu,"
+		"\"lock_acquisitions\":%llu,\"lock_contentions\":%llu,\"queue_wait_ns\":%llu,\"run_ns\":%llu}}\n",
+		(unsigned long long)stats.jobs_executed_, (unsigned long long)stats.jobs_helped_,
+		(unsigned long long)stats.lock_acquisitions_, (unsigned long long)stats.lock_contentions_,
+		(unsigned long long)stats.queue_wait_ns_, (unsigned long long)stats.run_ns_);
+
+	fclose(f);
+	return true;
+}
+
+Boss::ThreadState* Boss::get_local_state() {
+	if (local_state_cache.boss_id == id_) { return (ThreadState*)local_state_cache.state; }
+
+	std::lock_guard<std::mutex> lock{ threads_mutex_ };
+	std::unique_ptr<ThreadState>& state = threads_[std::this_thread::get_id()];
+	if (state == nullptr) {
+		state = std::make_unique<ThreadState>();
+		state->index_ = next_thread_index_++;
+		state->name_ = "Thread " + std::to_string(state->index_);
+	}
+
+	local_state_cache.boss_id = id_;
+	local_state_cache.state = state.get();
+
+	return state.get();
+}
+
+void Boss::worker_loop(unsigned int index, const std::string& name) {
+	ThreadState* state = nullptr;
+	{
+		std::lock_guard<std::mutex> lock{ threads_mutex_ };
+		std::unique_ptr<ThreadState>& new_state = threads_[std::this_thread::get_id()];
+		new_state = std::make_unique<ThreadState>();
+		new_state->index_ = index;
+		new_state->name_ = name;
+		new_state->worker_ = true;
+		state = new_state.get();
+	}
+	local_state_cache.boss_id = id_;
+	local_state_cache.state = state;
+
+	while (true) {
+		Job* job = nullptr;
+		{
+			// Lock mutex to avoid that more than one thread can access the jobs queue
+			std::unique_lock<std::mutex> lk(queue_mutex_, std::defer_lock);
+			lock_queue(lk, state);
+			job_condition_.wait(lk, [this] {return stop_ || queue_head_ != nullptr; });
+			if (stop_) { return; }
+			//Get the first job available and remove it from the list
+			job = pop_job();
+		}
+		execute(job, state);
+		running_jobs_.fetch_sub(1);
+	}
+}
+
+void Boss::lock_queue(std::unique_lock<std::mutex>& lock, ThreadState* state) {
+	state->lock_acquisitions_.store(state->lock_acquisitions_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (!lock.try_lock()) {
+		state->lock_contentions_.store(state->lock_contentions_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		lock.lock();
+	}
+}
+
+uint64_t Boss::trace_now() const {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_start_).count();
+}
+
+void Boss::push_job(Job* job, ThreadState* state) {
+	std::unique_lock<std::mutex> lk(queue_mutex_, std::defer_lock);
+	lock_queue(lk, state);
+
+	job->next_ = nullptr;
+	if (queue_tail_ != nullptr) { queue_tail_->next_ = job; }
+	else { queue_head_ = job; }
+	queue_tail_ = job;
+	job_count_++;
+
+	lk.unlock();
+	job_condition_.notify_one();
+}
+
+Job* Boss::pop_job() {
+	Job* job = queue_head_;
+	if (job != nullptr) {
+		queue_head_ = job->next_;
+		if (queue_head_ == nullptr) { queue_tail_ = nullptr; }
+		job->next_ = nullptr;
+		job_count_--;
+		running_jobs_.fetch_add(1);
+	}
+	return job;
+}
+
+bool Boss::run_one() {
+	ThreadState* state = get_local_state();
+	Job* job = nullptr;
+	{
+		std::unique_lock<std::mutex> lk(queue_mutex_, std::defer_lock);
+		lock_queue(lk, state);
+		job = pop_job();
+	}
+	if (job == nullptr) { return false; }
+
+	execute(job, state);
+	running_jobs_.fetch_sub(1);
+	return true;
+}
+
+void Boss::execute(Job* job, ThreadState* state) {
+	state->jobs_executed_.store(state->jobs_executed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (!state->worker_) {
+		state->jobs_helped_.store(state->jobs_helped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	if (!telemetry_.load(std::memory_order_relaxed)) {
+		job->Run();
+		job->pool_->Free(job);
+		return;
+	}
+
+	//The job goes back to the pool once it has run, so read what's needed before
+	JobTraceEvent event;
+	event.begin_ns_ = trace_now();
+	event.enqueue_ns_ = job->enqueue_ns_ != 0 ? job->enqueue_ns_ : event.begin_ns_;
+	event.helped_ = !state->worker_;
+
+	job->Run();
+	event.end_ns_ = trace_now();
+	job->pool_->Free(job);
+
+	state->trace_.Push(event);
+
+	state->queue_wait_ns_.store(state->queue_wait_ns_.load(std::memory_order_relaxed) + (event.begin_ns_ - event.enqueue_ns_), std::memory_order_relaxed);
+	state->run_ns_.store(state->run_ns_.load(std::memory_order_relaxed) + (event.end_ns_ - event.begin_ns_), std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include <bounds_tree.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+static float SurfaceArea(const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+	glm::vec3 size = bounds_max - bounds_min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool Contains(const glm::vec3& outer_min, const glm::vec3& outer_max, const glm::vec3& inner_min, const glm::vec3& inner_max) {
+	return outer_min.x <= inner_min.x && outer_min.y <= inner_min.y && outer_min.z <= inner_min.z &&
+		inner_max.x <= outer_max.x && inner_max.y <= outer_max.y && inner_max.z <= outer_max.z;
+}
+
+static bool Overlaps(const glm::vec3& a_min, const glm::vec3& a_max, const glm::vec3& b_min, const glm::vec3& b_max) {
+	return a_min.x <= b_max.x && b_min.x <= a_max.x && a_min.y <= b_max.y && b_min.y <= a_max.y && a_min.z <= b_max.z && b_min.z <= a_max.z;
+}
+
+static bool OverlapsSphere(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::vec3& center, float radius) {
+	glm::vec3 closest = glm::clamp(center, bounds_min, bounds_max);
+	glm::vec3 offset = center - closest;
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+static FrustumResult TestFrustums(const Frustum* frustums, unsigned int frustum_count, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+	glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+	glm::vec3 extent = (bounds_max - bounds_min) * 0.5f;
+	FrustumResult result = FrustumResult::kOutside;
+	for (unsigned int i = 0; i < frustum_count; ++i) {
+		FrustumResult frustum_result = TestBox(frustums[i], center, extent);
+		if (frustum_result == FrustumResult::kInside) { return frustum_result; }
+		if (frustum_result == FrustumResult::kIntersecting) { result = frustum_result; }
+	}
+	return result;
+}
+
+/**
+ * @brief Slab test of a ray against a box
+ *
+ * @return bool True if the ray enters the box before max_distance, with the distance it does stored in distance
+ */
+static bool IntersectRay(const glm::vec3& origin, const glm::vec3& direction, float max_distance, const glm::vec3& bounds_min, const glm::vec3& bounds_max, float* distance) {
+	float near_distance = 0.0f;
+	float far_distance = max_distance;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (direction[axis] == 0.0f) {
+			if (origin[axis] < bounds_min[axis] || origin[axis] > bounds_max[axis]) { return false; }
+			continue;
+		}
+		float inverse = 1.0f / direction[axis];
+		float enter = (bounds_min[axis] - origin[axis]) * inverse;
+		float leave = (bounds_max[axis] - origin[axis]) * inverse;
+		if (enter > leave) { std::swap(enter, leave); }
+		near_distance = std::max(near_distance, enter);
+		far_distance = std::min(far_distance, leave);
+		if (near_distance > far_distance) { return false; }
+	}
+	*distance = near_distance;
+	return true;
+}
+
+void TransformBounds(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::mat4& transform, glm::vec3* world_min, glm::vec3* world_max) {
+	glm::vec3 center = glm::vec3(transform * glm::vec4((bounds_min + bounds_max) * 0.5f, 1.0f));
+	glm::vec3 extent = (bounds_max - bounds_min) * 0.5f;
+	glm::vec3 world_extent;
+	for (int axis = 0; axis < 3; ++axis) {
+		world_extent[axis] = fabsf(transform[0][axis]) * extent.x + fabsf(transform[1][axis]) * extent.y + fabsf(transform[2][axis]) * extent.z;
+	}
+	*world_min = center - world_extent;
+	*world_max = center + world_extent;
+}
+
+BoundsTree::BoundsTree() {
+	root_ = kBoundsTreeNullNode;
+	free_list_ = kBoundsTreeNullNode;
+	leaf_count_ = 0;
+}
+
+int32_t BoundsTree::AllocateNode() {
+	int32_t node = free_list_;
+	if (node == kBoundsTreeNullNode) {
+		node = (int32_t)nodes_.size();
+		nodes_.emplace_back();
+	}
+	else {
+		free_list_ = nodes_[node].parent_;
+	}
+
+	BoundsTreeNode& n = nodes_[node];
+	n.parent_ = kBoundsTreeNullNode;
+	n.children_[0] = kBoundsTreeNullNode;
+	n.children_[1] = kBoundsTreeNullNode;
+	n.height_ = 0;
+	n.entity_ = 0;
+	return node;
+}
+
+void BoundsTree::FreeNode(int32_t node) {
+	nodes_[node].parent_ = free_list_;
+	nodes_[node].height_ = -1;
+	free_list_ = node;
+}
+
+static void EnlargeBounds(const glm::vec3& bounds_min, const glm::vec3& bounds_max, glm::vec3* enlarged_min, glm::vec3* enlarged_max) {
+	glm::vec3 margin = glm::max((bounds_max - bounds_min) * kBoundsTreeMargin, glm::vec3(kBoundsTreeMinMargin));
+	*enlarged_min = bounds_min - margin;
+	*enlarged_max = bounds_max + margin;
+}
+
+int32_t BoundsTree::CreateProxy(const glm::vec3& bounds_min, const glm::vec3& bounds_max, size_t entity) {
+	int32_t proxy = AllocateNode();
+	BoundsTreeNode& n = nodes_[proxy];
+	n.tight_min_ = bounds_min;
+	n.tight_max_ = bounds_max;
+	n.entity_ = entity;
+	EnlargeBounds(bounds_min, bounds_max, &n.min_, &n.max_);
+
+	InsertLeaf(proxy);
+	leaf_count_++;
+	return proxy;
+}
+
+void BoundsTree::DestroyProxy(int32_t proxy) {
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	leaf_count_--;
+}
+
+bool BoundsTree::MoveProxy(int32_t proxy, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+	BoundsTreeNode& n = nodes_[proxy];
+	n.tight_min_ = bounds_min;
+	n.tight_max_ = bounds_max;
+
+	glm::vec3 enlarged_min, enlarged_max;
+	EnlargeBounds(bounds_min, bounds_max, &enlarged_min, &enlarged_max);
+	if (Contains(n.min_, n.max_, bounds_min, bounds_max) &&
+		SurfaceArea(n.min_, n.max_) <= SurfaceArea(enlarged_min, enlarged_max) * kBoundsTreeShrinkRatio) {
+		return false;
+	}
+
+	RemoveLeaf(proxy);
+	nodes_[proxy].min_ = enlarged_min;
+	nodes_[proxy].max_ = enlarged_max;
+	InsertLeaf(proxy);
+	return true;
+}
+
+void BoundsTree::GetBounds(int32_t proxy, glm::vec3* bounds_min, glm::vec3* bounds_max) const {
+	*bounds_min = nodes_[proxy].tight_min_;
+	*bounds_max = nodes_[proxy].tight_max_;
+}
+
+void BoundsTree::Clear() {
+	nodes_.clear();
+	root_ = kBoundsTreeNullNode;
+	free_list_ = kBoundsTreeNullNode;
+	leaf_count_ = 0;
+}
+
+int32_t BoundsTree::FindBestSibling(int32_t leaf) const {
+	const glm::vec3 leaf_min = nodes_[leaf].min_;
+	const glm::vec3 leaf_max = nodes_[leaf].max_;
+	const glm::vec3 leaf_center = leaf_min + leaf_max;
+	const float leaf_area = SurfaceArea(leaf_min, leaf_max);
+
+	int32_t best = root_;
+	float direct_cost = SurfaceArea(glm::min(leaf_min, nodes_[root_].min_), glm::max(leaf_max, nodes_[root_].max_));
+	float best_cost = direct_cost;
+	//What the ancestors of the node grow if the leaf goes below it
+	float inherited_cost = 0.0f;
+
+	int32_t node = root_;
+	while (!nodes_[node].IsLeaf()) {
+		const BoundsTreeNode& n = nodes_[node];
+		float cost = direct_cost + inherited_cost;
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = node;
+		}
+		inherited_cost += direct_cost - SurfaceArea(n.min_, n.max_);
+
+		float child_direct_costs[2];
+		float lower_costs[2];
+		for (int i = 0; i < 2; ++i) {
+			const BoundsTreeNode& child = nodes_[n.children_[i]];
+			child_direct_costs[i] = SurfaceArea(glm::min(leaf_min, child.min_), glm::max(leaf_max, child.max_));
+			lower_costs[i] = FLT_MAX;
+			if (child.IsLeaf()) {
+				float child_cost = child_direct_costs[i] + inherited_cost;
+				if (child_cost < best_cost) {
+					best_cost = child_cost;
+					best = n.children_[i];
+				}
+			}
+			else {
+				//Nothing below the child can cost less than this
+				lower_costs[i] = inherited_cost + child_direct_costs[i] + std::min(leaf_area - SurfaceArea(child.min_, child.max_), 0.0f);
+			}
+		}
+
+		if (best_cost <= lower_costs[0] && best_cost <= lower_costs[1]) { break; }
+
+		int side = lower_costs[0] < lower_costs[1] ? 0 : 1;
+		if (lower_costs[0] == lower_costs[1]) {
+			//Ties go to the nearest child
+			const BoundsTreeNode& a = nodes_[n.children_[0]];
+			const BoundsTreeNode& b = nodes_[n.children_[1]];
+			glm::vec3 to_a = a.min_ + a.max_ - leaf_center;
+			glm::vec3 to_b = b.min_ + b.max_ - leaf_center;
+			side = glm::dot(to_a, to_a) <= glm::dot(to_b, to_b) ? 0 : 1;
+		}
+		node = n.children_[side];
+		direct_cost = child_direct_costs[side];
+	}
+
+	return best;
+}
+
+void BoundsTree::InsertLeaf(int32_t leaf) {
+	if (root_ == kBoundsTreeNullNode) {
+		root_ = leaf;
+		nodes_[leaf].parent_ = kBoundsTreeNullNode;
+		return;
+	}
+
+	int32_t sibling = FindBestSibling(leaf);
+	int32_t old_parent = nodes_[sibling].parent_;
+
+	//Allocating may move the pool, the nodes are only accessed by index from here
+	int32_t new_parent = AllocateNode();
+	nodes_[new_parent].parent_ = old_parent;
+	nodes_[new_parent].min_ = glm::min(nodes_[leaf].min_, nodes_[sibling].min_);
+	nodes_[new_parent].max_ = glm::max(nodes_[leaf].max_, nodes_[sibling].max_);
+	nodes_[new_parent].height_ = nodes_[sibling].height_ + 1;
+	nodes_[new_parent].children_[0] = sibling;
+	nodes_[new_parent].children_[1] = leaf;
+	nodes_[sibling].parent_ = new_parent;
+	nodes_[leaf].parent_ = new_parent;
+
+	if (old_parent == kBoundsTreeNullNode) {
+		root_ = new_parent;
+	}
+	else {
+		BoundsTreeNode& p = nodes_[old_parent];
+		p.children_[p.children_[0] == sibling ? 0 : 1] = new_parent;
+	}
+
+	Refit(new_parent);
+}
+
+void BoundsTree::RemoveLeaf(int32_t leaf) {
+	if (leaf == root_) {
+		root_ = kBoundsTreeNullNode;
+		return;
+	}
+
+	int32_t parent = nodes_[leaf].parent_;
+	int32_t grand_parent = nodes_[parent].parent_;
+	int32_t sibling = nodes_[parent].children_[nodes_[parent].children_[0] == leaf ? 1 : 0];
+
+	nodes_[sibling].parent_ = grand_parent;
+	FreeNode(parent);
+	if (grand_parent == kBoundsTreeNullNode) {
+		root_ = sibling;
+		return;
+	}
+
+	BoundsTreeNode& g = nodes_[grand_parent];
+	g.children_[g.children_[0] == parent ? 0 : 1] = sibling;
+	Refit(grand_parent);
+}
+
+void BoundsTree::Refit(int32_t node) {
+	while (node != kBoundsTreeNullNode) {
+		node = Balance(node);
+
+		BoundsTreeNode& n = nodes_[node];
+		const BoundsTreeNode& a = nodes_[n.children_[0]];
+		const BoundsTreeNode& b = nodes_[n.children_[1]];
+		n.height_ = 1 + std::max(a.height_, b.height_);
+		n.min_ = glm::min(a.min_, b.min_);
+		n.max_ = glm::max(a.max_, b.max_);
+
+		node = n.parent_;
+	}
+}
+
+int32_t BoundsTree::Balance(int32_t node) {
+	BoundsTreeNode& a = nodes_[node];
+	if (a.IsLeaf() || a.height_ < 2) { return node; }
+
+	int32_t balance = nodes_[a.children_[1]].height_ - nodes_[a.children_[0]].height_;
+	if (balance >= -1 && balance <= 1) { return node; }
+
+	//The higher child takes the place of the node, which keeps the lower child and the lower grandchild
+	int side = balance > 1 ? 1 : 0;
+	int32_t up = a.children_[side];
+	int32_t low = a.children_[1 - side];
+	BoundsTreeNode& u = nodes_[up];
+	int32_t taller = u.children_[0];
+	int32_t shorter = u.children_[1];
+	if (nodes_[taller].height_ < nodes_[shorter].height_) { std::swap(taller, shorter); }
+
+	u.parent_ = a.parent_;
+	if (u.parent_ == kBoundsTreeNullNode) {
+		root_ = up;
+	}
+	else {
+		BoundsTreeNode& p = nodes_[u.parent_];
+		p.children_[p.children_[0] == node ? 0 : 1] = up;
+	}
+
+	u.children_[0] = node;
+	u.children_[1] = taller;
+	a.parent_ = up;
+	a.children_[side] = shorter;
+	nodes_[shorter].parent_ = node;
+
+	a.min_ = glm::min(nodes_[low].min_, nodes_[shorter].min_);
+	a.max_ = glm::max(nodes_[low].max_, nodes_[shorter].max_);
+	a.height_ = 1 + std::max(nodes_[low].height_, nodes_[shorter].height_);
+	u.min_ = glm::min(a.min_, nodes_[taller].min_);
+	u.max_ = glm::max(a.max_, nodes_[taller].max_);
+	u.height_ = 1 + std::max(a.height_, nodes_[taller].height_);
+
+	return up;
+}
+
+void BoundsTree::QueryAabb(const glm::vec3& bounds_min, const glm::vec3& bounds_max, std::vector<size_t>* entities) const {
+	if (root_ == kBoundsTreeNullNode) { return; }
+
+	std::vector<int32_t> stack;
+	stack.reserve(64);
+	stack.push_back(root_);
+	while (!stack.empty()) {
+		const BoundsTreeNode& n = nodes_[stack.back()];
+		stack.pop_back();
+		if (!Overlaps(n.min_, n.max_, bounds_min, bounds_max)) { continue; }
+
+		if (n.IsLeaf()) {
+			if (Overlaps(n.tight_min_, n.tight_max_, bounds_min, bounds_max)) { entities->push_back(n.entity_); }
+			continue;
+		}
+		stack.push_back(n.children_[0]);
+		stack.push_back(n.children_[1]);
+	}
+}
+
+void BoundsTree::QuerySphere(const glm::vec3& center, float radius, std::vector<size_t>* entities) const {
+	if (root_ == kBoundsTreeNullNode) { return; }
+
+	std::vector<int32_t> stack;
+	stack.reserve(64);
+	stack.push_back(root_);
+	while (!stack.empty()) {
+		const BoundsTreeNode& n = nodes_[stack.back()];
+		stack.pop_back();
+		if (!OverlapsSphere(n.min_, n.max_, center, radius)) { continue; }
+
+		if (n.IsLeaf()) {
+			if (OverlapsSphere(n.tight_min_, n.tight_max_, center, radius)) { entities->push_back(n.entity_); }
+			continue;
+		}
+		stack.push_back(n.children_[0]);
+		stack.push_back(n.children_[1]);
+	}
+}
+
+void BoundsTree::QueryFrustum(const Frustum* frustums, unsigned int frustum_count, std::vector<size_t>* entities) const {
+	QueryFrustum(root_, frustums, frustum_count, entities);
+}
+
+void BoundsTree::QueryFrustum(int32_t subtree, const Frustum* frustums, unsigned int frustum_count, std::vector<size_t>* entities) const {
+	if (subtree == kBoundsTreeNullNode || frustum_count == 0) { return; }
+
+	//Nodes are pushed with whether an ancestor was found inside a frustum, those aren't tested again
+	std::vector<std::pair<int32_t, bool>> stack;
+	stack.reserve(64);
+	stack.emplace_back(subtree, false);
+	while (!stack.empty()) {
+		auto [node, inside] = stack.back();
+		stack.pop_back();
+		const BoundsTreeNode& n = nodes_[node];
+
+		if (!inside) {
+			const glm::vec3& bounds_min = n.IsLeaf() ? n.tight_min_ : n.min_;
+			const glm::vec3& bounds_max = n.IsLeaf() ? n.tight_max_ : n.max_;
+			FrustumResult result = TestFrustums(frustums, frustum_count, bounds_min, bounds_max);
+			if (result == FrustumResult::kOutside) { continue; }
+			inside = result == FrustumResult::kInside;
+		}
+
+		if (n.IsLeaf()) {
+			entities->push_back(n.entity_);
+			continue;
+		}
+		stack.emplace_back(n.children_[0], inside);
+		stack.emplace_back(n.children_[1], inside);
+	}
+}
+
+void BoundsTree::GetSubtrees(size_t count, std::vector<int32_t>* subtrees) const {
+	subtrees->clear();
+	if (root_ == kBoundsTreeNullNode) { return; }
+
+	subtrees->push_back(root_);
+	while (subtrees->size() < count) {
+		size_t highest = 0;
+		for (size_t i = 1; i < subtrees->size(); ++i) {
+			if (nodes_[(*subtrees)[i]].height_ > nodes_[(*subtrees)[highest]].height_) { highest = i; }
+		}
+
+		const BoundsTreeNode& n = nodes_[(*subtrees)[highest]];
+		if (n.IsLeaf()) { break; }
+		(*subtrees)[highest] = n.children_[0];
+		subtrees->push_back(n.children_[1]);
+	}
+}
+
+void BoundsTree::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float max_distance, std::vector<BoundsTreeHit>* hits) const {
+	hits->clear();
+	if (root_ == kBoundsTreeNullNode) { return; }
+
+	std::vector<int32_t> stack;
+	stack.reserve(64);
+	stack.push_back(root_);
+	while (!stack.empty()) {
+		const BoundsTreeNode& n = nodes_[stack.back()];
+		stack.pop_back();
+
+		float distance;
+		if (!IntersectRay(origin, direction, max_distance, n.min_, n.max_, &distance)) { continue; }
+
+		if (n.IsLeaf()) {
+			if (IntersectRay(origin, direction, max_distance, n.tight_min_, n.tight_max_, &distance)) {
+				hits->push_back({ n.entity_, distance });
+			}
+			continue;
+		}
+		stack.push_back(n.children_[0]);
+		stack.push_back(n.children_[1]);
+	}
+
+	std::sort(hits->begin(), hits->end(), [](const BoundsTreeHit& a, const BoundsTreeHit& b) { return a.distance_ < b.distance_; });
+}
@@ -620,6 +620,10 @@ void ComponentManager::ResetComponentSystem() {
   }
   deleted_entities_.clear();
 
+  bounds_tree_.Clear();
+  bounds_proxies_.clear();
+  bounds_proxy_seen_.clear();
+
   num_entities_ = 0;
   
 }
@@ -631,6 +635,87 @@ void ComponentManager::Update(){
     CheckChildTransformUpdates();
 
 }
+void ComponentManager::UpdateBoundsTree(){
+
+  static size_t render_hash = typeid(RendererComponent).hash_code();
+  static size_t transf_hash = typeid(TransformComponent).hash_code();
+
+  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(components_classes_.find(render_hash)->second.get())).components_;
+  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(components_classes_.find(transf_hash)->second.get())).components_;
+  size_t render_size = renderer_components->size();
+  size_t transf_size = transform_components->size();
+
+  std::fill(bounds_proxy_seen_.begin(), bounds_proxy_seen_.end(), (unsigned char)0);
+
+  size_t transform_iterator = 0;
+  for (size_t it = 0; it < render_size; it++) {
+
+    size_t id = renderer_components->at(it).entity_id_;
+    RendererComponent* r = &(renderer_components->at(it).data_);
+
+    while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
+      transform_iterator++;
+    }
+
+    //Its proxy isn't claimed and goes away below
+    if (!r->isInit_ || !r->mesh_->isInit_) {
+      r->bounds_proxy_ = kBoundsTreeNullNode;
+      continue;
+    }
+
+    TransformComponent* transform = nullptr;
+    if (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
+      transform = &(transform_components->at(transform_iterator).data_);
+    }
+
+    //A proxy claimed already belongs to a copy of this renderer
+    int32_t proxy = r->bounds_proxy_;
+    bool owned = proxy != kBoundsTreeNullNode && (size_t)proxy < bounds_proxy_seen_.size() && bounds_proxy_seen_[proxy] == 0;
+
+    //Only the leaves whose transform, mesh or mesh bounds changed are moved. Swapping entities changes the id
+    //of the components, and the renderer may end up under another transform
+    bool moved = !owned || r->bounds_dirty_ || r->bounds_generation_ != r->mesh_->bounds_generation_ ||
+      (transform != nullptr && transform->bounds_dirty_) || bounds_tree_.GetEntity(proxy) != id;
+    if (moved) {
+      //The world matrix was worked out when the transform changed
+      static const glm::mat4 identity = glm::mat4(1.0f);
+      const glm::mat4& world = transform != nullptr ? transform->absolute : identity;
+
+      glm::vec3 world_min, world_max;
+      TransformBounds(r->mesh_->bounds_min_, r->mesh_->bounds_max_, world, &world_min, &world_max);
+
+      if (owned) {
+        bounds_tree_.MoveProxy(proxy, world_min, world_max);
+        bounds_tree_.SetEntity(proxy, id);
+      }
+      else {
+        proxy = bounds_tree_.CreateProxy(world_min, world_max, id);
+        r->bounds_proxy_ = proxy;
+        bounds_proxies_.push_back(proxy);
+      }
+
+      r->bounds_dirty_ = false;
+      r->bounds_generation_ = r->mesh_->bounds_generation_;
+      if (transform != nullptr) { transform->bounds_dirty_ = false; }
+    }
+
+    if (bounds_proxy_seen_.size() <= (size_t)proxy) { bounds_proxy_seen_.resize((size_t)proxy + 1, 0); }
+    bounds_proxy_seen_[proxy] = 1;
+  }
+
+  //Proxies of the renderers removed since the last update
+  for (size_t i = 0; i < bounds_proxies_.size();) {
+    int32_t proxy = bounds_proxies_[i];
+    if ((size_t)proxy < bounds_proxy_seen_.size() && bounds_proxy_seen_[proxy] != 0) {
+      i++;
+      continue;
+    }
+    bounds_tree_.DestroyProxy(proxy);
+    bounds_proxies_[i] = bounds_proxies_.back();
+    bounds_proxies_.pop_back();
+  }
+}
+
 bool ComponentManager::CustomUnorderedMapContains(size_t val) {
     bool exists = false;
 
@@ -9,6 +9,14 @@ RendererComponent::RendererComponent() {
     needs_light_ = true;
     casts_shadows_ = true;
     receives_shadows_ = true;
+    occluder_ = false;
+
+    lod_ = 0;
+    shadow_lod_ = 0;
+
+    bounds_proxy_ = kBoundsTreeNullNode;
+    bounds_dirty_ = true;
+    bounds_generation_ = 0;
 }
 
 //MULTITHREAD UNSAFE
@@ -18,6 +26,7 @@ RendererComponent* RendererComponent::Init(std::shared_ptr<TinyObj> mesh) {
     if (mesh.get() != nullptr) {
         mesh_ = mesh;
         isInit_ = true;
+        bounds_dirty_ = true;
     }
 
     return this;
@@ -34,6 +43,7 @@ RendererComponent* RendererComponent::AddTexture(std::shared_ptr<Texture> textur
 RendererComponent* RendererComponent::ChangeMesh(std::shared_ptr<TinyObj> new_mesh) {
     if (new_mesh != nullptr && new_mesh != mesh_) {
         mesh_ = new_mesh;
+        bounds_dirty_ = true;
 
         if (!new_mesh.get()->isInit_) { isInit_ = false; }
         else { isInit_ = true; }
@@ -41,3 +51,30 @@ RendererComponent* RendererComponent::ChangeMesh(std::shared_ptr<TinyObj> new_me
 
     return this;
 }
+
+//Level of detail for a projected size, the number of thresholds it's under
+static unsigned char LodForScreenSize(float screen_size, unsigned int lod_count) {
+    unsigned int lod = 0;
+    float threshold = kLodScreenSize;
+    while (lod + 1 < lod_count && screen_size < threshold) {
+        lod++;
+        threshold *= 0.5f;
+    }
+
+    return (unsigned char)lod;
+}
+
+unsigned char RendererComponent::SelectLod(float screen_size, bool shadow_view) {
+    unsigned char& current = shadow_view ? shadow_lod_ : lod_;
+    unsigned int lod_count = mesh_ != nullptr ? (unsigned int)std::max<size_t>(mesh_->lods_.size(), 1) : 1;
+    if (shadow_view) { screen_size *= kShadowLodScale; }
+
+    //Only move to a coarser LOD once the mesh is clearly smaller than the threshold, and back once it's clearly bigger
+    unsigned char coarser = LodForScreenSize(screen_size * (1.0f + kLodHysteresis), lod_count);
+    unsigned char finer = LodForScreenSize(screen_size * (1.0f - kLodHysteresis), lod_count);
+    if (coarser > current) { current = coarser; }
+    else if (finer < current) { current = finer; }
+    if (current >= lod_count) { current = (unsigned char)(lod_count - 1); }
+
+    return current;
+}
@@ -10,6 +10,7 @@ TransformComponent::TransformComponent() {
     relative = glm::mat4(1.0f);
     absolute = glm::mat4(1.0f);
     updated_ = false;
+    bounds_dirty_ = true;
 }
 
 glm::mat4 TransformComponent::GetRelativeMatrix() {
@@ -214,6 +215,7 @@ void TransformComponent::UpdateTransform(){
                glm::translate(position_) * tmp_rot * glm::scale(glm::mat4(1.0f), scale_);
 
     updated_ = true;
+    bounds_dirty_ = true;
 }
 
 void TransformComponent::UpdateRelativeMatrix(){
@@ -4,7 +4,7 @@
 #include <tinyobj.hpp>
 
 #ifdef RENDER_OPENGL
-Cubemap::Cubemap() {
+Cubemap::Cubemap(std::shared_ptr<GeometryArena> arena) {
 
   width_ = 0;
   height_ = 0;
@@ -14,7 +14,7 @@ Cubemap::Cubemap() {
 
   mesh_ = std::make_unique<TinyObj>();
   mesh_->LoadObj("../data/meshes/cube.obj");
-  mesh_->InitBuffer();
+  mesh_->InitBuffer(arena);
 
   std::unique_ptr<char> src_vertex  { Shader::ReadShaderFromFile(CUBEMAP_VERTEX_SHADER) };
   std::unique_ptr<char> src_fragment{ Shader::ReadShaderFromFile(CUBEMAP_FRAGMENT_SHADER) };
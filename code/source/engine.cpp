@@ -24,12 +24,12 @@ int Engine::shutdown() {
 
 void Engine::GameLoop(){}
 
-Engine::Engine(int window_w, int window_h) {
+Engine::Engine(int window_w, int window_h, const BossConfig& boss_config) {
   srand((unsigned int)time(NULL));
  
   component_manager_ = std::make_unique<ComponentManager>();
   scene_manager_ = std::make_unique<SceneManager>();
-  boss_system_ = std::make_unique<Boss>();
+  boss_system_ = std::make_unique<Boss>(boss_config);
 
   audio_device_ = alcOpenDevice("openal-soft");
   audio_context_ = alcCreateContext(audio_device_, NULL);
@@ -37,6 +37,7 @@ Engine::Engine(int window_w, int window_h) {
 
 #ifdef RENDER_OPENGL
   render_system_ = std::make_unique<RenderSystemOpenGL>(window_w, window_h);
+  static_cast<RenderSystemOpenGL*>(render_system_.get())->SetBoss(boss_system_.get());
 #endif
 #ifdef RENDER_DIRECTX11
   render_system_ = std::make_unique<RenderSystemDirectX11>(window_w, window_h);
@@ -61,6 +62,9 @@ Engine::Engine(ID3D11Device* device, ID3D11DeviceContext* devCont,
 #endif
 
 Engine::~Engine() {
+  //The coroutines still loading have to finish while the render context and resources exist
+  if (boss_system_ != nullptr) { boss_system_->drain(); }
+
 #ifdef RENDER_OPENGL
   glfwTerminate();
 #endif
@@ -93,7 +97,7 @@ Boss* Engine::getBossSystem(){return boss_system_.get();}
 std::shared_ptr<TinyObj> Engine::AddMesh(std::string filepath){
   
 #ifdef RENDER_OPENGL
-  return static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_.addMesh(filepath);
+  return static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_.addMesh(filepath, boss_system_.get());
 #endif
 #ifdef RENDER_DIRECTX11
   RenderSystemDirectX11* r= static_cast<RenderSystemDirectX11*>(render_system_.get());
@@ -103,9 +107,51 @@ std::shared_ptr<TinyObj> Engine::AddMesh(std::string filepath){
   
 }
 
+std::shared_ptr<TinyObj> Engine::StreamMesh(std::string filepath){
+
+#ifdef RENDER_OPENGL
+  return static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_.streamMesh(filepath, boss_system_.get());
+#endif
+#ifdef RENDER_DIRECTX11
+  return AddMesh(filepath);
+#endif
+}
+
+std::shared_ptr<Texture> Engine::StreamTexture(std::string filepath){
+
+#ifdef RENDER_OPENGL
+  return static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_.streamTexture(filepath, boss_system_.get());
+#endif
+#ifdef RENDER_DIRECTX11
+  RenderSystemDirectX11* r = static_cast<RenderSystemDirectX11*>(render_system_.get());
+  return r->resource_list_.addTexture(r->getDevice(), filepath);
+#endif
+}
+
+void Engine::SetTextureBudget(size_t bytes){
+#ifdef RENDER_OPENGL
+  Resources& resources = static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_;
+  if (resources.texture_residency_ != nullptr) { resources.texture_residency_->SetBudget(bytes); }
+#endif
+#ifdef RENDER_DIRECTX11
+  printf("Texture budgets only apply with OpenGL\n");
+#endif
+}
+
+size_t Engine::LoadGltf(std::string filepath){
+
+#ifdef RENDER_OPENGL
+  return ::LoadGltf(filepath, component_manager_.get(), &static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_, boss_system_.get());
+#endif
+#ifdef RENDER_DIRECTX11
+  printf("glTF files can only be loaded with OpenGL\n");
+  return 0;
+#endif
+}
+
 void Engine::AddTexture(std::string filepath){
 #ifdef RENDER_OPENGL
-  static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_.addTexture(filepath);
+  static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_.addTexture(filepath, boss_system_.get());
 #endif
 #ifdef RENDER_DIRECTX11
   RenderSystemDirectX11* r = static_cast<RenderSystemDirectX11*>(render_system_.get());
@@ -116,6 +162,19 @@ void Engine::AddTexture(std::string filepath){
 
 
 void Engine::Update(){
+#ifdef RENDER_OPENGL
+  //Parts of the pixel buffers the GPU is done with can take the uploads of this frame
+  Resources& resources = static_cast<RenderSystemOpenGL*>(render_system_.get())->resource_list_;
+  if (resources.texture_streamer_ != nullptr) { resources.texture_streamer_->BeginFrame(); }
+  //Mip levels for what the last frame drew, the changes start with the continuations below
+  if (resources.texture_residency_ != nullptr && resources.texture_streamer_ != nullptr && boss_system_ != nullptr) {
+    resources.texture_residency_->Update(resources.textures_, *boss_system_, *resources.texture_streamer_);
+  }
+#endif
+
+  //Resume the tasks that were waiting for a new frame to run on the main thread
+  if (boss_system_ != nullptr) { boss_system_->run_frame_continuations(); }
+
   //Update the component manager needed elements
   component_manager_->Update();
 
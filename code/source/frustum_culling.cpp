@@ -0,0 +1,90 @@
+#include <frustum_culling.hpp>
+
+#include <cmath>
+
+#include <glm/gtc/matrix_access.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define EVE_CULLING_SSE	1
+#endif
+
+void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[kFrustumPlaneCount]) {
+	glm::vec4 row_x = glm::row(matrix, 0);
+	glm::vec4 row_y = glm::row(matrix, 1);
+	glm::vec4 row_z = glm::row(matrix, 2);
+	glm::vec4 row_w = glm::row(matrix, 3);
+
+	planes[0] = row_w + row_x;
+	planes[1] = row_w - row_x;
+	planes[2] = row_w + row_y;
+	planes[3] = row_w - row_y;
+	planes[4] = row_w + row_z;
+	planes[5] = row_w - row_z;
+
+	for (unsigned int i = 0; i < kFrustumPlaneCount; ++i) {
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f) { planes[i] /= length; }
+	}
+}
+
+void Frustum::Set(const glm::mat4& view_projection) {
+	glm::vec4 planes[kFrustumPlaneCount];
+	ExtractFrustumPlanes(view_projection, planes);
+
+	for (unsigned int i = 0; i < kFrustumPlaneBatches * kFrustumPlaneBatchSize; ++i) {
+		//The padding is a plane every point is one unit inside of
+		glm::vec4 plane = i < kFrustumPlaneCount ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		normal_x_[i] = plane.x;
+		normal_y_[i] = plane.y;
+		normal_z_[i] = plane.z;
+		distance_[i] = plane.w;
+	}
+}
+
+#ifdef EVE_CULLING_SSE
+FrustumResult TestBox(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent) {
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 center_x = _mm_set1_ps(center.x);
+	__m128 center_y = _mm_set1_ps(center.y);
+	__m128 center_z = _mm_set1_ps(center.z);
+	__m128 extent_x = _mm_set1_ps(extent.x);
+	__m128 extent_y = _mm_set1_ps(extent.y);
+	__m128 extent_z = _mm_set1_ps(extent.z);
+
+	int outside = 0;
+	int intersecting = 0;
+	for (unsigned int i = 0; i < kFrustumPlaneBatches * kFrustumPlaneBatchSize; i += kFrustumPlaneBatchSize) {
+		__m128 normal_x = _mm_load_ps(frustum.normal_x_ + i);
+		__m128 normal_y = _mm_load_ps(frustum.normal_y_ + i);
+		__m128 normal_z = _mm_load_ps(frustum.normal_z_ + i);
+
+		__m128 distance = _mm_add_ps(_mm_mul_ps(center_x, normal_x), _mm_load_ps(frustum.distance_ + i));
+		distance = _mm_add_ps(distance, _mm_mul_ps(center_y, normal_y));
+		distance = _mm_add_ps(distance, _mm_mul_ps(center_z, normal_z));
+
+		//Distance the box reaches along each normal
+		__m128 reach = _mm_mul_ps(extent_x, _mm_andnot_ps(sign_mask, normal_x));
+		reach = _mm_add_ps(reach, _mm_mul_ps(extent_y, _mm_andnot_ps(sign_mask, normal_y)));
+		reach = _mm_add_ps(reach, _mm_mul_ps(extent_z, _mm_andnot_ps(sign_mask, normal_z)));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+		intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, reach), zero));
+	}
+
+	if (outside != 0) { return FrustumResult::kOutside; }
+	return intersecting != 0 ? FrustumResult::kIntersecting : FrustumResult::kInside;
+}
+#else
+FrustumResult TestBox(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent) {
+	FrustumResult result = FrustumResult::kInside;
+	for (unsigned int i = 0; i < kFrustumPlaneCount; ++i) {
+		float distance = frustum.normal_x_[i] * center.x + frustum.normal_y_[i] * center.y + frustum.normal_z_[i] * center.z + frustum.distance_[i];
+		float reach = extent.x * fabsf(frustum.normal_x_[i]) + extent.y * fabsf(frustum.normal_y_[i]) + extent.z * fabsf(frustum.normal_z_[i]);
+		if (distance + reach < 0.0f) { return FrustumResult::kOutside; }
+		if (distance - reach < 0.0f) { result = FrustumResult::kIntersecting; }
+	}
+	return result;
+}
+#endif
@@ -0,0 +1,314 @@
+#include <geometry_arena.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+RangeAllocator::RangeAllocator() {
+	capacity_ = 0;
+	used_ = 0;
+}
+
+void RangeAllocator::Reset(uint32_t capacity, uint32_t used) {
+	capacity_ = capacity;
+	used_ = used;
+	free_.clear();
+	if (used < capacity) { free_.push_back({ used, capacity - used }); }
+}
+
+bool RangeAllocator::Allocate(uint32_t count, uint32_t alignment, uint32_t* offset) {
+	for (size_t i = 0; i < free_.size(); ++i) {
+		ArenaRange range = free_[i];
+		uint32_t aligned = (range.offset_ + alignment - 1) / alignment * alignment;
+		uint32_t padding = aligned - range.offset_;
+		if (range.count_ < padding || range.count_ - padding < count) { continue; }
+
+		//The padding stays free before the allocation, and the rest after it
+		uint32_t rest = range.count_ - padding - count;
+		if (padding == 0 && rest == 0) {
+			free_.erase(free_.begin() + i);
+		}
+		else if (padding == 0) {
+			free_[i] = { aligned + count, rest };
+		}
+		else {
+			free_[i].count_ = padding;
+			if (rest != 0) { free_.insert(free_.begin() + i + 1, { aligned + count, rest }); }
+		}
+
+		used_ += count;
+		*offset = aligned;
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t count) {
+	if (count == 0) { return; }
+
+	auto next = std::lower_bound(free_.begin(), free_.end(), offset,
+		[](const ArenaRange& range, uint32_t value) { return range.offset_ < value; });
+	size_t i = next - free_.begin();
+	free_.insert(next, { offset, count });
+	used_ -= count;
+
+	//Merge with the neighbours it touches
+	if (i + 1 < free_.size() && free_[i].offset_ + free_[i].count_ == free_[i + 1].offset_) {
+		free_[i].count_ += free_[i + 1].count_;
+		free_.erase(free_.begin() + i + 1);
+	}
+	if (i > 0 && free_[i - 1].offset_ + free_[i - 1].count_ == free_[i].offset_) {
+		free_[i - 1].count_ += free_[i].count_;
+		free_.erase(free_.begin() + i);
+	}
+}
+
+void RangeAllocator::Grow(uint32_t capacity) {
+	if (capacity <= capacity_) { return; }
+
+	if (!free_.empty() && free_.back().offset_ + free_.back().count_ == capacity_) {
+		free_.back().count_ += capacity - capacity_;
+	}
+	else {
+		free_.push_back({ capacity_, capacity - capacity_ });
+	}
+	capacity_ = capacity;
+}
+
+#ifdef RENDER_OPENGL
+//Points the attributes of the bound vertex array to the bound vertex buffer, as the layout stores them
+static void SetVertexAttributes(const VertexLayout& layout) {
+	glEnableVertexAttribArray(0);
+	if (layout.quantized_positions_) {
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, layout.stride_, (void*)0);
+	}
+	else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, layout.stride_, (void*)0);
+	}
+	if (layout.has_colors_) {
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, layout.stride_, (void*)(uintptr_t)layout.color_offset_);
+	}
+	else {
+		//Without the array the attribute takes its constant value
+		glDisableVertexAttribArray(1);
+		glVertexAttrib3f(1, 1.0f, 1.0f, 1.0f);
+	}
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, layout.stride_, (void*)(uintptr_t)layout.normal_offset_);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, layout.stride_, (void*)(uintptr_t)layout.uv_offset_);
+}
+
+//Copy of the bytes of a buffer that have to survive a resize
+struct BufferMove {
+	size_t from_;
+	size_t to_;
+	size_t size_;
+};
+
+//Creates a buffer with the moved ranges of the old one and deletes the old one.
+//The copy targets are used so the element buffer of the bound vertex array isn't touched
+static GLuint ReplaceBuffer(GLuint old_buffer, size_t size, const std::vector<BufferMove>& moves) {
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, nullptr, GL_STATIC_DRAW);
+
+	if (old_buffer != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+		for (size_t i = 0; i < moves.size(); ++i) {
+			if (moves[i].size_ == 0) { continue; }
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)moves[i].from_, (GLintptr)moves[i].to_, (GLsizeiptr)moves[i].size_);
+		}
+		glDeleteBuffers(1, &old_buffer);
+	}
+
+	return buffer;
+}
+
+GeometryArena::GeometryArena() {
+	index_buffer_ = 0;
+}
+
+GeometryArena::~GeometryArena() {
+	for (size_t i = 0; i < pools_.size(); ++i) {
+		glDeleteVertexArrays(1, &pools_[i].vertex_array_);
+		glDeleteBuffers(1, &pools_[i].buffer_);
+	}
+	if (index_buffer_ != 0) { glDeleteBuffers(1, &index_buffer_); }
+}
+
+unsigned int GeometryArena::FindPool(const VertexLayout& layout) {
+	//The quantization range is a uniform, meshes with different ranges share the format
+	for (unsigned int i = 0; i < (unsigned int)pools_.size(); ++i) {
+		const VertexLayout& other = pools_[i].layout_;
+		if (other.quantized_positions_ == layout.quantized_positions_ && other.has_colors_ == layout.has_colors_ &&
+			other.stride_ == layout.stride_ && other.normal_offset_ == layout.normal_offset_ &&
+			other.uv_offset_ == layout.uv_offset_ && other.color_offset_ == layout.color_offset_) {
+			return i;
+		}
+	}
+
+	VertexPool pool;
+	pool.layout_ = layout;
+	pool.buffer_ = 0;
+	pool.ranges_.Reset(0);
+	glGenVertexArrays(1, &pool.vertex_array_);
+	pools_.push_back(pool);
+
+	unsigned int format = (unsigned int)pools_.size() - 1;
+	ResizeVertexPool(format, kArenaInitialVertices, false);
+	return format;
+}
+
+void GeometryArena::ResizeVertexPool(unsigned int format, uint32_t capacity, bool compact) {
+	VertexPool& pool = pools_[format];
+	uint32_t stride = pool.layout_.stride_;
+
+	std::vector<BufferMove> moves;
+	uint32_t used = 0;
+	if (compact) {
+		std::vector<GeometryAllocation*> moved;
+		for (size_t i = 0; i < allocations_.size(); ++i) {
+			if (allocations_[i]->format_ == format) { moved.push_back(allocations_[i].get()); }
+		}
+		std::sort(moved.begin(), moved.end(), [](const GeometryAllocation* a, const GeometryAllocation* b) { return a->base_vertex_ < b->base_vertex_; });
+
+		for (size_t i = 0; i < moved.size(); ++i) {
+			moves.push_back({ (size_t)moved[i]->base_vertex_ * stride, (size_t)used * stride, (size_t)moved[i]->vertex_count_ * stride });
+			moved[i]->base_vertex_ = used;
+			used += moved[i]->vertex_count_;
+		}
+		pool.ranges_.Reset(capacity, used);
+	}
+	else {
+		moves.push_back({ 0, 0, (size_t)pool.ranges_.capacity() * stride });
+		pool.ranges_.Grow(capacity);
+	}
+
+	pool.buffer_ = ReplaceBuffer(pool.buffer_, (size_t)capacity * stride, moves);
+
+	//The vertex array keeps the buffer its attributes were pointed to
+	glBindVertexArray(pool.vertex_array_);
+	glBindBuffer(GL_ARRAY_BUFFER, pool.buffer_);
+	SetVertexAttributes(pool.layout_);
+	if (index_buffer_ != 0) { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_); }
+	glBindVertexArray(0);
+}
+
+void GeometryArena::ResizeIndexBuffer(uint32_t capacity, bool compact) {
+	std::vector<BufferMove> moves;
+	if (compact) {
+		std::vector<GeometryAllocation*> moved;
+		for (size_t i = 0; i < allocations_.size(); ++i) { moved.push_back(allocations_[i].get()); }
+		std::sort(moved.begin(), moved.end(), [](const GeometryAllocation* a, const GeometryAllocation* b) { return a->index_offset_ < b->index_offset_; });
+
+		//Each mesh keeps its offset aligned to its index size
+		uint32_t used = 0;
+		for (size_t i = 0; i < moved.size(); ++i) {
+			used = (used + moved[i]->index_size_ - 1) / moved[i]->index_size_ * moved[i]->index_size_;
+			moves.push_back({ moved[i]->index_offset_, used, moved[i]->index_bytes_ });
+			moved[i]->index_offset_ = used;
+			used += moved[i]->index_bytes_;
+		}
+
+		//The padding between meshes counts as used until the next compaction
+		index_ranges_.Reset(capacity, used);
+	}
+	else {
+		moves.push_back({ 0, 0, index_ranges_.capacity() });
+		index_ranges_.Grow(capacity);
+	}
+
+	index_buffer_ = ReplaceBuffer(index_buffer_, capacity, moves);
+
+	for (size_t i = 0; i < pools_.size(); ++i) {
+		glBindVertexArray(pools_[i].vertex_array_);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+	}
+	glBindVertexArray(0);
+}
+
+GeometryAllocation* GeometryArena::Allocate(const VertexLayout& layout, const void* vertex_data, uint32_t vertex_count,
+	const void* index_data, uint32_t index_count) {
+
+	if (index_buffer_ == 0) {
+		index_ranges_.Reset(0);
+		ResizeIndexBuffer(kArenaInitialIndexBytes, false);
+	}
+
+	std::unique_ptr<GeometryAllocation> allocation = std::make_unique<GeometryAllocation>();
+	allocation->format_ = FindPool(layout);
+	allocation->vertex_count_ = vertex_count;
+	allocation->index_size_ = layout.index_size_;
+	allocation->index_bytes_ = index_count * layout.index_size_;
+
+	//Compacting is tried first if the space is there but split. If it's still not enough, as the padding kept between
+	//meshes of different index sizes can make it, the buffer grows with room for the whole mesh at the end
+	VertexPool* pool = &pools_[allocation->format_];
+	bool allocated = pool->ranges_.Allocate(vertex_count, 1, &allocation->base_vertex_);
+	if (!allocated) {
+		uint32_t capacity = pool->ranges_.capacity();
+		if (capacity - pool->ranges_.used() >= vertex_count) {
+			ResizeVertexPool(allocation->format_, capacity, true);
+			allocated = pool->ranges_.Allocate(vertex_count, 1, &allocation->base_vertex_);
+		}
+		if (!allocated) {
+			ResizeVertexPool(allocation->format_, std::max(capacity * 2, capacity + vertex_count), false);
+			allocated = pool->ranges_.Allocate(vertex_count, 1, &allocation->base_vertex_);
+		}
+		printf("GeometryArena: vertex format %u %s to %u vertices\n", allocation->format_,
+			pool->ranges_.capacity() == capacity ? "compacted" : "grown", pool->ranges_.capacity());
+	}
+	assert(allocated);
+
+	allocated = index_ranges_.Allocate(allocation->index_bytes_, allocation->index_size_, &allocation->index_offset_);
+	if (!allocated) {
+		uint32_t capacity = index_ranges_.capacity();
+		if (capacity - index_ranges_.used() >= allocation->index_bytes_ + allocation->index_size_) {
+			ResizeIndexBuffer(capacity, true);
+			allocated = index_ranges_.Allocate(allocation->index_bytes_, allocation->index_size_, &allocation->index_offset_);
+		}
+		if (!allocated) {
+			ResizeIndexBuffer(std::max(capacity * 2, capacity + allocation->index_bytes_ + allocation->index_size_), false);
+			allocated = index_ranges_.Allocate(allocation->index_bytes_, allocation->index_size_, &allocation->index_offset_);
+		}
+		printf("GeometryArena: index buffer %s to %u bytes\n", index_ranges_.capacity() == capacity ? "compacted" : "grown",
+			index_ranges_.capacity());
+	}
+	assert(allocated);
+
+	allocation->vertex_array_ = pool->vertex_array_;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool->buffer_);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation->base_vertex_ * layout.stride_, (GLsizeiptr)vertex_count * layout.stride_, vertex_data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation->index_offset_, (GLsizeiptr)allocation->index_bytes_, index_data);
+
+	allocations_.push_back(std::move(allocation));
+	return allocations_.back().get();
+}
+
+void GeometryArena::Free(GeometryAllocation* allocation) {
+	if (allocation == nullptr) { return; }
+
+	pools_[allocation->format_].ranges_.Free(allocation->base_vertex_, allocation->vertex_count_);
+	index_ranges_.Free(allocation->index_offset_, allocation->index_bytes_);
+
+	for (size_t i = 0; i < allocations_.size(); ++i) {
+		if (allocations_[i].get() == allocation) {
+			allocations_[i] = std::move(allocations_.back());
+			allocations_.pop_back();
+			break;
+		}
+	}
+}
+
+void GeometryArena::Compact() {
+	for (unsigned int i = 0; i < (unsigned int)pools_.size(); ++i) {
+		if (pools_[i].ranges_.free_ranges() > 1) { ResizeVertexPool(i, pools_[i].ranges_.capacity(), true); }
+	}
+	if (index_ranges_.free_ranges() > 1) { ResizeIndexBuffer(index_ranges_.capacity(), true); }
+}
+#endif
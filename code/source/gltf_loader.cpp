@@ -0,0 +1,357 @@
+#include <gltf_loader.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+#include <glm/gtx/euler_angles.hpp>
+
+#include <boss.hpp>
+#include <mapped_file.hpp>
+#include <component_system.hpp>
+#include <resources.hpp>
+
+#define CGLTF_IMPLEMENTATION // define this in only *one* .cc
+#include <cgltf.h>
+
+#ifdef RENDER_OPENGL
+
+/**
+ * @brief Geometry of a primitive of the file, packed on a worker and uploaded on the main thread
+ */
+struct GltfPrimitive {
+	const cgltf_primitive* primitive_;
+	/** Mesh of the primitive, nullptr if it can't be drawn */
+	std::shared_ptr<TinyObj> mesh_;
+	/** Base color texture of its material, if any */
+	std::shared_ptr<Texture> texture_;
+	/** Whether the mesh was already in the resources and doesn't need to be packed */
+	bool loaded_;
+
+	std::vector<uint8_t> vertices_;
+	/** Indexes converted to the layout of the mesh, empty if they are uploaded straight from the file */
+	std::vector<uint8_t> indexes_;
+	/** Indexes to upload, in the file or in indexes_ */
+	const void* index_data_;
+};
+
+/**
+ * @brief State shared while the entities of the node tree are created
+ */
+struct GltfImport {
+	ComponentManager* component_manager_;
+	const cgltf_data* data_;
+	std::vector<GltfPrimitive> primitives_;
+	/** First primitive of each mesh of the file in primitives_ */
+	std::vector<size_t> first_primitive_;
+	/** Entities created */
+	size_t entities_;
+	/** Nodes that didn't fit under their parent */
+	size_t detached_;
+};
+
+//Returns the first set of an attribute of a primitive, nullptr if it doesn't have it
+static const cgltf_accessor* FindAttribute(const cgltf_primitive* primitive, cgltf_attribute_type type) {
+	for (cgltf_size i = 0; i < primitive->attributes_count; ++i) {
+		if (primitive->attributes[i].type == type && primitive->attributes[i].index == 0) {
+			return primitive->attributes[i].data;
+		}
+	}
+	return nullptr;
+}
+
+//Reads an attribute of every vertex as floats, whatever its component type and even if it's sparse
+static void ReadAttribute(const cgltf_accessor* accessor, std::vector<float>& out) {
+	out.resize(cgltf_accessor_unpack_floats(accessor, nullptr, 0));
+	cgltf_accessor_unpack_floats(accessor, out.data(), out.size());
+}
+
+//Returns the indexes of an accessor where they are in the buffer, if they are tightly packed
+//16 or 32 bit ones the arena can take as they are. nullptr if they have to be converted
+static const void* GetIndexData(const cgltf_accessor* accessor) {
+	uint32_t size = 0;
+	if (accessor->component_type == cgltf_component_type_r_16u) { size = sizeof(uint16_t); }
+	if (accessor->component_type == cgltf_component_type_r_32u) { size = sizeof(uint32_t); }
+
+	const cgltf_buffer_view* view = accessor->buffer_view;
+	if (size == 0 || accessor->is_sparse || view == nullptr || view->data != nullptr || view->buffer->data == nullptr) {
+		return nullptr;
+	}
+	if (accessor->stride != size || (view->stride != 0 && view->stride != size)) { return nullptr; }
+
+	return (const uint8_t*)view->buffer->data + view->offset + accessor->offset;
+}
+
+//Builds the vertices of a primitive and packs them, with the bounds and the LOD of the mesh
+static void PackPrimitive(GltfPrimitive& primitive) {
+	const cgltf_primitive* source = primitive.primitive_;
+	TinyObj* mesh = primitive.mesh_.get();
+
+	const cgltf_accessor* positions = FindAttribute(source, cgltf_attribute_type_position);
+	const cgltf_accessor* normals = FindAttribute(source, cgltf_attribute_type_normal);
+	const cgltf_accessor* uvs = FindAttribute(source, cgltf_attribute_type_texcoord);
+	const cgltf_accessor* colors = FindAttribute(source, cgltf_attribute_type_color);
+
+	std::vector<Vertex> vertices(positions->count);
+	std::vector<float> values;
+
+	ReadAttribute(positions, values);
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		vertices[i].position_ = glm::vec3(values[i * 3], values[i * 3 + 1], values[i * 3 + 2]);
+		vertices[i].color_ = glm::vec3(1.0f);
+		vertices[i].normal_ = glm::vec3(0.0f);
+		vertices[i].uv_ = glm::vec2(0.0f);
+	}
+
+	if (normals != nullptr && normals->count == vertices.size()) {
+		ReadAttribute(normals, values);
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].normal_ = glm::vec3(values[i * 3], values[i * 3 + 1], values[i * 3 + 2]);
+		}
+	}
+
+	//glTF puts the origin of the UVs on the top of the image, and the textures are flipped when loaded
+	if (uvs != nullptr && uvs->count == vertices.size()) {
+		ReadAttribute(uvs, values);
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].uv_ = glm::vec2(values[i * 2], 1.0f - values[i * 2 + 1]);
+		}
+	}
+
+	if (colors != nullptr && colors->count == vertices.size()) {
+		cgltf_size components = cgltf_num_components(colors->type);
+		ReadAttribute(colors, values);
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].color_ = glm::vec3(values[i * components], values[i * components + 1], values[i * components + 2]);
+		}
+	}
+
+	mesh->layout_ = ChooseVertexLayout(vertices, true);
+	PackVertices(mesh->layout_, vertices, primitive.vertices_);
+	mesh->vertex_count_ = (unsigned int)vertices.size();
+
+	//Non indexed primitives draw every vertex in order
+	const cgltf_accessor* indexes = source->indices;
+	primitive.index_data_ = indexes != nullptr ? GetIndexData(indexes) : nullptr;
+	mesh->index_count_ = (unsigned int)(indexes != nullptr ? indexes->count : vertices.size());
+	if (primitive.index_data_ != nullptr) {
+		mesh->layout_.index_size_ = indexes->component_type == cgltf_component_type_r_32u ? sizeof(uint32_t) : sizeof(uint16_t);
+	}
+	else {
+		std::vector<unsigned int> converted(mesh->index_count_);
+		for (size_t i = 0; i < converted.size(); ++i) {
+			converted[i] = indexes != nullptr ? (unsigned int)cgltf_accessor_read_index(indexes, i) : (unsigned int)i;
+		}
+		PackIndexes(mesh->layout_, converted, primitive.indexes_);
+		primitive.index_data_ = primitive.indexes_.data();
+	}
+
+	mesh->lods_.assign(1, { 0, mesh->index_count_, 0.0f });
+
+	mesh->bounds_min_ = vertices[0].position_;
+	mesh->bounds_max_ = vertices[0].position_;
+	for (size_t i = 1; i < vertices.size(); ++i) {
+		mesh->bounds_min_ = glm::min(mesh->bounds_min_, vertices[i].position_);
+		mesh->bounds_max_ = glm::max(mesh->bounds_max_, vertices[i].position_);
+	}
+	glm::vec3 center = (mesh->bounds_min_ + mesh->bounds_max_) * 0.5f;
+	float radius_squared = 0.0f;
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		glm::vec3 offset = vertices[i].position_ - center;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+	mesh->bounds_radius_ = sqrtf(radius_squared);
+}
+
+//Gives an entity the transform of a matrix, in the order TransformComponent composes it
+static void SetTransform(TransformComponent* transform, const glm::mat4& matrix) {
+	glm::vec3 scale, translation, skew;
+	glm::vec4 perspective;
+	glm::quat rotation;
+	glm::decompose(matrix, scale, rotation, translation, skew, perspective);
+
+	//The rotation is applied as yaw * pitch * roll
+	float yaw, pitch, roll;
+	glm::extractEulerAngleYXZ(glm::mat4_cast(rotation), yaw, pitch, roll);
+
+	transform->SetTranslation(translation);
+	transform->SetScale(scale);
+	transform->SetRotation(pitch, yaw, roll, true);
+}
+
+//Parents an entity created for the file. If the parent has no room for more children, the entity
+//stays at the root of the scene with the transform it would have had
+static void AttachEntity(GltfImport& import, size_t& parent, size_t& child, const glm::mat4& local, const glm::mat4& world) {
+	ComponentManager* component_manager = import.component_manager_;
+	import.entities_++;
+
+	if (component_manager->make_parent(parent, child) == TreeComponentErrors::kOK) {
+		SetTransform(component_manager->get_component<TransformComponent>(child), local);
+		return;
+	}
+
+	SetTransform(component_manager->get_component<TransformComponent>(child), world);
+	import.detached_++;
+}
+
+static void CreateNodeEntity(GltfImport& import, const cgltf_node* node, size_t& parent, const glm::mat4& parent_world) {
+	ComponentManager* component_manager = import.component_manager_;
+
+	float local_values[16];
+	cgltf_node_transform_local(node, local_values);
+	glm::mat4 local = glm::make_mat4(local_values);
+	glm::mat4 world = parent_world * local;
+
+	size_t entity = component_manager->new_entity();
+	if (node->name != nullptr) { component_manager->set_entity_name(entity, node->name); }
+	AttachEntity(import, parent, entity, local, world);
+
+	if (node->mesh != nullptr) {
+		const cgltf_mesh* mesh = node->mesh;
+		size_t first = import.first_primitive_[mesh - import.data_->meshes];
+
+		for (cgltf_size p = 0; p < mesh->primitives_count; ++p) {
+			GltfPrimitive& primitive = import.primitives_[first + p];
+			if (primitive.mesh_ == nullptr) { continue; }
+
+			size_t target = entity;
+			if (mesh->primitives_count > 1) {
+				target = component_manager->new_entity();
+				AttachEntity(import, entity, target, glm::mat4(1.0f), world);
+			}
+
+			RendererComponent* renderer = component_manager->addComponent<RendererComponent>(target);
+			renderer->Init(primitive.mesh_);
+			if (primitive.texture_ != nullptr) { renderer->AddTexture(primitive.texture_); }
+			if (target != entity || node->name == nullptr) { component_manager->set_entity_name(target, primitive.mesh_->name_); }
+		}
+	}
+
+	for (cgltf_size c = 0; c < node->children_count; ++c) {
+		CreateNodeEntity(import, node->children[c], entity, world);
+	}
+}
+
+size_t LoadGltf(const std::string& filepath, ComponentManager* component_manager, Resources* resources, Boss* boss) {
+	auto start = std::chrono::steady_clock::now();
+
+	//The binary chunk is only pointed to by cgltf, it's read from the mapping
+	MappedFile file;
+	if (!file.Open(filepath)) {
+		printf("Gltf: couldn't open %s\n", filepath.c_str());
+		return 0;
+	}
+
+	cgltf_options options;
+	memset(&options, 0, sizeof(cgltf_options));
+	cgltf_data* data = nullptr;
+	cgltf_result result = cgltf_parse(&options, file.data(), file.size(), &data);
+	if (result == cgltf_result_success) { result = cgltf_load_buffers(&options, data, filepath.c_str()); }
+	if (result == cgltf_result_success) { result = cgltf_validate(data); }
+	if (result != cgltf_result_success) {
+		printf("Gltf: %s couldn't be read, error %d\n", filepath.c_str(), (int)result);
+		cgltf_free(data);
+		return 0;
+	}
+
+	std::filesystem::path path(filepath);
+	std::string file_name = path.stem().string();
+
+	GltfImport import;
+	import.component_manager_ = component_manager;
+	import.data_ = data;
+	import.entities_ = 0;
+	import.detached_ = 0;
+	import.first_primitive_.resize(data->meshes_count);
+
+	//Each primitive is identified by its place in the file, so loading it again reuses the meshes
+	for (cgltf_size m = 0; m < data->meshes_count; ++m) {
+		const cgltf_mesh& mesh = data->meshes[m];
+		import.first_primitive_[m] = import.primitives_.size();
+
+		for (cgltf_size p = 0; p < mesh.primitives_count; ++p) {
+			const cgltf_primitive* source = &mesh.primitives[p];
+
+			GltfPrimitive primitive;
+			primitive.primitive_ = source;
+			primitive.loaded_ = false;
+			primitive.index_data_ = nullptr;
+
+			std::string key = filepath + "#" + std::to_string(m) + "." + std::to_string(p);
+			primitive.mesh_ = resources->getMeshByPath(key);
+			primitive.loaded_ = primitive.mesh_ != nullptr;
+
+			const cgltf_accessor* positions = FindAttribute(source, cgltf_attribute_type_position);
+			if (!primitive.loaded_ && source->type == cgltf_primitive_type_triangles && positions != nullptr && positions->count != 0) {
+				primitive.mesh_ = std::make_shared<TinyObj>();
+				primitive.mesh_->name_ = mesh.name != nullptr ? mesh.name : file_name + "_" + std::to_string(m);
+				if (mesh.primitives_count > 1) { primitive.mesh_->name_ += "_" + std::to_string(p); }
+				primitive.mesh_->full_path_ = key;
+			}
+
+			//Only the base color is used, from image files next to the model
+			const cgltf_material* material = source->material;
+			if (material != nullptr && material->has_pbr_metallic_roughness) {
+				const cgltf_texture* texture = material->pbr_metallic_roughness.base_color_texture.texture;
+				if (texture != nullptr && texture->image != nullptr && texture->image->uri != nullptr &&
+					strncmp(texture->image->uri, "data:", 5) != 0) {
+					primitive.texture_ = resources->addTexture((path.parent_path() / texture->image->uri).generic_string(), boss);
+				}
+			}
+
+			import.primitives_.push_back(std::move(primitive));
+		}
+	}
+
+	//Pack the new primitives on the workers, they only read the file
+	JobCounter counter;
+	for (size_t i = 0; i < import.primitives_.size(); ++i) {
+		GltfPrimitive* primitive = &import.primitives_[i];
+		if (primitive->mesh_ == nullptr || primitive->loaded_) { continue; }
+
+		if (boss != nullptr) { boss->run([primitive]() { PackPrimitive(*primitive); }, &counter); }
+		else { PackPrimitive(*primitive); }
+	}
+	if (boss != nullptr) { boss->wait(&counter); }
+
+	size_t new_meshes = 0;
+	for (size_t i = 0; i < import.primitives_.size(); ++i) {
+		GltfPrimitive& primitive = import.primitives_[i];
+		if (primitive.mesh_ == nullptr || primitive.loaded_) { continue; }
+
+		primitive.mesh_->InitBuffer(resources->geometry_arena_, primitive.vertices_.data(), primitive.index_data_);
+		primitive.mesh_ = resources->storeMesh(std::move(primitive.mesh_));
+		primitive.vertices_ = std::vector<uint8_t>();
+		primitive.indexes_ = std::vector<uint8_t>();
+		new_meshes++;
+	}
+
+	//Every node hangs from an entity named like the file, the default scene or every root node if there's none
+	size_t root = component_manager->new_entity();
+	component_manager->set_entity_name(root, file_name);
+
+	const cgltf_scene* scene = data->scene != nullptr ? data->scene : (data->scenes_count != 0 ? &data->scenes[0] : nullptr);
+	if (scene != nullptr) {
+		for (cgltf_size n = 0; n < scene->nodes_count; ++n) {
+			CreateNodeEntity(import, scene->nodes[n], root, glm::mat4(1.0f));
+		}
+	}
+	else {
+		for (cgltf_size n = 0; n < data->nodes_count; ++n) {
+			if (data->nodes[n].parent == nullptr) { CreateNodeEntity(import, &data->nodes[n], root, glm::mat4(1.0f)); }
+		}
+	}
+
+	cgltf_free(data);
+
+	float load_time_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Gltf %s: %zu primitives, %zu new meshes, %zu entities in %.3f ms\n", file_name.c_str(),
+		import.primitives_.size(), new_meshes, import.entities_, load_time_ms);
+	if (import.detached_ != 0) {
+		printf("Gltf %s: %zu nodes didn't fit under their parent and were left at the root\n", file_name.c_str(), import.detached_);
+	}
+
+	return root;
+}
+
+#endif
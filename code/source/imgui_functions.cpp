@@ -1,5 +1,6 @@
 #include "imgui_functions.hpp"
 
+#include <atomic>
 #include <filesystem>
 #ifdef RENDER_OPENGL
 	#include "imgui.h"
@@ -15,6 +16,8 @@
 #include <scene_manager.hpp>
 
 static bool openDisplayWindowData = false;
+static bool openDisplayRenderStats = false;
+static bool openDisplayJobStats = false;
 static bool openDisplayTexture = false;
 
 static bool openDisplayResourceList = false;
@@ -43,6 +46,8 @@ static bool openDisplayScenes = false;
 static bool openDisplayDialogNewScene = false;
 static bool openDisplayDialogSaveScene = false;
 static bool openDisplayDialogLoadScene = false;
+//Set while a scene loads in the background, only one can load at a time
+static std::atomic<bool> loadingScene = false;
 
 static unsigned int selectedEditScene = 0;
 //static unsigned int selectedDeleteScene = 0;
@@ -78,13 +83,63 @@ void ImguiFunctions::DisplayWindowData(Window* win, ComponentManager* comp){
 	}
 }
 
+#ifdef RENDER_OPENGL
+void ImguiFunctions::DisplayRenderStats(RenderSystemOpenGL* render){
+	if (openDisplayRenderStats) {
+		ImGui::Begin("Render stats", &openDisplayRenderStats);
+
+		ImGui::Checkbox("Sort draws by state", &render->sort_draws_);
+		ImGui::Text("Draws: %u", render->render_stats_.draws_);
+		ImGui::Text("Vertex array changes: %u", render->render_stats_.vertex_array_changes_);
+		ImGui::Text("Texture changes: %u", render->render_stats_.texture_changes_);
+		ImGui::Text("Cull mode changes: %u", render->render_stats_.cull_changes_);
+
+		ImGui::End();
+	}
+}
+
+//File the traced jobs are exported to, it opens on chrome://tracing and Perfetto
+static const char* const kJobTraceFile = "job_trace.json";
+
+void ImguiFunctions::DisplayJobStats(Boss* boss){
+	if (openDisplayJobStats && boss != nullptr) {
+		ImGui::Begin("Job stats", &openDisplayJobStats);
+
+		BossStats stats = boss->get_stats();
+		ImGui::Text("Workers: %u", boss->get_worker_count());
+		ImGui::Text("Queued jobs: %d", boss->get_job_count());
+		ImGui::Text("Jobs executed: %llu", (unsigned long long)stats.jobs_executed_);
+		ImGui::Text("Jobs helped: %llu", (unsigned long long)stats.jobs_helped_);
+		ImGui::Text("Queue locks: %llu, contended: %llu", (unsigned long long)stats.lock_acquisitions_, (unsigned long long)stats.lock_contentions_);
+
+		bool telemetry = boss->is_telemetry_enabled();
+		if (ImGui::Checkbox("Trace jobs", &telemetry)) { boss->set_telemetry(telemetry); }
+		if (telemetry) {
+			ImGui::Text("Queue wait: %.3f ms", stats.queue_wait_ns_ / 1000000.0);
+			ImGui::Text("Run time: %.3f ms", stats.run_ns_ / 1000000.0);
+			if (ImGui::Button("Export trace") && boss->export_chrome_trace(kJobTraceFile)) {
+				printf("Boss: trace written to %s\n", kJobTraceFile);
+			}
+		}
+
+		ImGui::End();
+	}
+}
+#endif
+
 void ImguiFunctions::DisplayTexture(Texture* text){
 	if (openDisplayTexture && text != nullptr) {
 		ImGui::Begin(text->src_.c_str(), &openDisplayTexture, ImGuiWindowFlags_AlwaysHorizontalScrollbar | ImGuiWindowFlags_AlwaysVerticalScrollbar);
 	#ifdef RENDER_OPENGL
-		ImVec2 v = ImVec2((float)text->width_, (float)text->height_);
-		ImU64 id = text->texture_id_;
-		ImGui::Image((ImTextureID)id, v);
+		//Imgui only draws 2D textures, the layers of an array can't be shown on their own
+		if (text->array_ != nullptr) {
+			ImGui::Text("Packed in layer %u of a %dx%d texture array", text->array_layer_, text->array_->width_, text->array_->height_);
+		}
+		else {
+			ImVec2 v = ImVec2((float)text->width_, (float)text->height_);
+			ImU64 id = text->texture_id_;
+			ImGui::Image((ImTextureID)id, v);
+		}
 	#endif
 	#ifdef RENDER_DIRECTX11
 		ImGui::Image(((void*)text->shader_resource_view_.Get()), ImVec2((float)text->width_, (float)text->height_));
@@ -487,9 +542,9 @@ void ImguiFunctions::DisplayResourceList(ComponentManager* comp, RenderSystem* r
 						ImGui::TableNextColumn();
 						ImGui::Text(render->resource_list_.meshes_[i]->name_.c_str());
 						ImGui::TableNextColumn();
-						ImGui::Text("%zd", render->resource_list_.meshes_[i]->vertices_.size());
+						ImGui::Text("%u", render->resource_list_.meshes_[i]->vertex_count_);
 						ImGui::TableNextColumn();
-						ImGui::Text("%zd", render->resource_list_.meshes_[i]->indexes_.size());
+						ImGui::Text("%u", render->resource_list_.meshes_[i]->index_count_);
 						ImGui::TableNextColumn();
 						sprintf_s(str, "##MeshCullingType%d", (unsigned int)i);
 						if (ImGui::BeginCombo(str, cull_names[render->resource_list_.meshes_[i]->cull_type_].c_str())) {
@@ -894,6 +949,7 @@ void ImguiFunctions::DisplayEntityComponents(ComponentManager* comp, RenderSyste
 			ImGui::Checkbox("Needs light", &render->needs_light_);
 			ImGui::Checkbox("Casts shadows", &render->casts_shadows_);
 			ImGui::Checkbox("Receive shadows", &render->receives_shadows_);
+			ImGui::Checkbox("Occluder", &render->occluder_);
 			ImGui::Separator();
 
 			if (ImGui::BeginCombo("##RenderMeshSelected", (render->isInit_?render->mesh_.get()->name_.c_str():"No mesh selected"))) {
@@ -1165,7 +1221,8 @@ void ImguiFunctions::DisplayAddTextureToRenderer(ComponentManager* comp, Rendere
 				bool found = false;
 				for (unsigned int j = 0; !found && j < renderer->textures_.size(); ++j) {
 					#ifdef RENDER_OPENGL
-					if (render_sys->resource_list_.textures_.at(i)->texture_id_ == renderer->textures_.at(j)->texture_id_) {
+					//Packed textures have no id of their own
+					if (render_sys->resource_list_.textures_.at(i) == renderer->textures_.at(j)) {
 						found = true;
 					}
 					#endif
@@ -1193,7 +1250,8 @@ void ImguiFunctions::DisplayAddTextureToRenderer(ComponentManager* comp, Rendere
 					bool found = false;
 					for (unsigned int j = 0; !found && j < renderer->textures_.size(); ++j) {
 						#ifdef RENDER_OPENGL
-						if (render_sys->resource_list_.textures_.at(i)->texture_id_ == renderer->textures_.at(j)->texture_id_) {
+						//Packed textures have no id of their own
+						if (render_sys->resource_list_.textures_.at(i) == renderer->textures_.at(j)) {
 							found = true;
 						}
 						#endif
@@ -1474,10 +1532,22 @@ void ImguiFunctions::DisplaySaveNewScene(ComponentManager* cm, RenderSystem* rs,
 	}
 }
 
+#ifdef RENDER_OPENGL
+//Loads a scene without stopping the frames, it ends on the main thread when the scene was swapped
+static eve::task<> LoadSceneInBackground(ComponentManager* cm, RenderSystem* rs, SceneManager* sm, Boss* boss, std::string scene_name) {
+	bool loaded = co_await sm->LoadSceneAsync(cm, rs, boss, scene_name);
+	//The menus may point to entities of the scene replaced
+	if (loaded) { ImguiFunctions::ResetImguiMenus(); }
+	else { printf("Couldn't load scene %s\n", scene_name.c_str()); }
+	loadingScene = false;
+}
+#endif
+
 void ImguiFunctions::DisplayLoadScene(ComponentManager* cm, RenderSystem* rs, SceneManager* sm) {
 	static unsigned int selectedLoadScene = 0;
 	if (ImGui::Begin("Load scene")) {
 		ImGui::Text("Load a different scene? All changes not saved will be lost");
+		if (loadingScene) { ImGui::Text("A scene is still loading"); }
 
 		if (sm->scenes_.size() != 0) {
 
@@ -1504,7 +1574,18 @@ void ImguiFunctions::DisplayLoadScene(ComponentManager* cm, RenderSystem* rs, Sc
 			if (ImGui::Button("Confirm##ConfirmLoadScene")) {
 				ResetImguiMenus();
 				std::string temp_str = sm->scenes_.at(selectedLoadScene).alias;
+#ifdef RENDER_OPENGL
+				//With a job system the resources load on the workers and the scene is swapped on a later frame
+				Boss* boss = static_cast<RenderSystemOpenGL*>(rs)->getBoss();
+				if (boss != nullptr) {
+					if (!loadingScene.exchange(true)) {
+						eve::spawn(*boss, LoadSceneInBackground(cm, rs, sm, boss, temp_str.substr(0, temp_str.rfind("."))));
+					}
+				}
+				else { sm->LoadScene(cm, rs, temp_str.substr(0, temp_str.rfind(".")).c_str()); }
+#else
 				sm->LoadScene(cm, rs, temp_str.substr(0, temp_str.rfind(".")).c_str());
+#endif
 
 				//Load given scene
 				openDisplayDialogLoadScene = false;
@@ -1529,6 +1610,10 @@ void ImguiFunctions::DisplayMenuBar(Window* win, SceneManager* scene_manager){
 		if (ImGui::BeginMainMenuBar()) {
 			if (ImGui::BeginMenu("Main Menu", openDisplayMenuBar)) {
 				if (ImGui::MenuItem("Display Window Data")) {openDisplayWindowData = true;}
+#ifdef RENDER_OPENGL
+				if (ImGui::MenuItem("Display Render Stats")) {openDisplayRenderStats = true;}
+				if (ImGui::MenuItem("Display Job Stats")) {openDisplayJobStats = true;}
+#endif
 				if (ImGui::MenuItem("Quit", "Escape")) {win->close_window();}
 				ImGui::EndMenu();
 			}
@@ -1584,6 +1669,8 @@ void ImguiFunctions::DisplayMenuBar(Window* win, SceneManager* scene_manager){
 
 void ImguiFunctions::ResetImguiMenus(){
 	openDisplayWindowData = false;
+	openDisplayRenderStats = false;
+	openDisplayJobStats = false;
 	openDisplayTexture = false;
 
 	openDisplayResourceList = false;
@@ -1616,6 +1703,8 @@ void ImguiFunctions::ImguiFunctionCalls(ComponentManager* cm, RenderSystem* rs,
 
 #ifdef RENDER_OPENGL
 	DisplayWindowData(static_cast<RenderSystemOpenGL*>(rs)->getWindow(), cm);
+	DisplayRenderStats(static_cast<RenderSystemOpenGL*>(rs));
+	DisplayJobStats(static_cast<RenderSystemOpenGL*>(rs)->getBoss());
 	DisplaySceneGraph(cm);
 	DisplayResourceList(cm, rs);
 	DisplayEntityComponents(cm, rs);//Scene management
@@ -0,0 +1,76 @@
+#include "job.hpp"
+
+// #### JOB ####
+
+void Job::Run() {
+	invoke_(this);
+
+	//The last job of the counter wakes up whoever is waiting for it
+	if (counter_ != nullptr) { counter_->done_one(); }
+}
+
+void Job::Discard() {
+	destroy_(this);
+
+	if (counter_ != nullptr) { counter_->done_one(); }
+}
+
+// #### JOB POOL ####
+
+JobPool::JobPool() : owner_{ std::this_thread::get_id() }, free_list_{ nullptr }, remote_free_list_{ nullptr } {
+	Grow();
+}
+
+JobPool::~JobPool() {
+	free_list_ = nullptr;
+	remote_free_list_.store(nullptr);
+	blocks_.clear();
+}
+
+Job* JobPool::Allocate() {
+	//Reclaim every job returned by other threads at once
+	if (free_list_ == nullptr) {
+		free_list_ = remote_free_list_.exchange(nullptr, std::memory_order_acquire);
+	}
+	if (free_list_ == nullptr) { Grow(); }
+
+	Job* job = free_list_;
+	free_list_ = job->next_;
+
+	job->next_ = nullptr;
+	job->counter_ = nullptr;
+	job->pool_ = this;
+
+	return job;
+}
+
+void JobPool::Free(Job* job) {
+	if (std::this_thread::get_id() == owner_) {
+		job->next_ = free_list_;
+		free_list_ = job;
+		return;
+	}
+
+	//Only the owner pops from the remote list and it always takes all of it,
+	//so pushing with a compare exchange is enough and has no ABA problem
+	Job* head = remote_free_list_.load(std::memory_order_relaxed);
+	do {
+		job->next_ = head;
+	} while (!remote_free_list_.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t JobPool::capacity() const {
+	return blocks_.size() * kJobsPerPoolBlock;
+}
+
+void JobPool::Grow() {
+	std::unique_ptr<Job[]> block = std::make_unique<Job[]>(kJobsPerPoolBlock);
+
+	for (unsigned int i = 0; i < kJobsPerPoolBlock; ++i) {
+		block[i].pool_ = this;
+		block[i].next_ = free_list_;
+		free_list_ = &block[i];
+	}
+
+	blocks_.push_back(std::move(block));
+}
@@ -0,0 +1,38 @@
+#include "job_trace.hpp"
+
+static_assert((kJobTraceCapacity & (kJobTraceCapacity - 1)) == 0, "kJobTraceCapacity must be a power of two");
+
+JobTraceBuffer::JobTraceBuffer() : events_{ std::make_unique<JobTraceEvent[]>(kJobTraceCapacity) }, head_{ 0 } {}
+
+void JobTraceBuffer::Push(const JobTraceEvent& event) {
+	uint64_t head = head_.load(std::memory_order_relaxed);
+	events_[head & (kJobTraceCapacity - 1)] = event;
+	head_.store(head + 1, std::memory_order_release);
+}
+
+void JobTraceBuffer::Snapshot(std::vector<JobTraceEvent>& out) const {
+	uint64_t end = head_.load(std::memory_order_acquire);
+	uint64_t begin = end > kJobTraceCapacity ? end - kJobTraceCapacity : 0;
+
+	size_t first = out.size();
+	for (uint64_t i = begin; i < end; ++i) {
+		out.push_back(events_[i & (kJobTraceCapacity - 1)]);
+	}
+
+	//The owner may have wrapped around while copying, drop what it overwrote
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t new_end = head_.load(std::memory_order_relaxed);
+	if (new_end > begin + kJobTraceCapacity) {
+		uint64_t overwritten = new_end - kJobTraceCapacity - begin;
+		if (overwritten > end - begin) { overwritten = end - begin; }
+		out.erase(out.begin() + first, out.begin() + first + (size_t)overwritten);
+	}
+}
+
+void JobTraceBuffer::Clear() {
+	head_.store(0, std::memory_order_release);
+}
+
+uint64_t JobTraceBuffer::total() const {
+	return head_.load(std::memory_order_acquire);
+}
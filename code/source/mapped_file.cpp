@@ -0,0 +1,84 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : data_{ nullptr }, size_{ 0 }, file_handle_{ INVALID_HANDLE_VALUE }, mapping_handle_{ nullptr } {}
+#else
+MappedFile::MappedFile() : data_{ nullptr }, size_{ 0 } {}
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filepath) {
+	Close();
+
+#ifdef _WIN32
+	file_handle_ = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file_handle_ == INVALID_HANDLE_VALUE) { return false; }
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	mapping_handle_ = CreateFileMappingA(file_handle_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_handle_ == nullptr) {
+		Close();
+		return false;
+	}
+
+	data_ = (const unsigned char*)MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+	if (data_ == nullptr) {
+		Close();
+		return false;
+	}
+	size_ = (size_t)file_size.QuadPart;
+#else
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0) { return false; }
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//The mapping keeps its own reference to the file
+	close(fd);
+	if (view == MAP_FAILED) { return false; }
+
+	data_ = (const unsigned char*)view;
+	size_ = (size_t)file_stat.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+	if (data_ != nullptr) { UnmapViewOfFile(data_); }
+	if (mapping_handle_ != nullptr) { CloseHandle(mapping_handle_); }
+	if (file_handle_ != INVALID_HANDLE_VALUE) { CloseHandle(file_handle_); }
+	mapping_handle_ = nullptr;
+	file_handle_ = INVALID_HANDLE_VALUE;
+#else
+	if (data_ != nullptr) { munmap((void*)data_, size_); }
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
@@ -0,0 +1,583 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indexes, size_t vertex_count, unsigned int cache_size) {
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (indexes.empty() || vertex_count == 0) { return stats; }
+
+	//Miss count when each vertex entered the cache, 0 if it never did.
+	//With a FIFO a vertex stays until cache_size other vertices have entered after it
+	std::vector<unsigned int> inserted_at(vertex_count, 0);
+	unsigned int misses = 0;
+
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		unsigned int v = indexes[i];
+		if (inserted_at[v] == 0 || misses - inserted_at[v] >= cache_size) {
+			misses++;
+			inserted_at[v] = misses;
+		}
+	}
+
+	stats.acmr_ = (float)misses / (float)(indexes.size() / 3);
+	stats.atvr_ = (float)misses / (float)vertex_count;
+	return stats;
+}
+
+//Returns the next vertex with triangles left when the fanning vertex has none:
+//first the recently used ones, and if none of them, the next one in order
+static int SkipDeadEnd(const std::vector<unsigned int>& live, std::vector<unsigned int>& dead_end, size_t& cursor) {
+	while (!dead_end.empty()) {
+		unsigned int v = dead_end.back();
+		dead_end.pop_back();
+		if (live[v] > 0) { return (int)v; }
+	}
+
+	while (cursor < live.size()) {
+		if (live[cursor] > 0) { return (int)cursor; }
+		cursor++;
+	}
+
+	return -1;
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indexes, const std::vector<Vertex>& vertices, bool reduce_overdraw, unsigned int cache_size) {
+	const size_t triangle_count = indexes.size() / 3;
+	if (triangle_count == 0) { return; }
+
+	size_t vertex_count = (size_t)*std::max_element(indexes.begin(), indexes.end()) + 1;
+	reduce_overdraw = reduce_overdraw && vertices.size() >= vertex_count;
+
+	//Triangles using each vertex, and how many of them haven't been emitted yet
+	std::vector<unsigned int> live(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; ++i) { live[indexes[i]]++; }
+
+	std::vector<unsigned int> offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; ++v) { offsets[v + 1] = offsets[v] + live[v]; }
+
+	std::vector<unsigned int> adjacency(triangle_count * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangle_count * 3; ++i) { adjacency[fill[indexes[i]]++] = (unsigned int)(i / 3); }
+
+	std::vector<unsigned int> cache_time(vertex_count, 0);
+	std::vector<unsigned int> dead_end;
+	std::vector<unsigned int> candidates;
+	std::vector<bool> emitted(triangle_count, false);
+	dead_end.reserve(triangle_count * 3);
+
+	std::vector<unsigned int> output;
+	output.reserve(triangle_count * 3);
+	//First triangle of each cluster, a new one starts every time the fanning hits a dead end
+	std::vector<size_t> clusters = { 0 };
+
+	unsigned int time = cache_size + 1;
+	size_t cursor = 0;
+	int fanning = SkipDeadEnd(live, dead_end, cursor);
+
+	while (fanning >= 0) {
+		candidates.clear();
+
+		//Emit every triangle around the fanning vertex
+		for (unsigned int k = offsets[fanning]; k < offsets[fanning + 1]; ++k) {
+			unsigned int t = adjacency[k];
+			if (emitted[t]) { continue; }
+
+			for (unsigned int c = 0; c < 3; ++c) {
+				unsigned int v = indexes[t * 3 + c];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cache_time[v] > cache_size) {
+					cache_time[v] = time;
+					time++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		//Continue with the candidate that is still in the cache and will stay there the longest
+		int next = -1;
+		unsigned int best = 0;
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			unsigned int v = candidates[i];
+			if (live[v] == 0) { continue; }
+
+			unsigned int priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size) { priority = time - cache_time[v]; }
+			if (priority > best) {
+				best = priority;
+				next = (int)v;
+			}
+		}
+
+		if (next == -1) {
+			next = SkipDeadEnd(live, dead_end, cursor);
+			if (next >= 0) { clusters.push_back(output.size() / 3); }
+		}
+
+		fanning = next;
+	}
+
+	if (!reduce_overdraw || clusters.size() < 2) {
+		indexes.swap(output);
+		return;
+	}
+
+	//Draw first the clusters further from the center and facing outwards, as they are
+	//the most likely to occlude the rest of the mesh
+	glm::vec3 mesh_center(0.0f);
+	for (size_t v = 0; v < vertex_count; ++v) { mesh_center += vertices[v].position_; }
+	mesh_center /= (float)vertex_count;
+
+	clusters.push_back(triangle_count);
+	std::vector<std::pair<float, size_t>> sorted_clusters(clusters.size() - 1);
+
+	for (size_t c = 0; c + 1 < clusters.size(); ++c) {
+		glm::vec3 center(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const glm::vec3& p0 = vertices[output[t * 3 + 0]].position_;
+			const glm::vec3& p1 = vertices[output[t * 3 + 1]].position_;
+			const glm::vec3& p2 = vertices[output[t * 3 + 2]].position_;
+
+			//The cross product is the normal weighted by twice the area
+			glm::vec3 weighted_normal = glm::cross(p1 - p0, p2 - p0);
+			float triangle_area = glm::length(weighted_normal);
+
+			center += (p0 + p1 + p2) * (triangle_area / 3.0f);
+			normal += weighted_normal;
+			area += triangle_area;
+		}
+
+		if (area > 0.0f) { center /= area; }
+		sorted_clusters[c] = { glm::dot(center - mesh_center, normal), c };
+	}
+
+	std::stable_sort(sorted_clusters.begin(), sorted_clusters.end(),
+		[](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first > b.first; });
+
+	indexes.clear();
+	for (size_t i = 0; i < sorted_clusters.size(); ++i) {
+		size_t c = sorted_clusters[i].second;
+		indexes.insert(indexes.end(), output.begin() + clusters[c] * 3, output.begin() + clusters[c + 1] * 3);
+	}
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indexes) {
+	const unsigned int kUnused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertices.size(), kUnused);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		unsigned int& new_index = remap[indexes[i]];
+		if (new_index == kUnused) {
+			new_index = (unsigned int)ordered.size();
+			ordered.push_back(vertices[indexes[i]]);
+		}
+		indexes[i] = new_index;
+	}
+
+	vertices.swap(ordered);
+}
+
+/**
+ * @brief Sum of squared distances to a set of planes, stored as the upper half of a symmetric 4x4 matrix
+ */
+struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+static void AddPlane(Quadric& q, const glm::dvec3& n, double d, double weight) {
+	q.a2 += weight * n.x * n.x; q.ab += weight * n.x * n.y; q.ac += weight * n.x * n.z; q.ad += weight * n.x * d;
+	q.b2 += weight * n.y * n.y; q.bc += weight * n.y * n.z; q.bd += weight * n.y * d;
+	q.c2 += weight * n.z * n.z; q.cd += weight * n.z * d;
+	q.d2 += weight * d * d;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other) {
+	q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+	q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+	q.c2 += other.c2; q.cd += other.cd;
+	q.d2 += other.d2;
+}
+
+static double EvaluateQuadric(const Quadric& q, const glm::vec3& p) {
+	double x = p.x, y = p.y, z = p.z;
+	double result = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+		+ q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+		+ q.c2 * z * z + 2.0 * q.cd * z
+		+ q.d2;
+	return result > 0.0 ? result : 0.0;
+}
+
+/**
+ * @brief Candidate edge to collapse, from one position into another
+ */
+struct Collapse {
+	double cost_;
+	unsigned int from_;
+	unsigned int to_;
+	unsigned int from_version_;
+	unsigned int to_version_;
+
+	bool operator<(const Collapse& other) const { return cost_ > other.cost_; }
+};
+
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indexes,
+	size_t target_index_count, float max_error, float* result_error) {
+
+	if (result_error != nullptr) { *result_error = 0.0f; }
+	const size_t triangle_count = indexes.size() / 3;
+	if (triangle_count == 0 || indexes.size() <= target_index_count) { return indexes; }
+
+	//Vertices split by normals or uvs share a position, the topology is built over the positions
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const {
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return (size_t)((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+		}
+	};
+	std::unordered_map<glm::vec3, unsigned int, PositionHash> position_ids;
+	std::vector<unsigned int> position_of(vertices.size());
+	std::vector<glm::vec3> positions;
+	std::vector<std::vector<unsigned int>> wedges;
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		auto inserted = position_ids.try_emplace(vertices[v].position_, (unsigned int)positions.size());
+		if (inserted.second) {
+			positions.push_back(vertices[v].position_);
+			wedges.emplace_back();
+		}
+		position_of[v] = inserted.first->second;
+		wedges[inserted.first->second].push_back((unsigned int)v);
+	}
+	const size_t position_count = positions.size();
+
+	glm::vec3 bounds_min = positions[0];
+	glm::vec3 bounds_max = positions[0];
+	for (size_t p = 1; p < position_count; ++p) {
+		bounds_min = glm::min(bounds_min, positions[p]);
+		bounds_max = glm::max(bounds_max, positions[p]);
+	}
+	double extent = glm::length(bounds_max - bounds_min);
+	if (extent <= 0.0) { return indexes; }
+	double max_cost = (double)max_error * extent;
+	max_cost *= max_cost;
+
+	std::vector<unsigned int> triangles(indexes.begin(), indexes.begin() + triangle_count * 3);
+	std::vector<bool> triangle_alive(triangle_count, true);
+	std::vector<std::vector<unsigned int>> adjacency(position_count);
+	std::vector<Quadric> quadrics(position_count, Quadric{});
+
+	//Planes of every triangle, and edges to know which ones are borders
+	std::unordered_map<uint64_t, unsigned int> edge_uses;
+	size_t live_triangles = 0;
+	for (size_t t = 0; t < triangle_count; ++t) {
+		unsigned int p0 = position_of[triangles[t * 3 + 0]];
+		unsigned int p1 = position_of[triangles[t * 3 + 1]];
+		unsigned int p2 = position_of[triangles[t * 3 + 2]];
+		if (p0 == p1 || p1 == p2 || p0 == p2) {
+			triangle_alive[t] = false;
+			continue;
+		}
+		live_triangles++;
+
+		glm::dvec3 normal = glm::cross(glm::dvec3(positions[p1] - positions[p0]), glm::dvec3(positions[p2] - positions[p0]));
+		double length = glm::length(normal);
+		if (length > 0.0) {
+			normal /= length;
+			double d = -glm::dot(normal, glm::dvec3(positions[p0]));
+			AddPlane(quadrics[p0], normal, d, 1.0);
+			AddPlane(quadrics[p1], normal, d, 1.0);
+			AddPlane(quadrics[p2], normal, d, 1.0);
+		}
+
+		unsigned int corners[3] = { p0, p1, p2 };
+		for (unsigned int e = 0; e < 3; ++e) {
+			unsigned int a = corners[e], b = corners[(e + 1) % 3];
+			edge_uses[((uint64_t)std::min(a, b) << 32) | std::max(a, b)]++;
+			adjacency[corners[e]].push_back((unsigned int)t);
+		}
+	}
+
+	//Borders get a plane perpendicular to their face so they don't shrink
+	const double kBorderWeight = 10.0;
+	for (size_t t = 0; t < triangle_count; ++t) {
+		if (!triangle_alive[t]) { continue; }
+		unsigned int corners[3] = { position_of[triangles[t * 3 + 0]], position_of[triangles[t * 3 + 1]], position_of[triangles[t * 3 + 2]] };
+		glm::dvec3 face_normal = glm::cross(glm::dvec3(positions[corners[1]] - positions[corners[0]]), glm::dvec3(positions[corners[2]] - positions[corners[0]]));
+
+		for (unsigned int e = 0; e < 3; ++e) {
+			unsigned int a = corners[e], b = corners[(e + 1) % 3];
+			if (edge_uses[((uint64_t)std::min(a, b) << 32) | std::max(a, b)] != 1) { continue; }
+
+			glm::dvec3 edge = glm::dvec3(positions[b] - positions[a]);
+			glm::dvec3 normal = glm::cross(edge, face_normal);
+			double length = glm::length(normal);
+			if (length <= 0.0) { continue; }
+			normal /= length;
+			double d = -glm::dot(normal, glm::dvec3(positions[a]));
+			AddPlane(quadrics[a], normal, d, kBorderWeight);
+			AddPlane(quadrics[b], normal, d, kBorderWeight);
+		}
+	}
+
+	std::vector<unsigned int> version(position_count, 0);
+	std::vector<bool> position_alive(position_count, true);
+	std::vector<Collapse> queue;
+
+	auto push_edge = [&](unsigned int a, unsigned int b) {
+		Quadric q = quadrics[a];
+		AddQuadric(q, quadrics[b]);
+		double cost_ab = EvaluateQuadric(q, positions[b]);
+		double cost_ba = EvaluateQuadric(q, positions[a]);
+		if (cost_ba < cost_ab) { std::swap(a, b); cost_ab = cost_ba; }
+		queue.push_back({ cost_ab, a, b, version[a], version[b] });
+		std::push_heap(queue.begin(), queue.end());
+	};
+
+	for (size_t t = 0; t < triangle_count; ++t) {
+		if (!triangle_alive[t]) { continue; }
+		for (unsigned int e = 0; e < 3; ++e) {
+			unsigned int a = position_of[triangles[t * 3 + e]];
+			unsigned int b = position_of[triangles[t * 3 + (e + 1) % 3]];
+			if (a < b) { push_edge(a, b); }
+		}
+	}
+
+	double error = 0.0;
+	std::unordered_map<unsigned int, unsigned int> wedge_map;
+
+	while (!queue.empty() && live_triangles * 3 > target_index_count) {
+		std::pop_heap(queue.begin(), queue.end());
+		Collapse c = queue.back();
+		queue.pop_back();
+
+		if (!position_alive[c.from_] || !position_alive[c.to_]) { continue; }
+		if (version[c.from_] != c.from_version_ || version[c.to_] != c.to_version_) { continue; }
+		if (c.cost_ > max_cost) { break; }
+
+		//Reject the collapse if any remaining triangle would flip
+		bool flips = false;
+		for (size_t i = 0; !flips && i < adjacency[c.from_].size(); ++i) {
+			unsigned int t = adjacency[c.from_][i];
+			if (!triangle_alive[t]) { continue; }
+
+			glm::vec3 p[3];
+			bool has_to = false;
+			for (unsigned int k = 0; k < 3; ++k) {
+				unsigned int pos = position_of[triangles[t * 3 + k]];
+				has_to = has_to || pos == c.to_;
+				p[k] = positions[pos];
+			}
+			if (has_to) { continue; }
+
+			glm::vec3 old_normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+			for (unsigned int k = 0; k < 3; ++k) {
+				if (position_of[triangles[t * 3 + k]] == c.from_) { p[k] = positions[c.to_]; }
+			}
+			glm::vec3 new_normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+			if (glm::dot(old_normal, new_normal) <= 0.0f) { flips = true; }
+		}
+		if (flips) { continue; }
+
+		//Triangles on the edge disappear, and tell which vertex of the destination replaces each one of the source
+		wedge_map.clear();
+		for (size_t i = 0; i < adjacency[c.from_].size(); ++i) {
+			unsigned int t = adjacency[c.from_][i];
+			if (!triangle_alive[t]) { continue; }
+
+			unsigned int from_vertex = 0, to_vertex = 0;
+			bool has_to = false;
+			for (unsigned int k = 0; k < 3; ++k) {
+				unsigned int v = triangles[t * 3 + k];
+				if (position_of[v] == c.from_) { from_vertex = v; }
+				if (position_of[v] == c.to_) { to_vertex = v; has_to = true; }
+			}
+			if (has_to) {
+				wedge_map.try_emplace(from_vertex, to_vertex);
+				triangle_alive[t] = false;
+				live_triangles--;
+			}
+		}
+
+		//Move the rest of the triangles to the destination
+		for (size_t i = 0; i < adjacency[c.from_].size(); ++i) {
+			unsigned int t = adjacency[c.from_][i];
+			if (!triangle_alive[t]) { continue; }
+
+			for (unsigned int k = 0; k < 3; ++k) {
+				unsigned int v = triangles[t * 3 + k];
+				if (position_of[v] != c.from_) { continue; }
+
+				auto mapped = wedge_map.find(v);
+				if (mapped == wedge_map.end()) {
+					//Keep the attributes as close as possible
+					unsigned int best = wedges[c.to_][0];
+					float best_score = -1e30f;
+					for (size_t w = 0; w < wedges[c.to_].size(); ++w) {
+						const Vertex& candidate = vertices[wedges[c.to_][w]];
+						float score = glm::dot(candidate.normal_, vertices[v].normal_) - glm::length(candidate.uv_ - vertices[v].uv_);
+						if (score > best_score) {
+							best_score = score;
+							best = wedges[c.to_][w];
+						}
+					}
+					mapped = wedge_map.try_emplace(v, best).first;
+				}
+				triangles[t * 3 + k] = mapped->second;
+			}
+			adjacency[c.to_].push_back(t);
+		}
+
+		position_alive[c.from_] = false;
+		adjacency[c.from_].clear();
+		AddQuadric(quadrics[c.to_], quadrics[c.from_]);
+		version[c.to_]++;
+		error = std::max(error, c.cost_);
+
+		//The cost of every edge around the destination has changed
+		for (size_t i = 0; i < adjacency[c.to_].size(); ++i) {
+			unsigned int t = adjacency[c.to_][i];
+			if (!triangle_alive[t]) { continue; }
+			for (unsigned int k = 0; k < 3; ++k) {
+				unsigned int pos = position_of[triangles[t * 3 + k]];
+				if (pos != c.to_) { push_edge(pos, c.to_); }
+			}
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(live_triangles * 3);
+	for (size_t t = 0; t < triangle_count; ++t) {
+		if (!triangle_alive[t]) { continue; }
+		result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+	}
+
+	if (result_error != nullptr) { *result_error = (float)(std::sqrt(error) / extent); }
+	return result;
+}
+
+//Computes the bounding sphere and the normal cone of the triangles of a meshlet
+static void ComputeMeshletBounds(Meshlet& meshlet, const std::vector<unsigned int>& indexes, const std::vector<Vertex>& vertices) {
+	const unsigned int* first = indexes.data() + meshlet.index_offset_;
+
+	glm::vec3 bounds_min = vertices[first[0]].position_;
+	glm::vec3 bounds_max = bounds_min;
+	for (unsigned int i = 1; i < meshlet.index_count_; ++i) {
+		bounds_min = glm::min(bounds_min, vertices[first[i]].position_);
+		bounds_max = glm::max(bounds_max, vertices[first[i]].position_);
+	}
+
+	glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+	float radius_squared = 0.0f;
+	for (unsigned int i = 0; i < meshlet.index_count_; ++i) {
+		glm::vec3 offset = vertices[first[i]].position_ - center;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+
+	//Each triangle counts the same, big ones shouldn't hide the directions of the small ones
+	glm::vec3 axis(0.0f);
+	for (unsigned int i = 0; i < meshlet.index_count_; i += 3) {
+		glm::vec3 normal = glm::cross(vertices[first[i + 1]].position_ - vertices[first[i]].position_,
+			vertices[first[i + 2]].position_ - vertices[first[i]].position_);
+		float length = glm::length(normal);
+		if (length > 0.0f) { axis += normal / length; }
+	}
+
+	float cutoff = 1.0f;
+	float axis_length = glm::length(axis);
+	if (axis_length > 0.0f) {
+		axis /= axis_length;
+
+		float min_dot = 1.0f;
+		for (unsigned int i = 0; i < meshlet.index_count_; i += 3) {
+			glm::vec3 normal = glm::cross(vertices[first[i + 1]].position_ - vertices[first[i]].position_,
+				vertices[first[i + 2]].position_ - vertices[first[i]].position_);
+			float length = glm::length(normal);
+			if (length > 0.0f) { min_dot = std::min(min_dot, glm::dot(normal / length, axis)); }
+		}
+
+		//Past 84 degrees the cone is too wide to ever cull anything
+		if (min_dot > 0.1f) { cutoff = sqrtf(1.0f - min_dot * min_dot); }
+	}
+
+	memcpy(meshlet.center_, &center, sizeof(meshlet.center_));
+	meshlet.radius_ = sqrtf(radius_squared);
+	memcpy(meshlet.cone_axis_, &axis, sizeof(meshlet.cone_axis_));
+	meshlet.cone_cutoff_ = cutoff;
+}
+
+std::vector<Meshlet> BuildMeshlets(const std::vector<unsigned int>& indexes, size_t index_count, const std::vector<Vertex>& vertices,
+	unsigned int max_vertices, unsigned int max_triangles) {
+
+	std::vector<Meshlet> meshlets;
+	if (index_count < 3 || vertices.empty()) { return meshlets; }
+
+	//Meshlet that last used each vertex, to count the unique ones without clearing anything
+	const unsigned int kUnused = 0xFFFFFFFF;
+	std::vector<unsigned int> used_by(vertices.size(), kUnused);
+
+	Meshlet current = {};
+	unsigned int vertex_count = 0;
+
+	for (size_t t = 0; t + 2 < index_count; t += 3) {
+		unsigned int id = (unsigned int)meshlets.size();
+		unsigned int new_vertices = 0;
+		for (unsigned int k = 0; k < 3; ++k) {
+			unsigned int v = indexes[t + k];
+			bool repeated = used_by[v] == id || (k > 0 && indexes[t] == v) || (k > 1 && indexes[t + 1] == v);
+			if (!repeated) { new_vertices++; }
+		}
+
+		//Close the meshlet if the triangle doesn't fit
+		if (current.index_count_ != 0 &&
+			(vertex_count + new_vertices > max_vertices || current.index_count_ / 3 + 1 > max_triangles)) {
+			ComputeMeshletBounds(current, indexes, vertices);
+			meshlets.push_back(current);
+
+			current = {};
+			current.index_offset_ = (uint32_t)t;
+			vertex_count = 0;
+			id++;
+		}
+
+		for (unsigned int k = 0; k < 3; ++k) {
+			unsigned int v = indexes[t + k];
+			if (used_by[v] != id) {
+				used_by[v] = id;
+				vertex_count++;
+			}
+		}
+		current.index_count_ += 3;
+	}
+
+	ComputeMeshletBounds(current, indexes, vertices);
+	meshlets.push_back(current);
+
+	return meshlets;
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3* view_position) {
+	glm::vec3 center(meshlet.center_[0], meshlet.center_[1], meshlet.center_[2]);
+
+	for (unsigned int i = 0; i < 6; ++i) {
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -meshlet.radius_) { return false; }
+	}
+
+	//Every normal is inside the cone, if the viewer is inside its back side no triangle faces it
+	if (view_position != nullptr && meshlet.cone_cutoff_ < 1.0f) {
+		glm::vec3 axis(meshlet.cone_axis_[0], meshlet.cone_axis_[1], meshlet.cone_axis_[2]);
+		glm::vec3 view = center - *view_position;
+		if (glm::dot(view, axis) >= meshlet.cone_cutoff_ * glm::length(view) + meshlet.radius_) { return false; }
+	}
+
+	return true;
+}
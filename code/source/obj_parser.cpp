@@ -0,0 +1,407 @@
+#include "obj_parser.hpp"
+
+#include <charconv>
+#include <algorithm>
+
+#include <boss.hpp>
+#include <mapped_file.hpp>
+
+/**
+ * @brief Part of the file parsed by a single job
+ */
+struct ObjChunk {
+	/** First character of the chunk, always at the start of a line */
+	const char* begin_;
+	/** One past the last character of the chunk */
+	const char* end_;
+
+	std::vector<float> positions_;
+	std::vector<float> colors_;
+	std::vector<float> normals_;
+	std::vector<float> texcoords_;
+
+	/** Corners of every face, before triangulating them */
+	std::vector<ObjCorner> corners_;
+	/** Number of corners of each face */
+	std::vector<unsigned char> face_sizes_;
+	/** Bit mask per corner of the indexes that are negative, relative to the end of the attributes read so far */
+	std::vector<unsigned char> relative_;
+
+	/** Attributes read by the previous chunks */
+	size_t position_offset_;
+	size_t normal_offset_;
+	size_t texcoord_offset_;
+	/** Position of the triangles of the chunk in the final list of corners */
+	size_t corner_offset_;
+
+	std::string error_;
+};
+
+//Bits of ObjChunk::relative_
+const unsigned char kObjRelativeVertex = 1;
+const unsigned char kObjRelativeNormal = 2;
+const unsigned char kObjRelativeTexcoord = 4;
+
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+static inline const char* SkipSpaces(const char* p, const char* end) {
+	while (p < end && IsSpace(*p)) { ++p; }
+	return p;
+}
+
+//Parses as double and then converts, like tinyobjloader, so the values match
+static bool ParseFloat(const char*& p, const char* end, float& value) {
+	p = SkipSpaces(p, end);
+	if (p < end && *p == '+') { ++p; }
+
+	double parsed;
+	std::from_chars_result result = std::from_chars(p, end, parsed);
+	if (result.ec != std::errc()) { return false; }
+
+	value = (float)parsed;
+	p = result.ptr;
+	return true;
+}
+
+//Parses an OBJ index, 1 based or negative from the end. Returns it 0 based, marking if it's relative
+static bool ParseIndex(const char*& p, const char* end, size_t local_count, int& index, bool& relative) {
+	int parsed;
+	std::from_chars_result result = std::from_chars(p, end, parsed);
+	if (result.ec != std::errc() || parsed == 0) { return false; }
+	p = result.ptr;
+
+	relative = parsed < 0;
+	index = relative ? (int)local_count + parsed : parsed - 1;
+	return true;
+}
+
+static void ParseChunk(ObjChunk& chunk) {
+	const char* p = chunk.begin_;
+	const char* end = chunk.end_;
+
+	while (p < end) {
+		p = SkipSpaces(p, end);
+		const char* line_end = std::find(p, end, '\n');
+
+		if (p + 1 < line_end && p[0] == 'v' && IsSpace(p[1])) {
+			p += 2;
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			ParseFloat(p, line_end, x);
+			ParseFloat(p, line_end, y);
+			ParseFloat(p, line_end, z);
+			chunk.positions_.insert(chunk.positions_.end(), { x, y, z });
+
+			//Same defaults as tinyobjloader when the colors are missing or incomplete
+			float r = 1.0f, g = 1.0f, b = 1.0f;
+			if (ParseFloat(p, line_end, r)) {
+				if (!ParseFloat(p, line_end, g)) { g = 1.0f; b = 1.0f; }
+				else if (!ParseFloat(p, line_end, b)) { r = 1.0f; g = 1.0f; b = 1.0f; }
+			}
+			else { r = 1.0f; }
+			chunk.colors_.insert(chunk.colors_.end(), { r, g, b });
+		}
+		else if (p + 2 < line_end && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+			p += 3;
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			ParseFloat(p, line_end, x);
+			ParseFloat(p, line_end, y);
+			ParseFloat(p, line_end, z);
+			chunk.normals_.insert(chunk.normals_.end(), { x, y, z });
+		}
+		else if (p + 2 < line_end && p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) {
+			p += 3;
+			float u = 0.0f, v = 0.0f;
+			ParseFloat(p, line_end, u);
+			ParseFloat(p, line_end, v);
+			chunk.texcoords_.insert(chunk.texcoords_.end(), { u, v });
+		}
+		else if (p + 1 < line_end && p[0] == 'f' && IsSpace(p[1])) {
+			p += 2;
+			unsigned int count = 0;
+
+			while (true) {
+				p = SkipSpaces(p, line_end);
+				if (p >= line_end || *p == '\r') { break; }
+
+				ObjCorner corner = { -1, -1, -1 };
+				unsigned char relative_mask = 0;
+				bool relative = false;
+
+				if (!ParseIndex(p, line_end, chunk.positions_.size() / 3, corner.vertex_index, relative)) {
+					chunk.error_ = "Failed parsing face";
+					return;
+				}
+				if (relative) { relative_mask |= kObjRelativeVertex; }
+
+				if (p < line_end && *p == '/') {
+					++p;
+					if (p < line_end && *p != '/') {
+						if (!ParseIndex(p, line_end, chunk.texcoords_.size() / 2, corner.texcoord_index, relative)) {
+							chunk.error_ = "Failed parsing face";
+							return;
+						}
+						if (relative) { relative_mask |= kObjRelativeTexcoord; }
+					}
+					if (p < line_end && *p == '/') {
+						++p;
+						if (!ParseIndex(p, line_end, chunk.normals_.size() / 3, corner.normal_index, relative)) {
+							chunk.error_ = "Failed parsing face";
+							return;
+						}
+						if (relative) { relative_mask |= kObjRelativeNormal; }
+					}
+				}
+
+				//Only keep track of relative indexes once one shows up
+				if (relative_mask != 0 && chunk.relative_.size() < chunk.corners_.size()) {
+					chunk.relative_.resize(chunk.corners_.size(), 0);
+				}
+				if (!chunk.relative_.empty() || relative_mask != 0) { chunk.relative_.push_back(relative_mask); }
+
+				chunk.corners_.push_back(corner);
+				count++;
+			}
+
+			//Triangles and quads are triangulated here, bigger polygons are left to tinyobjloader
+			if (count > 4) {
+				chunk.error_ = "Polygons with more than 4 vertices are not supported";
+				return;
+			}
+			chunk.face_sizes_.push_back((unsigned char)count);
+		}
+
+		p = line_end + 1;
+	}
+}
+
+//Turns the indexes of the chunk into indexes of the whole file and triangulates the faces
+static void ResolveChunk(ObjChunk& chunk, ObjData& out) {
+	const size_t position_count = out.positions_.size() / 3;
+	const size_t normal_count = out.normals_.size() / 3;
+	const size_t texcoord_count = out.texcoords_.size() / 2;
+
+	for (size_t i = 0; i < chunk.corners_.size(); ++i) {
+		ObjCorner& c = chunk.corners_[i];
+		unsigned char mask = i < chunk.relative_.size() ? chunk.relative_[i] : 0;
+
+		if (mask & kObjRelativeVertex) { c.vertex_index += (int)chunk.position_offset_; }
+		if (mask & kObjRelativeNormal) { c.normal_index += (int)chunk.normal_offset_; }
+		if (mask & kObjRelativeTexcoord) { c.texcoord_index += (int)chunk.texcoord_offset_; }
+
+		if (c.vertex_index < 0 || (size_t)c.vertex_index >= position_count ||
+			c.normal_index >= (int)normal_count || c.texcoord_index >= (int)texcoord_count ||
+			((mask & kObjRelativeNormal) && c.normal_index < 0) || ((mask & kObjRelativeTexcoord) && c.texcoord_index < 0)) {
+			chunk.error_ = "Face index out of range";
+			return;
+		}
+	}
+
+	ObjCorner* triangles = out.corners_.data() + chunk.corner_offset_;
+	const ObjCorner* face = chunk.corners_.data();
+	const float* v = out.positions_.data();
+
+	for (size_t f = 0; f < chunk.face_sizes_.size(); ++f) {
+		unsigned int size = chunk.face_sizes_[f];
+
+		if (size == 3) {
+			*triangles++ = face[0];
+			*triangles++ = face[1];
+			*triangles++ = face[2];
+		}
+		else if (size == 4) {
+			//Split by the shortest diagonal, exactly like tinyobjloader
+			const float* v0 = v + face[0].vertex_index * 3;
+			const float* v1 = v + face[1].vertex_index * 3;
+			const float* v2 = v + face[2].vertex_index * 3;
+			const float* v3 = v + face[3].vertex_index * 3;
+
+			float e02x = v2[0] - v0[0];
+			float e02y = v2[1] - v0[1];
+			float e02z = v2[2] - v0[2];
+			float e13x = v3[0] - v1[0];
+			float e13y = v3[1] - v1[1];
+			float e13z = v3[2] - v1[2];
+
+			float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+			float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+			if (sqr02 < sqr13) {
+				// [0, 1, 2], [0, 2, 3]
+				*triangles++ = face[0];
+				*triangles++ = face[1];
+				*triangles++ = face[2];
+				*triangles++ = face[0];
+				*triangles++ = face[2];
+				*triangles++ = face[3];
+			}
+			else {
+				// [0, 1, 3], [1, 2, 3]
+				*triangles++ = face[0];
+				*triangles++ = face[1];
+				*triangles++ = face[3];
+				*triangles++ = face[1];
+				*triangles++ = face[2];
+				*triangles++ = face[3];
+			}
+		}
+		//Less than 3 vertices are degenerated faces, skipped
+
+		face += size;
+	}
+}
+
+//Runs a function for every chunk, on the workers if there's a boss
+template<typename F>
+static void ForEachChunk(Boss* boss, std::vector<ObjChunk>& chunks, F&& function) {
+	if (boss == nullptr || chunks.size() == 1) {
+		for (size_t i = 0; i < chunks.size(); ++i) { function(chunks[i]); }
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		ObjChunk* chunk = &chunks[i];
+		boss->run([&function, chunk]() { function(*chunk); }, &counter);
+	}
+	boss->wait(&counter);
+}
+
+//Returns the first error of the chunks, if any
+static bool CheckChunks(const std::vector<ObjChunk>& chunks, std::string& error) {
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		if (!chunks[i].error_.empty()) {
+			error = chunks[i].error_;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ParseObj(const std::string& filepath, Boss* boss, ObjData& out, std::string& error) {
+	MappedFile file;
+	if (!file.Open(filepath)) {
+		error = "Couldn't open " + filepath;
+		return false;
+	}
+
+	const char* data = (const char*)file.data();
+	const char* data_end = data + file.size();
+
+	//Split in line aligned chunks, a few per thread so they are balanced
+	size_t chunk_count = 1;
+	if (boss != nullptr) {
+		size_t max_chunks = ((size_t)boss->get_worker_count() + 1) * 4;
+		chunk_count = std::clamp(file.size() / kObjParserMinChunkSize, (size_t)1, max_chunks);
+	}
+
+	std::vector<ObjChunk> chunks(chunk_count);
+	const char* chunk_begin = data;
+	for (size_t i = 0; i < chunk_count; ++i) {
+		const char* chunk_end = data_end;
+		if (i + 1 < chunk_count) {
+			chunk_end = std::max(chunk_begin, data + file.size() * (i + 1) / chunk_count);
+			chunk_end = std::find(chunk_end, data_end, '\n');
+			if (chunk_end != data_end) { ++chunk_end; }
+		}
+		chunks[i].begin_ = chunk_begin;
+		chunks[i].end_ = chunk_end;
+		chunk_begin = chunk_end;
+	}
+
+	ForEachChunk(boss, chunks, [](ObjChunk& chunk) { ParseChunk(chunk); });
+	if (!CheckChunks(chunks, error)) { return false; }
+
+	//Every chunk knows where its data goes once the previous ones have been counted
+	size_t positions = 0, normals = 0, texcoords = 0, corners = 0;
+	for (size_t i = 0; i < chunk_count; ++i) {
+		ObjChunk& chunk = chunks[i];
+		chunk.position_offset_ = positions / 3;
+		chunk.normal_offset_ = normals / 3;
+		chunk.texcoord_offset_ = texcoords / 2;
+		chunk.corner_offset_ = corners;
+
+		positions += chunk.positions_.size();
+		normals += chunk.normals_.size();
+		texcoords += chunk.texcoords_.size();
+		for (size_t f = 0; f < chunk.face_sizes_.size(); ++f) {
+			unsigned int size = chunk.face_sizes_[f];
+			corners += size == 3 ? 3 : (size == 4 ? 6 : 0);
+		}
+	}
+
+	out.positions_.resize(positions);
+	out.colors_.resize(positions);
+	out.normals_.resize(normals);
+	out.texcoords_.resize(texcoords);
+	out.corners_.resize(corners);
+
+	//Stitch the attributes together, and then triangulate with the final indexes
+	ForEachChunk(boss, chunks, [&out](ObjChunk& chunk) {
+		std::copy(chunk.positions_.begin(), chunk.positions_.end(), out.positions_.begin() + chunk.position_offset_ * 3);
+		std::copy(chunk.colors_.begin(), chunk.colors_.end(), out.colors_.begin() + chunk.position_offset_ * 3);
+		std::copy(chunk.normals_.begin(), chunk.normals_.end(), out.normals_.begin() + chunk.normal_offset_ * 3);
+		std::copy(chunk.texcoords_.begin(), chunk.texcoords_.end(), out.texcoords_.begin() + chunk.texcoord_offset_ * 2);
+	});
+
+	ForEachChunk(boss, chunks, [&out](ObjChunk& chunk) { ResolveChunk(chunk, out); });
+	if (!CheckChunks(chunks, error)) { return false; }
+
+	return true;
+}
+
+ObjStream::ObjStream() {
+	cursor_ = 0;
+}
+
+bool ObjStream::Open(const std::string& filepath, std::string& error) {
+	cursor_ = 0;
+	data_ = ObjData();
+	if (!file_.Open(filepath)) {
+		error = "Couldn't open " + filepath;
+		return false;
+	}
+	return true;
+}
+
+bool ObjStream::ReadNext(std::string& error, size_t window_size) {
+	const char* data = (const char*)file_.data();
+	const char* data_end = data + file_.size();
+
+	ObjChunk chunk;
+	chunk.begin_ = data + cursor_;
+	chunk.end_ = std::find(chunk.begin_ + std::min(window_size, (size_t)(data_end - chunk.begin_)), data_end, '\n');
+	if (chunk.end_ != data_end) { ++chunk.end_; }
+	cursor_ = chunk.end_ - data;
+
+	ParseChunk(chunk);
+	if (!chunk.error_.empty()) {
+		error = chunk.error_;
+		return false;
+	}
+
+	//The window goes after everything read before it, and its triangles replace the previous ones
+	chunk.position_offset_ = data_.positions_.size() / 3;
+	chunk.normal_offset_ = data_.normals_.size() / 3;
+	chunk.texcoord_offset_ = data_.texcoords_.size() / 2;
+	chunk.corner_offset_ = 0;
+
+	data_.positions_.insert(data_.positions_.end(), chunk.positions_.begin(), chunk.positions_.end());
+	data_.colors_.insert(data_.colors_.end(), chunk.colors_.begin(), chunk.colors_.end());
+	data_.normals_.insert(data_.normals_.end(), chunk.normals_.begin(), chunk.normals_.end());
+	data_.texcoords_.insert(data_.texcoords_.end(), chunk.texcoords_.begin(), chunk.texcoords_.end());
+
+	size_t corners = 0;
+	for (size_t f = 0; f < chunk.face_sizes_.size(); ++f) {
+		unsigned int size = chunk.face_sizes_[f];
+		corners += size == 3 ? 3 : (size == 4 ? 6 : 0);
+	}
+	data_.corners_.resize(corners);
+
+	ResolveChunk(chunk, data_);
+	if (!chunk.error_.empty()) {
+		error = chunk.error_;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,251 @@
+#include <occlusion_culling.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define EVE_OCCLUSION_SSE	1
+#endif
+
+//Smallest w a vertex in front of the camera can have
+static const float kOcclusionMinW = 1e-6f;
+
+OcclusionBuffer::OcclusionBuffer(unsigned int width, unsigned int height) {
+	//The rows are drawn four pixels at a time without looking at the edge
+	width_ = (std::max(width, 4u) + 3u) & ~3u;
+	height_ = std::max(height, 1u);
+	view_projection_ = glm::mat4(1.0f);
+	triangle_count_ = 0;
+
+	size_t size = 0;
+	unsigned int level_width = width_;
+	unsigned int level_height = height_;
+	while (true) {
+		levels_.push_back({ size, level_width, level_height });
+		size += (size_t)level_width * level_height;
+		if (level_width == 1 && level_height == 1) { break; }
+		level_width = (level_width + 1) / 2;
+		level_height = (level_height + 1) / 2;
+	}
+	pyramid_.resize(size, 1.0f);
+}
+
+void OcclusionBuffer::Clear(const glm::mat4& view_projection) {
+	view_projection_ = view_projection;
+	triangle_count_ = 0;
+	std::fill(pyramid_.begin(), pyramid_.end(), 1.0f);
+}
+
+void OcclusionBuffer::DrawOccluder(const glm::vec3* positions, size_t vertex_count, const uint32_t* indexes, size_t index_count, const glm::mat4& transform) {
+	glm::mat4 mvp = view_projection_ * transform;
+	clip_positions_.resize(vertex_count);
+	for (size_t i = 0; i < vertex_count; ++i) {
+		clip_positions_[i] = mvp * glm::vec4(positions[i], 1.0f);
+	}
+
+	for (size_t i = 0; i + 2 < index_count; i += 3) {
+		if (indexes[i] >= vertex_count || indexes[i + 1] >= vertex_count || indexes[i + 2] >= vertex_count) { continue; }
+		const glm::vec4* triangle[3] = { &clip_positions_[indexes[i]], &clip_positions_[indexes[i + 1]], &clip_positions_[indexes[i + 2]] };
+
+		unsigned int inside = 0;
+		for (unsigned int v = 0; v < 3; ++v) {
+			if (triangle[v]->z >= -triangle[v]->w) { ++inside; }
+		}
+		if (inside == 0) { continue; }
+		if (inside == 3) {
+			RasterizeTriangle(*triangle[0], *triangle[1], *triangle[2]);
+			continue;
+		}
+
+		//Crosses the near plane, the part in front of it has three or four corners
+		glm::vec4 polygon[4];
+		unsigned int corner_count = 0;
+		for (unsigned int v = 0; v < 3; ++v) {
+			const glm::vec4& a = *triangle[v];
+			const glm::vec4& b = *triangle[(v + 1) % 3];
+			float da = a.z + a.w;
+			float db = b.z + b.w;
+			if (da >= 0.0f) { polygon[corner_count++] = a; }
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				polygon[corner_count++] = a + (b - a) * (da / (da - db));
+			}
+		}
+		for (unsigned int v = 2; v < corner_count; ++v) {
+			RasterizeTriangle(polygon[0], polygon[v - 1], polygon[v]);
+		}
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	if (a.w <= kOcclusionMinW || b.w <= kOcclusionMinW || c.w <= kOcclusionMinW) { return; }
+
+	//To pixels, with the depth from 0 at the near plane to 1 at the far one
+	glm::vec3 screen[3];
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	for (unsigned int v = 0; v < 3; ++v) {
+		float inv_w = 1.0f / clip[v]->w;
+		screen[v].x = (clip[v]->x * inv_w * 0.5f + 0.5f) * (float)width_;
+		screen[v].y = (clip[v]->y * inv_w * 0.5f + 0.5f) * (float)height_;
+		screen[v].z = clip[v]->z * inv_w * 0.5f + 0.5f;
+	}
+
+	//Both sides are drawn, the ones facing away are turned around
+	float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+	if (std::fabs(area) < 1e-8f) { return; }
+	if (area < 0.0f) {
+		std::swap(screen[1], screen[2]);
+		area = -area;
+	}
+
+	int min_x = std::max((int)std::floor(std::min({ screen[0].x, screen[1].x, screen[2].x })), 0);
+	int max_x = std::min((int)std::ceil(std::max({ screen[0].x, screen[1].x, screen[2].x })), (int)width_ - 1);
+	int min_y = std::max((int)std::floor(std::min({ screen[0].y, screen[1].y, screen[2].y })), 0);
+	int max_y = std::min((int)std::ceil(std::max({ screen[0].y, screen[1].y, screen[2].y })), (int)height_ - 1);
+	if (min_x > max_x || min_y > max_y) { return; }
+	++triangle_count_;
+
+	//Edge functions a * x + b * y + c, not negative on the inner side of each edge
+	float edge_a[3], edge_b[3], edge_c[3];
+	for (unsigned int e = 0; e < 3; ++e) {
+		const glm::vec3& from = screen[e];
+		const glm::vec3& to = screen[(e + 1) % 3];
+		edge_a[e] = from.y - to.y;
+		edge_b[e] = to.x - from.x;
+		edge_c[e] = -(edge_a[e] * from.x + edge_b[e] * from.y);
+	}
+
+	//Depth is linear on the screen after the divide
+	float dx1 = screen[1].x - screen[0].x, dy1 = screen[1].y - screen[0].y, dz1 = screen[1].z - screen[0].z;
+	float dx2 = screen[2].x - screen[0].x, dy2 = screen[2].y - screen[0].y, dz2 = screen[2].z - screen[0].z;
+	float depth_a = (dz1 * dy2 - dz2 * dy1) / area;
+	float depth_b = (dz2 * dx1 - dz1 * dx2) / area;
+	float depth_c = screen[0].z - depth_a * screen[0].x - depth_b * screen[0].y;
+
+	float* depth = pyramid_.data();
+
+#ifdef EVE_OCCLUSION_SSE
+	int first_x = min_x & ~3;
+	__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 zero = _mm_setzero_ps();
+	for (int y = min_y; y <= max_y; ++y) {
+		float center_y = (float)y + 0.5f;
+		__m128 row_edge0 = _mm_set1_ps(edge_b[0] * center_y + edge_c[0]);
+		__m128 row_edge1 = _mm_set1_ps(edge_b[1] * center_y + edge_c[1]);
+		__m128 row_edge2 = _mm_set1_ps(edge_b[2] * center_y + edge_c[2]);
+		__m128 row_depth = _mm_set1_ps(depth_b * center_y + depth_c);
+		float* row = depth + (size_t)y * width_;
+
+		for (int x = first_x; x <= max_x; x += 4) {
+			__m128 center_x = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge_a[0]), center_x), row_edge0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge_a[1]), center_x), row_edge1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge_a[2]), center_x), row_edge2);
+			__m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(mask) == 0) { continue; }
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depth_a), center_x), row_depth);
+			__m128 old_z = _mm_loadu_ps(row + x);
+			__m128 new_z = _mm_min_ps(old_z, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, new_z), _mm_andnot_ps(mask, old_z)));
+		}
+	}
+#else
+	for (int y = min_y; y <= max_y; ++y) {
+		float center_y = (float)y + 0.5f;
+		float* row = depth + (size_t)y * width_;
+		for (int x = min_x; x <= max_x; ++x) {
+			float center_x = (float)x + 0.5f;
+			if (edge_a[0] * center_x + edge_b[0] * center_y + edge_c[0] < 0.0f) { continue; }
+			if (edge_a[1] * center_x + edge_b[1] * center_y + edge_c[1] < 0.0f) { continue; }
+			if (edge_a[2] * center_x + edge_b[2] * center_y + edge_c[2] < 0.0f) { continue; }
+			float z = depth_a * center_x + depth_b * center_y + depth_c;
+			row[x] = std::min(row[x], z);
+		}
+	}
+#endif
+}
+
+void OcclusionBuffer::BuildPyramid() {
+	for (size_t l = 1; l < levels_.size(); ++l) {
+		const Level& below = levels_[l - 1];
+		const Level& level = levels_[l];
+		const float* src = pyramid_.data() + below.offset_;
+		float* dst = pyramid_.data() + level.offset_;
+
+#ifdef EVE_OCCLUSION_SSE
+		if ((below.width_ & 7) == 0 && (below.height_ & 1) == 0) {
+			for (unsigned int y = 0; y < level.height_; ++y) {
+				const float* row0 = src + (size_t)(y * 2) * below.width_;
+				const float* row1 = row0 + below.width_;
+				for (unsigned int x = 0; x < level.width_; x += 4) {
+					__m128 left = _mm_max_ps(_mm_loadu_ps(row0 + x * 2), _mm_loadu_ps(row1 + x * 2));
+					__m128 right = _mm_max_ps(_mm_loadu_ps(row0 + x * 2 + 4), _mm_loadu_ps(row1 + x * 2 + 4));
+					__m128 even = _mm_shuffle_ps(left, right, _MM_SHUFFLE(2, 0, 2, 0));
+					__m128 odd = _mm_shuffle_ps(left, right, _MM_SHUFFLE(3, 1, 3, 1));
+					_mm_storeu_ps(dst + (size_t)y * level.width_ + x, _mm_max_ps(even, odd));
+				}
+			}
+			continue;
+		}
+#endif
+
+		//Odd sizes, the last texel covers only what's left below it
+		for (unsigned int y = 0; y < level.height_; ++y) {
+			unsigned int y0 = y * 2;
+			unsigned int y1 = std::min(y0 + 1, below.height_ - 1);
+			for (unsigned int x = 0; x < level.width_; ++x) {
+				unsigned int x0 = x * 2;
+				unsigned int x1 = std::min(x0 + 1, below.width_ - 1);
+				float far_z = std::max(std::max(src[(size_t)y0 * below.width_ + x0], src[(size_t)y0 * below.width_ + x1]),
+					std::max(src[(size_t)y1 * below.width_ + x0], src[(size_t)y1 * below.width_ + x1]));
+				dst[(size_t)y * level.width_ + x] = far_z;
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const glm::vec3& bounds_min, const glm::vec3& bounds_max) const {
+	float min_x = (float)width_, max_x = 0.0f;
+	float min_y = (float)height_, max_y = 0.0f;
+	float near_z = 1.0f;
+	for (unsigned int i = 0; i < 8; ++i) {
+		glm::vec4 corner((i & 1) ? bounds_max.x : bounds_min.x, (i & 2) ? bounds_max.y : bounds_min.y, (i & 4) ? bounds_max.z : bounds_min.z, 1.0f);
+		glm::vec4 clip = view_projection_ * corner;
+		//Crossing the near plane it covers the screen as far as we know
+		if (clip.w <= kOcclusionMinW || clip.z < -clip.w) { return true; }
+
+		float inv_w = 1.0f / clip.w;
+		float x = (clip.x * inv_w * 0.5f + 0.5f) * (float)width_;
+		float y = (clip.y * inv_w * 0.5f + 0.5f) * (float)height_;
+		min_x = std::min(min_x, x);
+		max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y);
+		max_y = std::max(max_y, y);
+		near_z = std::min(near_z, clip.z * inv_w * 0.5f + 0.5f);
+	}
+
+	//Off the screen is for the frustum to decide
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= (float)width_ || min_y >= (float)height_) { return true; }
+
+	unsigned int x0 = (unsigned int)std::clamp((int)std::floor(min_x), 0, (int)width_ - 1);
+	unsigned int x1 = (unsigned int)std::clamp((int)std::floor(max_x), 0, (int)width_ - 1);
+	unsigned int y0 = (unsigned int)std::clamp((int)std::floor(min_y), 0, (int)height_ - 1);
+	unsigned int y1 = (unsigned int)std::clamp((int)std::floor(max_y), 0, (int)height_ - 1);
+
+	size_t l = 0;
+	while (l + 1 < levels_.size() &&
+		((x1 >> l) - (x0 >> l) >= kOcclusionTestTexels || (y1 >> l) - (y0 >> l) >= kOcclusionTestTexels)) {
+		++l;
+	}
+
+	const Level& level = levels_[l];
+	const float* texels = pyramid_.data() + level.offset_;
+	for (unsigned int y = y0 >> l; y <= (y1 >> l); ++y) {
+		for (unsigned int x = x0 >> l; x <= (x1 >> l); ++x) {
+			if (texels[(size_t)y * level.width_ + x] >= near_z) { return true; }
+		}
+	}
+
+	return false;
+}
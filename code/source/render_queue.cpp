@@ -0,0 +1,68 @@
+#include <render_queue.hpp>
+
+#include <algorithm>
+
+//Takes the lowest bits of a field and moves it to its place in the key
+static uint64_t KeyField(uint64_t value, unsigned int bits, unsigned int shift) {
+	return (value & ((1ull << bits) - 1ull)) << shift;
+}
+
+uint64_t MakeRenderKey(RenderPass pass, uint32_t program, uint32_t cull, uint32_t material, uint32_t mesh, float distance) {
+	const unsigned int depth_shift = 0;
+	const unsigned int mesh_shift = depth_shift + kRenderKeyDepthBits;
+	const unsigned int material_shift = mesh_shift + kRenderKeyMeshBits;
+	const unsigned int cull_shift = material_shift + kRenderKeyMaterialBits;
+	const unsigned int program_shift = cull_shift + kRenderKeyCullBits;
+	const unsigned int pass_shift = program_shift + kRenderKeyProgramBits;
+
+	//Any distance fits, the far ones share the last values
+	float depth = std::max(distance, 0.0f);
+	depth = depth / (depth + kRenderKeyDepthScale);
+	uint64_t depth_max = (1ull << kRenderKeyDepthBits) - 1ull;
+	uint64_t depth_bits = std::min((uint64_t)(depth * (float)depth_max), depth_max);
+
+	return KeyField((uint64_t)pass, kRenderKeyPassBits, pass_shift) |
+		KeyField(program, kRenderKeyProgramBits, program_shift) |
+		KeyField(cull, kRenderKeyCullBits, cull_shift) |
+		KeyField(material, kRenderKeyMaterialBits, material_shift) |
+		KeyField(mesh, kRenderKeyMeshBits, mesh_shift) |
+		depth_bits;
+}
+
+void RenderQueue::Sort() {
+	size_t count = packets_.size();
+	if (count < 2) { return; }
+
+	//Every histogram in one walk, a byte is only sorted if the keys don't all have the same
+	size_t histograms[8][256] = {};
+	for (const RenderPacket& packet : packets_) {
+		for (unsigned int byte = 0; byte < 8; ++byte) {
+			++histograms[byte][(packet.key_ >> (byte * 8)) & 0xFF];
+		}
+	}
+
+	scratch_.resize(count);
+	for (unsigned int byte = 0; byte < 8; ++byte) {
+		size_t* histogram = histograms[byte];
+		if (histogram[(packets_[0].key_ >> (byte * 8)) & 0xFF] == count) { continue; }
+
+		size_t offset = 0;
+		for (unsigned int digit = 0; digit < 256; ++digit) {
+			size_t digit_count = histogram[digit];
+			histogram[digit] = offset;
+			offset += digit_count;
+		}
+
+		for (const RenderPacket& packet : packets_) {
+			scratch_[histogram[(packet.key_ >> (byte * 8)) & 0xFF]++] = packet;
+		}
+		packets_.swap(scratch_);
+	}
+}
+
+void RenderQueue::GetItems(std::vector<uint32_t>* items) const {
+	items->resize(packets_.size());
+	for (size_t i = 0; i < packets_.size(); ++i) {
+		(*items)[i] = packets_[i].item_;
+	}
+}
@@ -130,6 +130,8 @@ void RenderSystemDirectX11::Render(ComponentManager* comp){
   ObjectLightInteraction o;
   o.viewPos = c->position_;
 
+  select_lods(comp, c);
+
   g_pd3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
   unsigned int stride = sizeof(Vertex);
@@ -205,7 +207,8 @@ void RenderSystemDirectX11::Render(ComponentManager* comp){
                   }
 
                   //Draw the mesh
-                  g_pd3dDeviceContext->DrawIndexed((UINT)r->mesh_->indexes_.size(), 0, 0);
+                  MeshLod lod = r->mesh_->get_lod(r->lod_);
+                  g_pd3dDeviceContext->DrawIndexed((UINT)lod.index_count_, (UINT)lod.index_offset_, 0);
               }
           }
       
@@ -288,7 +291,8 @@ void RenderSystemDirectX11::Render(ComponentManager* comp){
                   }
 
                   //Draw the mesh
-                  g_pd3dDeviceContext->DrawIndexed((UINT)r->mesh_->indexes_.size(), 0, 0);
+                  MeshLod lod = r->mesh_->get_lod(r->lod_);
+                  g_pd3dDeviceContext->DrawIndexed((UINT)lod.index_count_, (UINT)lod.index_offset_, 0);
               }
           }
 
@@ -305,6 +309,47 @@ void RenderSystemDirectX11::Render(ComponentManager* comp){
 
 }
 
+void RenderSystemDirectX11::select_lods(ComponentManager* comp, CameraComponent* cam){
+  static size_t render_hash = typeid(RendererComponent).hash_code();
+  static size_t transf_hash = typeid(TransformComponent).hash_code();
+
+  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
+  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
+  size_t render_size = renderer_components->size();
+  size_t transf_size = transform_components->size();
+
+  //Orthographic projections don't shrink with the distance
+  bool orthographic = cam->projection_[3][3] == 1.0f;
+
+  size_t transform_iterator = 0;
+  for (size_t it = 0; it < render_size; ++it) {
+      size_t id = renderer_components->at(it).entity_id_;
+      RendererComponent* r = &(renderer_components->at(it).data_);
+
+      while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
+          transform_iterator++;
+      }
+
+      if (!r->isInit_ || !r->mesh_->isInit_ || r->mesh_->lods_.size() < 2) { continue; }
+
+      glm::mat4 trans = glm::mat4(1.0f);
+      if (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
+          trans = comp->get_parent_transform_matrix(id);
+      }
+      glm::vec3 center = glm::vec3(trans * glm::vec4((r->mesh_->bounds_min_ + r->mesh_->bounds_max_) * 0.5f, 1.0f));
+      float scale = std::max(glm::length(glm::vec3(trans[0])), std::max(glm::length(glm::vec3(trans[1])), glm::length(glm::vec3(trans[2]))));
+      float radius = r->mesh_->bounds_radius_ * scale;
+
+      //Diameter over the height of the view at that distance, the camera inside the sphere sees it whole
+      float screen_size = radius * cam->projection_[1][1];
+      if (!orthographic) {
+          float distance = glm::length(center - cam->position_);
+          screen_size = distance > radius ? screen_size / distance : 1.0f;
+      }
+      r->SelectLod(screen_size, false);
+  }
+}
+
 void RenderSystemDirectX11::Update(){
   //Update
 
@@ -1070,7 +1115,7 @@ void RenderSystemDirectX11::render_scene_cubemap(ComponentManager* comp){
     glBindBuffer(GL_ARRAY_BUFFER, cubemap->mesh_->virtual_buffer_object_);
     glBindVertexArray(cubemap->mesh_->virtual_array_object_);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubemap->mesh_->index_buffer_object_);
-    glDrawElements(GL_TRIANGLES, (GLsizei)cubemap->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+    glDrawElements(GL_TRIANGLES, (GLsizei)cubemap->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
 
     glDepthFunc(GL_LEQUAL);
 
@@ -1141,7 +1186,7 @@ void RenderSystemDirectX11::render_elements_with_texture(ComponentManager* comp,
       glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
       glBindVertexArray(r->mesh_->virtual_array_object_);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
       //glBindTexture(GL_TEXTURE_2D, 0);
 
     }
@@ -1183,7 +1228,7 @@ void RenderSystemDirectX11::render_elements_depthmap(ComponentManager* comp, Pro
       glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
       glBindVertexArray(r->mesh_->virtual_array_object_);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
 
     }
   }
@@ -1254,7 +1299,7 @@ void RenderSystemDirectX11::render_light_elements(ComponentManager* comp, Progra
         glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
         glBindVertexArray(r->mesh_->virtual_array_object_);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
 
       }
     }
@@ -1331,7 +1376,7 @@ void RenderSystemDirectX11::render_light_elements(ComponentManager* comp, Progra
         glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
         glBindVertexArray(r->mesh_->virtual_array_object_);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
 
       }
     }
@@ -1415,7 +1460,7 @@ void RenderSystemDirectX11::render_light_elements(ComponentManager* comp, Progra
         glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
         glBindVertexArray(r->mesh_->virtual_array_object_);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
 
       }
     }
@@ -1805,7 +1850,7 @@ void RenderSystemDirectX11::DeferredRendering(ComponentManager* comp){
       glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
       glBindVertexArray(r->mesh_->virtual_array_object_);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->index_count_, GL_UNSIGNED_INT, nullptr);
 
     }
   }
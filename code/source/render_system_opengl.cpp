@@ -9,6 +9,11 @@
 
 #ifdef RENDER_OPENGL
 RenderSystemOpenGL::RenderSystemOpenGL(int window_w, int window_h){
+  bounds_tree_ = nullptr;
+  camera_view_ = 0;
+  boss_ = nullptr;
+  sort_draws_ = true;
+
   if (!glfwInit()) {
     exit(EXIT_FAILURE);
   }
@@ -167,6 +172,7 @@ RenderSystemOpenGL::~RenderSystemOpenGL(){
 }
 
 void RenderSystemOpenGL::Render(ComponentManager* comp){
+  render_stats_.Clear();
   //*/
   DeferredRendering(comp);
   /*/
@@ -463,28 +469,49 @@ void RenderSystemOpenGL::render_scene_cubemap(ComponentManager* comp){
       }
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubemap->mesh_->virtual_buffer_object_);
-    glBindVertexArray(cubemap->mesh_->virtual_array_object_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubemap->mesh_->index_buffer_object_);
-    glDrawElements(GL_TRIANGLES, (GLsizei)cubemap->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+    //The sky mesh may not have its buffers yet
+    TinyObj* mesh = cubemap->mesh_.get();
+    if (mesh != nullptr && mesh->isInit_ && mesh->geometry_ != nullptr) {
+      glBindVertexArray(mesh->geometry_->vertex_array_);
+      draw_mesh_lod(mesh, 0);
+    }
 
     glDepthFunc(GL_LEQUAL);
 
   }
 }
 
-void RenderSystemOpenGL::render_elements_with_texture(ComponentManager* comp, Program* prog){
+//Identifies the textures a renderer binds, the layer of a packed texture is a uniform and doesn't count
+static uint64_t MaterialSignature(const RendererComponent* r) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const std::shared_ptr<Texture>& texture : r->textures_) {
+    uint64_t id = 0;
+    if (texture->loaded_) { id = texture->array_ != nullptr ? (1ull << 32) | texture->array_->texture_id_ : texture->texture_id_; }
+    hash = (hash ^ id) * 1099511628211ull;
+  }
+  return hash;
+}
 
+void RenderSystemOpenGL::gather_render_items(ComponentManager* comp){
 
   static size_t render_hash = typeid(RendererComponent).hash_code();
   static size_t transf_hash = typeid(TransformComponent).hash_code();
 
+  comp->UpdateBoundsTree();
+  bounds_tree_ = &comp->bounds_tree_;
+
   std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
   std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
   size_t render_size = renderer_components->size();
   size_t transf_size = transform_components->size();
 
-  unsigned char last_cull = -1;
+  render_items_.clear();
+  visibility_items_.item_of_entity_.assign(comp->num_entities_ + 1, kNoVisibilityItem);
+  visibility_items_.casts_shadows_.clear();
+  material_ids_.clear();
+  mesh_ids_.clear();
+  frame_meshes_.clear();
+
   size_t transform_iterator = 0;
   for (size_t it = 0; it < render_size; it++) {
 
@@ -501,99 +528,353 @@ void RenderSystemOpenGL::render_elements_with_texture(ComponentManager* comp, Pr
       t = &(transform_components->at(transform_iterator).data_);
     }
 
-    //Only draw if the
-    if (r->isInit_ && r->mesh_->isInit_) {
-      glm::mat4 trans = glm::mat4(1.0f);
-      if (nullptr != t) { trans = t->GetTransform(); }
-      prog->SetMat4("transform", (float*)glm::value_ptr(trans));
-      prog->SetBool("needs_light", r->needs_light_);
+    if (!r->isInit_ || !r->mesh_->isInit_) { continue; }
+
+    RenderItem item;
+    item.renderer_ = r;
+    item.transform_ = glm::mat4(1.0f);
+    if (nullptr != t) { item.transform_ = t->GetTransform(); }
+    item.entity_ = id;
+    item.center_ = glm::vec3(item.transform_ * glm::vec4((r->mesh_->bounds_min_ + r->mesh_->bounds_max_) * 0.5f, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(item.transform_[0])), std::max(glm::length(glm::vec3(item.transform_[1])), glm::length(glm::vec3(item.transform_[2]))));
+    item.radius_ = r->mesh_->bounds_radius_ * scale;
+    item.screen_size_ = 0.0f;
+    item.material_id_ = material_ids_.emplace(MaterialSignature(r), (uint32_t)material_ids_.size()).first->second;
+    auto mesh_id = mesh_ids_.emplace(r->mesh_.get(), (uint32_t)frame_meshes_.size());
+    if (mesh_id.second) { frame_meshes_.push_back(r->mesh_.get()); }
+    item.mesh_id_ = mesh_id.first->second;
+
+    if (id < visibility_items_.item_of_entity_.size()) { visibility_items_.item_of_entity_[id] = (uint32_t)render_items_.size(); }
+    visibility_items_.casts_shadows_.push_back(r->casts_shadows_ ? 1 : 0);
+    render_items_.push_back(item);
+  }
 
-      // Activate textures if there are any
-      for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
-        if (r->textures_.at(j)->loaded_) {
-          char source[50] = "0";
-            GLuint textureId = r->textures_.at(j)->texture_id_;
-            glActiveTexture(GL_TEXTURE0 + j);
-            glBindTexture(GL_TEXTURE_2D, textureId);
-            sprintf_s(source, "texture%d", (int)j + 1);
-            prog->SetSampler(source, j);
-        }
-      }
+  //The meshes sharing a vertex array get consecutive indexes, sorting by mesh binds each array once
+  mesh_order_.resize(frame_meshes_.size());
+  for (uint32_t i = 0; i < (uint32_t)mesh_order_.size(); ++i) { mesh_order_[i] = i; }
+  std::sort(mesh_order_.begin(), mesh_order_.end(), [this](uint32_t a, uint32_t b) {
+    GLuint array_a = frame_meshes_[a]->geometry_->vertex_array_;
+    GLuint array_b = frame_meshes_[b]->geometry_->vertex_array_;
+    return array_a != array_b ? array_a < array_b : a < b;
+  });
+  mesh_rank_.resize(mesh_order_.size());
+  for (uint32_t i = 0; i < (uint32_t)mesh_order_.size(); ++i) { mesh_rank_[mesh_order_[i]] = i; }
+  for (RenderItem& item : render_items_) { item.mesh_id_ = mesh_rank_[item.mesh_id_]; }
+}
 
-      //Set the culling method
-      if (r->mesh_->cull_type_ != last_cull) {
-        switch (r->mesh_->cull_type_) {
-        case 0:glCullFace(GL_FRONT); break;
-        case 1:glCullFace(GL_BACK); break;
-        case 2:glCullFace(GL_FRONT_AND_BACK); break;
-        }
+void RenderSystemOpenGL::prepare_visibility(const glm::vec3& cam_position, bool directionals_follow_camera){
+  visibility_.BeginFrame();
+  camera_view_ = visibility_.AddView(&main_view_projection_, 1, false);
+
+  for (size_t i = 0; i < lights_.directional_.size(); ++i) {
+    DirectionalLight* dir = lights_.directional_.at(i).get();
+    if (!dir->visible_) { continue; }
+    if (directionals_follow_camera) {
+      dir->position_ = cam_position;
+      dir->UpdateProjection();
+      dir->UpdateView();
+    }
+    visibility_.AddView(&dir->lightMatrix_, 1, true);
+  }
 
-        last_cull = r->mesh_->cull_type_;
+  for (size_t i = 0; i < lights_.spot_.size(); ++i) {
+    SpotLight* spot = lights_.spot_.at(i).get();
+    if (!spot->visible_) { continue; }
+    spot->UpdateProjection();
+    spot->UpdateView();
+    visibility_.AddView(&spot->lightMatrix_, 1, true);
+  }
+
+  for (size_t i = 0; i < lights_.point_.size(); ++i) {
+    PointLight* point = lights_.point_.at(i).get();
+    if (!point->visible_) { continue; }
+    point->UpdateProjection();
+    point->UpdateView();
+    visibility_.AddView(point->lightMatrix_, kCubeFaceCount, true);
+  }
+
+  visibility_.Cull(*bounds_tree_, visibility_items_, boss_);
+}
+
+void RenderSystemOpenGL::cull_occluded(){
+  const std::vector<uint32_t>& in_view = visibility_.GetVisible(camera_view_);
+  occlusion_.Clear(main_view_projection_);
+
+  size_t occluder_count = 0;
+  for (uint32_t i : in_view) {
+    const RenderItem& item = render_items_[i];
+    RendererComponent* r = item.renderer_;
+    if (!r->occluder_) { continue; }
+    TinyObj* mesh = r->mesh_.get();
+    //The triangles are gathered on the workers, until they're ready the object doesn't hide anything
+    if (mesh->occluder_indexes_.empty()) {
+      if (mesh->occluder_failed_ || mesh->occluder_building_ || mesh->streaming_) { continue; }
+      if (boss_ != nullptr) {
+        eve::spawn(*boss_, BuildOccluderAsync(r->mesh_, *boss_));
+        continue;
       }
+      mesh->occluder_failed_ = !mesh->BuildOccluder(&mesh->occluder_positions_, &mesh->occluder_indexes_);
+      if (mesh->occluder_failed_) { continue; }
+    }
+    occlusion_.DrawOccluder(mesh->occluder_positions_.data(), mesh->occluder_positions_.size(),
+                            mesh->occluder_indexes_.data(), mesh->occluder_indexes_.size(), item.transform_);
+    occluder_count++;
+  }
 
-      //c->draw_calls++;
+  if (occluder_count == 0) {
+    camera_visible_ = in_view;
+    return;
+  }
+  occlusion_.BuildPyramid();
+
+  //The occluders are drawn even if they hide each other, they're in the depth buffer already
+  camera_visible_.clear();
+  glm::vec3 bounds_min, bounds_max;
+  for (uint32_t i : in_view) {
+    RendererComponent* r = render_items_[i].renderer_;
+    if (!r->occluder_ && r->bounds_proxy_ != kBoundsTreeNullNode) {
+      bounds_tree_->GetBounds(r->bounds_proxy_, &bounds_min, &bounds_max);
+      if (!occlusion_.IsVisible(bounds_min, bounds_max)) { continue; }
+    }
+    camera_visible_.push_back(i);
+  }
+}
 
-      glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
-      glBindVertexArray(r->mesh_->virtual_array_object_);
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
-      //glBindTexture(GL_TEXTURE_2D, 0);
+void RenderSystemOpenGL::sort_render_items(const std::vector<uint32_t>& visible, RenderPass pass, const glm::vec3& view_position, std::vector<uint32_t>* sorted){
+  if (!sort_draws_) {
+    *sorted = visible;
+    return;
+  }
 
+  //Every item of a pass is drawn with the program of the pass, and the shadow maps only bind vertex arrays
+  bool shadow = pass == RenderPass::kShadow;
+  render_queue_.Clear();
+  for (uint32_t i : visible) {
+    const RenderItem& item = render_items_[i];
+    uint32_t cull = shadow ? 0 : item.renderer_->mesh_->cull_type_;
+    uint32_t material = shadow ? 0 : item.material_id_;
+    float distance = glm::length(item.center_ - view_position);
+    render_queue_.Add(MakeRenderKey(pass, 0, cull, material, item.mesh_id_, distance), i);
+  }
+  render_queue_.Sort();
+  render_queue_.GetItems(sorted);
+}
+
+void RenderSystemOpenGL::select_lods(const glm::mat4& projection, const glm::vec3& view_position){
+
+  //Orthographic projections don't shrink with the distance
+  bool orthographic = projection[3][3] == 1.0f;
+  float view_height = (float)window_->GetWindowHeight();
+
+  for (size_t i = 0; i < render_items_.size(); ++i) {
+    RenderItem& item = render_items_[i];
+    RendererComponent* r = item.renderer_;
+
+    const glm::vec3& center = item.center_;
+    float radius = item.radius_;
+
+    //Diameter over the height of the view at that distance, the camera inside the sphere sees it whole
+    float screen_size = radius * projection[1][1];
+    if (!orthographic) {
+      float distance = glm::length(center - view_position);
+      screen_size = distance > radius ? screen_size / distance : 1.0f;
+    }
+    item.screen_size_ = screen_size;
+
+    //Objects out of the camera view can still cast shadows into it. The shadow views share a LOD picked from the
+    //size on the camera, the lights don't see the objects much bigger than it does
+    if (r->mesh_->lods_.size() >= 2) {
+      r->SelectLod(screen_size, false);
+      r->SelectLod(screen_size, true);
+    }
+  }
+
+  //The residency keeps the mip levels that match the pixels the object covers, only for the objects drawn
+  for (uint32_t i : camera_visible_) {
+    const RenderItem& item = render_items_[i];
+    for (const std::shared_ptr<Texture>& texture : item.renderer_->textures_) {
+      texture->RequestLevel(item.screen_size_ * view_height);
     }
   }
 }
 
-void RenderSystemOpenGL::render_elements_depthmap(ComponentManager* comp, Program* prog){
+void RenderSystemOpenGL::draw_mesh_lod(const TinyObj* mesh, unsigned int lod){
+  //Streamed meshes have no LODs, every piece uploaded so far is drawn
+  if (!mesh->streamed_chunks_.empty()) {
+    cluster_counts_.clear();
+    cluster_offsets_.clear();
+    cluster_base_vertices_.clear();
+    for (size_t i = 0; i < mesh->streamed_chunks_.size(); ++i) {
+      const GeometryAllocation* chunk = mesh->streamed_chunks_[i];
+      cluster_counts_.push_back((GLsizei)(chunk->index_bytes_ / chunk->index_size_));
+      cluster_offsets_.push_back((const void*)(uintptr_t)chunk->index_offset_);
+      cluster_base_vertices_.push_back((GLint)chunk->base_vertex_);
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, cluster_counts_.data(), GL_UNSIGNED_SHORT, cluster_offsets_.data(), (GLsizei)cluster_counts_.size(), cluster_base_vertices_.data());
+    return;
+  }
 
-  static size_t render_hash = typeid(RendererComponent).hash_code();
-  static size_t transf_hash = typeid(TransformComponent).hash_code();
+  MeshLod range = mesh->get_lod(lod);
+  GLenum index_type = mesh->layout_.index_size_ == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  uintptr_t offset = mesh->geometry_->index_offset_ + (uintptr_t)mesh->layout_.index_size_ * range.index_offset_;
+  glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.index_count_, index_type, (void*)offset, (GLint)mesh->geometry_->base_vertex_);
+}
 
-  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
-  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
-  size_t render_size = renderer_components->size();
-  size_t transf_size = transform_components->size();
+void RenderSystemOpenGL::draw_mesh(const TinyObj* mesh, unsigned int lod, const glm::mat4& transform, const glm::mat4& view_projection, const glm::vec3* view_position){
+  //Only the full detail LOD is split in meshlets
+  MeshLod range = mesh->get_lod(lod);
+  if (range.index_offset_ != 0 || mesh->meshlets_.size() < 2) {
+    draw_mesh_lod(mesh, lod);
+    return;
+  }
 
-  size_t transform_iterator = 0;
-  for (size_t it = 0; it < render_size; it++) {
+  glm::vec4 planes[6];
+  ExtractFrustumPlanes(view_projection * transform, planes);
 
-    size_t id = renderer_components->at(it).entity_id_;
-    RendererComponent* r = &(renderer_components->at(it).data_);
-    TransformComponent* t = nullptr;
+  //Affine transforms keep which side of a triangle faces a point, the viewer can be moved to the space of the mesh.
+  //Only meshes culling their back faces can skip the meshlets facing away
+  glm::vec3 local_view_position;
+  const glm::vec3* local_view = nullptr;
+  if (view_position != nullptr && mesh->cull_type_ == 1) {
+    local_view_position = glm::vec3(glm::inverse(transform) * glm::vec4(*view_position, 1.0f));
+    local_view = &local_view_position;
+  }
 
-    //Search for the assigned transform of this renderer if it exists
-    while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
-      transform_iterator++;
+  cluster_counts_.clear();
+  cluster_offsets_.clear();
+  cluster_base_vertices_.clear();
+  uint32_t last_end = 0;
+
+  for (size_t i = 0; i < mesh->meshlets_.size(); ++i) {
+    const Meshlet& meshlet = mesh->meshlets_[i];
+    if (!IsMeshletVisible(meshlet, planes, local_view)) { continue; }
+
+    //Consecutive meshlets are drawn as a single range
+    if (!cluster_counts_.empty() && last_end == meshlet.index_offset_) {
+      cluster_counts_.back() += (GLsizei)meshlet.index_count_;
     }
+    else {
+      cluster_counts_.push_back((GLsizei)meshlet.index_count_);
+      cluster_offsets_.push_back((const void*)(mesh->geometry_->index_offset_ + (uintptr_t)mesh->layout_.index_size_ * meshlet.index_offset_));
+      cluster_base_vertices_.push_back((GLint)mesh->geometry_->base_vertex_);
+    }
+    last_end = meshlet.index_offset_ + meshlet.index_count_;
+  }
 
-    if (transf_size != 0 && transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
-      t = &(transform_components->at(transform_iterator).data_);
+  if (cluster_counts_.empty()) { return; }
+
+  GLenum index_type = mesh->layout_.index_size_ == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, cluster_counts_.data(), index_type, cluster_offsets_.data(), (GLsizei)cluster_counts_.size(), cluster_base_vertices_.data());
+}
+
+//Selects the layer of the first texture of a renderer if it's packed, binding its array only when it isn't already.
+//The rest of the textures of the renderer are bound on their own
+static void BindTextureArray(Program* prog, RendererComponent* r, GLuint* bound_texture_array, RenderStateStats* stats) {
+  const Texture* texture = r->textures_.empty() ? nullptr : r->textures_.at(0).get();
+  if (texture == nullptr || texture->array_ == nullptr || !texture->loaded_) {
+    prog->SetBool("use_texture_array", false);
+    return;
+  }
+
+  if (texture->array_->texture_id_ != *bound_texture_array) {
+    *bound_texture_array = texture->array_->texture_id_;
+    glActiveTexture(GL_TEXTURE0 + kTextureArrayUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, *bound_texture_array);
+    stats->texture_changes_++;
+  }
+  prog->SetBool("use_texture_array", true);
+  prog->SetInt("texture_layer", (int)texture->array_layer_);
+}
+
+//Binds a texture to a unit unless the last draw of the loop left it there. Units past the ones
+//tracked are always bound
+static void BindTexture2D(GLuint unit, GLuint texture, GLuint bound_textures[kTrackedTextureUnits], RenderStateStats* stats) {
+  if (unit < kTrackedTextureUnits) {
+    if (bound_textures[unit] == texture) { return; }
+    bound_textures[unit] = texture;
+  }
+  glActiveTexture(GL_TEXTURE0 + unit);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  stats->texture_changes_++;
+}
+
+void RenderSystemOpenGL::render_elements_with_texture(const std::vector<uint32_t>& visible, Program* prog){
+
+  unsigned char last_cull = -1;
+  GLuint bound_array = 0;
+  GLuint bound_texture_array = 0;
+  GLuint bound_textures[kTrackedTextureUnits] = {};
+  for (uint32_t i : visible) {
+
+    RendererComponent* r = render_items_[i].renderer_;
+    const glm::mat4& trans = render_items_[i].transform_;
+
+    //Quantized positions are taken back to the space of the mesh with the object transform
+    glm::mat4 vertex_trans = trans * GetDequantizeTransform(r->mesh_->layout_);
+    prog->SetMat4("transform", (float*)glm::value_ptr(vertex_trans));
+    prog->SetBool("needs_light", r->needs_light_);
+
+    // Activate textures if there are any
+    BindTextureArray(prog, r, &bound_texture_array, &render_stats_);
+    for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
+      if (r->textures_.at(j)->loaded_ && r->textures_.at(j)->array_ == nullptr) {
+        char source[50] = "0";
+          BindTexture2D(j, r->textures_.at(j)->texture_id_, bound_textures, &render_stats_);
+          sprintf_s(source, "texture%d", (int)j + 1);
+          prog->SetSampler(source, j);
+      }
     }
 
-    //Only draw if the
-    if (r->isInit_ && r->mesh_->isInit_) {
-      glm::mat4 trans = glm::mat4(1.0f);
-      if (nullptr != t) { trans = t->GetTransform(); }
-      prog->SetMat4("transform", (float*)glm::value_ptr(trans));
+    //Set the culling method
+    if (r->mesh_->cull_type_ != last_cull) {
+      switch (r->mesh_->cull_type_) {
+      case 0:glCullFace(GL_FRONT); break;
+      case 1:glCullFace(GL_BACK); break;
+      case 2:glCullFace(GL_FRONT_AND_BACK); break;
+      }
+
+      last_cull = r->mesh_->cull_type_;
+      render_stats_.cull_changes_++;
+    }
 
-      glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
-      glBindVertexArray(r->mesh_->virtual_array_object_);
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-      glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+    //c->draw_calls++;
 
+    //Meshes with the same vertex format share the vertex array, it only changes with the format
+    if (r->mesh_->geometry_->vertex_array_ != bound_array) {
+      bound_array = r->mesh_->geometry_->vertex_array_;
+      glBindVertexArray(bound_array);
+      render_stats_.vertex_array_changes_++;
     }
+    render_stats_.draws_++;
+    draw_mesh(r->mesh_.get(), r->lod_, trans, main_view_projection_, &main_view_position_);
+    //glBindTexture(GL_TEXTURE_2D, 0);
   }
 }
 
-void RenderSystemOpenGL::render_light_elements(ComponentManager* comp, Program* prog, DirectionalLight* directional)
-{
-  static size_t render_hash = typeid(RendererComponent).hash_code();
-  static size_t transf_hash = typeid(TransformComponent).hash_code();
+void RenderSystemOpenGL::render_elements_depthmap(const std::vector<uint32_t>& visible, Program* prog, const glm::mat4* light_view_projection){
 
-  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
-  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
-  size_t render_size = renderer_components->size();
-  size_t transf_size = transform_components->size();
+  GLuint bound_array = 0;
+  for (uint32_t i : visible) {
+
+    RendererComponent* r = render_items_[i].renderer_;
+    const glm::mat4& trans = render_items_[i].transform_;
+
+    glm::mat4 vertex_trans = trans * GetDequantizeTransform(r->mesh_->layout_);
+    prog->SetMat4("transform", (float*)glm::value_ptr(vertex_trans));
 
+    if (r->mesh_->geometry_->vertex_array_ != bound_array) {
+      bound_array = r->mesh_->geometry_->vertex_array_;
+      glBindVertexArray(bound_array);
+      render_stats_.vertex_array_changes_++;
+    }
+    render_stats_.draws_++;
+    if (light_view_projection != nullptr) { draw_mesh(r->mesh_.get(), r->shadow_lod_, trans, *light_view_projection, nullptr); }
+    else { draw_mesh_lod(r->mesh_.get(), r->shadow_lod_); }
+  }
+}
+
+void RenderSystemOpenGL::render_light_elements(const std::vector<uint32_t>& visible, Program* prog, DirectionalLight* directional)
+{
 
   //Update the program with the directional light values and the depthmap
 
@@ -609,64 +890,44 @@ void RenderSystemOpenGL::render_light_elements(ComponentManager* comp, Program*
   prog->SetVec3("directional.ambient", directional->ambient_);
 
   unsigned char last_cull = -1;
-  size_t transform_iterator = 0;
-  for (size_t it = 0; it < render_size; it++) {
-
-    size_t id = renderer_components->at(it).entity_id_;
-    RendererComponent* r = &(renderer_components->at(it).data_);
-    TransformComponent* t = nullptr;
-    if (r != nullptr) {
-      //Search for the assigned transform of this renderer if it exists
-      while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
-        transform_iterator++;
+  GLuint bound_array = 0;
+  GLuint bound_texture_array = 0;
+  GLuint bound_textures[kTrackedTextureUnits] = {};
+  for (uint32_t i : visible) {
+
+    RendererComponent* r = render_items_[i].renderer_;
+    const glm::mat4& trans = render_items_[i].transform_;
+
+    glm::mat4 vertex_trans = trans * GetDequantizeTransform(r->mesh_->layout_);
+
+    prog->SetMat4("transform", (float*)glm::value_ptr(vertex_trans));
+    prog->SetBool("receivesShadows", r->receives_shadows_);
+    prog->SetBool("needs_light", r->needs_light_);
+
+    // Activate textures if there are any
+    BindTextureArray(prog, r, &bound_texture_array, &render_stats_);
+    for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
+      if (r->textures_.at(j)->loaded_ && r->textures_.at(j)->array_ == nullptr) {
+        char source[50] = "0";
+        BindTexture2D(j + 1, r->textures_.at(j)->texture_id_, bound_textures, &render_stats_);
+        sprintf_s(source, "texture%d", (int)j + 1);
+        prog->SetSampler(source, j + 1);
       }
+    }
 
-      if (transf_size != 0 && transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
-        t = &(transform_components->at(transform_iterator).data_);
-      }
-
-      //Only draw if the renderer and mesh are init
-      if (r->isInit_ && r->mesh_->isInit_) {
-        glm::mat4 trans = glm::mat4(1.0f);
-        if (nullptr != t) { trans = t->GetTransform(); }
-
-        prog->SetMat4("transform", (float*)glm::value_ptr(trans));
-        prog->SetBool("receivesShadows", r->receives_shadows_);
-        prog->SetBool("needs_light", r->needs_light_);
-
-        // Activate textures if there are any
-        for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
-          if (r->textures_.at(j)->loaded_) {
-            char source[50] = "0";
-            GLuint textureId = r->textures_.at(j)->texture_id_;
-            glActiveTexture(GL_TEXTURE1 + j);
-            glBindTexture(GL_TEXTURE_2D, textureId);
-            sprintf_s(source, "texture%d", (int)j + 1);
-            prog->SetSampler(source, j + 1);
-          }
-        }
-
-        glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
-        glBindVertexArray(r->mesh_->virtual_array_object_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
-
-      }
+    if (r->mesh_->geometry_->vertex_array_ != bound_array) {
+      bound_array = r->mesh_->geometry_->vertex_array_;
+      glBindVertexArray(bound_array);
+      render_stats_.vertex_array_changes_++;
     }
+    render_stats_.draws_++;
+    draw_mesh(r->mesh_.get(), r->lod_, trans, main_view_projection_, &main_view_position_);
   }
 
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void RenderSystemOpenGL::render_light_elements(ComponentManager* comp, Program* prog, SpotLight* spotlight){
-  static size_t render_hash = typeid(RendererComponent).hash_code();
-  static size_t transf_hash = typeid(TransformComponent).hash_code();
-
-  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
-  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
-  size_t render_size = renderer_components->size();
-  size_t transf_size = transform_components->size();
-
+void RenderSystemOpenGL::render_light_elements(const std::vector<uint32_t>& visible, Program* prog, SpotLight* spotlight){
 
   //Update the program with the directional light values and the depthmap
 
@@ -686,65 +947,44 @@ void RenderSystemOpenGL::render_light_elements(ComponentManager* comp, Program*
   prog->SetFloat("spotlight.quadratic", spotlight->quadratic_);
 
   unsigned char last_cull = -1;
-  size_t transform_iterator = 0;
-  for (size_t it = 0; it < render_size; it++) {
-
-    size_t id = renderer_components->at(it).entity_id_;
-    RendererComponent* r = &(renderer_components->at(it).data_);
-    TransformComponent* t = nullptr;
-    if (r != nullptr) {
-      //Search for the assigned transform of this renderer if it exists
-      while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
-        transform_iterator++;
+  GLuint bound_array = 0;
+  GLuint bound_texture_array = 0;
+  GLuint bound_textures[kTrackedTextureUnits] = {};
+  for (uint32_t i : visible) {
+
+    RendererComponent* r = render_items_[i].renderer_;
+    const glm::mat4& trans = render_items_[i].transform_;
+
+    glm::mat4 vertex_trans = trans * GetDequantizeTransform(r->mesh_->layout_);
+
+    prog->SetMat4("transform", (float*)glm::value_ptr(vertex_trans));
+    prog->SetBool("receivesShadows", r->receives_shadows_);
+    prog->SetBool("needs_light", r->needs_light_);
+
+    // Activate textures if there are any
+    BindTextureArray(prog, r, &bound_texture_array, &render_stats_);
+    for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
+      if (r->textures_.at(j)->loaded_ && r->textures_.at(j)->array_ == nullptr) {
+        char source[50] = "0";
+        BindTexture2D(j + 1, r->textures_.at(j)->texture_id_, bound_textures, &render_stats_);
+        sprintf_s(source, "texture%d", (int)j + 1);
+        prog->SetSampler(source, j + 1);
       }
+    }
 
-      if (transf_size != 0 && transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
-        t = &(transform_components->at(transform_iterator).data_);
-      }
-
-      //Only draw if the renderer and mesh are init
-      if (r->isInit_ && r->mesh_->isInit_) {
-        glm::mat4 trans = glm::mat4(1.0f);
-        if (nullptr != t) { trans = t->GetTransform(); }
-
-        prog->SetMat4("transform", (float*)glm::value_ptr(trans));
-        prog->SetBool("receivesShadows", r->receives_shadows_);
-        prog->SetBool("needs_light", r->needs_light_);
-
-        // Activate textures if there are any
-        for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
-          if (r->textures_.at(j)->loaded_) {
-            char source[50] = "0";
-            GLuint textureId = r->textures_.at(j)->texture_id_;
-            glActiveTexture(GL_TEXTURE1 + j);
-            glBindTexture(GL_TEXTURE_2D, textureId);
-            sprintf_s(source, "texture%d", (int)j + 1);
-            prog->SetSampler(source, j + 1);
-          }
-        }
-
-        glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
-        glBindVertexArray(r->mesh_->virtual_array_object_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
-
-      }
+    if (r->mesh_->geometry_->vertex_array_ != bound_array) {
+      bound_array = r->mesh_->geometry_->vertex_array_;
+      glBindVertexArray(bound_array);
+      render_stats_.vertex_array_changes_++;
     }
+    render_stats_.draws_++;
+    draw_mesh(r->mesh_.get(), r->lod_, trans, main_view_projection_, &main_view_position_);
   }
 
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void RenderSystemOpenGL::render_light_elements(ComponentManager* comp, Program* prog, PointLight* pointlight){
-
-  static size_t render_hash = typeid(RendererComponent).hash_code();
-  static size_t transf_hash = typeid(TransformComponent).hash_code();
-
-  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
-  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
-  size_t render_size = renderer_components->size();
-  size_t transf_size = transform_components->size();
-
+void RenderSystemOpenGL::render_light_elements(const std::vector<uint32_t>& visible, Program* prog, PointLight* pointlight){
 
   //Update the program with the directional light values and the depthmap
   glActiveTexture(GL_TEXTURE0);
@@ -770,51 +1010,39 @@ void RenderSystemOpenGL::render_light_elements(ComponentManager* comp, Program*
   prog->SetFloat("point_far_plane", pointlight->zfar_);
 
   unsigned char last_cull = -1;
-  size_t transform_iterator = 0;
+  GLuint bound_array = 0;
+  GLuint bound_texture_array = 0;
+  GLuint bound_textures[kTrackedTextureUnits] = {};
 
-  for (size_t it = 0; it < render_size; it++) {
+  for (uint32_t i : visible) {
 
-    size_t id = renderer_components->at(it).entity_id_;
-    RendererComponent* r = &(renderer_components->at(it).data_);
-    TransformComponent* t = nullptr;
-    if (r != nullptr) {
-      //Search for the assigned transform of this renderer if it exists
-      while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
-        transform_iterator++;
-      }
+    RendererComponent* r = render_items_[i].renderer_;
+    const glm::mat4& trans = render_items_[i].transform_;
 
-      if (transf_size != 0 && transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
-        t = &(transform_components->at(transform_iterator).data_);
-      }
+    glm::mat4 vertex_trans = trans * GetDequantizeTransform(r->mesh_->layout_);
 
-      //Only draw if the renderer and mesh are init
-      if (r->isInit_ && r->mesh_->isInit_) {
-        glm::mat4 trans = glm::mat4(1.0f);
-        if (nullptr != t) { trans = t->GetTransform(); }
-
-        prog->SetMat4("transform", (float*)glm::value_ptr(trans));
-        prog->SetBool("receivesShadows", r->receives_shadows_);
-        prog->SetBool("needs_light", r->needs_light_);
-
-        // Activate textures if there are any
-        for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
-          if (r->textures_.at(j)->loaded_) {
-            char source[50] = "0";
-            GLuint textureId = r->textures_.at(j)->texture_id_;
-            glActiveTexture(GL_TEXTURE1 + j);
-            glBindTexture(GL_TEXTURE_2D, textureId);
-            sprintf_s(source, "texture%d", (int)j + 1);
-            prog->SetSampler(source, j + 1);
-          }
-        }
-
-        glBindBuffer(GL_ARRAY_BUFFER, r->mesh_->virtual_buffer_object_);
-        glBindVertexArray(r->mesh_->virtual_array_object_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->mesh_->index_buffer_object_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)r->mesh_->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+    prog->SetMat4("transform", (float*)glm::value_ptr(vertex_trans));
+    prog->SetBool("receivesShadows", r->receives_shadows_);
+    prog->SetBool("needs_light", r->needs_light_);
 
+    // Activate textures if there are any
+    BindTextureArray(prog, r, &bound_texture_array, &render_stats_);
+    for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
+      if (r->textures_.at(j)->loaded_ && r->textures_.at(j)->array_ == nullptr) {
+        char source[50] = "0";
+        BindTexture2D(j + 1, r->textures_.at(j)->texture_id_, bound_textures, &render_stats_);
+        sprintf_s(source, "texture%d", (int)j + 1);
+        prog->SetSampler(source, j + 1);
       }
     }
+
+    if (r->mesh_->geometry_->vertex_array_ != bound_array) {
+      bound_array = r->mesh_->geometry_->vertex_array_;
+      glBindVertexArray(bound_array);
+      render_stats_.vertex_array_changes_++;
+    }
+    render_stats_.draws_++;
+    draw_mesh(r->mesh_.get(), r->lod_, trans, main_view_projection_, &main_view_position_);
   }
 
   glBindTexture(GL_TEXTURE_2D, 0);
@@ -842,27 +1070,44 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
                             0.01f, 2000.0f); 
   }
  
+  main_view_projection_ = cam_projection * cam_view;
+  main_view_position_ = cam_position;
+  gather_render_items(comp);
+  prepare_visibility(cam_position, true);
+  cull_occluded();
+  select_lods(cam_projection, cam_position);
+  sort_render_items(camera_visible_, RenderPass::kCamera, cam_position, &camera_sorted_);
+  const std::vector<uint32_t>& camera_visible = camera_sorted_;
+  uint32_t shadow_view = camera_view_ + 1;
+
   //Set camera values to all the programs
 
   render_elements_with_texture_->Use();
   render_elements_with_texture_->SetMat4("projection", glm::value_ptr(cam_projection));
   render_elements_with_texture_->SetMat4("view", glm::value_ptr(cam_view));
   render_elements_with_texture_->SetVec3("viewPos", cam_position);
+  //Packed textures have a unit of their own, samplers of different types can't share one
+  render_elements_with_texture_->SetSampler("texture_array", kTextureArrayUnit);
 
   render_elements_directional_light_->Use();
   render_elements_directional_light_->SetMat4("projection", glm::value_ptr(cam_projection));
   render_elements_directional_light_->SetMat4("view", glm::value_ptr(cam_view));
   render_elements_directional_light_->SetVec3("viewPos", cam_position);
+  render_elements_directional_light_->SetSampler("texture_array", kTextureArrayUnit);
 
   render_elements_spotlight_->Use();
   render_elements_spotlight_->SetMat4("projection", glm::value_ptr(cam_projection));
   render_elements_spotlight_->SetMat4("view", glm::value_ptr(cam_view));
   render_elements_spotlight_->SetVec3("viewPos", cam_position);
+  render_elements_spotlight_->SetSampler("texture_array", kTextureArrayUnit);
 
   render_elements_pointlight_->Use();
   render_elements_pointlight_->SetMat4("projection", glm::value_ptr(cam_projection));
   render_elements_pointlight_->SetMat4("view", glm::value_ptr(cam_view));
   render_elements_pointlight_->SetVec3("viewPos", cam_position);
+  render_elements_pointlight_->SetSampler("texture_array", kTextureArrayUnit);
+  //With every texture packed it's never set by the draws, and unit 0 has the cube depthmap
+  render_elements_pointlight_->SetSampler("texture1", 1);
 
   bool first_pass = true;
 
@@ -875,14 +1120,8 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
     //Get the depthmap of the light and bind it's program and 
     DirectionalLight* dir = lights_.directional_.at(i).get();
 
-    //Change the dir position to follow the camera
-
     if (dir->visible_) {
 
-      dir->position_ = cam_position;
-      dir->UpdateProjection();
-      dir->UpdateView();
-
       //Render the shadow into the depthmap
       render_directional_and_spotlight_shadows_->Use();
       depthmap_directional_and_spotlight_shadows_->SetBuffer();
@@ -891,7 +1130,8 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
       glEnable(GL_CULL_FACE);
       glCullFace(GL_BACK);
       render_directional_and_spotlight_shadows_->SetMat4("lightSpaceMatrix", glm::value_ptr(dir->lightMatrix_));
-      render_elements_depthmap(comp, render_directional_and_spotlight_shadows_.get());
+      sort_render_items(visibility_.GetVisible(shadow_view++), RenderPass::kShadow, dir->position_, &shadow_sorted_);
+      render_elements_depthmap(shadow_sorted_, render_directional_and_spotlight_shadows_.get(), &dir->lightMatrix_);
       depthmap_directional_and_spotlight_shadows_->UnsetBuffer();
 
       //Reset viewport and render the elements with that depthmap and the directional light
@@ -905,13 +1145,13 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
         glBlendFunc(GL_ONE, GL_ZERO);
-        render_light_elements(comp, render_elements_directional_light_.get(), dir);
+        render_light_elements(camera_visible, render_elements_directional_light_.get(), dir);
         first_pass = false;
         glBlendFunc(GL_ONE, GL_ONE);
       }
       else {
         glBlendEquation(GL_FUNC_ADD);
-        render_light_elements(comp, render_elements_directional_light_.get(), dir);
+        render_light_elements(camera_visible, render_elements_directional_light_.get(), dir);
       }
     }
   }
@@ -922,9 +1162,6 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
 
     if (spot->visible_) {
 
-      spot->UpdateProjection();
-      spot->UpdateView();
-
       //Render the shadow into the depthmap
       render_directional_and_spotlight_shadows_->Use();
       depthmap_directional_and_spotlight_shadows_->SetBuffer();
@@ -933,7 +1170,8 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
       glEnable(GL_CULL_FACE);
       glCullFace(GL_BACK);
       render_directional_and_spotlight_shadows_->SetMat4("lightSpaceMatrix", glm::value_ptr(spot->lightMatrix_));
-      render_elements_depthmap(comp, render_directional_and_spotlight_shadows_.get());
+      sort_render_items(visibility_.GetVisible(shadow_view++), RenderPass::kShadow, spot->position_, &shadow_sorted_);
+      render_elements_depthmap(shadow_sorted_, render_directional_and_spotlight_shadows_.get(), &spot->lightMatrix_);
       depthmap_directional_and_spotlight_shadows_->UnsetBuffer();
 
       //Reset viewport and render the elements with that depthmap and the directional light
@@ -948,13 +1186,13 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
         glBlendFunc(GL_ONE, GL_ZERO);
-        render_light_elements(comp, render_elements_spotlight_.get(), spot);
+        render_light_elements(camera_visible, render_elements_spotlight_.get(), spot);
         first_pass = false;
         glBlendFunc(GL_ONE, GL_ONE);
       }
       else {
         glBlendEquation(GL_FUNC_ADD);
-        render_light_elements(comp, render_elements_spotlight_.get(), spot);
+        render_light_elements(camera_visible, render_elements_spotlight_.get(), spot);
       }
     }
 
@@ -966,9 +1204,6 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
 
     if (point->visible_) {
 
-      point->UpdateProjection();
-      point->UpdateView();
-
       //Render the shadow into the depthmap
       render_pointlight_shadows_->Use();
       depthmap_pointlight_shadows_->SetBuffer();
@@ -976,7 +1211,8 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
       glClear(GL_DEPTH_BUFFER_BIT);
       glEnable(GL_CULL_FACE);
       glCullFace(GL_BACK);
-      render_elements_depthmap(comp, render_pointlight_shadows_.get());
+      sort_render_items(visibility_.GetVisible(shadow_view++), RenderPass::kShadow, point->position_, &shadow_sorted_);
+      render_elements_depthmap(shadow_sorted_, render_pointlight_shadows_.get());
       depthmap_pointlight_shadows_->UnsetBuffer();
 
       //Reset viewport and render the elements with that depthmap and the directional light
@@ -991,13 +1227,13 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
         glBlendFunc(GL_ONE, GL_ZERO);
-        render_light_elements(comp, render_elements_pointlight_.get(), point);
+        render_light_elements(camera_visible, render_elements_pointlight_.get(), point);
         first_pass = false;
         glBlendFunc(GL_ONE, GL_ONE);
       }
       else {
         //glBlendEquation(GL_FUNC_ADD);
-        render_light_elements(comp, render_elements_pointlight_.get(), point);
+        render_light_elements(camera_visible, render_elements_pointlight_.get(), point);
       }
     }
 
@@ -1011,7 +1247,7 @@ void RenderSystemOpenGL::ForwardRendering(ComponentManager* comp) {
     glEnable(GL_CULL_FACE);
     glBlendFunc(GL_ONE, GL_ZERO);
     render_elements_with_texture_->Use();
-    render_elements_with_texture(comp, render_elements_with_texture_.get());
+    render_elements_with_texture(camera_visible, render_elements_with_texture_.get());
     glBlendFunc(GL_ONE, GL_ONE);
   }
 
@@ -1109,9 +1345,6 @@ void RenderSystemOpenGL::render_deferred_elements_without_light(ComponentManager
 static float offset = 0.0f;
 void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
 
-  static size_t render_hash = typeid(RendererComponent).hash_code();
-  static size_t transf_hash = typeid(TransformComponent).hash_code();
-
   // Render scene's geometry/color data into gbuffer
   deferred_framebuffer_->SetBuffer();
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -1133,6 +1366,16 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
       cam_view = camera->get_view();
   }
 
+  main_view_projection_ = cam_proj * cam_view;
+  main_view_position_ = cam_pos;
+  gather_render_items(comp);
+  prepare_visibility(cam_pos, false);
+  cull_occluded();
+  select_lods(cam_proj, cam_pos);
+  sort_render_items(camera_visible_, RenderPass::kCamera, cam_pos, &camera_sorted_);
+  const std::vector<uint32_t>& camera_visible = camera_sorted_;
+  uint32_t shadow_view = camera_view_ + 1;
+
   Program* dir_light_prog = deferred_rendering_directionallight_program_.get();
   dir_light_prog->Use();
   dir_light_prog->SetMat4("view", glm::value_ptr(cam_view));
@@ -1169,76 +1412,51 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
   elements_program->Use();
   elements_program->SetMat4("projection", glm::value_ptr(cam_proj));
   elements_program->SetMat4("view", glm::value_ptr(cam_view));
+  elements_program->SetSampler("texture_array", kTextureArrayUnit);
 
 
   //Render all elements to split the position, normal and albedo
-  std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(comp->components_classes_.find(render_hash)->second.get())).components_;
-  std::vector<component_node<TransformComponent>>* transform_components = &(*static_cast<component_list<TransformComponent>*>(comp->components_classes_.find(transf_hash)->second.get())).components_;
-  size_t render_size = renderer_components->size();
-  size_t transf_size = transform_components->size();
-
   unsigned char last_cull = -1;
-  unsigned int last_texture = -1;
-  size_t transform_iterator = 0;
-
-  for (size_t it = 0; it < render_size; it++) {
-
-    size_t id = renderer_components->at(it).entity_id_;
-    RendererComponent* r = &(renderer_components->at(it).data_);
-    TransformComponent* t = nullptr;
-
-    //Search for the assigned transform of this renderer if it exists
-    while (transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ < id) {
-      transform_iterator++;
-    }
-
-    if (transf_size != 0 && transform_iterator < transf_size && transform_components->at(transform_iterator).entity_id_ == id) {
-      t = &(transform_components->at(transform_iterator).data_);
-    }
-
-    //Only draw if the
-    if (r->isInit_ && r->mesh_->isInit_) {
-      glm::mat4 trans = glm::mat4(1.0f);
-      if (nullptr != t) { trans = t->GetTransform(); }
-      elements_program->SetMat4("transform", glm::value_ptr(trans));
-
-      // Activate textures if there are any
-      for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
-        if (r->textures_.at(j)->loaded_) {
-          GLuint textureId = r->textures_.at(j)->texture_id_;
-          glActiveTexture(GL_TEXTURE0 + j);
-
-          if (last_texture != textureId) {
-              last_texture = textureId;
-              glBindTexture(GL_TEXTURE_2D, last_texture);
-          }
-
-          elements_program->SetSampler("texture_diffuse", j);
-        }
+  GLuint bound_array = 0;
+  GLuint bound_texture_array = 0;
+  GLuint bound_textures[kTrackedTextureUnits] = {};
+
+  for (uint32_t i : camera_visible) {
+
+    RendererComponent* r = render_items_[i].renderer_;
+    const glm::mat4& trans = render_items_[i].transform_;
+    glm::mat4 vertex_trans = trans * GetDequantizeTransform(r->mesh_->layout_);
+    elements_program->SetMat4("transform", glm::value_ptr(vertex_trans));
+
+    // Activate textures if there are any
+    BindTextureArray(elements_program, r, &bound_texture_array, &render_stats_);
+    for (unsigned int j = 0; j < (unsigned int)r->textures_.size(); j++) {
+      if (r->textures_.at(j)->loaded_ && r->textures_.at(j)->array_ == nullptr) {
+        BindTexture2D(j, r->textures_.at(j)->texture_id_, bound_textures, &render_stats_);
+        elements_program->SetSampler("texture_diffuse", j);
       }
+    }
 
-      //Set the culling method
-      if (r->mesh_->cull_type_ != last_cull) {
-        switch (r->mesh_->cull_type_) {
-        case 0:glCullFace(GL_FRONT); break;
-        case 1:glCullFace(GL_BACK); break;
-        case 2:glCullFace(GL_FRONT_AND_BACK); break;
-        }
-
-        last_cull = r->mesh_->cull_type_;
+    //Set the culling method
+    if (r->mesh_->cull_type_ != last_cull) {
+      switch (r->mesh_->cull_type_) {
+      case 0:glCullFace(GL_FRONT); break;
+      case 1:glCullFace(GL_BACK); break;
+      case 2:glCullFace(GL_FRONT_AND_BACK); break;
       }
 
-      if (last_loaded_mesh != r->mesh_) {
-          last_loaded_mesh = r->mesh_;
-
-          glBindBuffer(GL_ARRAY_BUFFER, last_loaded_mesh->virtual_buffer_object_);
-          glBindVertexArray(last_loaded_mesh->virtual_array_object_);
-          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_loaded_mesh->index_buffer_object_);
-      }
+      last_cull = r->mesh_->cull_type_;
+      render_stats_.cull_changes_++;
+    }
 
-      
-      glDrawElements(GL_TRIANGLES, (GLsizei)last_loaded_mesh->indexes_.size(), GL_UNSIGNED_INT, nullptr);
+    if (r->mesh_->geometry_->vertex_array_ != bound_array) {
+      bound_array = r->mesh_->geometry_->vertex_array_;
+      glBindVertexArray(bound_array);
+      render_stats_.vertex_array_changes_++;
     }
+
+    render_stats_.draws_++;
+    draw_mesh(r->mesh_.get(), r->lod_, trans, main_view_projection_, &main_view_position_);
   }
 
   glBindTexture(GL_TEXTURE_2D, 0);
@@ -1273,7 +1491,8 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
       glClear(GL_DEPTH_BUFFER_BIT);
       glCullFace(GL_BACK);
       render_directional_and_spotlight_shadows_->SetMat4("lightSpaceMatrix", glm::value_ptr(dir->lightMatrix_));
-      render_elements_depthmap(comp, render_directional_and_spotlight_shadows_.get());
+      sort_render_items(visibility_.GetVisible(shadow_view++), RenderPass::kShadow, dir->position_, &shadow_sorted_);
+      render_elements_depthmap(shadow_sorted_, render_directional_and_spotlight_shadows_.get(), &dir->lightMatrix_);
       depthmap_directional_and_spotlight_shadows_->UnsetBuffer();
       glCullFace(GL_FRONT);
 
@@ -1303,9 +1522,6 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
 
     if (spot->visible_) {
 
-      spot->UpdateProjection();
-      spot->UpdateView();
-
       //Render the shadow into the depthmap
       render_directional_and_spotlight_shadows_->Use();
       depthmap_directional_and_spotlight_shadows_->SetBuffer();
@@ -1314,7 +1530,8 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
       glEnable(GL_CULL_FACE);
       glCullFace(GL_BACK);
       render_directional_and_spotlight_shadows_->SetMat4("lightSpaceMatrix", glm::value_ptr(spot->lightMatrix_));
-      render_elements_depthmap(comp, render_directional_and_spotlight_shadows_.get());
+      sort_render_items(visibility_.GetVisible(shadow_view++), RenderPass::kShadow, spot->position_, &shadow_sorted_);
+      render_elements_depthmap(shadow_sorted_, render_directional_and_spotlight_shadows_.get(), &spot->lightMatrix_);
       depthmap_directional_and_spotlight_shadows_->UnsetBuffer();
       glCullFace(GL_FRONT);
 
@@ -1344,9 +1561,6 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
 
     if (point->visible_) {
 
-      point->UpdateProjection();
-      point->UpdateView();
-
       //Render the shadow into the depthmap
       render_pointlight_shadows_->Use();
       depthmap_pointlight_shadows_->SetBuffer();
@@ -1362,7 +1576,8 @@ void RenderSystemOpenGL::DeferredRendering(ComponentManager* comp){
       render_pointlight_shadows_->SetMat4("lightSpaceMatrix[3]", glm::value_ptr(point->lightMatrix_[3]));
       render_pointlight_shadows_->SetMat4("lightSpaceMatrix[4]", glm::value_ptr(point->lightMatrix_[4]));
       render_pointlight_shadows_->SetMat4("lightSpaceMatrix[5]", glm::value_ptr(point->lightMatrix_[5]));
-      render_elements_depthmap(comp, render_pointlight_shadows_.get());
+      sort_render_items(visibility_.GetVisible(shadow_view++), RenderPass::kShadow, point->position_, &shadow_sorted_);
+      render_elements_depthmap(shadow_sorted_, render_pointlight_shadows_.get());
       depthmap_pointlight_shadows_->UnsetBuffer();
       glCullFace(GL_FRONT);
 
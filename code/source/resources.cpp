@@ -1,39 +1,104 @@
 #include <resources.hpp>
 
+#include <filesystem>
+#include <algorithm>
+
 
 // #### RESOURCES ####
 
+//Key of a file in the registry, so different spellings of the same path find the same asset
+static std::string AssetKey(const std::string& filepath) {
+  return std::filesystem::path(filepath).lexically_normal().generic_string();
+}
+
+//Returns the asset loaded from a path, marking it as just used
+template<class T>
+static std::shared_ptr<T> FindAsset(std::unordered_map<std::string, AssetEntry<T>>& paths, const std::string& key, uint64_t& use_counter) {
+  auto it = paths.find(key);
+  if (it == paths.end()) { return nullptr; }
+
+  it->second.last_used_ = ++use_counter;
+  return it->second.asset_.lock();
+}
+
+Resources::Resources() {
+  memory_budget_ = kDefaultResourceBudget;
+  memory_used_ = 0;
+  use_counter_ = 0;
 #ifdef RENDER_OPENGL
-std::shared_ptr<TinyObj> Resources::addMesh(std::string filepath) {
+  geometry_arena_ = std::make_shared<GeometryArena>();
+  texture_arrays_ = std::make_shared<TextureArrayPool>();
+#endif
+}
+
+#ifdef RENDER_OPENGL
+std::shared_ptr<TinyObj> Resources::addMesh(std::string filepath, Boss* boss) {
 
   if (filepath.empty()) { return std::shared_ptr<TinyObj>(nullptr); }
 
+  std::shared_ptr<TinyObj> found = FindAsset(mesh_paths_, AssetKey(filepath), use_counter_);
+  if (found != nullptr) { return found; }
+
   std::shared_ptr<TinyObj> mesh = std::make_shared<TinyObj>();
 
-  mesh->LoadObj(filepath);
-  mesh->InitBuffer();
+  mesh->LoadMesh(filepath, boss);
+  mesh->InitBuffer(geometry_arena_);
 
-  meshes_.push_back(std::move(mesh));
+  return storeMesh(std::move(mesh));
+}
+
+std::shared_ptr<TinyObj> Resources::streamMesh(std::string filepath, Boss* boss) {
+
+  if (boss == nullptr) { return addMesh(filepath); }
+  if (filepath.empty()) { return std::shared_ptr<TinyObj>(nullptr); }
 
-  return meshes_.back();
+  std::shared_ptr<TinyObj> found = FindAsset(mesh_paths_, AssetKey(filepath), use_counter_);
+  if (found != nullptr) { return found; }
+
+  std::shared_ptr<TinyObj> mesh = std::make_shared<TinyObj>();
+
+  //The task keeps the mesh alive, so it isn't evicted halfway
+  eve::spawn(*boss, StreamMesh(mesh, filepath, *boss, geometry_arena_));
+
+  return storeMesh(std::move(mesh));
 }
 
-std::shared_ptr<Texture> Resources::addTexture(std::string filepath) {
+std::shared_ptr<Texture> Resources::streamTexture(std::string filepath, Boss* boss) {
 
+  if (boss == nullptr || texture_streamer_ == nullptr) { return addTexture(filepath, boss); }
   if (filepath.empty()) { return std::shared_ptr<Texture>(nullptr); }
 
-  std::shared_ptr<Texture> text = std::make_shared<Texture>();
+  std::shared_ptr<Texture> found = FindAsset(texture_paths_, AssetKey(filepath), use_counter_);
+  if (found != nullptr) { return found; }
 
-  text->LoadTexture(filepath);
+  std::shared_ptr<Texture> text = std::make_shared<Texture>();
+  text->array_pool_ = texture_arrays_;
 
-  textures_.push_back(std::move(text));
+  //The task keeps the texture alive, so it isn't evicted halfway
+  eve::spawn(*boss, StreamTexture(text, filepath, *boss, *texture_streamer_, kTextureStreamInitialSize));
 
-  return textures_.back();
+  return storeTexture(std::move(text));
 }
 
+std::shared_ptr<Texture> Resources::addTexture(std::string filepath, Boss* boss) {
+
+  if (filepath.empty()) { return std::shared_ptr<Texture>(nullptr); }
+
+  std::shared_ptr<Texture> found = FindAsset(texture_paths_, AssetKey(filepath), use_counter_);
+  if (found != nullptr) { return found; }
+
+  std::shared_ptr<Texture> text = std::make_shared<Texture>();
+  text->array_pool_ = texture_arrays_;
+
+  text->LoadTexture(filepath, boss);
+
+  return storeTexture(std::move(text));
+}
 
 bool Resources::InitResources() {
-  cubemap_ = std::make_unique<Cubemap>();
+  cubemap_ = std::make_unique<Cubemap>(geometry_arena_);
+  texture_streamer_ = std::make_unique<TextureStreamer>();
+  texture_residency_ = std::make_unique<TextureResidency>(texture_arrays_);
 
   std::string skybox = "../data/cubemap/textures/skybox.jpg";
   //std::string space = "../data/cubemap/textures/space.jpg";
@@ -52,26 +117,31 @@ std::shared_ptr<TinyObj> Resources::addMesh(ID3D11Device* dev, ID3D11DeviceConte
 
     if (filepath.empty()) { return nullptr; }
 
-  meshes_.emplace_back(new TinyObj())->LoadObj(filepath);
-  meshes_.back()->InitBuffer(dev, devCon);
+  std::shared_ptr<TinyObj> found = FindAsset(mesh_paths_, AssetKey(filepath), use_counter_);
+  if (found != nullptr) { return found; }
+
+  std::shared_ptr<TinyObj> mesh = std::make_shared<TinyObj>();
 
-  return meshes_.back();
+  mesh->LoadObj(filepath);
+  mesh->InitBuffer(dev, devCon);
+
+  return storeMesh(std::move(mesh));
 }
 
 std::shared_ptr<Texture> Resources::addTexture(ID3D11Device* dev, std::string filepath) {
 
   if (filepath.empty()) { return std::shared_ptr<Texture>(nullptr); }
 
+  std::shared_ptr<Texture> found = FindAsset(texture_paths_, AssetKey(filepath), use_counter_);
+  if (found != nullptr) { return found; }
+
   std::shared_ptr<Texture> text = std::make_shared<Texture>();
 
   text->LoadTexture(dev, filepath);
 
-  textures_.push_back(std::move(text));
-
-  return textures_.back();
+  return storeTexture(std::move(text));
 }
 
-
 bool Resources::InitResources(ID3D11Device* dev) {
   cubemap_ = std::make_unique<Cubemap>(dev);
 
@@ -96,12 +166,139 @@ void Resources::ClearResources(){
     textures_[i].reset();
   }
   textures_.clear();
+  texture_paths_.clear();
+  texture_names_.clear();
 
   //-Meshes
   for (unsigned int i = 0; i < meshes_.size(); ++i) {
     meshes_[i].reset();
   }
   meshes_.clear();
+  mesh_paths_.clear();
+  mesh_names_.clear();
+
+  memory_used_ = 0;
+}
+
+std::shared_ptr<TinyObj> Resources::storeMesh(std::shared_ptr<TinyObj> mesh) {
+
+  if (mesh == nullptr) { return nullptr; }
+
+  std::string key = AssetKey(mesh->full_path_);
+  std::shared_ptr<TinyObj> found = FindAsset(mesh_paths_, key, use_counter_);
+  if (found != nullptr) { return found; }
+
+  size_t size = mesh->GetMemorySize();
+  mesh_paths_[key] = { mesh, size, ++use_counter_ };
+  mesh_names_.emplace(mesh->name_, key);
+  memory_used_ += size;
+
+  meshes_.push_back(std::move(mesh));
+  std::shared_ptr<TinyObj> stored = meshes_.back();
+
+  //The new mesh is referenced by the caller from now on, it can't be the one evicted
+  TrimResources();
+
+  return stored;
+}
+
+std::shared_ptr<Texture> Resources::storeTexture(std::shared_ptr<Texture> texture) {
+
+  if (texture == nullptr) { return nullptr; }
+
+  std::string key = AssetKey(texture->src_);
+  std::shared_ptr<Texture> found = FindAsset(texture_paths_, key, use_counter_);
+  if (found != nullptr) { return found; }
+
+  size_t size = texture->GetMemorySize();
+  texture_paths_[key] = { texture, size, ++use_counter_ };
+  texture_names_.emplace(texture->name_, key);
+  memory_used_ += size;
+
+  textures_.push_back(std::move(texture));
+  std::shared_ptr<Texture> stored = textures_.back();
+
+  TrimResources();
+
+  return stored;
+}
+
+void Resources::setMemoryBudget(size_t bytes) {
+  memory_budget_ = bytes;
+  TrimResources();
+}
+
+//Removes an asset from the registry and its list. The list must hold the only reference left
+template<class T>
+static size_t EvictAsset(std::vector<std::shared_ptr<T>>& list, std::unordered_map<std::string, AssetEntry<T>>& paths,
+  std::unordered_map<std::string, std::string>& names, const std::string& key) {
+
+  auto it = paths.find(key);
+  if (it == paths.end()) { return 0; }
+
+  std::shared_ptr<T> asset = it->second.asset_.lock();
+  size_t size = it->second.size_;
+  paths.erase(it);
+
+  if (asset != nullptr) {
+    auto name = names.find(asset->name_);
+    if (name != names.end() && name->second == key) { names.erase(name); }
+
+    list.erase(std::remove(list.begin(), list.end(), asset), list.end());
+  }
+
+  return size;
+}
+
+//Updates the bytes counted for each asset with the size it has now
+template<class T>
+static void RefreshAssetSizes(std::unordered_map<std::string, AssetEntry<T>>& paths, size_t& memory_used) {
+  for (auto& [key, entry] : paths) {
+    std::shared_ptr<T> asset = entry.asset_.lock();
+    if (asset == nullptr) { continue; }
+    size_t size = asset->GetMemorySize();
+    memory_used += size - entry.size_;
+    entry.size_ = size;
+  }
+}
+
+size_t Resources::TrimResources() {
+
+  //Streamed meshes and textures keep growing after they are stored
+  RefreshAssetSizes(mesh_paths_, memory_used_);
+  RefreshAssetSizes(texture_paths_, memory_used_);
+
+  if (memory_used_ <= memory_budget_) { return 0; }
+
+  //Only the assets nobody else holds can go, the list keeps the one reference they have
+  struct Candidate {
+    uint64_t last_used_;
+    bool is_mesh_;
+    const std::string* key_;
+  };
+  std::vector<Candidate> candidates;
+  for (auto& [key, entry] : mesh_paths_) {
+    if (entry.asset_.use_count() <= 1) { candidates.push_back({ entry.last_used_, true, &key }); }
+  }
+  for (auto& [key, entry] : texture_paths_) {
+    if (entry.asset_.use_count() <= 1) { candidates.push_back({ entry.last_used_, false, &key }); }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.last_used_ < b.last_used_; });
+
+  size_t freed = 0;
+  for (size_t i = 0; i < candidates.size() && memory_used_ - freed > memory_budget_; ++i) {
+    //Copied, erasing the entry frees the key it points to
+    std::string key = *candidates[i].key_;
+    if (candidates[i].is_mesh_) { freed += EvictAsset(meshes_, mesh_paths_, mesh_names_, key); }
+    else { freed += EvictAsset(textures_, texture_paths_, texture_names_, key); }
+  }
+  memory_used_ -= freed;
+
+  if (freed != 0) {
+    printf("Resources: evicted %zu KB, %zu KB of %zu KB used\n", freed / 1024, memory_used_ / 1024, memory_budget_ / 1024);
+  }
+
+  return freed;
 }
 
 RenderingText* Resources::addTextToRender(std::string text, float x, float y, glm::vec3 color, float s){
@@ -141,24 +338,21 @@ Audio* Resources::addAudioFile(std::string filepath) {
 
 std::shared_ptr<TinyObj> Resources::getMeshByName(std::string objfile){
 
-    std::shared_ptr<TinyObj> found = nullptr;
+    auto it = mesh_names_.find(objfile);
+    if (it == mesh_names_.end()) { return nullptr; }
 
-    for (unsigned int i = 0; found == nullptr && i < meshes_.size(); ++i) {
-        if (objfile.compare(meshes_.at(i)->name_) == 0) {
-            found = meshes_.at(i);
-        }
-    }
+    return FindAsset(mesh_paths_, it->second, use_counter_);
+}
+
+std::shared_ptr<TinyObj> Resources::getMeshByPath(std::string filepath){
 
-    return found;
+    return FindAsset(mesh_paths_, AssetKey(filepath), use_counter_);
 }
 
 std::shared_ptr<Texture> Resources::getTextureByName(std::string texturefile) {
-    std::shared_ptr<Texture> found = nullptr;
 
-    for (unsigned int i = 0; found == nullptr && i < textures_.size(); ++i) {
-        if (texturefile.compare(textures_.at(i)->name_) == 0) {
-            found = textures_.at(i);
-        }
-    }
-    return found;
+    auto it = texture_names_.find(texturefile);
+    if (it == texture_names_.end()) { return nullptr; }
+
+    return FindAsset(texture_paths_, it->second, use_counter_);
 }
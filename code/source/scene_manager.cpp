@@ -1,6 +1,18 @@
 #include "scene_manager.hpp"
 #include <sqlite3.h>
 
+//Whether a table of the database has a column, the databases saved before the column was added don't
+static bool HasColumn(sqlite3* db, const char* table, const char* column) {
+  sqlite3_stmt* prepared_stmt;
+  if (sqlite3_prepare_v2(db, "SELECT COUNT (*) FROM pragma_table_info(?1) WHERE name = ?2;", -1, &prepared_stmt, NULL) != SQLITE_OK) {
+    return false;
+  }
+  sqlite3_bind_text(prepared_stmt, 1, table, -1, SQLITE_STATIC);
+  sqlite3_bind_text(prepared_stmt, 2, column, -1, SQLITE_STATIC);
+  bool found = sqlite3_step(prepared_stmt) == SQLITE_ROW && sqlite3_column_int(prepared_stmt, 0) != 0;
+  sqlite3_finalize(prepared_stmt);
+  return found;
+}
 
 SceneManager::SceneManager(){
   scene_selected_ = "";
@@ -57,6 +69,10 @@ int SceneManager::SaveNewScene(ComponentManager* component_manager, RenderSystem
 
   //Create database tables
   sqlite3_exec(db, database_creation_queries_.c_str(), nullptr, nullptr, nullptr);
+  //Databases saved before the occluders existed get the column when they're overwritten
+  if (!HasColumn(db, "renderer", "occluder")) {
+    sqlite3_exec(db, "ALTER TABLE renderer ADD COLUMN occluder INTEGER NOT NULL DEFAULT 0;", nullptr, nullptr, nullptr);
+  }
 
   //Allow foreign keys
   sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
@@ -373,16 +389,17 @@ int SceneManager::SaveNewScene(ComponentManager* component_manager, RenderSystem
   std::vector<component_node<RendererComponent>>* renderer_components = &(*static_cast<component_list<RendererComponent>*>(component_manager->components_classes_.find(render_hash)->second.get())).components_;
   size_t render_size = renderer_components->size();
   for (size_t i = 0; i < render_size; ++i) {
-    strcpy_s(str, "INSERT INTO renderer (render_id, entity_id, needs_light, casts_shadow, receives_shadows) VALUES (?1, ?2, ?3, ?4, ?5);");
+    strcpy_s(str, "INSERT INTO renderer (render_id, entity_id, needs_light, casts_shadow, receives_shadows, occluder) VALUES (?1, ?2, ?3, ?4, ?5, ?6);");
     sqlite3_prepare_v2(db, str, -1, &prepared_stmt, NULL);
     RendererComponent* r = &(renderer_components->at(i).data_);
 
     sqlite3_bind_int(prepared_stmt, 1, (int)i);
     sqlite3_bind_int(prepared_stmt, 2, (int)renderer_components->at(i).entity_id_);
-    //Light, cast, receives
+    //Light, cast, receives, occluder
     sqlite3_bind_int(prepared_stmt, 3, r->needs_light_);
     sqlite3_bind_int(prepared_stmt, 4, r->casts_shadows_);
     sqlite3_bind_int(prepared_stmt, 5, r->receives_shadows_);
+    sqlite3_bind_int(prepared_stmt, 6, r->occluder_);
 
     step_result = sqlite3_step(prepared_stmt);
     if (step_result != SQLITE_DONE) {
@@ -580,22 +597,24 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
   //Reset current scene
   component_manager->ResetComponentSystem();
 
-  //Load each texture
+  //Load each texture, the ones already loaded are reused so the ids don't match the resources list
+  std::vector<std::shared_ptr<Texture>> textures;
   strcpy_s(str, "SELECT texture_id, texture_src FROM textures;");
   sqlite3_prepare_v2(db, str, -1, &prepared_stmt, NULL);
   while (sqlite3_step(prepared_stmt) != SQLITE_DONE) {
     int id = sqlite3_column_int(prepared_stmt, 0);
     const char* t_src = (const char*)sqlite3_column_text(prepared_stmt, 1);
     #ifdef RENDER_OPENGL
-      render_system->resource_list_.addTexture(t_src);
+      textures.push_back(render_system->resource_list_.addTexture(t_src));
     #endif
     #ifdef RENDER_DIRECTX11
-      render_system->resource_list_.addTexture(static_cast<RenderSystemDirectX11*>(render_system)->getDevice(), t_src);
+      textures.push_back(render_system->resource_list_.addTexture(static_cast<RenderSystemDirectX11*>(render_system)->getDevice(), t_src));
     #endif 
   }
   sqlite3_reset(prepared_stmt);
 
   //Load each mesh
+  std::vector<std::shared_ptr<TinyObj>> meshes;
   strcpy_s(str, "SELECT mesh_id, mesh_src, cull_type FROM meshes;");
   sqlite3_prepare_v2(db, str, -1, &prepared_stmt, NULL);
   while (sqlite3_step(prepared_stmt) != SQLITE_DONE) {
@@ -611,9 +630,19 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
         shared = render_system->resource_list_.addMesh(r->getDevice(), r->getDeviceContext(), t_src);
     #endif 
     shared->cull_type_ = cull;
+    meshes.push_back(shared);
   }
   sqlite3_reset(prepared_stmt);
 
+  return LoadSceneContents(db, component_manager, render_system, textures, meshes);
+}
+
+bool SceneManager::LoadSceneContents(sqlite3* db, ComponentManager* component_manager, RenderSystem* render_system,
+  const std::vector<std::shared_ptr<Texture>>& textures, const std::vector<std::shared_ptr<TinyObj>>& meshes) {
+
+  char str[1024];
+  sqlite3_stmt* prepared_stmt;
+
   //Save each rendered text
   strcpy_s(str, "SELECT screen_text_id, text_, color_x, color_y, color_z, pos_x, pos_y, scale FROM screen_text;");
   sqlite3_prepare_v2(db, str, -1, &prepared_stmt, NULL);
@@ -842,9 +871,12 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
   size_t num_renderers = (size_t)sqlite3_column_int(prepared_stmt, 0);
   sqlite3_reset(prepared_stmt);
 
+  //The renderers of databases saved before the occluders existed aren't occluders
+  const char* occluder_column = HasColumn(db, "renderer", "occluder") ? "occluder" : "0";
+
   //Create each render component and it's associated textures and mesh
   for (size_t i = 0; i < num_renderers; ++i) {
-    strcpy_s(str, "SELECT entity_id, needs_light, casts_shadow, receives_shadows FROM renderer WHERE render_id = ?1;");
+    sprintf_s(str, "SELECT entity_id, needs_light, casts_shadow, receives_shadows, %s FROM renderer WHERE render_id = ?1;", occluder_column);
     sqlite3_prepare_v2(db, str, -1, &prepared_stmt, NULL);
     sqlite3_bind_int(prepared_stmt, 1, (int)i);
 
@@ -854,12 +886,14 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
       bool needs_light = sqlite3_column_int(prepared_stmt, 1);
       bool casts_shadow = sqlite3_column_int(prepared_stmt, 2);
       bool receives_shadows = sqlite3_column_int(prepared_stmt, 3);
+      bool occluder = sqlite3_column_int(prepared_stmt, 4);
       sqlite3_reset(prepared_stmt);
 
       RendererComponent* r = component_manager->addComponent<RendererComponent>(entity_correspondance[entity_id]);
       r->needs_light_ = needs_light;
       r->casts_shadows_ = casts_shadow;
       r->receives_shadows_ = receives_shadows;
+      r->occluder_ = occluder;
 
       //Load the textures
       strcpy_s(str, "SELECT texture_id FROM textures_of_renderer WHERE render_id = ?1");
@@ -867,7 +901,7 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
       sqlite3_bind_int(prepared_stmt, 1, (int)i);
       while (sqlite3_step(prepared_stmt) != SQLITE_DONE) {
         size_t text_pos = sqlite3_column_int(prepared_stmt, 0);
-        r->AddTexture(render_system->resource_list_.textures_.at(text_pos));
+        r->AddTexture(textures.at(text_pos));
       }
       sqlite3_reset(prepared_stmt);
 
@@ -877,7 +911,7 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
       sqlite3_bind_int(prepared_stmt, 1, (int)i);
       while (sqlite3_step(prepared_stmt) != SQLITE_DONE) {
         size_t mesh_id = sqlite3_column_int(prepared_stmt, 0);
-        r->Init(render_system->resource_list_.meshes_.at(mesh_id));
+        r->Init(meshes.at(mesh_id));
       }
       sqlite3_reset(prepared_stmt);
 
@@ -972,6 +1006,102 @@ bool SceneManager::LoadScene(ComponentManager* component_manager, RenderSystem*
 }
 
 
+#ifdef RENDER_OPENGL
+//Loads a texture on a worker, without creating its Opengl buffer
+static eve::task<> LoadSceneTexture(std::shared_ptr<Texture>* texture, std::string src) {
+  *texture = std::make_shared<Texture>();
+  (*texture)->LoadTextureNoInit(src);
+  co_return;
+}
+
+//Loads a mesh on a worker, without creating its Opengl buffers
+static eve::task<> LoadSceneMesh(std::shared_ptr<TinyObj>* mesh, std::string src, int cull) {
+  *mesh = std::make_shared<TinyObj>();
+  (*mesh)->LoadMesh(src);
+  (*mesh)->cull_type_ = cull;
+  co_return;
+}
+
+eve::task<bool> SceneManager::LoadSceneAsync(ComponentManager* component_manager, RenderSystem* render_system, Boss* boss, std::string scene_name) {
+
+  //If empty or doesn't exist, exit
+  if (scene_name.empty() || !SceneManager::ExistsDB(scene_name)) {
+    printf("missing scene %s\n", scene_name.c_str());
+    co_return false;
+  }
+
+  //Everything until the buffers creation happens on the workers
+  co_await eve::schedule_on(*boss);
+
+  sqlite3* db = nullptr;
+  sqlite3_stmt* prepared_stmt;
+  std::string fullpath = DATABASE_PATH + scene_name;
+  fullpath.append(".db");
+  if (sqlite3_open(fullpath.c_str(), &db) != SQLITE_OK) {
+    printf("\x1b[31m Error opening database in path: %s \x1b[0m\n", scene_name.c_str());
+    SceneManager::PrintLastError(db);
+    co_return false;
+  }
+
+  //Gather the resources of the scene
+  std::vector<std::string> texture_srcs;
+  sqlite3_prepare_v2(db, "SELECT texture_id, texture_src FROM textures;", -1, &prepared_stmt, NULL);
+  while (sqlite3_step(prepared_stmt) != SQLITE_DONE) {
+    texture_srcs.push_back((const char*)sqlite3_column_text(prepared_stmt, 1));
+  }
+  sqlite3_reset(prepared_stmt);
+
+  std::vector<std::string> mesh_srcs;
+  std::vector<int> mesh_culls;
+  sqlite3_prepare_v2(db, "SELECT mesh_id, mesh_src, cull_type FROM meshes;", -1, &prepared_stmt, NULL);
+  while (sqlite3_step(prepared_stmt) != SQLITE_DONE) {
+    mesh_srcs.push_back((const char*)sqlite3_column_text(prepared_stmt, 1));
+    mesh_culls.push_back(sqlite3_column_int(prepared_stmt, 2));
+  }
+  sqlite3_reset(prepared_stmt);
+
+  //Load all of them in parallel
+  std::vector<std::shared_ptr<Texture>> textures(texture_srcs.size());
+  std::vector<std::shared_ptr<TinyObj>> meshes(mesh_srcs.size());
+  std::vector<eve::task<>> loads;
+  for (size_t i = 0; i < texture_srcs.size(); ++i) {
+    loads.push_back(LoadSceneTexture(&textures[i], texture_srcs[i]));
+  }
+  for (size_t i = 0; i < mesh_srcs.size(); ++i) {
+    loads.push_back(LoadSceneMesh(&meshes[i], mesh_srcs[i], mesh_culls[i]));
+  }
+  co_await eve::when_all(*boss, std::move(loads));
+
+  //Opengl buffers and the entities have to be created from the main thread
+  co_await eve::next_frame(*boss);
+
+  //Reset current scene
+  component_manager->ResetComponentSystem();
+
+  //Files that were already loaded keep the previous copy, the new one is dropped.
+  //The new ones are packed and uploaded over the next frames, see UploadTexture for when they are drawn
+  Resources& resources = render_system->resource_list_;
+  for (size_t i = 0; i < textures.size(); ++i) {
+    std::shared_ptr<Texture> stored = resources.storeTexture(textures[i]);
+    if (stored == textures[i]) {
+      stored->array_pool_ = resources.texture_arrays_;
+      if (resources.texture_streamer_ != nullptr) { eve::spawn(*boss, UploadTexture(stored, *boss, *resources.texture_streamer_, kTextureStreamInitialSize)); }
+      else { stored->InitTexture(); }
+    }
+    textures[i] = std::move(stored);
+  }
+  //Only the meshes that weren't loaded already take room in the arena
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    std::shared_ptr<TinyObj> stored = resources.storeMesh(meshes[i]);
+    if (stored == meshes[i]) { stored->InitBuffer(resources.geometry_arena_); }
+    stored->cull_type_ = meshes[i]->cull_type_;
+    meshes[i] = std::move(stored);
+  }
+
+  co_return LoadSceneContents(db, component_manager, render_system, textures, meshes);
+}
+#endif
+
 void SceneManager::QueryScenes(){
   
   scenes_.clear();
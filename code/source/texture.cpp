@@ -1,5 +1,11 @@
 #include <texture.hpp>
 
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -11,118 +17,381 @@ Texture::Texture() {
 	channels_ = 0;
 	loaded_ = false;
 	texture_id_ = -1;
+	gpu_size_ = 0;
+	loaded_from_cache_ = false;
+	cook_flags_ = kTextureCookDefault;
+	load_time_ms_ = 0.0f;
+	array_ = nullptr;
+	array_layer_ = 0;
+	pending_array_ = nullptr;
+	pending_layer_ = 0;
+	storage_format_ = TextureFormat::kRGBA8;
+	level_count_ = 0;
+	resident_level_ = 0;
+	requested_level_ = 0;
+	target_level_ = 0;
+	last_requested_frame_ = 0;
+	can_stream_levels_ = false;
+	streaming_levels_ = false;
 }
 
 Texture::~Texture() {
-	if (loaded_ && texture_id_ != -1) {
+	FreeArrayLayer();
+	//Created by the first upload even if no level made it
+	if (texture_id_ != -1) {
 		glDeleteTextures(1, &texture_id_);
 		loaded_ = false;
 	}
 }
-bool Texture::LoadTexture(std::string src) {
-	if (src.empty()) return false;
+bool Texture::LoadTexture(std::string src, Boss* boss) {
+	return LoadTextureNoInit(src, boss) && InitTexture();
+}
 
-	//Get img data
-	stbi_set_flip_vertically_on_load(true);
+bool Texture::LoadTextureNoInit(std::string src, Boss* boss) {
+	if (src.empty()) return false;
 
+	auto start = std::chrono::steady_clock::now();
 
-	data_ = stbi_load(src.c_str(), &width_, &height_, &channels_, 0);
-	if (data_ == nullptr) {
+	loaded_from_cache_ = LoadCache(src);
+	if (!loaded_from_cache_ && !CookTexture(src, boss)) {
 		printf("Error loading texture from file %s\n", src.c_str());
 		return false;
 	}
 
-	if (channels_ == 1) { format = GL_RED; }
-	else if (channels_ == 3) { format = GL_RGB; }
-	else if (channels_ == 4) { format = GL_RGBA; }
+	load_time_ms_ = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	SetPath(src);
+
+	if (loaded_from_cache_) {
+		printf("Texture %s: warm load from cooked file in %.3f ms\n", name_.c_str(), load_time_ms_);
+		can_stream_levels_ = true;
+	}
+	else {
+		printf("Texture %s: cold load from image in %.3f ms\n", name_.c_str(), load_time_ms_);
+		//Cook it for the next time
+		can_stream_levels_ = SaveCache(src);
+		if (!can_stream_levels_) {
+			printf("Texture %s: couldn't write the cooked file\n", name_.c_str());
+		}
+	}
+
+	return true;
+}
+
+//Reads the header of a cooked file, checking every level is where it says
+static bool ReadCacheHeader(const MappedFile& file, TextureCacheHeader* header_out) {
+	if (file.size() < sizeof(TextureCacheHeader)) { return false; }
+
+	TextureCacheHeader header;
+	memcpy(&header, file.data(), sizeof(TextureCacheHeader));
+
+	if (memcmp(header.magic_, kTextureCacheMagic, sizeof(kTextureCacheMagic)) != 0 ||
+		header.version_ != kTextureCacheVersion ||
+		header.level_count_ == 0 || header.level_count_ > kTextureMaxLevels ||
+		header.width_ == 0 || header.height_ == 0 ||
+		(header.format_ != TextureFormat::kRGBA8 && header.format_ != TextureFormat::kBC1 && header.format_ != TextureFormat::kBC3)) {
+		return false;
+	}
+
+	int level_width = (int)header.width_;
+	int level_height = (int)header.height_;
+	for (uint32_t level = 0; level < header.level_count_; ++level) {
+		if (header.level_sizes_[level] != GetTextureLevelSize(header.format_, level_width, level_height) ||
+			header.level_offsets_[level] + header.level_sizes_[level] > file.size()) {
+			return false;
+		}
+		level_width = std::max(1, level_width / 2);
+		level_height = std::max(1, level_height / 2);
+	}
+
+	*header_out = header;
+	return true;
+}
+
+bool Texture::LoadCache(std::string src) {
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+	if (!file->Open(src + kTextureCacheExtension)) { return false; }
+
+	TextureCacheHeader header;
+	if (!ReadCacheHeader(*file, &header)) { return false; }
+	if (header.cook_flags_ != cook_flags_) { return false; }
+
+	//Cooked somewhere with S3TC support, it has to be cooked again uncompressed
+	if (header.format_ != TextureFormat::kRGBA8 && !GLEW_EXT_texture_compression_s3tc) { return false; }
+
+	//Discard it if the image has changed since it was cooked. Without the image, the cooked file is enough
+	std::error_code error;
+	if (std::filesystem::exists(src, error)) {
+		uint64_t source_size = (uint64_t)std::filesystem::file_size(src, error);
+		int64_t source_time = (int64_t)std::filesystem::last_write_time(src, error).time_since_epoch().count();
+		if (error || source_size != header.source_size_ || source_time != header.source_time_) {
+			return false;
+		}
+	}
+
+	width_ = (int)header.width_;
+	height_ = (int)header.height_;
+	channels_ = (int)header.channels_;
+	format = header.channels_ == 2 || header.channels_ == 4 ? GL_RGBA : GL_RGB;
+	storage_format_ = header.format_;
+	level_count_ = header.level_count_;
+	resident_level_ = level_count_;
+	requested_level_ = level_count_;
+	cache_file_ = std::move(file);
+	return true;
+}
+
+std::unique_ptr<MappedFile> Texture::MapCookedLevels() const {
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+	if (!file->Open(src_ + kTextureCacheExtension)) { return nullptr; }
+
+	//Cooked again from a different image since it was loaded
+	TextureCacheHeader header;
+	if (!ReadCacheHeader(*file, &header) || header.width_ != (uint32_t)width_ || header.height_ != (uint32_t)height_ ||
+		header.format_ != storage_format_ || header.level_count_ != level_count_) {
+		return nullptr;
+	}
+	return file;
+}
+
+bool Texture::CookTexture(std::string src, Boss* boss) {
+	//The flip is global to stb, it's set every time
+	stbi_set_flip_vertically_on_load((cook_flags_ & kTextureCookFlip) != 0);
+
+	//Always decoded to 4 channels, the blocks are read the same way whatever the source has
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(src.c_str(), &width, &height, &channels, 4);
+	if (pixels == nullptr) { return false; }
+
+	bool transparent = false;
+	if (channels == 2 || channels == 4) {
+		for (size_t i = 3; i < (size_t)width * height * 4 && !transparent; i += 4) { transparent = pixels[i] != 255; }
+	}
+
+	//The times of the image are filled when the file is saved
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(TextureCacheHeader));
+	memcpy(header.magic_, kTextureCacheMagic, sizeof(kTextureCacheMagic));
+	header.version_ = kTextureCacheVersion;
+	header.width_ = (uint32_t)width;
+	header.height_ = (uint32_t)height;
+	header.channels_ = (uint32_t)channels;
+	header.cook_flags_ = cook_flags_;
+	//Without S3TC support the levels are stored as they are, still saving the decode and the mipmap generation
+	if (!GLEW_EXT_texture_compression_s3tc) { header.format_ = TextureFormat::kRGBA8; }
+	else { header.format_ = transparent ? TextureFormat::kBC3 : TextureFormat::kBC1; }
+
+	//Every level down to 1x1, as long as it fits in the header
+	uint64_t offset = sizeof(TextureCacheHeader);
+	int level_width = width;
+	int level_height = height;
+	while (header.level_count_ < kTextureMaxLevels) {
+		header.level_offsets_[header.level_count_] = offset;
+		header.level_sizes_[header.level_count_] = GetTextureLevelSize(header.format_, level_width, level_height);
+		offset += header.level_sizes_[header.level_count_];
+		header.level_count_++;
+		if ((cook_flags_ & kTextureCookMipmaps) == 0 || (level_width == 1 && level_height == 1)) { break; }
+		level_width = std::max(1, level_width / 2);
+		level_height = std::max(1, level_height / 2);
+	}
+
+	cooked_.resize(offset);
+	memcpy(cooked_.data(), &header, sizeof(TextureCacheHeader));
+
+	//Each level is filtered from the previous one before compressing it, never from the compressed blocks
+	std::vector<uint8_t> level_pixels;
+	std::vector<uint8_t> next_pixels;
+	const uint8_t* source = pixels;
+	level_width = width;
+	level_height = height;
+	for (uint32_t level = 0; level < header.level_count_; ++level) {
+		if (header.format_ == TextureFormat::kRGBA8) {
+			memcpy(cooked_.data() + header.level_offsets_[level], source, header.level_sizes_[level]);
+		}
+		else {
+			CompressImage(header.format_, source, level_width, level_height, cooked_.data() + header.level_offsets_[level], boss);
+		}
+		if (level + 1 == header.level_count_) { break; }
+
+		DownsampleImage(source, level_width, level_height, next_pixels);
+		level_pixels.swap(next_pixels);
+		source = level_pixels.data();
+		level_width = std::max(1, level_width / 2);
+		level_height = std::max(1, level_height / 2);
+	}
+	stbi_image_free(pixels);
+
+	width_ = width;
+	height_ = height;
+	channels_ = channels;
+	format = channels == 2 || channels == 4 ? GL_RGBA : GL_RGB;
+	storage_format_ = header.format_;
+	level_count_ = header.level_count_;
+	resident_level_ = level_count_;
+	requested_level_ = level_count_;
+
+	return true;
+}
+
+bool Texture::SaveCache(std::string src) const {
+	if (cooked_.size() <= sizeof(TextureCacheHeader)) { return false; }
+
+	std::error_code error;
+	TextureCacheHeader header;
+	memcpy(&header, cooked_.data(), sizeof(TextureCacheHeader));
+	header.source_size_ = (uint64_t)std::filesystem::file_size(src, error);
+	header.source_time_ = (int64_t)std::filesystem::last_write_time(src, error).time_since_epoch().count();
+	if (error) { return false; }
+
+	FILE* f = nullptr;
+	fopen_s(&f, (src + kTextureCacheExtension).c_str(), "wb");
+	if (f == nullptr) { return false; }
+
+	const size_t level_bytes = cooked_.size() - sizeof(TextureCacheHeader);
+	bool written = fwrite(&header, sizeof(TextureCacheHeader), 1, f) == 1;
+	written = written && fwrite(cooked_.data() + sizeof(TextureCacheHeader), 1, level_bytes, f) == level_bytes;
+	fclose(f);
+
+	//Don't leave a broken file behind
+	if (!written) { std::filesystem::remove(src + kTextureCacheExtension, error); }
+
+	return written;
+}
+
+const uint8_t* Texture::GetCookedData() const {
+	if (cache_file_ != nullptr) { return cache_file_->data(); }
+	return cooked_.empty() ? nullptr : cooked_.data();
+}
+
+bool Texture::BeginUpload(uint32_t first_level) {
+	if (array_pool_ != nullptr && texture_id_ == -1) {
+		int first_width = std::max(1, width_ >> first_level);
+		int first_height = std::max(1, height_ >> first_level);
+		pending_array_ = array_pool_->Allocate(first_width, first_height, storage_format_, level_count_ - first_level, format, &pending_layer_);
+		if (pending_array_ != nullptr) { return true; }
+		//Too big for an array, it gets its own texture like the rest unless it's already packed
+		if (array_ != nullptr) { return false; }
+	}
+
+	if (texture_id_ != -1) { return true; }
 
-	//Generate buffer from data with needed values
 	glGenTextures(1, &texture_id_);
 	glBindTexture(GL_TEXTURE_2D, texture_id_);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, data_);
-	glGenerateMipmap(GL_TEXTURE_2D);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glBindTexture(GL_TEXTURE_2D, 0);
+	resident_level_ = level_count_;
+	gpu_size_ = 0;
+	return true;
+}
 
-	//Free old data
-	stbi_image_free(data_);
-
-	//Set the file name from the source
-	char search_start = '/';
-	char search_end = '.';
-	size_t init_pos = -1;
-	size_t end_pos = -1;
-
-	//Find last ocurrence of the separator
-	init_pos = src.rfind(search_start);
-	end_pos = src.rfind(search_end);
+void Texture::UploadLevel(uint32_t level, const void* pixels) {
+	int level_width = std::max(1, width_ >> level);
+	int level_height = std::max(1, height_ >> level);
+	GLsizei level_size = (GLsizei)GetTextureLevelSize(storage_format_, level_width, level_height);
+
+	//The storage of every level of the layer already exists, the level is only written into it
+	if (pending_array_ != nullptr) {
+		GLint array_level = (GLint)(level - (level_count_ - pending_array_->level_count_));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, pending_array_->texture_id_);
+		if (storage_format_ == TextureFormat::kRGBA8) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, array_level, 0, 0, pending_layer_, level_width, level_height, 1,
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+		else {
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, array_level, 0, 0, pending_layer_, level_width, level_height, 1,
+				GetTextureInternalFormat(storage_format_), level_size, pixels);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return;
+	}
 
-	if (init_pos != -1) {
-		name_ = src.substr(init_pos + 1, end_pos - (init_pos + 1));
+	glBindTexture(GL_TEXTURE_2D, texture_id_);
+	if (storage_format_ == TextureFormat::kRGBA8) {
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, level_width, level_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	else {
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, GetTextureInternalFormat(storage_format_), level_width, level_height, 0,
+			level_size, pixels);
 	}
-	else { name_ = "unnamed"; }
 
-	//Mark as loaded and save the source route
+	//Only the levels already uploaded are sampled, so the texture is complete after each one
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count_ - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	resident_level_ = level;
+	gpu_size_ = GetLevelsSize(level);
 	loaded_ = true;
-	src_ = src;
+}
 
+void Texture::EndUpload() {
+	if (pending_array_ != nullptr) {
+		if (array_ != nullptr) { array_pool_->Free(array_, array_layer_); }
+		array_ = pending_array_;
+		array_layer_ = pending_layer_;
+		pending_array_ = nullptr;
 
-	return true;
-}
+		resident_level_ = level_count_ - array_->level_count_;
+		gpu_size_ = GetLevelsSize(resident_level_);
+		loaded_ = true;
+	}
 
-bool Texture::LoadTextureNoInit(std::string src) {
-	if (src.empty()) return false;
+	cache_file_.reset();
+	std::vector<uint8_t>().swap(cooked_);
+}
 
-	//Get img data
-	stbi_set_flip_vertically_on_load(true);
+bool Texture::DropLevels(uint32_t first_level) {
+	if (array_ != nullptr || texture_id_ == -1 || first_level <= resident_level_ || first_level >= level_count_) { return false; }
 
-	data_ = stbi_load(src.c_str(), &width_, &height_, &channels_, 0);
-	if (data_ == nullptr) {
-		printf("Error loading texture from file %s\n", src.c_str());
-		return false;
+	//The base level goes up first, the levels below it don't count for completeness and can be emptied
+	glBindTexture(GL_TEXTURE_2D, texture_id_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first_level);
+	for (uint32_t level = resident_level_; level < first_level; ++level) {
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 	}
+	glBindTexture(GL_TEXTURE_2D, 0);
 
-	if (channels_ == 1) { format = GL_RED; }
-	else if (channels_ == 3) { format = GL_RGB; }
-	else if (channels_ == 4) { format = GL_RGBA; }
-	src_ = src;
+	resident_level_ = first_level;
+	gpu_size_ = GetLevelsSize(first_level);
+	return true;
+}
 
-	//Set the file name from the source
-	char search_start = '/';
-	char search_end = '.';
-	size_t init_pos = -1;
-	size_t end_pos = -1;
+void Texture::RequestLevel(float pixels) {
+	//The levels aren't known until the texture is uploaded
+	if (!loaded_ || level_count_ == 0) { return; }
 
-	//Find last ocurrence of the separator
-	init_pos = src.rfind(search_start);
-	end_pos = src.rfind(search_end);
+	float texels = (float)std::max(width_, height_);
+	uint32_t level = 0;
+	if (pixels <= 0.0f) { level = level_count_ - 1; }
+	else if (texels > pixels) { level = std::min((uint32_t)log2f(texels / pixels), level_count_ - 1); }
 
-	if (init_pos != -1) {
-		name_ = src.substr(init_pos + 1, end_pos - (init_pos + 1));
-	}
-	else { name_ = "unnamed"; }
+	requested_level_ = std::min(requested_level_, level);
+}
 
-	return true;
+size_t Texture::GetLevelsSize(uint32_t first_level) const {
+	size_t size = 0;
+	for (uint32_t level = first_level; level < level_count_; ++level) {
+		size += GetTextureLevelSize(storage_format_, std::max(1, width_ >> level), std::max(1, height_ >> level));
+	}
+	return size;
 }
 
 bool Texture::InitTexture(){
-	if (!loaded_) {
-		//Generate buffer from data with needed values
-		glGenTextures(1, &texture_id_);
-		glBindTexture(GL_TEXTURE_2D, texture_id_);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, data_);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	const uint8_t* cooked = GetCookedData();
+	if (!loaded_ && cooked != nullptr) {
+		//Upload every level straight from the cooked data, there's nothing left to decode or generate
+		TextureCacheHeader header;
+		memcpy(&header, cooked, sizeof(TextureCacheHeader));
+
+		BeginUpload();
+		for (uint32_t level = header.level_count_; level-- > 0;) {
+			UploadLevel(level, cooked + header.level_offsets_[level]);
+		}
 
 		//Free old data
-		stbi_image_free(data_);
+		EndUpload();
 
 		//Mark as loaded and save the source route
 		loaded_ = true;
@@ -139,36 +408,41 @@ bool Texture::LoadCubemapTexture(std::string filepath) {
 		return false;
 	}
 
-	glGenTextures(1, &texture_id_);
-	glBindTexture(GL_TEXTURE_2D, texture_id_);
-
-	stbi_uc* data = nullptr;
-	data = stbi_load(filepath.c_str(), &width_, &height_, &channels_, 0);
-	if (data != nullptr) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	//Cooked like any other texture but as the image is, the sky map isn't flipped and it's sampled without mips
+	cook_flags_ = 0;
+	if (!LoadTextureNoInit(filepath) || !InitTexture()) {
+		printf("Cubemap texture failed to load at path: %s\n", filepath.c_str());
+		return false;
 	}
-	else { printf("Cubemap texture failed to load at path: %s\n", filepath.c_str()); }
 
+	glBindTexture(GL_TEXTURE_2D, texture_id_);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	stbi_image_free(data);
-
-	src_ = filepath;
-
-	loaded_ = true;
 	return true;
 }
 
+void Texture::FreeArrayLayer() {
+	if (array_ != nullptr) {
+		array_pool_->Free(array_, array_layer_);
+		array_ = nullptr;
+	}
+	if (pending_array_ != nullptr) {
+		array_pool_->Free(pending_array_, pending_layer_);
+		pending_array_ = nullptr;
+	}
+}
+
 bool Texture::FreeTexture() {
-	if (loaded_ && texture_id_ != -1) {
+	if (texture_id_ != -1) {
 		glDeleteTextures(1, &texture_id_);
-		loaded_ = false;
+		texture_id_ = -1;
 	}
+	FreeArrayLayer();
+	loaded_ = false;
 return true;
 }
 #endif
@@ -325,4 +599,32 @@ bool Texture::FreeTexture() {
 	}
 	return true;
 }
-#endif 
\ No newline at end of file
+#endif 
+
+void Texture::SetPath(std::string src) {
+	src_ = src;
+
+	//Set the file name from the source
+	char search_start = '/';
+	char search_end = '.';
+	size_t init_pos = -1;
+	size_t end_pos = -1;
+
+	//Find last ocurrence of the separator
+	init_pos = src.rfind(search_start);
+	end_pos = src.rfind(search_end);
+
+	if (init_pos != -1) {
+		name_ = src.substr(init_pos + 1, end_pos - (init_pos + 1));
+	}
+	else { name_ = "unnamed"; }
+}
+
+size_t Texture::GetMemorySize() const {
+#ifdef RENDER_OPENGL
+	if (gpu_size_ != 0) { return gpu_size_; }
+#endif
+	//Drivers store the 8 bit RGB textures with 4 bytes per texel, and the mip chain adds a third
+	size_t size = (size_t)width_ * height_ * 4;
+	return size + size / 3;
+}
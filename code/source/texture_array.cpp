@@ -0,0 +1,122 @@
+#include <texture_array.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef RENDER_OPENGL
+GLenum GetTextureInternalFormat(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::kBC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TextureFormat::kBC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default: return GL_RGBA8;
+	}
+}
+
+TextureArrayPool::TextureArrayPool() {}
+
+TextureArrayPool::~TextureArrayPool() {
+	for (const std::unique_ptr<TextureArray>& array : arrays_) {
+		glDeleteTextures(1, &array->texture_id_);
+	}
+}
+
+TextureArray* TextureArrayPool::Allocate(int width, int height, TextureFormat format, uint32_t level_count, unsigned int wrap_format, uint32_t* layer) {
+	size_t layer_size = 0;
+	for (uint32_t level = 0; level < level_count; ++level) {
+		layer_size += GetTextureLevelSize(format, std::max(1, width >> level), std::max(1, height >> level));
+	}
+	if (layer_size > kTextureArrayMaxBytes) { return nullptr; }
+
+	//Any array of the same kind with room left, remembering how big the last one was
+	uint32_t biggest = 0;
+	for (const std::unique_ptr<TextureArray>& array : arrays_) {
+		if (array->width_ != width || array->height_ != height || array->format_ != format ||
+			array->level_count_ != level_count || array->wrap_format_ != wrap_format) {
+			continue;
+		}
+		if (!array->free_layers_.empty()) {
+			*layer = array->free_layers_.back();
+			array->free_layers_.pop_back();
+			return array.get();
+		}
+		biggest = std::max(biggest, array->layer_count_);
+	}
+
+	std::unique_ptr<TextureArray> array = std::make_unique<TextureArray>();
+	array->width_ = width;
+	array->height_ = height;
+	array->format_ = format;
+	array->level_count_ = level_count;
+	array->wrap_format_ = wrap_format;
+	array->layer_size_ = layer_size;
+	array->layer_count_ = biggest == 0 ? kTextureArrayInitialLayers : biggest * 2;
+	array->layer_count_ = std::min(array->layer_count_, kTextureArrayMaxLayers);
+	array->layer_count_ = std::max(1u, std::min(array->layer_count_, (uint32_t)(kTextureArrayMaxBytes / layer_size)));
+	CreateStorage(*array);
+
+	//Taken from the back, so the first layers are used first
+	for (uint32_t free_layer = array->layer_count_; free_layer-- > 1;) {
+		array->free_layers_.push_back(free_layer);
+	}
+	*layer = 0;
+
+	arrays_.push_back(std::move(array));
+	return arrays_.back().get();
+}
+
+void TextureArrayPool::Free(TextureArray* array, uint32_t layer) {
+	array->free_layers_.push_back(layer);
+	if (array->free_layers_.size() < array->layer_count_) { return; }
+
+	for (size_t i = 0; i < arrays_.size(); ++i) {
+		if (arrays_[i].get() == array) {
+			glDeleteTextures(1, &array->texture_id_);
+			arrays_.erase(arrays_.begin() + i);
+			return;
+		}
+	}
+}
+
+size_t TextureArrayPool::GetMemorySize() const {
+	size_t size = 0;
+	for (const std::unique_ptr<TextureArray>& array : arrays_) {
+		size += array->layer_size_ * array->layer_count_;
+	}
+	return size;
+}
+
+void TextureArrayPool::CreateStorage(TextureArray& array) {
+	GLenum internal_format = GetTextureInternalFormat(array.format_);
+	GLint wrap = array.wrap_format_ == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+	//A bound pixel unpack buffer would turn the null data into an offset to read from
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glGenTextures(1, &array.texture_id_);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture_id_);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.level_count_ - 1);
+
+	for (uint32_t level = 0; level < array.level_count_; ++level) {
+		int level_width = std::max(1, array.width_ >> level);
+		int level_height = std::max(1, array.height_ >> level);
+		if (array.format_ == TextureFormat::kRGBA8) {
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, level_width, level_height, array.layer_count_, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+		else {
+			GLsizei level_size = (GLsizei)(GetTextureLevelSize(array.format_, level_width, level_height) * array.layer_count_);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, level_width, level_height, array.layer_count_, 0,
+				level_size, nullptr);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	printf("Texture array %dx%d: %u layers of %u levels, %.2f MB\n", array.width_, array.height_, array.layer_count_,
+		array.level_count_, (double)(array.layer_size_ * array.layer_count_) / (1024.0 * 1024.0));
+}
+#endif
@@ -0,0 +1,262 @@
+#include <texture_compressor.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <boss.hpp>
+
+size_t GetTextureLevelSize(TextureFormat format, int width, int height) {
+	if (format == TextureFormat::kRGBA8) { return (size_t)width * height * 4; }
+
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == TextureFormat::kBC1 ? 8 : 16);
+}
+
+//Copies the 4x4 pixels of a block, repeating the last row and column on the edges of the image
+static void FetchBlock(const uint8_t* rgba, int width, int height, int block_x, int block_y, uint8_t block[64]) {
+	for (int y = 0; y < 4; ++y) {
+		int source_y = std::min(block_y * 4 + y, height - 1);
+		for (int x = 0; x < 4; ++x) {
+			int source_x = std::min(block_x * 4 + x, width - 1);
+			memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)source_y * width + source_x) * 4, 4);
+		}
+	}
+}
+
+static uint16_t PackColor565(const float color[3]) {
+	int r = (int)std::clamp(color[0] * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f);
+	int g = (int)std::clamp(color[1] * (63.0f / 255.0f) + 0.5f, 0.0f, 63.0f);
+	int b = (int)std::clamp(color[2] * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackColor565(uint16_t packed, int color[3]) {
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+//Picks the closest of the four colors of the endpoints for each pixel, returning the total squared error
+static int ChooseColorIndexes(const uint8_t block[64], uint16_t color0, uint16_t color1, uint32_t* indexes) {
+	int palette[4][3];
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	for (int c = 0; c < 3; ++c) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	int total_error = 0;
+	*indexes = 0;
+	for (int i = 0; i < 16; ++i) {
+		const uint8_t* pixel = block + i * 4;
+		int best = 0;
+		int best_error = 0x7FFFFFFF;
+		for (int p = 0; p < 4; ++p) {
+			int dr = pixel[0] - palette[p][0];
+			int dg = pixel[1] - palette[p][1];
+			int db = pixel[2] - palette[p][2];
+			int error = dr * dr + dg * dg + db * db;
+			if (error < best_error) { best = p; best_error = error; }
+		}
+		*indexes |= (uint32_t)best << (i * 2);
+		total_error += best_error;
+	}
+	return total_error;
+}
+
+//Solves the endpoints that best fit the pixels with the indexes chosen, by least squares
+static bool RefineEndpoints(const uint8_t block[64], uint32_t indexes, float endpoint0[3], float endpoint1[3]) {
+	static const float kWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f };
+	float bx[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		float a = kWeights[(indexes >> (i * 2)) & 3];
+		float b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < 3; ++c) {
+			ax[c] += a * block[i * 4 + c];
+			bx[c] += b * block[i * 4 + c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f) { return false; }
+
+	float inverse = 1.0f / determinant;
+	for (int c = 0; c < 3; ++c) {
+		endpoint0[c] = (ax[c] * bb - bx[c] * ab) * inverse;
+		endpoint1[c] = (bx[c] * aa - ax[c] * ab) * inverse;
+	}
+	return true;
+}
+
+//Endpoints along the principal axis of the colors, refined once, always in the four color mode
+static void EncodeColorBlock(const uint8_t block[64], uint8_t out[8]) {
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 3; ++c) { mean[c] += block[i * 4 + c]; }
+	}
+	for (int c = 0; c < 3; ++c) { mean[c] /= 16.0f; }
+
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		float r = block[i * 4] - mean[0];
+		float g = block[i * 4 + 1] - mean[1];
+		float b = block[i * 4 + 2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	//Power iteration, a few steps are enough to find the axis the colors spread along
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; ++iteration) {
+		float x = axis[0] * covariance[0] + axis[1] * covariance[1] + axis[2] * covariance[2];
+		float y = axis[0] * covariance[1] + axis[1] * covariance[3] + axis[2] * covariance[4];
+		float z = axis[0] * covariance[2] + axis[1] * covariance[4] + axis[2] * covariance[5];
+		float length = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+		if (length < 1e-6f) { break; }
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	int min_pixel = 0, max_pixel = 0;
+	float min_projection = 1e30f, max_projection = -1e30f;
+	for (int i = 0; i < 16; ++i) {
+		float projection = block[i * 4] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+		if (projection < min_projection) { min_projection = projection; min_pixel = i; }
+		if (projection > max_projection) { max_projection = projection; max_pixel = i; }
+	}
+
+	float endpoint0[3], endpoint1[3];
+	for (int c = 0; c < 3; ++c) {
+		endpoint0[c] = block[max_pixel * 4 + c];
+		endpoint1[c] = block[min_pixel * 4 + c];
+	}
+	uint16_t color0 = PackColor565(endpoint0);
+	uint16_t color1 = PackColor565(endpoint1);
+	uint32_t indexes;
+	int error = ChooseColorIndexes(block, color0, color1, &indexes);
+
+	if (RefineEndpoints(block, indexes, endpoint0, endpoint1)) {
+		uint16_t refined0 = PackColor565(endpoint0);
+		uint16_t refined1 = PackColor565(endpoint1);
+		uint32_t refined_indexes;
+		if (ChooseColorIndexes(block, refined0, refined1, &refined_indexes) < error) {
+			color0 = refined0;
+			color1 = refined1;
+			indexes = refined_indexes;
+		}
+	}
+
+	//The first endpoint has to be the greater one for the four color mode, swapping them mirrors the indexes
+	if (color0 < color1) {
+		std::swap(color0, color1);
+		indexes ^= 0x55555555;
+	}
+	else if (color0 == color1) {
+		indexes = 0;
+	}
+
+	memcpy(out, &color0, 2);
+	memcpy(out + 2, &color1, 2);
+	memcpy(out + 4, &indexes, 4);
+}
+
+//Alpha between the extremes of the block, in the eight value mode
+static void EncodeAlphaBlock(const uint8_t block[64], uint8_t out[8]) {
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; ++i) {
+		alpha0 = std::max(alpha0, (int)block[i * 4 + 3]);
+		alpha1 = std::min(alpha1, (int)block[i * 4 + 3]);
+	}
+
+	out[0] = (uint8_t)alpha0;
+	out[1] = (uint8_t)alpha1;
+
+	uint64_t indexes = 0;
+	if (alpha0 != alpha1) {
+		int palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int p = 1; p < 7; ++p) { palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7; }
+
+		for (int i = 0; i < 16; ++i) {
+			int alpha = block[i * 4 + 3];
+			int best = 0;
+			for (int p = 1; p < 8; ++p) {
+				if (abs(alpha - palette[p]) < abs(alpha - palette[best])) { best = p; }
+			}
+			indexes |= (uint64_t)best << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; ++i) { out[2 + i] = (uint8_t)(indexes >> (i * 8)); }
+}
+
+void CompressImage(TextureFormat format, const uint8_t* rgba, int width, int height, uint8_t* out, Boss* boss) {
+	const int blocks_x = (width + 3) / 4;
+	const int blocks_y = (height + 3) / 4;
+	const size_t block_size = format == TextureFormat::kBC1 ? 8 : 16;
+
+	auto compress_rows = [=](int first_row, int last_row) {
+		uint8_t block[64];
+		for (int by = first_row; by < last_row; ++by) {
+			uint8_t* dst = out + (size_t)by * blocks_x * block_size;
+			for (int bx = 0; bx < blocks_x; ++bx) {
+				FetchBlock(rgba, width, height, bx, by, block);
+				if (format == TextureFormat::kBC3) {
+					EncodeAlphaBlock(block, dst);
+					dst += 8;
+				}
+				EncodeColorBlock(block, dst);
+				dst += 8;
+			}
+		}
+	};
+
+	int rows_per_job = std::max(1, (int)kCompressMinBlocksPerJob / blocks_x);
+	if (boss == nullptr || rows_per_job >= blocks_y) {
+		compress_rows(0, blocks_y);
+		return;
+	}
+
+	JobCounter counter;
+	for (int row = 0; row < blocks_y; row += rows_per_job) {
+		int last_row = std::min(row + rows_per_job, blocks_y);
+		boss->run([&compress_rows, row, last_row]() { compress_rows(row, last_row); }, &counter);
+	}
+	boss->wait(&counter);
+}
+
+void DownsampleImage(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& out) {
+	int next_width = std::max(1, width / 2);
+	int next_height = std::max(1, height / 2);
+	out.resize((size_t)next_width * next_height * 4);
+
+	for (int y = 0; y < next_height; ++y) {
+		const uint8_t* row0 = rgba + (size_t)std::min(y * 2, height - 1) * width * 4;
+		const uint8_t* row1 = rgba + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+		for (int x = 0; x < next_width; ++x) {
+			int x0 = std::min(x * 2, width - 1) * 4;
+			int x1 = std::min(x * 2 + 1, width - 1) * 4;
+			uint8_t* dst = out.data() + ((size_t)y * next_width + x) * 4;
+			for (int c = 0; c < 4; ++c) {
+				dst[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+}
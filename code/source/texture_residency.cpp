@@ -0,0 +1,117 @@
+#include <texture_residency.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+#include <boss.hpp>
+#include <texture.hpp>
+#include <texture_array.hpp>
+#include <texture_streamer.hpp>
+
+#ifdef RENDER_OPENGL
+TextureResidency::TextureResidency(std::shared_ptr<TextureArrayPool> arrays, size_t budget) {
+	arrays_ = std::move(arrays);
+	budget_ = budget;
+	resident_bytes_ = 0;
+	frame_ = 0;
+	reduced_count_ = 0;
+}
+
+void TextureResidency::SetBudget(size_t bytes) {
+	budget_ = bytes;
+	printf("Texture residency: budget of %zu KB\n", budget_ / 1024);
+}
+
+void TextureResidency::Update(const std::vector<std::shared_ptr<Texture>>& textures, Boss& boss, TextureStreamer& streamer) {
+	frame_++;
+
+	//Bytes that don't depend on the levels picked. The free layers of the arrays are left out, they come and go
+	//while textures are repacked and counting them would make the levels picked swing from frame to frame
+	size_t fixed_bytes = 0;
+	size_t packed_bytes = 0;
+	size_t total = 0;
+	std::vector<const std::shared_ptr<Texture>*> candidates;
+	for (const std::shared_ptr<Texture>& texture : textures) {
+		Texture* t = texture.get();
+		if (t->array_ != nullptr) { packed_bytes += t->gpu_size_; }
+
+		uint32_t requested = t->requested_level_;
+		t->requested_level_ = t->level_count_;
+
+		if (!t->loaded_ || !t->can_stream_levels_ || t->level_count_ < 2) {
+			fixed_bytes += t->gpu_size_;
+			continue;
+		}
+
+		//Textures not drawn keep the level they had, they only lose it when there's no room
+		if (requested < t->level_count_) {
+			t->target_level_ = requested;
+			t->last_requested_frame_ = frame_;
+		}
+		else if (t->last_requested_frame_ == 0) {
+			t->target_level_ = t->resident_level_;
+		}
+		total += t->GetLevelsSize(t->target_level_);
+		candidates.push_back(&texture);
+	}
+	total += fixed_bytes;
+
+	//The ones drawn the longest ago go down to their smallest level first
+	std::sort(candidates.begin(), candidates.end(), [](const std::shared_ptr<Texture>* a, const std::shared_ptr<Texture>* b) {
+		return (*a)->last_requested_frame_ < (*b)->last_requested_frame_;
+	});
+	size_t first_drawn = 0;
+	for (; first_drawn < candidates.size() && (*candidates[first_drawn])->last_requested_frame_ != frame_; ++first_drawn) {
+		Texture* t = candidates[first_drawn]->get();
+		if (total <= budget_) { continue; }
+		total -= t->GetLevelsSize(t->target_level_) - t->GetLevelsSize(t->level_count_ - 1);
+		t->target_level_ = t->level_count_ - 1;
+	}
+
+	//Then the ones drawn lose a level each, the most detailed levels first, so they all keep a similar quality
+	std::sort(candidates.begin() + first_drawn, candidates.end(), [](const std::shared_ptr<Texture>* a, const std::shared_ptr<Texture>* b) {
+		return (*a)->GetLevelsSize((*a)->target_level_) > (*b)->GetLevelsSize((*b)->target_level_);
+	});
+	std::vector<uint32_t> wanted(candidates.size() - first_drawn);
+	for (size_t i = first_drawn; i < candidates.size(); ++i) { wanted[i - first_drawn] = (*candidates[i])->target_level_; }
+	for (uint32_t pass = 0; pass < kTextureMaxLevels && total > budget_; ++pass) {
+		for (size_t i = first_drawn; i < candidates.size() && total > budget_; ++i) {
+			Texture* t = candidates[i]->get();
+			if (t->target_level_ + 1 >= t->level_count_) { continue; }
+			total -= t->GetLevelsSize(t->target_level_) - t->GetLevelsSize(t->target_level_ + 1);
+			t->target_level_++;
+		}
+	}
+
+	size_t reduced_count = 0;
+	for (size_t i = first_drawn; i < candidates.size(); ++i) {
+		if ((*candidates[i])->target_level_ != wanted[i - first_drawn]) { reduced_count++; }
+	}
+	if (reduced_count != reduced_count_) {
+		printf("Texture residency: %zu of %zu textures drawn below the level they need to fit in %zu KB\n",
+			reduced_count, candidates.size() - first_drawn, budget_ / 1024);
+		reduced_count_ = reduced_count;
+	}
+
+	//Loose textures drop their levels at once, packed ones and new levels have to be read from the cooked file
+	unsigned int started = 0;
+	for (const std::shared_ptr<Texture>* texture : candidates) {
+		Texture* t = texture->get();
+		if (t->streaming_levels_ || t->target_level_ == t->resident_level_) { continue; }
+
+		if (t->array_ == nullptr && t->target_level_ > t->resident_level_) {
+			t->DropLevels(t->target_level_);
+			continue;
+		}
+
+		if (started == kTextureResidencyStreamsPerFrame) { continue; }
+		started++;
+		t->streaming_levels_ = true;
+		eve::spawn(boss, StreamTextureLevels(*texture, t->target_level_, boss, streamer));
+	}
+
+	size_t array_bytes = arrays_ != nullptr ? arrays_->GetMemorySize() : 0;
+	resident_bytes_ = fixed_bytes + (array_bytes > packed_bytes ? array_bytes - packed_bytes : 0);
+	for (const std::shared_ptr<Texture>* texture : candidates) { resident_bytes_ += (*texture)->gpu_size_; }
+}
+#endif
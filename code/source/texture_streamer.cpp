@@ -0,0 +1,215 @@
+#include <texture_streamer.hpp>
+
+#include <cstring>
+#include <algorithm>
+
+#include <boss.hpp>
+#include <texture.hpp>
+
+#ifdef RENDER_OPENGL
+TextureStreamer::TextureStreamer(size_t ring_size, size_t frame_budget) {
+	buffer_ = 0;
+	mapping_ = nullptr;
+	capacity_ = 0;
+	head_ = 0;
+	frame_budget_ = frame_budget;
+	frame_bytes_ = 0;
+
+	if (!GLEW_ARB_buffer_storage) {
+		printf("Texture streamer: no persistent mapping, levels are uploaded from memory\n");
+		return;
+	}
+
+	//Written by the workers while the GPU reads other parts, coherent so no flush is needed
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &buffer_);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ring_size, nullptr, flags);
+	mapping_ = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ring_size, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (mapping_ == nullptr) {
+		printf("Texture streamer: couldn't map the pixel buffer, levels are uploaded from memory\n");
+		glDeleteBuffers(1, &buffer_);
+		buffer_ = 0;
+		return;
+	}
+	capacity_ = ring_size;
+}
+
+TextureStreamer::~TextureStreamer() {
+	for (const Region& region : regions_) {
+		if (region.fence_ != nullptr) { glDeleteSync(region.fence_); }
+	}
+	if (buffer_ != 0) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &buffer_);
+	}
+}
+
+void TextureStreamer::BeginFrame() {
+	frame_bytes_ = 0;
+
+	//Regions are freed in order, one still being written keeps the newer ones until it's uploaded
+	while (!regions_.empty() && regions_.front().fence_ != nullptr) {
+		GLenum status = glClientWaitSync(regions_.front().fence_, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { break; }
+		glDeleteSync(regions_.front().fence_);
+		regions_.pop_front();
+	}
+	if (regions_.empty()) { head_ = 0; }
+}
+
+bool TextureStreamer::Reserve(size_t size, size_t* offset, uint8_t** memory) {
+	if (frame_bytes_ != 0 && frame_bytes_ + size > frame_budget_) { return false; }
+
+	size_t aligned_size = (size + kTextureStreamAlignment - 1) & ~(kTextureStreamAlignment - 1);
+	*memory = nullptr;
+	*offset = 0;
+
+	//Levels that could never fit go straight from memory, counted against the budget as well
+	if (mapping_ == nullptr || aligned_size > capacity_) {
+		frame_bytes_ += size;
+		return true;
+	}
+
+	//Free room is after the head up to the oldest region, wrapping to the start of the ring
+	size_t start = head_;
+	if (!regions_.empty()) {
+		size_t tail = regions_.front().offset_;
+		if (head_ > tail) {
+			if (head_ + aligned_size > capacity_) {
+				if (aligned_size > tail) { return false; }
+				start = 0;
+			}
+		}
+		else if (head_ + aligned_size > tail) { return false; }
+	}
+	else if (head_ + aligned_size > capacity_) {
+		start = 0;
+	}
+
+	regions_.push_back({ start, aligned_size, nullptr });
+	head_ = start + aligned_size;
+	frame_bytes_ += size;
+
+	*offset = start;
+	*memory = mapping_ + start;
+	return true;
+}
+
+void TextureStreamer::Upload(Texture& texture, uint32_t level, size_t offset) {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+	texture.UploadLevel(level, (const void*)offset);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	for (Region& region : regions_) {
+		if (region.offset_ == offset && region.fence_ == nullptr) {
+			region.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			break;
+		}
+	}
+}
+
+size_t TextureStreamer::GetPendingBytes() const {
+	size_t bytes = 0;
+	for (const Region& region : regions_) { bytes += region.size_; }
+	return bytes;
+}
+
+//Uploads levels from the cooked data of a texture, from the smallest to the most detailed, returning the frames it took
+static eve::task<unsigned int> UploadLevels(Texture& texture, uint32_t first_level, uint32_t last_level, Boss& boss, TextureStreamer& streamer) {
+	const uint8_t* cooked = texture.GetCookedData();
+	TextureCacheHeader header;
+	memcpy(&header, cooked, sizeof(TextureCacheHeader));
+
+	unsigned int frames = 0;
+	for (uint32_t level = last_level + 1; level-- > first_level;) {
+		const uint8_t* level_data = cooked + header.level_offsets_[level];
+		size_t level_size = header.level_sizes_[level];
+
+		size_t offset;
+		uint8_t* memory;
+		while (!streamer.Reserve(level_size, &offset, &memory)) {
+			co_await eve::next_frame(boss);
+			frames++;
+		}
+
+		if (memory == nullptr) {
+			texture.UploadLevel(level, level_data);
+		}
+		else {
+			co_await eve::schedule_on(boss);
+			memcpy(memory, level_data, level_size);
+			co_await eve::next_frame(boss);
+			frames++;
+			streamer.Upload(texture, level, offset);
+		}
+	}
+	co_return frames;
+}
+
+eve::task<bool> UploadTexture(std::shared_ptr<Texture> texture, Boss& boss, TextureStreamer& streamer, int max_size) {
+	//The texture is only touched by Opengl, and by the draws, on the main thread
+	co_await eve::next_frame(boss);
+
+	if (texture->loaded_ || texture->GetCookedData() == nullptr) { co_return false; }
+
+	//The rest of the levels are streamed in by the residency once the draws ask for them, they have to be in the cooked file
+	uint32_t first_level = 0;
+	if (max_size > 0 && texture->can_stream_levels_) {
+		while (first_level + 1 < texture->level_count_ &&
+			std::max(texture->width_ >> first_level, texture->height_ >> first_level) > max_size) {
+			first_level++;
+		}
+	}
+
+	texture->BeginUpload(first_level);
+	unsigned int frames = 1 + co_await UploadLevels(*texture, first_level, texture->level_count_ - 1, boss, streamer);
+	texture->EndUpload();
+
+	printf("Texture %s: streamed %u of %u levels over %u frames\n", texture->name_.c_str(),
+		texture->level_count_ - first_level, texture->level_count_, frames);
+
+	co_return true;
+}
+
+eve::task<bool> StreamTextureLevels(std::shared_ptr<Texture> texture, uint32_t first_level, Boss& boss, TextureStreamer& streamer) {
+	//Mapped on a worker, the file may have to be read from the disk again
+	co_await eve::schedule_on(boss);
+	std::unique_ptr<MappedFile> file = texture->MapCookedLevels();
+	co_await eve::next_frame(boss);
+
+	bool streamed = false;
+	if (file == nullptr) {
+		printf("Texture %s: the cooked file is gone, its levels stay as they are\n", texture->name_.c_str());
+		texture->can_stream_levels_ = false;
+	}
+	else if (texture->BeginUpload(first_level)) {
+		//A packed texture needs every level in its new layer, a loose one only the levels it doesn't have
+		uint32_t last_level = texture->array_ != nullptr ? texture->level_count_ - 1 : texture->resident_level_ - 1;
+		texture->cache_file_ = std::move(file);
+		co_await UploadLevels(*texture, first_level, last_level, boss, streamer);
+		texture->EndUpload();
+		streamed = true;
+	}
+
+	texture->streaming_levels_ = false;
+	co_return streamed;
+}
+
+static eve::task<bool> StreamCookedTexture(std::shared_ptr<Texture> texture, std::string filepath, Boss& boss, TextureStreamer& streamer, int max_size) {
+	co_await eve::schedule_on(boss);
+	if (!texture->LoadTextureNoInit(filepath, &boss)) { co_return false; }
+
+	co_return co_await UploadTexture(std::move(texture), boss, streamer, max_size);
+}
+
+eve::task<bool> StreamTexture(std::shared_ptr<Texture> texture, std::string filepath, Boss& boss, TextureStreamer& streamer, int max_size) {
+	//Tasks don't start until they are awaited, the texture has to be identifiable before that
+	texture->SetPath(filepath);
+	return StreamCookedTexture(std::move(texture), std::move(filepath), boss, streamer, max_size);
+}
+#endif
@@ -1,4 +1,10 @@
 #include <tinyobj.hpp>
+#include <obj_parser.hpp>
+#include <mesh_optimizer.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <cstring>
 
 
 
@@ -7,28 +13,170 @@
 #define TINYOBJLOADER_USE_MAPBOX_EARCUT
 #include <tiny_obj_loader.h>
 
+/**
+ * @brief Indexes of the attributes of a face vertex, two vertices with the same ones are identical.
+ * The color shares the index of the position
+ */
+struct VertexKey {
+	int position_;
+	int normal_;
+	int uv_;
+
+	bool operator==(const VertexKey& other) const {
+		return position_ == other.position_ && normal_ == other.normal_ && uv_ == other.uv_;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey& key) const {
+		//Pack the three indexes and mix them so the buckets are spread
+		uint64_t h = (uint64_t)(uint32_t)key.position_;
+		h = h * 0x9E3779B97F4A7C15ull ^ (uint64_t)(uint32_t)key.normal_;
+		h = h * 0x9E3779B97F4A7C15ull ^ (uint64_t)(uint32_t)key.uv_;
+		return (size_t)(h ^ (h >> 32));
+	}
+};
+
 TinyObj::TinyObj() {
 	isInit_ = false;
-	bigger_than_optimazable_ = false;
+	vertex_count_ = 0;
+	index_count_ = 0;
+	bounds_min_ = glm::vec3(0.0f);
+	bounds_max_ = glm::vec3(0.0f);
+	bounds_radius_ = 0.0f;
+	bounds_generation_ = 0;
+	memset(&layout_, 0, sizeof(VertexLayout));
+	loaded_from_cache_ = false;
+	load_time_ms_ = 0.0f;
 	cull_type_ = 1;
+	occluder_failed_ = false;
+	occluder_building_ = false;
 #ifdef RENDER_OPENGL
-	virtual_buffer_object_ = -1;
-	virtual_array_object_ = -1;
+	geometry_ = nullptr;
+	streaming_ = false;
 #endif
 }
 
 TinyObj::~TinyObj() {
 	vertices_.clear();
 #ifdef RENDER_OPENGL
-	glDeleteBuffers(1, &virtual_buffer_object_);
-	glDeleteBuffers(1, &virtual_array_object_);
-	glDeleteBuffers(1, &index_buffer_object_);
+	if (arena_ != nullptr) {
+		//A streamed mesh points to its first piece, free each piece once
+		if (streamed_chunks_.empty()) { arena_->Free(geometry_); }
+		for (size_t i = 0; i < streamed_chunks_.size(); ++i) { arena_->Free(streamed_chunks_[i]); }
+	}
 #endif
 #ifdef RENDER_DIRECTX11
 	
 #endif
 }
 
+typedef std::unordered_map<VertexKey, unsigned int, VertexKeyHash> VertexMap;
+
+//Adds the face vertices to the buffers, reusing the ones already added
+template<typename Index>
+static void AddFaceVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indexes, VertexMap& unique_vertices,
+	const float* positions, const float* colors, const float* normals, const float* uvs,
+	const Index* corners, size_t count) {
+
+	Vertex vtx;
+
+	for (size_t i = 0; i < count; ++i) {
+		const Index& idx = corners[i];
+
+		//If already loaded, grab it's index
+		VertexKey key = { idx.vertex_index, idx.normal_index, idx.texcoord_index };
+		auto inserted = unique_vertices.try_emplace(key, (unsigned int)vertices.size());
+		if (!inserted.second) {
+			indexes.emplace_back(inserted.first->second);
+			continue;
+		}
+
+		vtx = { {0.0f, 0.0f, 0.0f}, // Position
+					 {0.0f, 0.0f, 0.0f},  // Color
+					 {0.0f, 0.0f, 0.0f},  // Normal
+						{0.0f, 0.0f}				// UV
+				};
+
+		// Vertex index
+		int temp_index = idx.vertex_index *3;
+		vtx.position_ = { 
+			positions[temp_index], 
+			positions[temp_index + 1], 
+			positions[temp_index + 2] 
+		};
+
+		// Optional: vertex colors
+		vtx.color_ = { 
+			colors[temp_index], 
+			colors[temp_index + 1], 
+			colors[temp_index + 2]
+		};
+
+		// Check if `normal_index` is zero or positive. negative = no normal data
+		if (idx.normal_index >= 0) {
+			temp_index = idx.normal_index * 3;
+			vtx.normal_= {
+				normals[temp_index],
+				normals[temp_index + 1],
+				normals[temp_index + 2]
+			};
+		}
+
+		// Check if `texcoord_index` is zero or positive. negative = no texcoord data
+		if (idx.texcoord_index >= 0) {
+			temp_index = idx.texcoord_index * 2;
+			vtx.uv_ = { uvs[temp_index] , uvs[temp_index + 1]};
+		}
+
+		//New vertex, insert it
+		indexes.emplace_back(inserted.first->second);
+		vertices.emplace_back(vtx);
+	}
+}
+
+//Sets the name of the mesh from the file name, and keeps the path for further comparisons
+static void SetNameFromPath(TinyObj* mesh, const std::string& inputfile) {
+	char search_start = '/';
+	char search_end = '.';
+	size_t init_pos = -1;
+	size_t end_pos = -1;
+
+	//Find last ocurrence of the separator
+	init_pos = inputfile.rfind(search_start);
+	end_pos = inputfile.rfind(search_end);
+
+	if (init_pos!= -1) {
+		mesh->name_ = inputfile.substr(init_pos+1, end_pos - (init_pos+1));
+	}
+	else {mesh->name_ = "unnamed";}
+
+	mesh->full_path_ = inputfile;
+}
+
+//Leaves the whole index buffer as the only LOD, without meshlets, and computes the bounds of the vertices
+static void SetFullDetail(TinyObj* mesh) {
+	mesh->lods_.assign(1, { 0, (uint32_t)mesh->indexes_.size(), 0.0f });
+	mesh->meshlets_.clear();
+
+	if (mesh->vertices_.empty()) { return; }
+
+	mesh->bounds_min_ = mesh->vertices_[0].position_;
+	mesh->bounds_max_ = mesh->vertices_[0].position_;
+	for (size_t i = 1; i < mesh->vertices_.size(); ++i) {
+		mesh->bounds_min_ = glm::min(mesh->bounds_min_, mesh->vertices_[i].position_);
+		mesh->bounds_max_ = glm::max(mesh->bounds_max_, mesh->vertices_[i].position_);
+	}
+
+	glm::vec3 center = (mesh->bounds_min_ + mesh->bounds_max_) * 0.5f;
+	float radius_squared = 0.0f;
+	for (size_t i = 0; i < mesh->vertices_.size(); ++i) {
+		glm::vec3 offset = mesh->vertices_[i].position_ - center;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+	mesh->bounds_radius_ = sqrtf(radius_squared);
+}
+
 void TinyObj::LoadObj(std::string inputfile) {
 	tinyobj::ObjReader reader;
 
@@ -48,172 +196,523 @@ void TinyObj::LoadObj(std::string inputfile) {
 	auto& shapes = reader.GetShapes();
 	//auto& materials = reader.GetMaterials();
 
-	Vertex vtx;
-	
-	//-------------------------------
-	// Load by brute force over vertices
-	//-------------------------------
-	
+	//Get number of vertices to reserve the memory at once
+	size_t vertex_count = 0;
+	for (size_t s = 0; s < shapes.size(); s++) {
+		vertex_count += shapes[s].mesh.indices.size();
+	}
+
+	indexes_.reserve(vertex_count);
+
+	//Index each vertex by the attributes it references, so repeated ones are stored once
+	VertexMap unique_vertices;
+	unique_vertices.reserve(vertex_count);
 
-	// Loop over shapes
-	//Get number of vertices to check if drawn by indexes or not, based on size of file
-	unsigned int vertex_count_ = 0;
+	//Faces are already triangulated, so the indices of the shapes can be used directly
 	for (size_t s = 0; s < shapes.size(); s++) {
-		size_t size = shapes[s].mesh.num_face_vertices.size();
-		for (size_t f = 0; f < size; f++) {
-			size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-			for (size_t v = 0; v < fv; v++) {vertex_count_++;}
+		AddFaceVertices(vertices_, indexes_, unique_vertices, attrib.vertices.data(), attrib.colors.data(),
+			attrib.normals.data(), attrib.texcoords.data(),
+			shapes[s].mesh.indices.data(), shapes[s].mesh.indices.size());
+	}
+
+	vertex_count_ = (unsigned int)vertices_.size();
+	index_count_ = (unsigned int)indexes_.size();
+	SetFullDetail(this);
+
+	SetNameFromPath(this, inputfile);
+}
+
+void TinyObj::LoadObjParallel(std::string inputfile, Boss* boss) {
+	ObjData data;
+	std::string error;
+
+	if (!ParseObj(inputfile, boss, data, error)) {
+		//Anything the parser can't handle is left to tinyobjloader
+		printf("ObjParser: %s on %s, using tinyobjloader\n", error.c_str(), inputfile.c_str());
+		LoadObj(inputfile);
+		return;
+	}
+
+	vertices_.clear();
+	indexes_.clear();
+	indexes_.reserve(data.corners_.size());
+
+	VertexMap unique_vertices;
+	unique_vertices.reserve(data.corners_.size());
+
+	AddFaceVertices(vertices_, indexes_, unique_vertices, data.positions_.data(), data.colors_.data(),
+		data.normals_.data(), data.texcoords_.data(), data.corners_.data(), data.corners_.size());
+
+	vertex_count_ = (unsigned int)vertices_.size();
+	index_count_ = (unsigned int)indexes_.size();
+	SetFullDetail(this);
+
+	SetNameFromPath(this, inputfile);
+}
+
+void TinyObj::LoadMesh(std::string inputfile, Boss* boss) {
+	auto start = std::chrono::steady_clock::now();
+
+	loaded_from_cache_ = LoadCache(inputfile);
+	if (!loaded_from_cache_) {
+		LoadObjParallel(inputfile, boss);
+		//Done once at import, the cooked file keeps the optimized order and the LODs
+		Optimize();
+		GenerateLods();
+		GenerateMeshlets();
+		layout_ = ChooseVertexLayout(vertices_, true);
+
+		printf("Mesh %s: vertex buffer %u -> %u bytes, index buffer %u -> %u bytes\n", name_.c_str(),
+			(unsigned int)(sizeof(Vertex) * vertex_count_), layout_.stride_ * vertex_count_,
+			(unsigned int)(sizeof(unsigned int) * index_count_), layout_.index_size_ * index_count_);
+	}
+
+	load_time_ms_ = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (loaded_from_cache_) {
+		printf("Mesh %s: warm load from cooked file in %.3f ms\n", name_.c_str(), load_time_ms_);
+	}
+	else {
+		printf("Mesh %s: cold load from OBJ in %.3f ms\n", name_.c_str(), load_time_ms_);
+		//Cook it for the next time
+		if (vertex_count_ != 0 && !SaveCache(inputfile)) {
+			printf("Mesh %s: couldn't write the cooked file\n", name_.c_str());
 		}
 	}
+}
 
-	vertices_.reserve(vertex_count_);
-	indexes_.reserve(vertex_count_);
+void TinyObj::Optimize(bool reduce_overdraw) {
+	if (indexes_.empty()) { return; }
 
-	//Check if bigger than the optimizable loop
-	bigger_than_optimazable_ = (vertex_count_ >= kVertexCountLimit);
+	//Drop the LODs, they would reference the vertices in the old order
+	if (!lods_.empty()) { indexes_.resize(lods_[0].index_count_); }
 
-	for (size_t s = 0; s < shapes.size(); s++) {
-		vtx = { {0.0f, 0.0f, 0.0f}, // Position
-					 {0.0f, 0.0f, 0.0f},  // Color
-					 {0.0f, 0.0f, 0.0f},  // Normal
-						{0.0f, 0.0f}				// UV
-				};
+	VertexCacheStats before = AnalyzeVertexCache(indexes_, vertices_.size());
 
-		// Loop over faces(polygon)
-		size_t index_offset = 0;
-		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-			size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-
-			// Loop over vertices in the face.
-			for (size_t v = 0; v < fv; v++) {
-				// access to vertex
-				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-				// Vertex index
-				int temp_index = idx.vertex_index *3;
-				vtx.position_ = { 
-					attrib.vertices[temp_index], 
-					attrib.vertices[temp_index + 1], 
-					attrib.vertices[temp_index + 2] 
-				};
+	OptimizeVertexCache(indexes_, vertices_, reduce_overdraw);
+	OptimizeVertexFetch(vertices_, indexes_);
+	vertex_count_ = (unsigned int)vertices_.size();
+	index_count_ = (unsigned int)indexes_.size();
+	SetFullDetail(this);
 
-				// Optional: vertex colors
-				vtx.color_ = { 
-					attrib.colors[temp_index], 
-					attrib.colors[temp_index + 1], 
-					attrib.colors[temp_index + 2]
-				};
+	VertexCacheStats after = AnalyzeVertexCache(indexes_, vertices_.size());
 
-				// Check if `normal_index` is zero or positive. negative = no normal data
-				if (idx.normal_index >= 0) {
-					temp_index = idx.normal_index * 3;
-					vtx.normal_= {
-						attrib.normals[temp_index],
-						attrib.normals[temp_index + 1],
-						attrib.normals[temp_index + 2]
-					};
-				}
-
-				// Check if `texcoord_index` is zero or positive. negative = no texcoord data
-				if (idx.texcoord_index >= 0) {
-					temp_index = idx.texcoord_index * 2;
-					vtx.uv_ = { attrib.texcoords[temp_index] , attrib.texcoords[temp_index + 1]};
-				}
-
-
-				if (!bigger_than_optimazable_) {
-					//*/
-					//Check if it exists in the map
-					bool found = false;	
-					unsigned int index=-1;
-					for (unsigned int i = 0; !found && i < vertices_.size(); ++i) {
-						if (!found  && Vertex::Compare(vertices_[i],vtx)) {
-							found = true;
-							index = i;
-						}
-					}
-
-					//If the vertex doesn't exist in the map, insert it
-					if (!found) {
-						unsigned int t= (unsigned int)vertices_.size();
-						indexes_.emplace_back(t);
-						vertices_.emplace_back(vtx);
-					}
-					//Else, grab it's index
-					else {indexes_.emplace_back(index);}
-				}
-				else {
-					indexes_.emplace_back((unsigned int)vertices_.size());
-					vertices_.emplace_back(vtx);
-				}
-			}
+	printf("Mesh %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name_.c_str(),
+		before.acmr_, after.acmr_, before.atvr_, after.atvr_);
+}
+
+void TinyObj::GenerateLods(unsigned int lod_count, float reduction, float max_error) {
+	if (indexes_.empty()) { return; }
+
+	//Keep only the full detail mesh, every LOD is simplified from it
+	if (!lods_.empty()) { indexes_.resize(lods_[0].index_count_); }
+	lods_.assign(1, { 0, (uint32_t)indexes_.size(), 0.0f });
+	const std::vector<unsigned int> full_detail = indexes_;
+
+	for (unsigned int i = 1; i < lod_count; ++i) {
+		size_t previous_count = lods_.back().index_count_;
+		size_t target_count = (size_t)((float)previous_count * reduction) / 3 * 3;
+
+		float error = 0.0f;
+		std::vector<unsigned int> lod = SimplifyMesh(vertices_, full_detail, target_count, max_error, &error);
+
+		//Not worth another LOD if the error limit has been reached before reducing it enough
+		if (lod.empty() || (float)lod.size() > (float)previous_count * (reduction + 1.0f) * 0.5f) { break; }
+
+		OptimizeVertexCache(lod, vertices_, false);
+		lods_.push_back({ (uint32_t)indexes_.size(), (uint32_t)lod.size(), error });
+		indexes_.insert(indexes_.end(), lod.begin(), lod.end());
+	}
+
+	index_count_ = (unsigned int)indexes_.size();
+
+	printf("Mesh %s: %u LODs, %u -> %u triangles, error %.4f\n", name_.c_str(), (unsigned int)lods_.size(),
+		lods_.front().index_count_ / 3, lods_.back().index_count_ / 3, lods_.back().error_);
+}
+
+void TinyObj::GenerateMeshlets() {
+	if (lods_.empty()) { return; }
+
+	meshlets_ = BuildMeshlets(indexes_, lods_[0].index_count_, vertices_);
+
+	printf("Mesh %s: %u meshlets\n", name_.c_str(), (unsigned int)meshlets_.size());
+}
+
+MeshLod TinyObj::get_lod(unsigned int lod) const {
+	if (lods_.empty()) { return { 0, index_count_, 0.0f }; }
+	return lods_[std::min(lod, (unsigned int)lods_.size() - 1)];
+}
+
+size_t TinyObj::GetMemorySize() const {
+	size_t size = (size_t)layout_.stride_ * vertex_count_ + (size_t)layout_.index_size_ * index_count_;
+	size += vertices_.capacity() * sizeof(Vertex) + indexes_.capacity() * sizeof(unsigned int);
+	size += occluder_positions_.capacity() * sizeof(glm::vec3) + occluder_indexes_.capacity() * sizeof(uint32_t);
+	size += lods_.capacity() * sizeof(MeshLod) + meshlets_.capacity() * sizeof(Meshlet);
+	if (cache_file_ != nullptr) { size += cache_file_->size(); }
+	return size;
+}
+
+//Reads the header of a cooked file, false if it isn't one of this version or its contents don't fit in it
+static bool ReadCacheHeader(const MappedFile& file, MeshCacheHeader& header) {
+	if (file.size() < sizeof(MeshCacheHeader)) { return false; }
+	memcpy(&header, file.data(), sizeof(MeshCacheHeader));
+
+	if (memcmp(header.magic_, kMeshCacheMagic, sizeof(kMeshCacheMagic)) != 0 ||
+		header.version_ != kMeshCacheVersion ||
+		header.layout_.stride_ == 0 ||
+		(header.layout_.index_size_ != sizeof(uint16_t) && header.layout_.index_size_ != sizeof(uint32_t))) {
+		return false;
+	}
+
+	return header.vertex_offset_ + (uint64_t)header.vertex_count_ * header.layout_.stride_ <= file.size() &&
+		header.index_offset_ + (uint64_t)header.index_count_ * header.layout_.index_size_ <= file.size() &&
+		header.lod_offset_ + (uint64_t)header.lod_count_ * sizeof(MeshLod) <= file.size() &&
+		header.lod_count_ != 0 &&
+		header.meshlet_offset_ + (uint64_t)header.meshlet_count_ * sizeof(Meshlet) <= file.size();
+}
 
-			index_offset += fv;
+bool TinyObj::BuildOccluder(std::vector<glm::vec3>* positions, std::vector<uint32_t>* triangles) const {
+	positions->clear();
+	triangles->clear();
+
+	//Meshes loaded from their cooked file only kept it mapped until the upload, it's read again
+	std::vector<Vertex> cooked_vertices;
+	std::vector<unsigned int> cooked_indexes;
+	const std::vector<Vertex>* vertices = &vertices_;
+	const std::vector<unsigned int>* indexes = &indexes_;
+	if (vertices_.empty() || indexes_.empty()) {
+		MappedFile file;
+		MeshCacheHeader header;
+		if (full_path_.empty() || !file.Open(full_path_ + kMeshCacheExtension) || !ReadCacheHeader(file, header)) {
+			printf("Mesh %s: no vertices on the CPU or cooked file to draw it as an occluder\n", name_.c_str());
+			return false;
 		}
+		UnpackVertices(header.layout_, file.data() + header.vertex_offset_, header.vertex_count_, cooked_vertices);
+		UnpackIndexes(header.layout_, file.data() + header.index_offset_, header.index_count_, cooked_indexes);
+		vertices = &cooked_vertices;
+		indexes = &cooked_indexes;
 	}
 
-	//Set the file name from the source
-	char search_start = '/';
-	char search_end = '.';
-	size_t init_pos = -1;
-	size_t end_pos = -1;
+	//The full detail triangles, a simplified silhouette could hide what's really visible behind its edges
+	size_t first = 0;
+	size_t count = indexes->size();
+	if (!lods_.empty()) {
+		first = std::min((size_t)lods_[0].index_offset_, indexes->size());
+		count = std::min((size_t)lods_[0].index_count_, indexes->size() - first);
+	}
 
-	//Find last ocurrence of the separator
-	init_pos = inputfile.rfind(search_start);
-	end_pos = inputfile.rfind(search_end);
+	//Only the positions of the vertices used, in the order they are used
+	std::vector<uint32_t> remap(vertices->size(), UINT32_MAX);
+	triangles->reserve(count);
+	for (size_t i = first; i + 2 < first + count; i += 3) {
+		const unsigned int* triangle = &(*indexes)[i];
+		if (triangle[0] >= vertices->size() || triangle[1] >= vertices->size() || triangle[2] >= vertices->size()) { continue; }
+		for (unsigned int v = 0; v < 3; ++v) {
+			if (remap[triangle[v]] == UINT32_MAX) {
+				remap[triangle[v]] = (uint32_t)positions->size();
+				positions->push_back((*vertices)[triangle[v]].position_);
+			}
+			triangles->push_back(remap[triangle[v]]);
+		}
+	}
 
-	if (init_pos!= -1) {
-		name_ = inputfile.substr(init_pos+1, end_pos - (init_pos+1));
+	return !triangles->empty();
+}
+
+bool TinyObj::LoadCache(std::string inputfile) {
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+	if (!file->Open(inputfile + kMeshCacheExtension)) { return false; }
+
+	MeshCacheHeader header;
+	if (!ReadCacheHeader(*file, header)) { return false; }
+
+	//Discard it if the OBJ has changed since it was cooked. Without the OBJ, the cooked file is enough
+	std::error_code error;
+	if (std::filesystem::exists(inputfile, error)) {
+		uint64_t source_size = (uint64_t)std::filesystem::file_size(inputfile, error);
+		int64_t source_time = (int64_t)std::filesystem::last_write_time(inputfile, error).time_since_epoch().count();
+		if (error || source_size != header.source_size_ || source_time != header.source_time_) {
+			return false;
+		}
 	}
-	else {name_ = "unnamed";}
 
-	//Save path for further comparisons
-	full_path_ = inputfile;
+	vertices_.clear();
+	indexes_.clear();
+	vertex_count_ = header.vertex_count_;
+	index_count_ = header.index_count_;
+	lods_.resize(header.lod_count_);
+	memcpy(lods_.data(), file->data() + header.lod_offset_, sizeof(MeshLod) * header.lod_count_);
+	meshlets_.resize(header.meshlet_count_);
+	if (!meshlets_.empty()) {
+		memcpy(meshlets_.data(), file->data() + header.meshlet_offset_, sizeof(Meshlet) * header.meshlet_count_);
+	}
+	bounds_min_ = glm::vec3(header.bounds_min_[0], header.bounds_min_[1], header.bounds_min_[2]);
+	bounds_max_ = glm::vec3(header.bounds_max_[0], header.bounds_max_[1], header.bounds_max_[2]);
+	bounds_radius_ = header.bounds_radius_;
+	layout_ = header.layout_;
+	cache_file_ = std::move(file);
+
+	SetNameFromPath(this, inputfile);
+	return true;
+}
+
+bool TinyObj::SaveCache(std::string inputfile) const {
+	std::error_code error;
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(MeshCacheHeader));
+
+	memcpy(header.magic_, kMeshCacheMagic, sizeof(kMeshCacheMagic));
+	header.version_ = kMeshCacheVersion;
+	//A mesh filled by hand has no layout, it's stored without quantizing the positions
+	header.layout_ = layout_.stride_ != 0 ? layout_ : ChooseVertexLayout(vertices_, false);
+	header.vertex_count_ = (uint32_t)vertices_.size();
+	header.index_count_ = (uint32_t)indexes_.size();
+	header.source_size_ = (uint64_t)std::filesystem::file_size(inputfile, error);
+	header.source_time_ = (int64_t)std::filesystem::last_write_time(inputfile, error).time_since_epoch().count();
+	if (error) { return false; }
+
+	header.vertex_offset_ = sizeof(MeshCacheHeader);
+	header.index_offset_ = header.vertex_offset_ + header.layout_.stride_ * vertices_.size();
+	header.lod_offset_ = header.index_offset_ + header.layout_.index_size_ * indexes_.size();
+	//A mesh filled by hand has no LODs, it's drawn whole
+	std::vector<MeshLod> lods = lods_;
+	if (lods.empty()) { lods.push_back({ 0, (uint32_t)indexes_.size(), 0.0f }); }
+	header.lod_count_ = (uint32_t)lods.size();
+	header.meshlet_offset_ = header.lod_offset_ + sizeof(MeshLod) * lods.size();
+	header.meshlet_count_ = (uint32_t)meshlets_.size();
+	memcpy(header.bounds_min_, &bounds_min_, sizeof(header.bounds_min_));
+	memcpy(header.bounds_max_, &bounds_max_, sizeof(header.bounds_max_));
+	header.bounds_radius_ = bounds_radius_;
+
+	std::vector<uint8_t> packed_vertices;
+	std::vector<uint8_t> packed_indexes;
+	PackVertices(header.layout_, vertices_, packed_vertices);
+	PackIndexes(header.layout_, indexes_, packed_indexes);
+
+	FILE* f = nullptr;
+	fopen_s(&f, (inputfile + kMeshCacheExtension).c_str(), "wb");
+	if (f == nullptr) { return false; }
+
+	bool written = fwrite(&header, sizeof(MeshCacheHeader), 1, f) == 1;
+	written = written && fwrite(packed_vertices.data(), 1, packed_vertices.size(), f) == packed_vertices.size();
+	written = written && fwrite(packed_indexes.data(), 1, packed_indexes.size(), f) == packed_indexes.size();
+	written = written && fwrite(lods.data(), sizeof(MeshLod), lods.size(), f) == lods.size();
+	written = written && (meshlets_.empty() || fwrite(meshlets_.data(), sizeof(Meshlet), meshlets_.size(), f) == meshlets_.size());
+	fclose(f);
+
+	//Don't leave a broken file behind
+	if (!written) { std::filesystem::remove(inputfile + kMeshCacheExtension, error); }
+
+	return written;
 }
 
 #ifdef RENDER_OPENGL
-void TinyObj::InitBuffer() {
-	if (vertices_.size() != 0 && !isInit_) {
+void TinyObj::InitBuffer(std::shared_ptr<GeometryArena> arena) {
+	if (vertex_count_ != 0 && !isInit_) {
 		isInit_ = true;
-		//Generate the virtual buffer, bind it, and allocate it
-		glGenBuffers(1, &virtual_buffer_object_);
-		glBindBuffer(GL_ARRAY_BUFFER, virtual_buffer_object_);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices_.size(), &vertices_[0].position_.x, GL_STATIC_DRAW);
-
-		//Generate the index buffer
-		glGenBuffers(1, &index_buffer_object_);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_object_);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indexes_.size(), &indexes_[0], GL_STATIC_DRAW);
-
-		//Generate the vertex array
-		glGenVertexArrays(1, &virtual_array_object_);
-		glBindVertexArray(virtual_array_object_);
-
-		//Enable the vertex attributes for positions, colors and normals
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		glEnableVertexAttribArray(1); 
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(6 * sizeof(float)));
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(9 * sizeof(float)));
-		
-		glBindVertexArray(0);
+
+		//Upload straight from the cooked file if there's one mapped, if not compress the vertices now.
+		//Meshes that weren't imported keep their positions as floats, not every program dequantizes them
+		std::vector<uint8_t> packed_vertices;
+		std::vector<uint8_t> packed_indexes;
+		const void* vertex_data = nullptr;
+		const void* index_data = nullptr;
+		if (cache_file_ != nullptr) {
+			const MeshCacheHeader* header = (const MeshCacheHeader*)cache_file_->data();
+			vertex_data = cache_file_->data() + header->vertex_offset_;
+			index_data = cache_file_->data() + header->index_offset_;
+		}
+		else {
+			if (layout_.stride_ == 0) { layout_ = ChooseVertexLayout(vertices_, false); }
+			PackVertices(layout_, vertices_, packed_vertices);
+			PackIndexes(layout_, indexes_, packed_indexes);
+			vertex_data = packed_vertices.data();
+			index_data = packed_indexes.data();
+		}
+
+		InitBuffer(std::move(arena), vertex_data, index_data);
+
+		//The data lives on the GPU now
+		cache_file_.reset();
 	}
 }
+
+void TinyObj::InitBuffer(std::shared_ptr<GeometryArena> arena, const void* vertex_data, const void* index_data) {
+	if (vertex_count_ != 0 && geometry_ == nullptr) {
+		isInit_ = true;
+		arena_ = std::move(arena);
+		geometry_ = arena_->Allocate(layout_, vertex_data, vertex_count_, index_data, index_count_);
+	}
+}
+
+/**
+ * @brief Triangles of a window of a streamed mesh, packed and ready to upload
+ */
+struct StreamedPiece {
+	std::vector<uint8_t> vertices_;
+	std::vector<uint8_t> indexes_;
+	uint32_t vertex_count_;
+	uint32_t index_count_;
+	glm::vec3 bounds_min_;
+	glm::vec3 bounds_max_;
+};
+
+//Packs the vertices gathered so far as a piece, choosing the layout with the first one.
+//The first pieces are uploaded before the rest is read, so later ones can't add attributes to it
+static void FlushStreamedPiece(std::vector<Vertex>& vertices, std::vector<unsigned int>& indexes, VertexMap& unique_vertices,
+	VertexLayout& layout, std::vector<StreamedPiece>& pieces, bool& colors_dropped) {
+	if (indexes.empty()) { return; }
+
+	if (layout.stride_ == 0) { layout = ChooseVertexLayout(vertices, false); }
+	else if (!layout.has_colors_ && !colors_dropped) { colors_dropped = ChooseVertexLayout(vertices, false).has_colors_; }
+
+	StreamedPiece piece;
+	PackVertices(layout, vertices, piece.vertices_);
+	PackIndexes(layout, indexes, piece.indexes_);
+	piece.vertex_count_ = (uint32_t)vertices.size();
+	piece.index_count_ = (uint32_t)indexes.size();
+	piece.bounds_min_ = vertices[0].position_;
+	piece.bounds_max_ = vertices[0].position_;
+	for (size_t i = 1; i < vertices.size(); ++i) {
+		piece.bounds_min_ = glm::min(piece.bounds_min_, vertices[i].position_);
+		piece.bounds_max_ = glm::max(piece.bounds_max_, vertices[i].position_);
+	}
+	pieces.emplace_back(std::move(piece));
+
+	vertices.clear();
+	indexes.clear();
+	unique_vertices.clear();
+}
+
+static eve::task<bool> StreamObj(std::shared_ptr<TinyObj> mesh, std::string inputfile, Boss& boss, std::shared_ptr<GeometryArena> arena) {
+	auto start = std::chrono::steady_clock::now();
+
+	co_await eve::schedule_on(boss);
+
+	ObjStream stream;
+	std::string error;
+	bool ok = stream.Open(inputfile, error);
+
+	//Only read on the workers, the mesh is only touched on the main thread
+	VertexLayout layout;
+	memset(&layout, 0, sizeof(VertexLayout));
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indexes;
+	VertexMap unique_vertices;
+	std::vector<StreamedPiece> pieces;
+	bool colors_dropped = false;
+
+	while (ok && !stream.done()) {
+		ok = stream.ReadNext(error);
+		if (!ok) { break; }
+
+		//Pieces are split before they need 32 bit indexes, so every piece is drawn with the same index type
+		const ObjData& data = stream.data();
+		for (size_t t = 0; t + 3 <= data.corners_.size(); t += 3) {
+			if (vertices.size() + 3 > kMaxShortIndexVertices) {
+				FlushStreamedPiece(vertices, indexes, unique_vertices, layout, pieces, colors_dropped);
+			}
+			AddFaceVertices(vertices, indexes, unique_vertices, data.positions_.data(), data.colors_.data(),
+				data.normals_.data(), data.texcoords_.data(), data.corners_.data() + t, 3);
+		}
+		FlushStreamedPiece(vertices, indexes, unique_vertices, layout, pieces, colors_dropped);
+
+		co_await eve::next_frame(boss);
+
+		for (size_t i = 0; i < pieces.size(); ++i) {
+			const StreamedPiece& piece = pieces[i];
+			GeometryAllocation* allocation = arena->Allocate(layout, piece.vertices_.data(), piece.vertex_count_,
+				piece.indexes_.data(), piece.index_count_);
+
+			if (mesh->streamed_chunks_.empty()) {
+				mesh->bounds_min_ = piece.bounds_min_;
+				mesh->bounds_max_ = piece.bounds_max_;
+			}
+			mesh->bounds_min_ = glm::min(mesh->bounds_min_, piece.bounds_min_);
+			mesh->bounds_max_ = glm::max(mesh->bounds_max_, piece.bounds_max_);
+			mesh->bounds_radius_ = glm::length(mesh->bounds_max_ - mesh->bounds_min_) * 0.5f;
+			//The bounds tree moves the leaves of the renderers drawing it
+			mesh->bounds_generation_++;
+
+			mesh->streamed_chunks_.push_back(allocation);
+			mesh->vertex_count_ += piece.vertex_count_;
+			mesh->index_count_ += piece.index_count_;
+		}
+		pieces.clear();
+
+		if (!mesh->streamed_chunks_.empty() && !mesh->isInit_) {
+			mesh->layout_ = layout;
+			mesh->arena_ = arena;
+			mesh->geometry_ = mesh->streamed_chunks_[0];
+			mesh->isInit_ = true;
+		}
+
+		if (!stream.done()) { co_await eve::schedule_on(boss); }
+	}
+
+	//Still on a worker if the file couldn't be read or it was empty
+	if (!ok || mesh->streamed_chunks_.empty()) { co_await eve::next_frame(boss); }
+	if (!ok) { printf("Mesh %s: streaming stopped, %s\n", mesh->name_.c_str(), error.c_str()); }
+	if (colors_dropped) { printf("Mesh %s: the first piece has no vertex colors, the ones of later pieces were dropped\n", mesh->name_.c_str()); }
+
+	mesh->streaming_ = false;
+	mesh->load_time_ms_ = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Mesh %s: streamed %u vertices in %u pieces in %.3f ms\n", mesh->name_.c_str(),
+		mesh->vertex_count_, (unsigned int)mesh->streamed_chunks_.size(), mesh->load_time_ms_);
+
+	co_return ok;
+}
+
+eve::task<bool> StreamMesh(std::shared_ptr<TinyObj> mesh, std::string inputfile, Boss& boss, std::shared_ptr<GeometryArena> arena) {
+	//Tasks don't start until they are awaited, the mesh has to be identifiable before that
+	SetNameFromPath(mesh.get(), inputfile);
+	mesh->streaming_ = true;
+	return StreamObj(std::move(mesh), std::move(inputfile), boss, std::move(arena));
+}
+
+static eve::task<bool> BuildOccluderOnWorker(std::shared_ptr<TinyObj> mesh, Boss& boss) {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> triangles;
+	co_await eve::schedule_on(boss);
+	bool ok = mesh->BuildOccluder(&positions, &triangles);
+
+	//The render system draws the occluders from the main thread
+	co_await eve::next_frame(boss);
+	mesh->occluder_positions_ = std::move(positions);
+	mesh->occluder_indexes_ = std::move(triangles);
+	mesh->occluder_failed_ = !ok;
+	mesh->occluder_building_ = false;
+	co_return ok;
+}
+
+eve::task<bool> BuildOccluderAsync(std::shared_ptr<TinyObj> mesh, Boss& boss) {
+	//Tasks don't start until they are awaited, the mesh can't be requested twice meanwhile
+	mesh->occluder_building_ = true;
+	return BuildOccluderOnWorker(std::move(mesh), boss);
+}
 #endif
 #ifdef RENDER_DIRECTX11
 void TinyObj::InitBuffer(ID3D11Device* dev, ID3D11DeviceContext* devCon) {
-	if (vertices_.size() != 0 && !isInit_ ) {
+	if (vertex_count_ != 0 && !isInit_ ) {
 		HRESULT hr;
+
+		//The input layout expects whole vertices and 32 bit indexes, expand the cooked ones
+		if (cache_file_ != nullptr) {
+			const MeshCacheHeader* header = (const MeshCacheHeader*)cache_file_->data();
+			UnpackVertices(layout_, cache_file_->data() + header->vertex_offset_, vertex_count_, vertices_);
+			UnpackIndexes(layout_, cache_file_->data() + header->index_offset_, index_count_, indexes_);
+			cache_file_.reset();
+		}
+		const void* vertex_data = vertices_.data();
+		const void* index_data = indexes_.data();
+
 		// Vertex Buffer
 		{
 			D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-			vertexBufferData.pSysMem = vertices_.data();
+			vertexBufferData.pSysMem = vertex_data;
 			vertexBufferData.SysMemPitch = 0;
 			vertexBufferData.SysMemSlicePitch = 0;
-			CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(Vertex) * (unsigned int)vertices_.size(), D3D11_BIND_VERTEX_BUFFER);
+			CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(Vertex) * vertex_count_, D3D11_BIND_VERTEX_BUFFER);
 			hr = dev->CreateBuffer(&vertexBufferDesc, &vertexBufferData, g_pVertexBuffer.GetAddressOf());
 			if (FAILED(hr)) {
 				printf("Missing creating vertex buffer  %#010x\n", hr);
@@ -237,10 +736,10 @@ void TinyObj::InitBuffer(ID3D11Device* dev, ID3D11DeviceContext* devCon) {
 		// Index Buffer
 		{
 			D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-			indexBufferData.pSysMem = indexes_.data();
+			indexBufferData.pSysMem = index_data;
 			indexBufferData.SysMemPitch = 0;
 			indexBufferData.SysMemSlicePitch = 0;
-			CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * (unsigned int)indexes_.size(), D3D11_BIND_INDEX_BUFFER);
+			CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * index_count_, D3D11_BIND_INDEX_BUFFER);
 			hr = dev->CreateBuffer(&indexBufferDesc, &indexBufferData, g_pIndexBuffer.GetAddressOf());
 
 			if (FAILED(hr)) {
@@ -261,6 +760,7 @@ void TinyObj::InitBuffer(ID3D11Device* dev, ID3D11DeviceContext* devCon) {
 			/**/
 		}
 
+		cache_file_.reset();
 		isInit_ = true;
 	}
 }
@@ -0,0 +1,214 @@
+#include <vertex_format.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+//Rounds to the nearest half float, flushing the denormals to zero
+static uint16_t FloatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x007FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF) { return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0); }
+	if (exponent <= 0) { return sign; }
+	if (exponent >= 31) { return sign | 0x7C00; }
+
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	//Round to nearest, ties to even. A carry into the exponent is still the right result
+	uint32_t rest = mantissa & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0)) { half++; }
+
+	return sign | (uint16_t)half;
+}
+
+static float HalfToFloat(uint16_t half) {
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits = sign;
+
+	if (exponent == 0x1F) { bits |= 0x7F800000 | (mantissa << 13); }
+	else if (exponent != 0) { bits |= ((exponent - 15 + 127) << 23) | (mantissa << 13); }
+	else if (mantissa != 0) {
+		//Denormal, normalize it
+		exponent = 127 - 15 + 1;
+		while ((mantissa & 0x400) == 0) { mantissa <<= 1; exponent--; }
+		bits |= (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//Projects the normal on an octahedron and unfolds it on a square, which keeps the precision even in every direction
+static glm::vec2 EncodeOctahedral(glm::vec3 n) {
+	float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (length == 0.0f) { return glm::vec2(0.0f); }
+	n /= length;
+
+	glm::vec2 result(n.x, n.y);
+	if (n.z < 0.0f) {
+		result.x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		result.y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return result;
+}
+
+static glm::vec3 DecodeOctahedral(glm::vec2 e) {
+	glm::vec3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+static int16_t FloatToSnorm16(float value) {
+	return (int16_t)roundf(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+VertexLayout ChooseVertexLayout(const std::vector<Vertex>& vertices, bool quantize_positions) {
+	VertexLayout layout;
+	memset(&layout, 0, sizeof(VertexLayout));
+
+	layout.quantized_positions_ = quantize_positions && !vertices.empty();
+	layout.index_size_ = vertices.size() <= kMaxShortIndexVertices ? sizeof(uint16_t) : sizeof(uint32_t);
+	layout.position_scale_ = 1.0f;
+
+	//Parsers leave the vertices white when the file has no colors
+	for (size_t i = 0; i < vertices.size() && !layout.has_colors_; ++i) {
+		layout.has_colors_ = vertices[i].color_ != glm::vec3(1.0f);
+	}
+
+	if (layout.quantized_positions_) {
+		glm::vec3 bounds_min = vertices[0].position_;
+		glm::vec3 bounds_max = vertices[0].position_;
+		for (size_t i = 1; i < vertices.size(); ++i) {
+			bounds_min = glm::min(bounds_min, vertices[i].position_);
+			bounds_max = glm::max(bounds_max, vertices[i].position_);
+		}
+
+		glm::vec3 extent = bounds_max - bounds_min;
+		float scale = std::max(extent.x, std::max(extent.y, extent.z));
+		layout.position_offset_[0] = bounds_min.x;
+		layout.position_offset_[1] = bounds_min.y;
+		layout.position_offset_[2] = bounds_min.z;
+		layout.position_scale_ = scale > 0.0f ? scale : 1.0f;
+	}
+
+	layout.normal_offset_ = layout.quantized_positions_ ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+	layout.uv_offset_ = layout.normal_offset_ + 2 * sizeof(int16_t);
+	layout.color_offset_ = layout.uv_offset_ + 2 * sizeof(uint16_t);
+	layout.stride_ = layout.has_colors_ ? layout.color_offset_ + 4 * sizeof(uint8_t) : layout.color_offset_;
+
+	return layout;
+}
+
+glm::mat4 GetDequantizeTransform(const VertexLayout& layout) {
+	if (!layout.quantized_positions_) { return glm::mat4(1.0f); }
+
+	glm::vec3 offset(layout.position_offset_[0], layout.position_offset_[1], layout.position_offset_[2]);
+	return glm::scale(glm::translate(glm::mat4(1.0f), offset), glm::vec3(layout.position_scale_));
+}
+
+void PackVertices(const VertexLayout& layout, const std::vector<Vertex>& vertices, std::vector<uint8_t>& out) {
+	out.assign(vertices.size() * layout.stride_, 0);
+
+	glm::vec3 offset(layout.position_offset_[0], layout.position_offset_[1], layout.position_offset_[2]);
+	float inverse_scale = 1.0f / layout.position_scale_;
+
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		const Vertex& v = vertices[i];
+		uint8_t* dst = out.data() + i * layout.stride_;
+
+		if (layout.quantized_positions_) {
+			glm::vec3 q = glm::clamp((v.position_ - offset) * inverse_scale, 0.0f, 1.0f) * 65535.0f;
+			uint16_t position[4] = { (uint16_t)roundf(q.x), (uint16_t)roundf(q.y), (uint16_t)roundf(q.z), 0 };
+			memcpy(dst, position, sizeof(position));
+		}
+		else {
+			memcpy(dst, &v.position_, 3 * sizeof(float));
+		}
+
+		glm::vec2 octahedral = EncodeOctahedral(v.normal_);
+		int16_t normal[2] = { FloatToSnorm16(octahedral.x), FloatToSnorm16(octahedral.y) };
+		memcpy(dst + layout.normal_offset_, normal, sizeof(normal));
+
+		uint16_t uv[2] = { FloatToHalf(v.uv_.x), FloatToHalf(v.uv_.y) };
+		memcpy(dst + layout.uv_offset_, uv, sizeof(uv));
+
+		if (layout.has_colors_) {
+			glm::vec3 c = glm::clamp(v.color_, 0.0f, 1.0f) * 255.0f;
+			uint8_t color[4] = { (uint8_t)roundf(c.r), (uint8_t)roundf(c.g), (uint8_t)roundf(c.b), 255 };
+			memcpy(dst + layout.color_offset_, color, sizeof(color));
+		}
+	}
+}
+
+void UnpackVertices(const VertexLayout& layout, const uint8_t* data, size_t count, std::vector<Vertex>& out) {
+	out.resize(count);
+
+	glm::vec3 offset(layout.position_offset_[0], layout.position_offset_[1], layout.position_offset_[2]);
+
+	for (size_t i = 0; i < count; ++i) {
+		Vertex& v = out[i];
+		const uint8_t* src = data + i * layout.stride_;
+
+		if (layout.quantized_positions_) {
+			uint16_t position[4];
+			memcpy(position, src, sizeof(position));
+			v.position_ = offset + glm::vec3(position[0], position[1], position[2]) * (layout.position_scale_ / 65535.0f);
+		}
+		else {
+			memcpy(&v.position_, src, 3 * sizeof(float));
+		}
+
+		int16_t normal[2];
+		memcpy(normal, src + layout.normal_offset_, sizeof(normal));
+		v.normal_ = DecodeOctahedral(glm::max(glm::vec2(normal[0], normal[1]) / 32767.0f, -1.0f));
+
+		uint16_t uv[2];
+		memcpy(uv, src + layout.uv_offset_, sizeof(uv));
+		v.uv_ = glm::vec2(HalfToFloat(uv[0]), HalfToFloat(uv[1]));
+
+		v.color_ = glm::vec3(1.0f);
+		if (layout.has_colors_) {
+			uint8_t color[4];
+			memcpy(color, src + layout.color_offset_, sizeof(color));
+			v.color_ = glm::vec3(color[0], color[1], color[2]) / 255.0f;
+		}
+	}
+}
+
+void PackIndexes(const VertexLayout& layout, const std::vector<unsigned int>& indexes, std::vector<uint8_t>& out) {
+	out.resize(indexes.size() * layout.index_size_);
+
+	if (layout.index_size_ == sizeof(uint32_t)) {
+		memcpy(out.data(), indexes.data(), out.size());
+		return;
+	}
+
+	uint16_t* dst = (uint16_t*)out.data();
+	for (size_t i = 0; i < indexes.size(); ++i) { dst[i] = (uint16_t)indexes[i]; }
+}
+
+void UnpackIndexes(const VertexLayout& layout, const uint8_t* data, size_t count, std::vector<unsigned int>& out) {
+	out.resize(count);
+
+	if (layout.index_size_ == sizeof(uint32_t)) {
+		memcpy(out.data(), data, count * sizeof(uint32_t));
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		uint16_t index;
+		memcpy(&index, data + i * sizeof(uint16_t), sizeof(index));
+		out[i] = index;
+	}
+}
@@ -0,0 +1,93 @@
+#include <visibility.hpp>
+
+#include <algorithm>
+
+#include <boss.hpp>
+
+Visibility::Visibility() {
+	view_count_ = 0;
+}
+
+void Visibility::BeginFrame() {
+	view_count_ = 0;
+}
+
+uint32_t Visibility::AddView(const glm::mat4* view_projections, unsigned int frustum_count, bool shadow_view) {
+	if (views_.size() == view_count_) { views_.emplace_back(); }
+
+	VisibilityView& view = views_[view_count_];
+	view.frustum_count_ = std::min(frustum_count, kCubeFaceCount);
+	view.shadow_view_ = shadow_view;
+	view.visible_.clear();
+	for (unsigned int i = 0; i < view.frustum_count_; ++i) {
+		view.frustums_[i].Set(view_projections[i]);
+	}
+
+	return (uint32_t)view_count_++;
+}
+
+void Visibility::CullSubtree(const BoundsTree& tree, const VisibilityItems& items, const VisibilityView& view, Job* job) {
+	job->entities_.clear();
+	job->items_.clear();
+	tree.QueryFrustum(job->subtree_, view.frustums_, view.frustum_count_, &job->entities_);
+
+	for (size_t entity : job->entities_) {
+		uint32_t item = entity < items.item_of_entity_.size() ? items.item_of_entity_[entity] : kNoVisibilityItem;
+		if (item == kNoVisibilityItem) { continue; }
+		if (view.shadow_view_ && items.casts_shadows_[item] == 0) { continue; }
+		job->items_.push_back(item);
+	}
+}
+
+void Visibility::MergeView(const std::vector<Job>& jobs, size_t first_job, size_t job_count, VisibilityView* view) {
+	view->visible_.clear();
+	for (size_t i = first_job; i < first_job + job_count; ++i) {
+		view->visible_.insert(view->visible_.end(), jobs[i].items_.begin(), jobs[i].items_.end());
+	}
+
+	//The tree returns them in its own order, the draws go in the order of the items
+	std::sort(view->visible_.begin(), view->visible_.end());
+}
+
+void Visibility::Cull(const BoundsTree& tree, const VisibilityItems& items, Boss* boss) {
+	if (view_count_ == 0) { return; }
+
+	//Enough pieces for every worker, the views themselves already are some
+	size_t workers = boss != nullptr ? boss->get_worker_count() : 0;
+	size_t split = (workers * kVisibilityJobsPerWorker + view_count_ - 1) / view_count_;
+	split = std::clamp(split, (size_t)1, (size_t)kVisibilityMaxSubtrees);
+	tree.GetSubtrees(split, &subtrees_);
+	if (subtrees_.empty()) {
+		for (size_t i = 0; i < view_count_; ++i) { views_[i].visible_.clear(); }
+		return;
+	}
+
+	size_t subtree_count = subtrees_.size();
+	jobs_.resize(view_count_ * subtree_count);
+	for (size_t i = 0; i < jobs_.size(); ++i) {
+		jobs_[i].view_ = (uint32_t)(i / subtree_count);
+		jobs_[i].subtree_ = subtrees_[i % subtree_count];
+	}
+
+	if (boss == nullptr || jobs_.size() == 1) {
+		for (Job& job : jobs_) { CullSubtree(tree, items, views_[job.view_], &job); }
+		for (size_t i = 0; i < view_count_; ++i) { MergeView(jobs_, i * subtree_count, subtree_count, &views_[i]); }
+		return;
+	}
+
+	JobCounter cull_counter;
+	for (Job& job : jobs_) {
+		Job* j = &job;
+		const VisibilityView* view = &views_[job.view_];
+		boss->run([&tree, &items, view, j]() { CullSubtree(tree, items, *view, j); }, &cull_counter);
+	}
+	boss->wait(&cull_counter);
+
+	JobCounter merge_counter;
+	for (size_t i = 0; i < view_count_; ++i) {
+		VisibilityView* view = &views_[i];
+		const std::vector<Job>* jobs = &jobs_;
+		boss->run([jobs, i, subtree_count, view]() { MergeView(*jobs, i * subtree_count, subtree_count, view); }, &merge_counter);
+	}
+	boss->wait(&merge_counter);
+}
@@ -82,6 +82,7 @@ CREATE TABLE IF NOT EXISTS renderer(
   needs_light INTEGER NOT NULL,
   casts_shadow INTEGER NOT NULL,
   receives_shadows INTEGER NOT NULL,
+  occluder INTEGER NOT NULL DEFAULT 0,
   FOREIGN KEY (entity_id) REFERENCES entities(entity_id) ON DELETE CASCADE
   PRIMARY KEY (render_id)
 );
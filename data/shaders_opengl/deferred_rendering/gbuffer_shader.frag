@@ -9,6 +9,15 @@ in vec3 Normal;
 
 uniform sampler2D texture_diffuse;
 uniform sampler2D texture_specular;
+uniform sampler2DArray texture_array;
+uniform int texture_layer;
+uniform bool use_texture_array;
+
+//The base color comes from the layer of the array when the texture is packed
+vec4 BaseColor(vec2 uv) {
+	if (use_texture_array) { return texture(texture_array, vec3(uv, float(texture_layer))); }
+	return texture(texture_diffuse, uv);
+}
 
 void main() {
 	// store the fragment position vector in the first gbuffer texture;
@@ -16,7 +25,7 @@ void main() {
 	// also store the per-fragment normals into the gbuffer
 	gNormal = normalize(Normal);
 	// and the diffuse per-fragment color
-	gAlbedoSpec.rgb = texture(texture_diffuse, TexCoords).rgb;
+	gAlbedoSpec.rgb = BaseColor(TexCoords).rgb;
 	//store specular intensity in gAlbedSpec's alpha component
-	gAlbedoSpec.a = texture(texture_diffuse, TexCoords).r;
+	gAlbedoSpec.a = BaseColor(TexCoords).r;
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aCol;
-layout (location = 2) in vec3 aNormal;
+layout (location = 2) in vec2 aNormal;
 layout (location = 3) in vec2 aTexCoords;
 
 out vec3 FragPos;
@@ -12,13 +12,22 @@ uniform mat4 transform;
 uniform mat4 view;
 uniform mat4 projection;
 
+//Normals come octahedral encoded
+vec3 decodeNormal(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() {
 	vec4 worldPos = transform * vec4(aPos, 1.0);
 	FragPos = worldPos.xyz;
 	TexCoords = aTexCoords;
 
 	mat3 normalMatrix = transpose(inverse(mat3(transform)));
-	Normal = normalMatrix * aNormal;
+	Normal = normalMatrix * decodeNormal(aNormal);
 
 	gl_Position = projection * view * worldPos;
 }
\ No newline at end of file
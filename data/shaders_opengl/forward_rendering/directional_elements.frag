@@ -22,6 +22,14 @@ uniform bool needs_light;
 uniform DirectionalLight directional;
 uniform sampler2D directional_depthmap;
 uniform sampler2D texture1;
+uniform sampler2DArray texture_array;
+uniform int texture_layer;
+uniform bool use_texture_array;
+
+vec4 BaseColor(vec2 uv) {
+	if (use_texture_array) { return texture(texture_array, vec3(uv, float(texture_layer))); }
+	return texture(texture1, uv);
+}
 
 float ShadowCalculation(vec4 fragPosLightSpace){
     // perform perspective divide
@@ -68,7 +76,7 @@ void main() {
 
 	  // -- DIFFUSE --
 	  vec3 lightDir = normalize(-directional.direction);
-	  float diff = max(dot(Normal, lightDir), 0.0);
+	  float diff = max(dot(norm, lightDir), 0.0);
 	  // -- SPECULAR --
 	  vec3 reflectDir = reflect(-lightDir, norm);
 	  vec3 halfwayDir = normalize(lightDir + viewDir);
@@ -85,7 +93,7 @@ void main() {
 	  }
 	  else{shadow = 0.0;}
 
-	  vec3 result = (directional.ambient + (1.0 - shadow) * (diffuse + specular)) * vec3(texture(texture1, UV));
+	  vec3 result = (directional.ambient + (1.0 - shadow) * (diffuse + specular)) * vec3(BaseColor(UV));
 	  FragColor = vec4(result, 1.0);
   }
 }
\ No newline at end of file
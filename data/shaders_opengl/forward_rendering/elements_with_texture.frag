@@ -7,10 +7,18 @@ in vec3 FragPos;
 
 uniform bool needs_light;
 uniform sampler2D texture1;
+uniform sampler2DArray texture_array;
+uniform int texture_layer;
+uniform bool use_texture_array;
+
+vec4 BaseColor(vec2 uv) {
+	if (use_texture_array) { return texture(texture_array, vec3(uv, float(texture_layer))); }
+	return texture(texture1, uv);
+}
 
 void main() {
 	FragColor = vec4(0.0, 0.0, 0.0, 1.0);
 	if(float(needs_light) == 0.0){
-		FragColor = vec4(vec3(texture(texture1, UV)), 1.0);
+		FragColor = vec4(vec3(BaseColor(UV)), 1.0);
 	}
 }
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aCol;
-layout (location = 2) in vec3 aNorm;
+layout (location = 2) in vec2 aNorm;
 layout (location = 3) in vec2 aUV;
 
 out vec3 FragPos;
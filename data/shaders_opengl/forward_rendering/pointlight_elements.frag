@@ -23,8 +23,16 @@ uniform bool needs_light;
 uniform PointLight pointlight;
 uniform samplerCube pointlight_depthmap;
 uniform sampler2D texture1;
+uniform sampler2DArray texture_array;
+uniform int texture_layer;
+uniform bool use_texture_array;
 uniform float point_far_plane;
 
+vec4 BaseColor(vec2 uv) {
+	if (use_texture_array) { return texture(texture_array, vec3(uv, float(texture_layer))); }
+	return texture(texture1, uv);
+}
+
 // array of offset direction for sampling
 vec3 gridSamplingDisk[20] = vec3[]
 (
@@ -89,7 +97,7 @@ void main() {
 		}
 		else { shadow = 0.0; }
 
-		vec3 result = ((1.0 - shadow) * (diffuse + specular)) * vec3(texture(texture1, UV));
+		vec3 result = ((1.0 - shadow) * (diffuse + specular)) * vec3(BaseColor(UV));
 		FragColor = vec4(result, 1.0);
 	}
 
@@ -26,6 +26,14 @@ uniform bool needs_light;
 uniform SpotLight spotlight;
 uniform sampler2D spotlight_depthmap;
 uniform sampler2D texture1;
+uniform sampler2DArray texture_array;
+uniform int texture_layer;
+uniform bool use_texture_array;
+
+vec4 BaseColor(vec2 uv) {
+	if (use_texture_array) { return texture(texture_array, vec3(uv, float(texture_layer))); }
+	return texture(texture1, uv);
+}
 
 float ShadowCalculation(vec4 fragPosLightSpace){
     // perform perspective divide
@@ -96,7 +104,7 @@ void main(){
     }
     else{ shadow = 0.0;}  
 
-    vec3 result = ((1.0 - shadow) * (diffuse + specular)) * vec3(texture(texture1, UV));
+    vec3 result = ((1.0 - shadow) * (diffuse + specular)) * vec3(BaseColor(UV));
 	  FragColor = vec4(result, 1.0);
   }
 }
\ No newline at end of file
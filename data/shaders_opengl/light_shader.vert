@@ -4,7 +4,7 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aCol;
-layout (location = 2) in vec3 aNorm;
+layout (location = 2) in vec2 aNorm;
 layout (location = 3) in vec2 aUV;
 
 out vec3 FragPos;
@@ -22,11 +22,20 @@ uniform mat4 directionalLightMatrix;
 uniform mat4 spotlightLightMatrix;
 uniform vec3 viewPos;
 
+//Normals come octahedral encoded
+vec3 decodeNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
 void main() {
   CamView = viewPos;
   FragPos = vec3(transform * vec4(aPos, 1.0));
   Color = aCol;
-  Normal = transpose(inverse(mat3(transform))) * aNorm;
+  Normal = transpose(inverse(mat3(transform))) * decodeNormal(aNorm);
   UV = aUV;
   FragPosDirectionalLightSpace = directionalLightMatrix * vec4(FragPos, 1.0);
   FragPosSpotlightLightSpace = spotlightLightMatrix * vec4(FragPos, 1.0);
@@ -2,7 +2,9 @@ workspace "Enhanced_Valencian_Engine"
   projects_names = {
     "PR00_Demos",
     "PR01_Shadows",
-    "PR02_Audio"
+    "PR02_Audio",
+    "PR03_Streaming",
+    "PR04_Algorithms"
   }
 
   language "C++"
@@ -74,6 +76,8 @@ for j, prj in ipairs(projects_names) do
     if(prj == "PR00_Demos") then files{"tests/demos.cpp"}
     elseif(prj == "PR01_Shadows") then files{"tests/test_shadows.cpp"}
     elseif(prj == "PR02_Audio") then files{"tests/test_audio.cpp"}
+    elseif(prj == "PR03_Streaming") then files{"tests/test_streaming.cpp"}
+    elseif(prj == "PR04_Algorithms") then files{"tests/test_algorithms.cpp"}
     end
 
     includedirs {"./deps/","./code/**","./tests/"}
@@ -278,7 +278,7 @@ int main(int, char**) {
 	}
 
 	for (unsigned int i = 0; i < engine.getRenderSystem()->resource_list_.meshes_.size(); i++) {
-		engine.getRenderSystem()->resource_list_.meshes_.at(i)->InitBuffer();
+		engine.getRenderSystem()->resource_list_.meshes_.at(i)->InitBuffer(engine.getRenderSystem()->resource_list_.geometry_arena_);
 	}
 
 	for (unsigned int i = 0; i < engine.getRenderSystem()->resource_list_.textures_.size(); i++) {
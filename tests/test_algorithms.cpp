@@ -0,0 +1,658 @@
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "render_queue.hpp"
+#include "bounds_tree.hpp"
+#include "frustum_culling.hpp"
+#include "geometry_arena.hpp"
+#include "vertex_format.hpp"
+#include "texture_compressor.hpp"
+#include "mesh_optimizer.hpp"
+
+//Checks that failed on the whole run
+static int failures = 0;
+
+static void Check(bool condition, const char* what) {
+	if (!condition) {
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+//Same seed on every run so a failure can be repeated
+static std::mt19937 rng(1234);
+
+static float RandomFloat(float min, float max) {
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+// #### RENDER QUEUE ####
+
+static void TestRenderKeys() {
+	uint64_t camera_max = MakeRenderKey(RenderPass::kCamera, 63, 3, 0xFFFF, 0xFFFF, 1e30f);
+	uint64_t shadow_min = MakeRenderKey(RenderPass::kShadow, 0, 0, 0, 0, 0.0f);
+	Check(shadow_min > camera_max, "render key: the pass goes before every other field");
+
+	Check(MakeRenderKey(RenderPass::kCamera, 2, 0, 0, 0, 0.0f) > MakeRenderKey(RenderPass::kCamera, 1, 3, 0xFFFF, 0xFFFF, 1e30f),
+		"render key: the program goes before the cull mode, material, mesh and depth");
+	Check(MakeRenderKey(RenderPass::kCamera, 0, 0, 2, 0, 0.0f) > MakeRenderKey(RenderPass::kCamera, 0, 0, 1, 0xFFFF, 1e30f),
+		"render key: the material goes before the mesh and depth");
+	Check(MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 1, 0.0f) > MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 1e30f),
+		"render key: the farthest depth doesn't spill into the mesh");
+	Check(MakeRenderKey(RenderPass::kCamera, 0, 0, 0x10000, 0, 0.0f) == MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 0.0f),
+		"render key: fields too big keep only their lowest bits");
+	Check(MakeRenderKey(RenderPass::kCamera, 64, 0, 0, 0, 0.0f) == MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 0.0f),
+		"render key: programs too big don't change the pass");
+	Check(MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, -5.0f) == MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 0.0f),
+		"render key: negative distances are taken as 0");
+
+	bool monotonic = true;
+	uint64_t previous = MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 0.0f);
+	for (float distance = 0.25f; distance < 10000.0f; distance *= 1.1f) {
+		uint64_t key = MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, distance);
+		monotonic = monotonic && key >= previous;
+		previous = key;
+	}
+	Check(monotonic, "render key: farther objects never get a smaller depth");
+	Check(MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 1.0f) < MakeRenderKey(RenderPass::kCamera, 0, 0, 0, 0, 2.0f),
+		"render key: near objects are told apart");
+}
+
+//Sorts the packets with the queue and with std::stable_sort, the radix sort has to give the same order
+static bool SortsLikeStableSort(const std::vector<uint64_t>& keys) {
+	RenderQueue queue;
+	std::vector<RenderPacket> expected;
+	for (size_t i = 0; i < keys.size(); ++i) {
+		queue.Add(keys[i], (uint32_t)i);
+		expected.push_back({ keys[i], (uint32_t)i });
+	}
+	queue.Sort();
+	std::stable_sort(expected.begin(), expected.end(), [](const RenderPacket& a, const RenderPacket& b) { return a.key_ < b.key_; });
+
+	const std::vector<RenderPacket>& sorted = queue.GetPackets();
+	if (sorted.size() != expected.size()) { return false; }
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		if (sorted[i].key_ != expected[i].key_ || sorted[i].item_ != expected[i].item_) { return false; }
+	}
+
+	std::vector<uint32_t> items;
+	queue.GetItems(&items);
+	for (size_t i = 0; i < items.size(); ++i) {
+		if (items[i] != expected[i].item_) { return false; }
+	}
+	return true;
+}
+
+static void TestRenderQueue() {
+	Check(SortsLikeStableSort({}), "render queue: empty queue");
+	Check(SortsLikeStableSort({ 42 }), "render queue: one packet");
+
+	std::vector<uint64_t> keys;
+	for (int i = 0; i < 5000; ++i) { keys.push_back(((uint64_t)rng() << 32) | rng()); }
+	Check(SortsLikeStableSort(keys), "render queue: random keys");
+
+	//Repeated keys keep the order they were added in
+	std::vector<uint64_t> values;
+	for (int i = 0; i < 40; ++i) { values.push_back(((uint64_t)rng() << 32) | rng()); }
+	keys.clear();
+	for (int i = 0; i < 5000; ++i) { keys.push_back(values[rng() % values.size()]); }
+	Check(SortsLikeStableSort(keys), "render queue: repeated keys");
+
+	//Bytes that all the keys share are skipped
+	keys.clear();
+	for (int i = 0; i < 5000; ++i) {
+		keys.push_back(MakeRenderKey(RenderPass::kCamera, 3, 1, rng() % 8, rng() % 300, RandomFloat(0.0f, 50.0f)));
+	}
+	Check(SortsLikeStableSort(keys), "render queue: keys sharing their top bytes");
+	Check(SortsLikeStableSort(std::vector<uint64_t>(100, 7)), "render queue: all the keys equal");
+}
+
+// #### BOUNDS TREE ####
+
+static bool BoxesOverlap(const glm::vec3& a_min, const glm::vec3& a_max, const glm::vec3& b_min, const glm::vec3& b_max) {
+	return a_min.x <= b_max.x && a_max.x >= b_min.x && a_min.y <= b_max.y && a_max.y >= b_min.y &&
+		a_min.z <= b_max.z && a_max.z >= b_min.z;
+}
+
+static void RandomBox(glm::vec3* bounds_min, glm::vec3* bounds_max) {
+	*bounds_min = glm::vec3(RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f));
+	*bounds_max = *bounds_min + glm::vec3(RandomFloat(0.0f, 5.0f), RandomFloat(0.0f, 5.0f), RandomFloat(0.0f, 5.0f));
+}
+
+static void TestBoundsTree() {
+	const size_t count = 2000;
+	BoundsTree tree;
+	std::vector<glm::vec3> mins(count), maxs(count);
+	std::vector<int32_t> proxies(count, kBoundsTreeNullNode);
+
+	for (size_t i = 0; i < count; ++i) {
+		RandomBox(&mins[i], &maxs[i]);
+		proxies[i] = tree.CreateProxy(mins[i], maxs[i], i);
+	}
+
+	//Some leaves go away and others move, a little inside their enlarged box or far from it
+	for (size_t i = 0; i < count; i += 3) {
+		tree.DestroyProxy(proxies[i]);
+		proxies[i] = kBoundsTreeNullNode;
+	}
+	for (size_t i = 1; i < count; i += 5) {
+		if (proxies[i] == kBoundsTreeNullNode) { continue; }
+		glm::vec3 offset = (i % 2 == 0) ? glm::vec3(0.01f) : glm::vec3(RandomFloat(-50.0f, 50.0f), RandomFloat(-50.0f, 50.0f), 0.0f);
+		mins[i] += offset;
+		maxs[i] += offset;
+		tree.MoveProxy(proxies[i], mins[i], maxs[i]);
+	}
+
+	size_t alive = 0;
+	bool bounds_kept = true;
+	for (size_t i = 0; i < count; ++i) {
+		if (proxies[i] == kBoundsTreeNullNode) { continue; }
+		alive++;
+		glm::vec3 leaf_min, leaf_max;
+		tree.GetBounds(proxies[i], &leaf_min, &leaf_max);
+		bounds_kept = bounds_kept && leaf_min == mins[i] && leaf_max == maxs[i] && tree.GetEntity(proxies[i]) == i;
+	}
+	Check(tree.GetLeafCount() == alive, "bounds tree: leaf count after removing");
+	Check(bounds_kept, "bounds tree: leaves keep their exact box and entity");
+	Check(tree.GetHeight() <= 2 * (int32_t)ceil(log2((double)alive)), "bounds tree: the tree stays balanced");
+
+	bool aabb_matches = true;
+	bool sphere_matches = true;
+	for (int q = 0; q < 100; ++q) {
+		glm::vec3 query_min, query_max;
+		RandomBox(&query_min, &query_max);
+		query_max += glm::vec3(20.0f);
+
+		std::vector<size_t> found;
+		tree.QueryAabb(query_min, query_max, &found);
+		std::vector<size_t> expected;
+		for (size_t i = 0; i < count; ++i) {
+			if (proxies[i] != kBoundsTreeNullNode && BoxesOverlap(mins[i], maxs[i], query_min, query_max)) { expected.push_back(i); }
+		}
+		std::sort(found.begin(), found.end());
+		aabb_matches = aabb_matches && found == expected;
+
+		glm::vec3 center = (query_min + query_max) * 0.5f;
+		float radius = RandomFloat(1.0f, 30.0f);
+		found.clear();
+		tree.QuerySphere(center, radius, &found);
+		expected.clear();
+		for (size_t i = 0; i < count; ++i) {
+			if (proxies[i] == kBoundsTreeNullNode) { continue; }
+			glm::vec3 closest = glm::clamp(center, mins[i], maxs[i]);
+			if (glm::dot(closest - center, closest - center) <= radius * radius) { expected.push_back(i); }
+		}
+		std::sort(found.begin(), found.end());
+		sphere_matches = sphere_matches && found == expected;
+	}
+	Check(aabb_matches, "bounds tree: box queries find the same leaves as testing them all");
+	Check(sphere_matches, "bounds tree: sphere queries find the same leaves as testing them all");
+
+	//The tree only prunes whole subtrees, every leaf it returns passes the same test as when testing them one by one
+	Frustum frustum;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.5f, 1.0f, 80.0f);
+	frustum.Set(projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	std::vector<size_t> found;
+	tree.QueryFrustum(&frustum, 1, &found);
+	std::vector<size_t> expected;
+	for (size_t i = 0; i < count; ++i) {
+		if (proxies[i] == kBoundsTreeNullNode) { continue; }
+		if (TestBox(frustum, (mins[i] + maxs[i]) * 0.5f, (maxs[i] - mins[i]) * 0.5f) != FrustumResult::kOutside) { expected.push_back(i); }
+	}
+	std::sort(found.begin(), found.end());
+	Check(!expected.empty() && found == expected, "bounds tree: frustum queries find the same leaves as testing them all");
+
+	for (size_t i = 0; i < count; ++i) {
+		if (proxies[i] != kBoundsTreeNullNode) { tree.DestroyProxy(proxies[i]); }
+	}
+	found.clear();
+	tree.QueryAabb(glm::vec3(-1000.0f), glm::vec3(1000.0f), &found);
+	Check(tree.GetLeafCount() == 0 && tree.GetHeight() == -1 && found.empty(), "bounds tree: empty after removing every leaf");
+}
+
+// #### FRUSTUM CULLING ####
+
+static void TestFrustumBoxes() {
+	Frustum frustum;
+	glm::mat4 view_projection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f);
+	frustum.Set(view_projection);
+
+	Check(TestBox(frustum, glm::vec3(0.0f, 0.0f, -50.0f), glm::vec3(1.0f)) == FrustumResult::kInside, "frustum: box in the middle is inside");
+	Check(TestBox(frustum, glm::vec3(0.0f, 0.0f, 50.0f), glm::vec3(1.0f)) == FrustumResult::kOutside, "frustum: box behind is outside");
+	Check(TestBox(frustum, glm::vec3(0.0f, 0.0f, -200.0f), glm::vec3(1.0f)) == FrustumResult::kOutside, "frustum: box past the far plane is outside");
+	Check(TestBox(frustum, glm::vec3(0.0f, 0.0f, -100.0f), glm::vec3(1.0f)) == FrustumResult::kIntersecting, "frustum: box on the far plane intersects");
+	Check(TestBox(frustum, glm::vec3(-20.0f, 0.0f, -20.0f), glm::vec3(1.0f)) == FrustumResult::kIntersecting, "frustum: box on a side plane intersects");
+
+	//Same planes tested one at a time, away from the boundaries where the rounding could differ
+	glm::vec4 planes[kFrustumPlaneCount];
+	ExtractFrustumPlanes(view_projection, planes);
+	bool matches = true;
+	for (int i = 0; i < 10000; ++i) {
+		glm::vec3 center(RandomFloat(-120.0f, 120.0f), RandomFloat(-120.0f, 120.0f), RandomFloat(-150.0f, 20.0f));
+		glm::vec3 extent(RandomFloat(0.0f, 10.0f), RandomFloat(0.0f, 10.0f), RandomFloat(0.0f, 10.0f));
+
+		FrustumResult expected = FrustumResult::kInside;
+		bool near_boundary = false;
+		for (unsigned int p = 0; p < kFrustumPlaneCount; ++p) {
+			glm::vec3 normal(planes[p]);
+			float distance = glm::dot(normal, center) + planes[p].w;
+			float reach = glm::dot(glm::abs(normal), extent);
+			near_boundary = near_boundary || fabsf(distance + reach) < 1e-3f || fabsf(distance - reach) < 1e-3f;
+			if (distance + reach < 0.0f) { expected = FrustumResult::kOutside; }
+			else if (distance - reach < 0.0f && expected == FrustumResult::kInside) { expected = FrustumResult::kIntersecting; }
+		}
+		if (!near_boundary) { matches = matches && TestBox(frustum, center, extent) == expected; }
+	}
+	Check(matches, "frustum: the batched test gives the same as testing each plane");
+}
+
+// #### RANGE ALLOCATOR ####
+
+static void TestRangeAllocator() {
+	const uint32_t capacity = 4096;
+	RangeAllocator ranges;
+	ranges.Reset(capacity);
+
+	struct Range { uint32_t offset; uint32_t count; };
+	std::vector<Range> live;
+	std::vector<int> owner(capacity, -1);
+	uint32_t used = 0;
+	bool no_overlap = true;
+	bool aligned = true;
+	bool used_matches = true;
+
+	const uint32_t alignments[] = { 1, 2, 4, 16 };
+	for (int op = 0; op < 5000; ++op) {
+		if (live.empty() || rng() % 3 != 0) {
+			uint32_t count = 1 + rng() % 64;
+			uint32_t alignment = alignments[rng() % 4];
+			uint32_t offset = 0;
+			if (ranges.Allocate(count, alignment, &offset)) {
+				aligned = aligned && offset % alignment == 0 && offset + count <= capacity;
+				for (uint32_t u = offset; u < offset + count && u < capacity; ++u) {
+					no_overlap = no_overlap && owner[u] == -1;
+					owner[u] = op;
+				}
+				live.push_back({ offset, count });
+				used += count;
+			}
+		}
+		else {
+			size_t index = rng() % live.size();
+			Range range = live[index];
+			live[index] = live.back();
+			live.pop_back();
+			for (uint32_t u = range.offset; u < range.offset + range.count; ++u) { owner[u] = -1; }
+			ranges.Free(range.offset, range.count);
+			used -= range.count;
+		}
+		used_matches = used_matches && ranges.used() == used;
+	}
+	Check(no_overlap, "range allocator: allocations never overlap");
+	Check(aligned, "range allocator: allocations are aligned and inside the capacity");
+	Check(used_matches, "range allocator: used count follows the allocations");
+
+	for (const Range& range : live) { ranges.Free(range.offset, range.count); }
+	Check(ranges.used() == 0 && ranges.free_ranges() == 1, "range allocator: freeing everything merges it back into one range");
+
+	//Full, growing leaves the new room at the end
+	uint32_t offset = 0;
+	Check(ranges.Allocate(capacity, 1, &offset) && offset == 0, "range allocator: the whole capacity fits");
+	Check(!ranges.Allocate(1, 1, &offset), "range allocator: nothing fits once full");
+	ranges.Grow(capacity * 2);
+	Check(ranges.Allocate(capacity, 1, &offset) && offset == capacity, "range allocator: growing adds the room at the end");
+
+	//Compaction keeps the padding as used
+	ranges.Reset(100, 30);
+	Check(ranges.used() == 30 && ranges.free_ranges() == 1 && ranges.Allocate(70, 1, &offset) && offset == 30,
+		"range allocator: reset with the used part at the start");
+}
+
+// #### VERTEX FORMAT ####
+
+static std::vector<Vertex> RandomVertices(size_t count, bool colors) {
+	std::vector<Vertex> vertices(count);
+	for (Vertex& v : vertices) {
+		v.position_ = glm::vec3(RandomFloat(-50.0f, 50.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(0.0f, 30.0f));
+		v.normal_ = glm::normalize(glm::vec3(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f)) + glm::vec3(0.001f));
+		v.uv_ = glm::vec2(RandomFloat(0.0f, 4.0f), RandomFloat(-1.0f, 1.0f));
+		v.color_ = colors ? glm::vec3(RandomFloat(0.0f, 1.0f), RandomFloat(0.0f, 1.0f), RandomFloat(0.0f, 1.0f)) : glm::vec3(1.0f);
+	}
+	return vertices;
+}
+
+static void TestVertexPacking() {
+	std::vector<Vertex> vertices = RandomVertices(1000, true);
+
+	for (int quantize = 0; quantize < 2; ++quantize) {
+		VertexLayout layout = ChooseVertexLayout(vertices, quantize != 0);
+		Check(layout.quantized_positions_ == (quantize != 0) && layout.has_colors_ && layout.index_size_ == 2,
+			"vertex format: layout of a small mesh with colors");
+
+		std::vector<uint8_t> packed;
+		PackVertices(layout, vertices, packed);
+		Check(packed.size() == vertices.size() * layout.stride_, "vertex format: packed size");
+
+		std::vector<Vertex> unpacked;
+		UnpackVertices(layout, packed.data(), vertices.size(), unpacked);
+
+		float position_error = 0.0f;
+		float normal_dot = 1.0f;
+		float uv_error = 0.0f;
+		float color_error = 0.0f;
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			position_error = std::max(position_error, glm::length(unpacked[i].position_ - vertices[i].position_));
+			normal_dot = std::min(normal_dot, glm::dot(unpacked[i].normal_, vertices[i].normal_));
+			glm::vec2 uv_difference = glm::abs(unpacked[i].uv_ - vertices[i].uv_) / glm::max(glm::abs(vertices[i].uv_), glm::vec2(1.0f));
+			uv_error = std::max(uv_error, std::max(uv_difference.x, uv_difference.y));
+			glm::vec3 color_difference = glm::abs(unpacked[i].color_ - vertices[i].color_);
+			color_error = std::max(color_error, std::max(color_difference.x, std::max(color_difference.y, color_difference.z)));
+		}
+
+		//A quantization step on each axis, or exact for floats
+		float max_position_error = quantize != 0 ? layout.position_scale_ / 65535.0f * 1.8f : 0.0f;
+		Check(position_error <= max_position_error, "vertex format: position round trip");
+		Check(normal_dot > 0.9999f, "vertex format: octahedral normal round trip");
+		Check(uv_error <= 1.0f / 1024.0f, "vertex format: half float UV round trip");
+		Check(color_error <= 0.5f / 255.0f + 1e-5f, "vertex format: color round trip");
+
+		//Dequantizing on the GPU gives the same positions
+		glm::mat4 dequantize = GetDequantizeTransform(layout);
+		if (quantize != 0) {
+			uint16_t raw[4];
+			memcpy(raw, packed.data(), sizeof(raw));
+			glm::vec3 position = glm::vec3(dequantize * glm::vec4(glm::vec3(raw[0], raw[1], raw[2]) / 65535.0f, 1.0f));
+			Check(glm::length(position - unpacked[0].position_) < 1e-3f, "vertex format: dequantize transform");
+		}
+		else {
+			Check(dequantize == glm::mat4(1.0f), "vertex format: float positions don't need dequantizing");
+		}
+	}
+
+	//Meshes without colors leave them out and get them back white
+	std::vector<Vertex> white = RandomVertices(100, false);
+	VertexLayout white_layout = ChooseVertexLayout(white, true);
+	std::vector<uint8_t> packed;
+	PackVertices(white_layout, white, packed);
+	std::vector<Vertex> unpacked;
+	UnpackVertices(white_layout, packed.data(), white.size(), unpacked);
+	Check(!white_layout.has_colors_ && white_layout.stride_ == white_layout.color_offset_ && unpacked[50].color_ == glm::vec3(1.0f),
+		"vertex format: meshes without colors");
+
+	//Indexes
+	std::vector<unsigned int> indexes;
+	for (int i = 0; i < 3000; ++i) { indexes.push_back(rng() % (unsigned int)vertices.size()); }
+	VertexLayout layout = ChooseVertexLayout(vertices, false);
+	std::vector<unsigned int> unpacked_indexes;
+	PackIndexes(layout, indexes, packed);
+	UnpackIndexes(layout, packed.data(), indexes.size(), unpacked_indexes);
+	Check(packed.size() == indexes.size() * 2 && unpacked_indexes == indexes, "vertex format: 16 bit index round trip");
+
+	std::vector<Vertex> big = RandomVertices(kMaxShortIndexVertices + 10, false);
+	layout = ChooseVertexLayout(big, false);
+	indexes.clear();
+	for (int i = 0; i < 3000; ++i) { indexes.push_back(rng() % (unsigned int)big.size()); }
+	PackIndexes(layout, indexes, packed);
+	UnpackIndexes(layout, packed.data(), indexes.size(), unpacked_indexes);
+	Check(layout.index_size_ == 4 && unpacked_indexes == indexes, "vertex format: 32 bit indexes past the 16 bit range");
+}
+
+// #### TEXTURE COMPRESSION ####
+
+static void DecodeColor565(uint16_t packed, int color[3]) {
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+//Decodes a BC1 color block as the hardware does, BC3 always uses the four color mode
+static void DecodeColorBlock(const uint8_t* block, bool four_colors, uint8_t pixels[16][4]) {
+	uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+	uint32_t indexes = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+
+	int palette[4][4];
+	DecodeColor565(color0, palette[0]);
+	DecodeColor565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	palette[3][3] = 255;
+	for (int c = 0; c < 3; ++c) {
+		if (four_colors || color0 > color1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+			palette[3][3] = 0;
+		}
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		int p = (indexes >> (i * 2)) & 3;
+		for (int c = 0; c < 4; ++c) { pixels[i][c] = (uint8_t)palette[p][c]; }
+	}
+}
+
+static void DecodeAlphaBlock(const uint8_t* block, uint8_t pixels[16][4]) {
+	int alpha[8];
+	alpha[0] = block[0];
+	alpha[1] = block[1];
+	if (alpha[0] > alpha[1]) {
+		for (int i = 1; i < 7; ++i) { alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7; }
+	}
+	else {
+		for (int i = 1; i < 5; ++i) { alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5; }
+		alpha[6] = 0;
+		alpha[7] = 255;
+	}
+
+	uint64_t indexes = 0;
+	for (int i = 0; i < 6; ++i) { indexes |= (uint64_t)block[2 + i] << (i * 8); }
+	for (int i = 0; i < 16; ++i) { pixels[i][3] = (uint8_t)alpha[(indexes >> (i * 3)) & 7]; }
+}
+
+//Compresses and decodes an image, returning the largest error of any channel
+static int CompressionError(TextureFormat format, const std::vector<uint8_t>& rgba, int width, int height, double* mean_error) {
+	std::vector<uint8_t> blocks(GetTextureLevelSize(format, width, height));
+	CompressImage(format, rgba.data(), width, height, blocks.data());
+
+	size_t block_size = format == TextureFormat::kBC1 ? 8 : 16;
+	int blocks_x = (width + 3) / 4;
+	int max_error = 0;
+	double total_error = 0.0;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const uint8_t* block = blocks.data() + ((size_t)(y / 4) * blocks_x + x / 4) * block_size;
+			uint8_t pixels[16][4];
+			if (format == TextureFormat::kBC1) {
+				DecodeColorBlock(block, false, pixels);
+			}
+			else {
+				DecodeColorBlock(block + 8, true, pixels);
+				DecodeAlphaBlock(block, pixels);
+			}
+
+			const uint8_t* pixel = pixels[(y % 4) * 4 + x % 4];
+			const uint8_t* source = rgba.data() + ((size_t)y * width + x) * 4;
+			for (int c = 0; c < 4; ++c) {
+				int error = abs((int)pixel[c] - (int)source[c]);
+				max_error = std::max(max_error, error);
+				total_error += error;
+			}
+		}
+	}
+	*mean_error = total_error / ((double)width * height * 4);
+	return max_error;
+}
+
+static void TestTextureCompression() {
+	Check(GetTextureLevelSize(TextureFormat::kBC1, 10, 6) == 3 * 2 * 8, "texture compression: BC1 size rounds up to whole blocks");
+	Check(GetTextureLevelSize(TextureFormat::kBC3, 4, 4) == 16, "texture compression: BC3 block size");
+	Check(GetTextureLevelSize(TextureFormat::kRGBA8, 10, 6) == 10 * 6 * 4, "texture compression: uncompressed size");
+
+	//Colors 5:6:5 can store exactly
+	const uint8_t solid_colors[][4] = { { 255, 0, 0, 255 }, { 0, 255, 0, 255 }, { 8, 4, 8, 255 }, { 255, 255, 255, 255 } };
+	for (const uint8_t* color : solid_colors) {
+		std::vector<uint8_t> rgba;
+		for (int i = 0; i < 8 * 8; ++i) { rgba.insert(rgba.end(), color, color + 4); }
+		double mean_error = 0.0;
+		Check(CompressionError(TextureFormat::kBC1, rgba, 8, 8, &mean_error) == 0, "texture compression: BC1 solid colors are exact");
+		Check(CompressionError(TextureFormat::kBC3, rgba, 8, 8, &mean_error) == 0, "texture compression: BC3 solid colors are exact");
+	}
+
+	//Smooth gradient, with an edge that doesn't fill the last blocks. The channels change in different
+	//directions, so the blocks aren't on a line and some error is expected
+	const int width = 30, height = 18;
+	std::vector<uint8_t> gradient;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			gradient.push_back((uint8_t)(x * 255 / (width - 1)));
+			gradient.push_back((uint8_t)(y * 255 / (height - 1)));
+			gradient.push_back((uint8_t)(128 + (x - y) * 2));
+			gradient.push_back((uint8_t)(255 - (x + y) * 4));
+		}
+	}
+
+	std::vector<uint8_t> opaque = gradient;
+	for (size_t i = 3; i < opaque.size(); i += 4) { opaque[i] = 255; }
+	double mean_error = 0.0;
+	int max_error = CompressionError(TextureFormat::kBC1, opaque, width, height, &mean_error);
+	Check(max_error <= 32 && mean_error < 4.0, "texture compression: BC1 gradient error");
+
+	max_error = CompressionError(TextureFormat::kBC3, gradient, width, height, &mean_error);
+	Check(max_error <= 32 && mean_error < 4.0, "texture compression: BC3 gradient error with alpha");
+}
+
+// #### MESH OPTIMIZER ####
+
+//Grid of quads on the XY plane, with the height given at each vertex
+static void MakeGrid(int quads, float bump, std::vector<Vertex>* vertices, std::vector<unsigned int>* indexes) {
+	vertices->clear();
+	indexes->clear();
+	for (int y = 0; y <= quads; ++y) {
+		for (int x = 0; x <= quads; ++x) {
+			Vertex v;
+			v.position_ = glm::vec3((float)x / quads, (float)y / quads, 0.0f);
+			v.position_.z = bump * sinf(v.position_.x * 6.0f) * cosf(v.position_.y * 5.0f);
+			v.normal_ = glm::vec3(0.0f, 0.0f, 1.0f);
+			v.uv_ = glm::vec2(v.position_);
+			v.color_ = glm::vec3(1.0f);
+			vertices->push_back(v);
+		}
+	}
+	for (int y = 0; y < quads; ++y) {
+		for (int x = 0; x < quads; ++x) {
+			unsigned int corner = (unsigned int)(y * (quads + 1) + x);
+			unsigned int quad[6] = { corner, corner + 1, corner + quads + 2, corner, corner + quads + 2, corner + quads + 1 };
+			indexes->insert(indexes->end(), quad, quad + 6);
+		}
+	}
+}
+
+//Triangles rotated so the lowest index goes first, so reordering the triangles or their corners compares equal
+static std::vector<glm::uvec3> CanonicalTriangles(const std::vector<unsigned int>& indexes) {
+	std::vector<glm::uvec3> triangles;
+	for (size_t t = 0; t + 3 <= indexes.size(); t += 3) {
+		glm::uvec3 triangle(indexes[t], indexes[t + 1], indexes[t + 2]);
+		while (triangle.x > triangle.y || triangle.x > triangle.z) { triangle = glm::uvec3(triangle.y, triangle.z, triangle.x); }
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end(), [](const glm::uvec3& a, const glm::uvec3& b) {
+		return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+	});
+	return triangles;
+}
+
+static void TestVertexCache() {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indexes;
+	MakeGrid(48, 0.0f, &vertices, &indexes);
+
+	//Shuffled triangles, the worst case for the cache
+	std::vector<unsigned int> shuffled;
+	std::vector<size_t> order(indexes.size() / 3);
+	for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+	std::shuffle(order.begin(), order.end(), rng);
+	for (size_t t : order) { shuffled.insert(shuffled.end(), indexes.begin() + t * 3, indexes.begin() + t * 3 + 3); }
+
+	VertexCacheStats before = AnalyzeVertexCache(shuffled, vertices.size());
+	std::vector<unsigned int> optimized = shuffled;
+	OptimizeVertexCache(optimized, vertices);
+	VertexCacheStats after = AnalyzeVertexCache(optimized, vertices.size());
+
+	Check(CanonicalTriangles(optimized) == CanonicalTriangles(shuffled), "vertex cache: the triangles and their winding are kept");
+	Check(after.acmr_ < before.acmr_ && after.acmr_ < 0.85f, "vertex cache: Tipsify lowers the ACMR of a grid");
+	Check(after.atvr_ >= 1.0f && after.acmr_ >= 0.5f, "vertex cache: ratios within their limits");
+
+	//Fetch order follows the first use of each vertex
+	std::vector<Vertex> fetch_vertices = vertices;
+	std::vector<unsigned int> fetch_indexes = optimized;
+	OptimizeVertexFetch(fetch_vertices, fetch_indexes);
+	bool same_triangles = fetch_indexes.size() == optimized.size();
+	for (size_t i = 0; i < fetch_indexes.size() && same_triangles; ++i) {
+		same_triangles = fetch_vertices[fetch_indexes[i]].position_ == vertices[optimized[i]].position_;
+	}
+	unsigned int next = 0;
+	bool first_use_order = true;
+	for (unsigned int index : fetch_indexes) {
+		if (index > next) { first_use_order = false; }
+		if (index == next) { next++; }
+	}
+	Check(same_triangles && first_use_order, "vertex fetch: vertices reordered by their first use");
+}
+
+static void TestSimplify() {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indexes;
+
+	//A flat grid can go down to the target without moving its surface
+	MakeGrid(32, 0.0f, &vertices, &indexes);
+	size_t target = indexes.size() / 4;
+	float error = -1.0f;
+	std::vector<unsigned int> simplified = SimplifyMesh(vertices, indexes, target, 0.01f, &error);
+
+	bool valid = simplified.size() % 3 == 0;
+	for (size_t t = 0; t + 3 <= simplified.size() && valid; t += 3) {
+		unsigned int a = simplified[t], b = simplified[t + 1], c = simplified[t + 2];
+		valid = a < vertices.size() && b < vertices.size() && c < vertices.size() && a != b && b != c && a != c;
+	}
+	Check(valid, "simplify: triangles reference existing vertices and aren't degenerate");
+	Check(!simplified.empty() && simplified.size() <= target, "simplify: a flat grid reaches the target");
+	Check(error >= 0.0f && error <= 0.01f, "simplify: a flat grid keeps the error under the limit");
+
+	//A bumpy one stops once collapsing would move its surface too much
+	MakeGrid(32, 0.05f, &vertices, &indexes);
+	error = -1.0f;
+	simplified = SimplifyMesh(vertices, indexes, 30, 0.002f, &error);
+	Check(simplified.size() > 30 && simplified.size() < indexes.size(), "simplify: a bumpy grid stops at the error limit");
+	Check(error >= 0.0f && error <= 0.002f, "simplify: a bumpy grid keeps the error under the limit");
+
+	std::vector<unsigned int> coarser = SimplifyMesh(vertices, indexes, 30, 0.01f, &error);
+	Check(coarser.size() < simplified.size() && error <= 0.01f, "simplify: a bigger error limit removes more triangles");
+}
+
+int main(int, char**) {
+	TestRenderKeys();
+	TestRenderQueue();
+	TestBoundsTree();
+	TestFrustumBoxes();
+	TestRangeAllocator();
+	TestVertexPacking();
+	TestTextureCompression();
+	TestVertexCache();
+	TestSimplify();
+
+	printf("Algorithms: %s, %d checks failed\n", failures == 0 ? "passed" : "FAILED", failures);
+	return failures == 0 ? 0 : 1;
+}
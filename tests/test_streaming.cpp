@@ -0,0 +1,99 @@
+#include "engine.hpp"
+
+#include <cstdio>
+
+//Triangles of the test mesh, enough for several pieces and several read windows
+const int kStreamTriangles = 200000;
+//Frames to wait for the streaming before giving up
+const int kStreamMaxFrames = 100000;
+
+/**
+ * @brief Writes a row of separate triangles along X, so every piece of the stream grows the bounds of the mesh
+ *
+ * @param path Where to write the OBJ
+ * @param triangles Triangles of the row, the mesh goes from 0 to this in X
+ *
+ * @return bool False if the file couldn't be written
+ */
+static bool WriteTriangleRow(const char* path, int triangles) {
+	FILE* file = fopen(path, "w");
+	if (file == nullptr) { return false; }
+
+	for (int i = 0; i < triangles; ++i) {
+		fprintf(file, "v %d 0 0\nv %d 1 0\nv %d 0 0\nf %d %d %d\n", i, i, i + 1, i * 3 + 1, i * 3 + 2, i * 3 + 3);
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int, char**) {
+	unsigned int const window_w = 1280, window_h = 720;
+	const char* path = "../data/meshes/streaming_test.obj";
+
+	if (!WriteTriangleRow(path, kStreamTriangles)) {
+		printf("FAILED: couldn't write %s\n", path);
+		return 1;
+	}
+
+	Engine engine = Engine(window_w, window_h);
+	Window* window = engine.getWindow();
+	window->set_title("Test Streaming");
+
+	// #### CAMERA ####
+	engine.getComponentManager()->NewPerspectiveCamera(45.0f, (float)window_w / (float)window_h, 1.0f, 2000.0f);
+
+	std::shared_ptr<TinyObj> mesh = engine.StreamMesh(path);
+	size_t entity = engine.getComponentManager()->NewRenderer(mesh);
+	RendererComponent* renderer = engine.getComponentManager()->get_component<RendererComponent>(entity);
+
+	//The leaf is made with the first pieces and has to follow the ones coming in later frames
+	int frames = 0;
+	bool leaf_before_end = false;
+	while (window->is_open() && mesh->streaming_ && frames < kStreamMaxFrames) {
+		engine.Update();
+		engine.Render();
+		if (mesh->streaming_ && renderer->bounds_proxy_ != kBoundsTreeNullNode) { leaf_before_end = true; }
+		frames++;
+	}
+	//The last pieces are moved into the tree when the next frame is rendered
+	engine.Update();
+	engine.Render();
+
+	int failed = 0;
+	if (mesh->streaming_) {
+		printf("FAILED: the mesh is still streaming after %d frames\n", frames);
+		failed++;
+	}
+	if (mesh->streamed_chunks_.size() < 2 || !leaf_before_end) {
+		printf("FAILED: the mesh came in %u pieces, the leaf %s made before the end\n",
+			(unsigned int)mesh->streamed_chunks_.size(), leaf_before_end ? "was" : "wasn't");
+		failed++;
+	}
+
+	glm::vec3 expected_min = glm::vec3(0.0f, 0.0f, 0.0f);
+	glm::vec3 expected_max = glm::vec3((float)kStreamTriangles, 1.0f, 0.0f);
+	if (mesh->bounds_min_ != expected_min || mesh->bounds_max_ != expected_max) {
+		printf("FAILED: mesh bounds (%f %f %f) (%f %f %f)\n", mesh->bounds_min_.x, mesh->bounds_min_.y, mesh->bounds_min_.z,
+			mesh->bounds_max_.x, mesh->bounds_max_.y, mesh->bounds_max_.z);
+		failed++;
+	}
+
+	if (renderer->bounds_proxy_ == kBoundsTreeNullNode) {
+		printf("FAILED: the renderer has no leaf\n");
+		failed++;
+	}
+	else {
+		glm::vec3 leaf_min, leaf_max;
+		engine.getComponentManager()->bounds_tree_.GetBounds(renderer->bounds_proxy_, &leaf_min, &leaf_max);
+		if (leaf_min != expected_min || leaf_max != expected_max) {
+			printf("FAILED: leaf bounds (%f %f %f) (%f %f %f)\n", leaf_min.x, leaf_min.y, leaf_min.z,
+				leaf_max.x, leaf_max.y, leaf_max.z);
+			failed++;
+		}
+	}
+
+	remove(path);
+	printf("Streaming: %s, %u pieces in %d frames\n", failed == 0 ? "passed" : "FAILED",
+		(unsigned int)mesh->streamed_chunks_.size(), frames);
+	return failed == 0 ? 0 : 1;
+}